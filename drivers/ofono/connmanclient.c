@@ -0,0 +1,620 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "utils.h"
+#include "connmanclient.h"
+
+struct connman_service {
+	struct connman_client *client;
+	gchar *path;
+	GDBusProxy *proxy;
+	gulong signal_id;
+	GCancellable *cancellable;
+	gchar *state;
+	bool favorite;
+	bool autoconnect;
+	ofono_property_changed_cb prop_changed_cb;
+	void *prop_changed_data;
+};
+
+struct connman_client {
+	GDBusConnection *conn;
+	GCancellable *cancellable;
+	guint watch;
+	GDBusProxy *manager_proxy;
+	gulong manager_signal;
+	GHashTable *services;
+	struct connman_service *cellular_service;
+	connman_client_service_changed_cb service_changed_cb;
+	void *service_changed_data;
+};
+
+/* Async requests keep a reference to the cancellable of their owner so we can
+ * detect in the reply that the owner was freed in the meantime */
+struct connman_call {
+	void *owner;
+	GCancellable *cancellable;
+};
+
+static struct connman_call* connman_call_new(void *owner, GCancellable *cancellable)
+{
+	struct connman_call *call;
+
+	call = g_new0(struct connman_call, 1);
+	call->owner = owner;
+	call->cancellable = g_object_ref(cancellable);
+
+	return call;
+}
+
+static void* connman_call_finish(struct connman_call *call)
+{
+	void *owner = NULL;
+
+	if (!g_cancellable_is_cancelled(call->cancellable))
+		owner = call->owner;
+
+	g_object_unref(call->cancellable);
+	g_free(call);
+
+	return owner;
+}
+
+static bool is_cellular_service_path(const gchar *path)
+{
+	return g_strrstr(path, "cellular") != NULL;
+}
+
+static void notify_service_property(struct connman_service *service, const gchar *name)
+{
+	if (service->prop_changed_cb)
+		service->prop_changed_cb(name, service->prop_changed_data);
+}
+
+static void update_service_property(struct connman_service *service, const gchar *name, GVariant *value)
+{
+	bool bool_value;
+
+	if (g_str_equal(name, "State")) {
+		if (g_strcmp0(service->state, g_variant_get_string(value, NULL)) == 0)
+			return;
+
+		g_free(service->state);
+		service->state = g_variant_dup_string(value, NULL);
+	}
+	else if (g_str_equal(name, "Favorite")) {
+		bool_value = g_variant_get_boolean(value);
+		if (bool_value == service->favorite)
+			return;
+
+		service->favorite = bool_value;
+	}
+	else if (g_str_equal(name, "AutoConnect")) {
+		bool_value = g_variant_get_boolean(value);
+		if (bool_value == service->autoconnect)
+			return;
+
+		service->autoconnect = bool_value;
+	}
+	else {
+		return;
+	}
+
+	notify_service_property(service, name);
+}
+
+static void update_service_properties(struct connman_service *service, GVariant *properties)
+{
+	gchar *name = NULL;
+	GVariant *value = NULL;
+	GVariantIter iter;
+
+	g_variant_iter_init(&iter, properties);
+	while (g_variant_iter_loop(&iter, "{sv}", &name, &value))
+		update_service_property(service, name, value);
+}
+
+static void service_signal_cb(GDBusProxy *proxy, gchar *sender_name, gchar *signal_name,
+							  GVariant *parameters, gpointer user_data)
+{
+	struct connman_service *service = user_data;
+	GVariant *value = NULL;
+	const gchar *name = NULL;
+
+	if (g_strcmp0(signal_name, "PropertyChanged") != 0)
+		return;
+
+	g_variant_get(parameters, "(&sv)", &name, &value);
+	update_service_property(service, name, value);
+	g_variant_unref(value);
+}
+
+static void service_proxy_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct connman_service *service = connman_call_finish(user_data);
+	GError *error = NULL;
+	GDBusProxy *proxy;
+
+	proxy = g_dbus_proxy_new_finish(res, &error);
+	if (!proxy) {
+		if (service)
+			g_warning("[ConnMan] Failed to create proxy for service %s: %s", service->path, error->message);
+		g_error_free(error);
+		return;
+	}
+
+	if (!service) {
+		g_object_unref(proxy);
+		return;
+	}
+
+	service->proxy = proxy;
+	service->signal_id = g_signal_connect(service->proxy, "g-signal",
+										  G_CALLBACK(service_signal_cb), service);
+}
+
+static struct connman_service* connman_service_create(struct connman_client *client, const gchar *path)
+{
+	struct connman_service *service;
+
+	service = g_new0(struct connman_service, 1);
+	service->client = client;
+	service->path = g_strdup(path);
+	service->cancellable = g_cancellable_new();
+
+	g_dbus_proxy_new(client->conn, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES, NULL,
+					 "net.connman", path, "net.connman.Service", service->cancellable,
+					 service_proxy_cb, connman_call_new(service, service->cancellable));
+
+	return service;
+}
+
+static void connman_service_free(struct connman_service *service)
+{
+	if (!service)
+		return;
+
+	g_cancellable_cancel(service->cancellable);
+	g_object_unref(service->cancellable);
+
+	if (service->proxy) {
+		g_signal_handler_disconnect(service->proxy, service->signal_id);
+		g_object_unref(service->proxy);
+	}
+
+	g_free(service->state);
+	g_free(service->path);
+	g_free(service);
+}
+
+static void select_cellular_service(struct connman_client *client)
+{
+	struct connman_service *service = NULL;
+	GHashTableIter iter;
+	gpointer value;
+
+	/* FIXME we assume here that we only have one cellular service. When we come to
+	 * the point where we support multi-sim modems we have to revisit this decision */
+	if (client->cellular_service)
+		return;
+
+	g_hash_table_iter_init(&iter, client->services);
+	if (g_hash_table_iter_next(&iter, NULL, &value))
+		service = value;
+
+	if (!service)
+		return;
+
+	g_message("[ConnMan] Using cellular service %s", service->path);
+
+	client->cellular_service = service;
+
+	if (client->service_changed_cb)
+		client->service_changed_cb(service, client->service_changed_data);
+}
+
+static void update_service(struct connman_client *client, const gchar *path, GVariant *properties)
+{
+	struct connman_service *service;
+
+	if (!is_cellular_service_path(path))
+		return;
+
+	service = g_hash_table_lookup(client->services, path);
+	if (!service) {
+		g_message("[ConnMan] Found cellular service %s", path);
+		service = connman_service_create(client, path);
+		g_hash_table_insert(client->services, service->path, service);
+	}
+
+	update_service_properties(service, properties);
+}
+
+static void remove_service(struct connman_client *client, const gchar *path)
+{
+	bool current = false;
+
+	if (!g_hash_table_contains(client->services, path))
+		return;
+
+	if (client->cellular_service && g_str_equal(client->cellular_service->path, path)) {
+		g_warning("[ConnMan] Current cellular service %s disappeared", path);
+		client->cellular_service = NULL;
+		current = true;
+	}
+
+	g_hash_table_remove(client->services, path);
+
+	if (current && client->service_changed_cb)
+		client->service_changed_cb(NULL, client->service_changed_data);
+}
+
+static void update_from_service_list(struct connman_client *client, GVariant *service_list)
+{
+	const gchar *path = NULL;
+	GVariant *properties = NULL;
+	GVariantIter iter;
+
+	g_variant_iter_init(&iter, service_list);
+	while (g_variant_iter_loop(&iter, "(&o@a{sv})", &path, &properties))
+		update_service(client, path, properties);
+
+	select_cellular_service(client);
+}
+
+static void manager_signal_cb(GDBusProxy *proxy, gchar *sender_name, gchar *signal_name,
+							  GVariant *parameters, gpointer user_data)
+{
+	struct connman_client *client = user_data;
+	GVariant *changed = NULL;
+	GVariant *removed = NULL;
+	const gchar *path = NULL;
+	GVariantIter iter;
+
+	if (g_strcmp0(signal_name, "ServicesChanged") != 0)
+		return;
+
+	changed = g_variant_get_child_value(parameters, 0);
+	removed = g_variant_get_child_value(parameters, 1);
+
+	g_variant_iter_init(&iter, removed);
+	while (g_variant_iter_next(&iter, "&o", &path))
+		remove_service(client, path);
+
+	update_from_service_list(client, changed);
+
+	g_variant_unref(changed);
+	g_variant_unref(removed);
+}
+
+static void get_services_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct connman_client *client = connman_call_finish(user_data);
+	GError *error = NULL;
+	GVariant *response = NULL;
+	GVariant *service_list = NULL;
+
+	response = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, &error);
+	if (!response) {
+		if (client)
+			g_warning("[ConnMan] Failed to retrieve list of services: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	if (client) {
+		service_list = g_variant_get_child_value(response, 0);
+		update_from_service_list(client, service_list);
+		g_variant_unref(service_list);
+	}
+
+	g_variant_unref(response);
+}
+
+static void manager_proxy_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct connman_client *client = connman_call_finish(user_data);
+	GError *error = NULL;
+	GDBusProxy *proxy;
+
+	proxy = g_dbus_proxy_new_finish(res, &error);
+	if (!proxy) {
+		if (client)
+			g_warning("[ConnMan] Failed to create proxy for connman manager: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	if (!client) {
+		g_object_unref(proxy);
+		return;
+	}
+
+	client->manager_proxy = proxy;
+	client->manager_signal = g_signal_connect(client->manager_proxy, "g-signal",
+											  G_CALLBACK(manager_signal_cb), client);
+
+	g_dbus_proxy_call(client->manager_proxy, "GetServices", NULL, G_DBUS_CALL_FLAGS_NONE,
+					  -1, client->cancellable, get_services_cb,
+					  connman_call_new(client, client->cancellable));
+}
+
+static void connman_appeared_cb(GDBusConnection *conn, const gchar *name, const gchar *name_owner,
+								gpointer user_data)
+{
+	struct connman_client *client = user_data;
+
+	g_message("connman dbus service available");
+
+	if (client->manager_proxy)
+		return;
+
+	g_dbus_proxy_new(client->conn, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES, NULL,
+					 "net.connman", "/", "net.connman.Manager", client->cancellable,
+					 manager_proxy_cb, connman_call_new(client, client->cancellable));
+}
+
+static void connman_vanished_cb(GDBusConnection *conn, const gchar *name, gpointer user_data)
+{
+	struct connman_client *client = user_data;
+	bool had_service = (client->cellular_service != NULL);
+
+	g_message("connman dbus service disappeared");
+
+	if (client->manager_proxy) {
+		g_signal_handler_disconnect(client->manager_proxy, client->manager_signal);
+		g_object_unref(client->manager_proxy);
+		client->manager_proxy = NULL;
+		client->manager_signal = 0;
+	}
+
+	client->cellular_service = NULL;
+	g_hash_table_remove_all(client->services);
+
+	if (had_service && client->service_changed_cb)
+		client->service_changed_cb(NULL, client->service_changed_data);
+}
+
+static void bus_get_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct connman_client *client = connman_call_finish(user_data);
+	GError *error = NULL;
+	GDBusConnection *conn;
+
+	conn = g_bus_get_finish(res, &error);
+	if (!conn) {
+		if (client)
+			g_critical("[ConnMan] Failed to connect to the system bus: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	if (!client) {
+		g_object_unref(conn);
+		return;
+	}
+
+	client->conn = conn;
+	client->watch = g_bus_watch_name_on_connection(client->conn, "net.connman",
+										G_BUS_NAME_WATCHER_FLAGS_NONE,
+										connman_appeared_cb, connman_vanished_cb, client, NULL);
+}
+
+struct connman_client* connman_client_create(void)
+{
+	struct connman_client *client;
+
+	client = g_try_new0(struct connman_client, 1);
+	if (!client)
+		return NULL;
+
+	client->cancellable = g_cancellable_new();
+	client->services = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+											 (GDestroyNotify) connman_service_free);
+
+	g_bus_get(G_BUS_TYPE_SYSTEM, client->cancellable, bus_get_cb,
+			  connman_call_new(client, client->cancellable));
+
+	return client;
+}
+
+void connman_client_free(struct connman_client *client)
+{
+	if (!client)
+		return;
+
+	g_cancellable_cancel(client->cancellable);
+	g_object_unref(client->cancellable);
+
+	if (client->watch)
+		g_bus_unwatch_name(client->watch);
+
+	if (client->manager_proxy) {
+		g_signal_handler_disconnect(client->manager_proxy, client->manager_signal);
+		g_object_unref(client->manager_proxy);
+	}
+
+	g_hash_table_destroy(client->services);
+
+	if (client->conn)
+		g_object_unref(client->conn);
+
+	g_free(client);
+}
+
+void connman_client_register_cellular_service_changed_cb(struct connman_client *client,
+														 connman_client_service_changed_cb cb, void *data)
+{
+	if (!client)
+		return;
+
+	client->service_changed_cb = cb;
+	client->service_changed_data = data;
+}
+
+struct connman_service* connman_client_get_cellular_service(struct connman_client *client)
+{
+	if (!client)
+		return NULL;
+
+	return client->cellular_service;
+}
+
+void connman_service_register_prop_changed_cb(struct connman_service *service,
+											  ofono_property_changed_cb cb, void *data)
+{
+	if (!service)
+		return;
+
+	service->prop_changed_cb = cb;
+	service->prop_changed_data = data;
+}
+
+const gchar* connman_service_get_path(struct connman_service *service)
+{
+	if (!service)
+		return NULL;
+
+	return service->path;
+}
+
+const gchar* connman_service_get_state(struct connman_service *service)
+{
+	if (!service)
+		return NULL;
+
+	return service->state;
+}
+
+bool connman_service_is_connected(struct connman_service *service)
+{
+	if (!service)
+		return false;
+
+	return g_strcmp0(service->state, "ready") == 0 ||
+		   g_strcmp0(service->state, "online") == 0;
+}
+
+bool connman_service_get_favorite(struct connman_service *service)
+{
+	if (!service)
+		return false;
+
+	return service->favorite;
+}
+
+bool connman_service_get_autoconnect(struct connman_service *service)
+{
+	if (!service)
+		return false;
+
+	return service->autoconnect;
+}
+
+static void service_call_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct cb_data *cbd = user_data;
+	ofono_base_result_cb cb = cbd->cb;
+	struct ofono_error oerr;
+	GError *error = NULL;
+	GVariant *result;
+
+	result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+	if (!result) {
+		oerr.type = OFONO_ERROR_TYPE_FAILED;
+		oerr.message = error->message;
+		if (cb)
+			cb(&oerr, cbd->data);
+		g_error_free(error);
+		goto cleanup;
+	}
+
+	g_variant_unref(result);
+
+	if (cb)
+		cb(NULL, cbd->data);
+
+cleanup:
+	cb_data_free(cbd);
+}
+
+static void service_call(struct connman_service *service, const gchar *method, GVariant *parameters,
+						 ofono_base_result_cb cb, void *data)
+{
+	struct ofono_error error;
+
+	if (!service || !service->client->conn) {
+		error.type = OFONO_ERROR_TYPE_FAILED;
+		error.message = "Service not available";
+		if (parameters)
+			g_variant_unref(g_variant_ref_sink(parameters));
+		if (cb)
+			cb(&error, data);
+		return;
+	}
+
+	g_dbus_connection_call(service->client->conn, "net.connman", service->path,
+						   "net.connman.Service", method, parameters, NULL,
+						   G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+						   service_call_cb, cb_data_new(cb, data));
+}
+
+void connman_service_connect(struct connman_service *service, ofono_base_result_cb cb, void *data)
+{
+	/* nothing to do when we're already connected */
+	if (connman_service_is_connected(service)) {
+		if (cb)
+			cb(NULL, data);
+		return;
+	}
+
+	service_call(service, "Connect", NULL, cb, data);
+}
+
+void connman_service_disconnect(struct connman_service *service, ofono_base_result_cb cb, void *data)
+{
+	if (service && !connman_service_is_connected(service)) {
+		if (cb)
+			cb(NULL, data);
+		return;
+	}
+
+	service_call(service, "Disconnect", NULL, cb, data);
+}
+
+void connman_service_set_autoconnect(struct connman_service *service, bool autoconnect,
+									 ofono_base_result_cb cb, void *data)
+{
+	if (service && service->autoconnect == autoconnect) {
+		if (cb)
+			cb(NULL, data);
+		return;
+	}
+
+	service_call(service, "SetProperty",
+				 g_variant_new("(sv)", "AutoConnect", g_variant_new_boolean(autoconnect)),
+				 cb, data);
+}
+
+// vim:ts=4:sw=4:noexpandtab
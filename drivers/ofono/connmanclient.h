@@ -0,0 +1,55 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef CONNMAN_CLIENT_H_
+#define CONNMAN_CLIENT_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "ofonobase.h"
+
+struct connman_client;
+struct connman_service;
+
+typedef void (*connman_client_service_changed_cb)(struct connman_service *service, void *data);
+
+struct connman_client* connman_client_create(void);
+void connman_client_free(struct connman_client *client);
+
+void connman_client_register_cellular_service_changed_cb(struct connman_client *client,
+														 connman_client_service_changed_cb cb, void *data);
+struct connman_service* connman_client_get_cellular_service(struct connman_client *client);
+
+void connman_service_register_prop_changed_cb(struct connman_service *service,
+											  ofono_property_changed_cb cb, void *data);
+
+const gchar* connman_service_get_path(struct connman_service *service);
+const gchar* connman_service_get_state(struct connman_service *service);
+bool connman_service_is_connected(struct connman_service *service);
+bool connman_service_get_favorite(struct connman_service *service);
+bool connman_service_get_autoconnect(struct connman_service *service);
+
+void connman_service_connect(struct connman_service *service, ofono_base_result_cb cb, void *data);
+void connman_service_disconnect(struct connman_service *service, ofono_base_result_cb cb, void *data);
+void connman_service_set_autoconnect(struct connman_service *service, bool autoconnect,
+									 ofono_base_result_cb cb, void *data);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
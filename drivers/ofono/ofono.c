@@ -25,9 +25,15 @@ extern struct wan_driver ofono_wan_driver;
 
 #include "wanservice.h"
 #include "telephonyservice.h"
+#include "ofonoiothread.h"
+#include "ofonobase.h"
 
 void ofono_init(void)
 {
+	/* needs to be up before the drivers create their first proxies */
+	if (!ofono_io_thread_start())
+		g_warning("[ofono] Failed to start I/O thread; handling property changes on the main loop");
+
 	telephony_driver_register(&ofono_telephony_driver);
 	wan_driver_register(&ofono_wan_driver);
 }
@@ -36,6 +42,10 @@ void ofono_exit(void)
 {
 	wan_driver_unregister(&ofono_wan_driver);
 	telephony_driver_unregister(&ofono_telephony_driver);
+
+	ofono_io_thread_stop();
+
+	ofono_base_pools_shutdown();
 }
 
 // vim:ts=4:sw=4:noexpandtab
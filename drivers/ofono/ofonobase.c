@@ -24,44 +24,29 @@
 
 #include "utils.h"
 #include "ofonobase.h"
+#include "ofonoiothread.h"
+#include "glib-helpers.h"
 #include "ofono-interface.h"
+#include "flightrecorder.h"
+#include "slabpool.h"
+
+#define COMPLETIONS_PER_SLAB	32
+
+static struct slab_pool *completion_pool = NULL;
 
 struct ofono_base {
 	void *remote;
 	void *user_data;
 	gulong property_changed_signal;
+	struct ofono_io_watch *property_watch;
 	struct ofono_base_funcs *funcs;
 };
 
-static void set_property_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
-{
-	struct cb_data *cbd = user_data;
-	ofono_base_result_cb cb = cbd->cb;
-	struct ofono_base *base = cbd->user;
-	gboolean success = FALSE;
-	GError *error = NULL;
-	struct ofono_error oerr;
-
-	success = base->funcs->set_property_finish(base->remote, res, &error);
-	if (!success) {
-		oerr.message = error->message;
-		cb(&oerr, cbd->data);
-		g_error_free(error);
-	}
-	else {
-		cb(NULL, cbd->data);
-	}
-
-	g_free(cbd);
-}
-
 void ofono_base_set_property(struct ofono_base *base, const gchar *name, GVariant *value,
 						 ofono_base_result_cb cb, gpointer user_data)
 {
-	struct cb_data *cbd = cb_data_new(cb, user_data);
-	cbd->user = base;
-
-	base->funcs->set_property(base->remote, name, value, NULL, set_property_cb, cbd);
+	base->funcs->set_property(base->remote, name, value, NULL, ofono_completion_result_cb,
+		ofono_completion_new("SetProperty", base->remote, base->funcs->set_property_finish, cb, user_data));
 }
 
 static void handle_get_properties_result(struct ofono_base *base, GVariant *properties)
@@ -97,9 +82,20 @@ static void property_changed_cb(void *object, const gchar *name, GVariant *value
 {
 	struct ofono_base *base = user_data;
 
+	flight_recorder_record(FLIGHT_EVENT_PROPERTY_CHANGE, 0, 0, name);
+
 	base->funcs->update_property(name, g_variant_get_variant(value), base->user_data);
 }
 
+static void io_property_changed_cb(const gchar *name, GVariant *value, void *user_data)
+{
+	struct ofono_base *base = user_data;
+
+	flight_recorder_record(FLIGHT_EVENT_PROPERTY_CHANGE, 0, 0, name);
+
+	base->funcs->update_property(name, value, base->user_data);
+}
+
 struct ofono_base* ofono_base_create(struct ofono_base_funcs *funcs, void *remote, void *user_data)
 {
 	struct ofono_base *base;
@@ -114,8 +110,18 @@ struct ofono_base* ofono_base_create(struct ofono_base_funcs *funcs, void *remot
 	base->user_data = user_data;
 	base->funcs = funcs;
 
-	base->property_changed_signal = g_signal_connect(G_OBJECT(base->remote), "property-changed",
-		G_CALLBACK(property_changed_cb), base);
+	/* proxies which don't receive signals themselves get their property changes
+	 * through the I/O thread */
+	if (g_dbus_proxy_get_flags(G_DBUS_PROXY(base->remote)) & G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS) {
+		base->property_watch = ofono_io_thread_watch_properties(
+			g_dbus_proxy_get_object_path(G_DBUS_PROXY(base->remote)),
+			g_dbus_proxy_get_interface_name(G_DBUS_PROXY(base->remote)),
+			io_property_changed_cb, base);
+	}
+	else {
+		base->property_changed_signal = g_signal_connect(G_OBJECT(base->remote), "property-changed",
+			G_CALLBACK(property_changed_cb), base);
+	}
 
 	if (base->funcs->get_properties) {
 		base->funcs->get_properties(base->remote, NULL, get_properties_cb, base);
@@ -139,9 +145,113 @@ void ofono_base_free(struct ofono_base *base)
 	if (!base)
 		return;
 
-	g_signal_handler_disconnect(G_OBJECT(base->remote), base->property_changed_signal);
+	if (base->property_watch)
+		ofono_io_thread_unwatch(base->property_watch);
+	else
+		g_signal_handler_disconnect(G_OBJECT(base->remote), base->property_changed_signal);
 
 	g_free(base);
 }
 
+static const struct {
+	const gchar *name;
+	enum ofono_error_type type;
+} ofono_error_names[] = {
+	{ "org.ofono.Error.InvalidArguments", OFONO_ERROR_TYPE_INVALID_ARGUMENTS },
+	{ "org.ofono.Error.InvalidFormat", OFONO_ERROR_TYPE_INVALID_FORMAT },
+	{ "org.ofono.Error.NotImplemented", OFONO_ERROR_TYPE_NOT_IMPLEMENTED },
+	{ "org.ofono.Error.NotSupported", OFONO_ERROR_TYPE_NOT_IMPLEMENTED },
+	{ "org.ofono.Error.InProgress", OFONO_ERROR_TYPE_IN_PROGRESS },
+	{ "org.ofono.Error.Busy", OFONO_ERROR_TYPE_IN_PROGRESS },
+};
+
+/* Maps the D-Bus error ofono replied with to our error types; everything we
+ * don't know about (including local errors like timeouts) is a plain failure */
+enum ofono_error_type ofono_error_type_from_gerror(const GError *error)
+{
+	enum ofono_error_type type = OFONO_ERROR_TYPE_FAILED;
+	gchar *name;
+	int n;
+
+	if (!error || !g_dbus_error_is_remote_error(error))
+		return type;
+
+	name = g_dbus_error_get_remote_error(error);
+
+	for (n = 0; n < G_N_ELEMENTS(ofono_error_names); n++) {
+		if (g_strcmp0(name, ofono_error_names[n].name) == 0) {
+			type = ofono_error_names[n].type;
+			break;
+		}
+	}
+
+	g_free(name);
+
+	return type;
+}
+
+/* Records the reply to a method call in the flight recorder; the code is zero
+ * for success or the error type plus one */
+void ofono_base_record_reply(const gchar *method, const GError *error)
+{
+	flight_recorder_record(FLIGHT_EVENT_OFONO_REPLY, error ? ofono_error_type_from_gerror(error) + 1 : 0,
+						   0, method);
+}
+
+struct ofono_completion* ofono_completion_new(const gchar *method, void *remote, void *finish,
+											  void *cb, void *data)
+{
+	struct ofono_completion *completion;
+
+	if (!completion_pool)
+		completion_pool = slab_pool_new("ofono_completion", sizeof(struct ofono_completion),
+										COMPLETIONS_PER_SLAB);
+
+	completion = slab_pool_alloc0(completion_pool);
+	completion->method = method;
+	completion->remote = remote;
+	completion->finish = finish;
+	completion->cb = cb;
+	completion->data = data;
+
+	return completion;
+}
+
+void ofono_completion_free(struct ofono_completion *completion)
+{
+	slab_pool_release(completion_pool, completion);
+}
+
+/* Completes calls which don't return anything; finish has to be a
+ * glib_common_async_finish_cb and cb an ofono_base_result_cb */
+void ofono_completion_result_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	struct ofono_completion *completion = user_data;
+	glib_common_async_finish_cb finish = completion->finish;
+	ofono_base_result_cb cb = completion->cb;
+	struct ofono_error oerr;
+	GError *error = NULL;
+
+	finish(completion->remote, res, &error);
+	ofono_base_record_reply(completion->method, error);
+
+	if (error) {
+		oerr.type = ofono_error_type_from_gerror(error);
+		oerr.message = error->message;
+		cb(&oerr, completion->data);
+		g_error_free(error);
+	}
+	else {
+		cb(NULL, completion->data);
+	}
+
+	ofono_completion_free(completion);
+}
+
+void ofono_base_pools_shutdown(void)
+{
+	slab_pool_free(completion_pool);
+	completion_pool = NULL;
+}
+
 // vim:ts=4:sw=4:noexpandtab
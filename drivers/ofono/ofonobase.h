@@ -63,6 +63,28 @@ void ofono_base_free(struct ofono_base *base);
 void ofono_base_set_property(struct ofono_base *base, const gchar *name, GVariant *value,
 						 ofono_base_result_cb cb, gpointer user_data);
 
+enum ofono_error_type ofono_error_type_from_gerror(const GError *error);
+void ofono_base_record_reply(const gchar *method, const GError *error);
+
+/* Everything needed to finish an asynchronous method call on one of the proxies
+ * and pass the result on; used to take a cb_data chained to a second one
+ * holding the finish function */
+struct ofono_completion {
+	const gchar *method;
+	void *remote;
+	/* the _finish function of the call, e.g. a glib_common_async_finish_cb */
+	void *finish;
+	void *cb;
+	void *data;
+};
+
+struct ofono_completion* ofono_completion_new(const gchar *method, void *remote, void *finish,
+											  void *cb, void *data);
+void ofono_completion_free(struct ofono_completion *completion);
+void ofono_completion_result_cb(GObject *source, GAsyncResult *res, gpointer user_data);
+
+void ofono_base_pools_shutdown(void);
+
 #endif
 
 // vim:ts=4:sw=4:noexpandtab
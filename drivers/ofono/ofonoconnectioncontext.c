@@ -38,6 +38,7 @@ struct ofono_connection_context {
 	char *address;
 	char *netmask;
 	char *gateway;
+	char *interface;
 	enum ofono_connection_context_type type;
 	enum ofono_connection_context_protocol protocol;
 	char *name;
@@ -77,7 +78,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	const char *type_str;
 	const char *protocol_str;
 
-	g_message("[ConnectionContext:%s] property %s changed", ctx->path, name);
+	g_debug("[ConnectionContext:%s] property %s changed", ctx->path, name);
 
 	if (g_str_equal(name, "Active"))
 		ctx->active = g_variant_get_boolean(value);
@@ -131,6 +132,11 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 					g_free(ctx->gateway);
 				ctx->gateway = g_variant_dup_string(setting_value, NULL);
 			}
+			else if (g_strcmp0(setting_name, "Interface") == 0) {
+				if (ctx->interface)
+					g_free(ctx->interface);
+				ctx->interface = g_variant_dup_string(setting_value, NULL);
+			}
 		}
 	}
 
@@ -156,7 +162,7 @@ struct ofono_connection_context* ofono_connection_context_create(const gchar *pa
 		return NULL;
 
 	ctx->remote = ofono_interface_connection_context_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.ConnectionContext interface");
 		g_error_free(error);
@@ -221,6 +227,9 @@ void ofono_connection_context_free(struct ofono_connection_context *ctx)
 	if (ctx->gateway)
 		g_free(ctx->gateway);
 
+	if (ctx->interface)
+		g_free(ctx->interface);
+
 	if (ctx->remote)
 		g_object_unref(ctx->remote);
 
@@ -357,4 +366,12 @@ const char* ofono_connection_context_get_gateway(struct ofono_connection_context
 	return ctx->gateway;
 }
 
+const char* ofono_connection_context_get_interface(struct ofono_connection_context *ctx)
+{
+	if (!ctx)
+		return NULL;
+
+	return ctx->interface;
+}
+
 // vim:ts=4:sw=4:noexpandtab
@@ -72,6 +72,7 @@ void ofono_connection_context_set_name(struct ofono_connection_context *ctx, con
 const char* ofono_connection_context_get_address(struct ofono_connection_context *ctx);
 const char* ofono_connection_context_get_netmask(struct ofono_connection_context *ctx);
 const char* ofono_connection_context_get_gateway(struct ofono_connection_context *ctx);
+const char* ofono_connection_context_get_interface(struct ofono_connection_context *ctx);
 
 #endif
 
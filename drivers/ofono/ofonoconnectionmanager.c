@@ -69,7 +69,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	struct ofono_connection_manager *cm = user_data;
 	const char *bearer = NULL;
 
-	g_message("[ConnectionManager:%s] property %s changed", cm->path, name);
+	g_debug("[ConnectionManager:%s] property %s changed", cm->path, name);
 
 	if (g_str_equal(name, "Powered"))
 		cm->powered = g_variant_get_boolean(value);
@@ -194,7 +194,7 @@ void deactivate_all_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 	cb(NULL, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_connection_manager_deactivate_all(struct ofono_connection_manager *cm, ofono_base_result_cb cb, void *data)
@@ -307,7 +307,7 @@ static void get_contexts_cb(GObject *source, GAsyncResult *res, gpointer user_da
 	cb(NULL, cm->contexts, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_connection_manager_get_contexts(struct ofono_connection_manager *cm, ofono_connection_manager_get_contexts_cb cb, void *data)
@@ -383,7 +383,7 @@ void set_roaming_allowed_cb(struct ofono_error *error, void *data)
 	ofono_base_result_cb cb = cbd->cb;
 
 	cb(error, cbd->data);
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_connection_manager_set_roaming_allowed(struct ofono_connection_manager *cm, bool roaming_allowed,
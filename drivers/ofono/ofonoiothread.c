@@ -0,0 +1,545 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "ofonoiothread.h"
+
+/* During a modem reset ofono emits PropertyChanged signals faster than we can
+ * handle them on the main loop and everything else (most importantly the luna
+ * requests) would have to wait behind them. We therefore receive them on a
+ * dedicated thread with its own main context, coalesce them to the latest value
+ * per property and hand them over to the main thread in batches through a
+ * single producer/single consumer ring and an eventfd to wake it up. Method
+ * calls and all other signals stay on the main loop. */
+
+#define OFONO_IO_RING_SIZE			1024
+#define OFONO_IO_RING_MASK			(OFONO_IO_RING_SIZE - 1)
+/* Maximum time a property change is held back to be coalesced with further
+ * changes of the same property */
+#define OFONO_IO_COALESCE_MS		20
+
+/* Properties which drive a state machine on our side. Every transition counts
+ * (e.g. a call going through alerting to active) so they are never coalesced
+ * but handed over right away together with whatever is pending before them.
+ * Their type is checked here so the main thread doesn't get anything else. */
+static const struct {
+	const gchar *interface;
+	const gchar *name;
+	const gchar *type;
+} state_properties[] = {
+	{ "org.ofono.Modem", "Powered", "b" },
+	{ "org.ofono.Modem", "Online", "b" },
+	{ "org.ofono.VoiceCall", "State", "s" },
+	{ "org.ofono.NetworkRegistration", "Status", "s" },
+	{ "org.ofono.SimManager", "PinRequired", "s" },
+	{ "org.ofono.ConnectionManager", "Attached", "b" },
+	{ "org.ofono.ConnectionContext", "Active", "b" },
+	{ "org.ofono.Message", "State", "s" },
+};
+
+struct ofono_property_update {
+	/* "<path>\n<interface>\n<name>"; NULL for state properties as they
+	 * aren't coalesced */
+	gchar *key;
+	/* "<path>\n<interface>" */
+	gchar *object;
+	gchar *name;
+	GVariant *value;
+};
+
+struct ofono_io_watch {
+	gchar *object;
+	ofono_io_property_changed_cb cb;
+	void *data;
+	/* only used when there is no I/O thread */
+	GDBusConnection *conn;
+	guint subscription;
+};
+
+struct ofono_io_thread {
+	GThread *thread;
+	GMainContext *context;
+	GMainLoop *loop;
+	GDBusConnection *conn;
+	gchar *sender;
+
+	/* owned by the I/O thread; changes are handed over in the order the
+	 * properties first changed */
+	GHashTable *pending;
+	GQueue *pending_order;
+	GSource *flush_source;
+	unsigned int received;
+	unsigned int coalesced;
+
+	/* head is only written by the I/O thread, tail only by the main thread */
+	struct ofono_property_update *ring[OFONO_IO_RING_SIZE];
+	guint head;
+	guint tail;
+	int wakeup_fd;
+
+	/* owned by the main thread */
+	guint wakeup_watch;
+	GHashTable *watches;
+	GList *dispatch_next;
+};
+
+static struct ofono_io_thread *io_thread = NULL;
+
+static void free_property_update(struct ofono_property_update *update)
+{
+	if (!update)
+		return;
+
+	g_free(update->key);
+	g_free(update->object);
+	g_free(update->name);
+	if (update->value)
+		g_variant_unref(update->value);
+	g_free(update);
+}
+
+static bool ring_push(struct ofono_io_thread *iot, struct ofono_property_update *update)
+{
+	guint head = iot->head;
+
+	if (head - __atomic_load_n(&iot->tail, __ATOMIC_ACQUIRE) == OFONO_IO_RING_SIZE)
+		return false;
+
+	iot->ring[head & OFONO_IO_RING_MASK] = update;
+	__atomic_store_n(&iot->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static struct ofono_property_update* ring_pop(struct ofono_io_thread *iot)
+{
+	guint tail = iot->tail;
+	struct ofono_property_update *update;
+
+	if (tail == __atomic_load_n(&iot->head, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	update = iot->ring[tail & OFONO_IO_RING_MASK];
+	__atomic_store_n(&iot->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return update;
+}
+
+/* I/O thread */
+
+static gboolean flush_cb(gpointer user_data);
+
+static void schedule_flush(struct ofono_io_thread *iot)
+{
+	if (iot->flush_source)
+		return;
+
+	iot->flush_source = g_timeout_source_new(OFONO_IO_COALESCE_MS);
+	g_source_set_callback(iot->flush_source, flush_cb, iot, NULL);
+	g_source_attach(iot->flush_source, iot->context);
+}
+
+static void cancel_flush(struct ofono_io_thread *iot)
+{
+	if (!iot->flush_source)
+		return;
+
+	g_source_destroy(iot->flush_source);
+	g_source_unref(iot->flush_source);
+	iot->flush_source = NULL;
+}
+
+static void flush(struct ofono_io_thread *iot)
+{
+	struct ofono_property_update *update;
+	guint64 wakeup = 1;
+	bool pushed = false;
+
+	cancel_flush(iot);
+
+	while ((update = g_queue_pop_head(iot->pending_order)) != NULL) {
+		/* once it's in the ring it belongs to the main thread */
+		if (update->key)
+			g_hash_table_remove(iot->pending, update->key);
+
+		if (!ring_push(iot, update)) {
+			if (update->key)
+				g_hash_table_insert(iot->pending, update->key, update);
+			g_queue_push_head(iot->pending_order, update);
+			break;
+		}
+
+		pushed = true;
+	}
+
+	if (pushed && write(iot->wakeup_fd, &wakeup, sizeof(wakeup)) < 0)
+		g_warning("[ofono] Failed to wake up main thread: %s", strerror(errno));
+
+	/* the main thread didn't catch up yet so try again a bit later */
+	if (!g_queue_is_empty(iot->pending_order))
+		schedule_flush(iot);
+}
+
+static gboolean flush_cb(gpointer user_data)
+{
+	struct ofono_io_thread *iot = user_data;
+
+	/* returning FALSE destroys the source so we only drop our reference */
+	g_source_unref(iot->flush_source);
+	iot->flush_source = NULL;
+
+	flush(iot);
+
+	return FALSE;
+}
+
+/* Returns the expected type if the property drives a state machine */
+static const gchar* state_property_type(const gchar *interface, const gchar *name)
+{
+	unsigned int n;
+
+	for (n = 0; n < G_N_ELEMENTS(state_properties); n++) {
+		if (g_str_equal(state_properties[n].name, name) &&
+			g_str_equal(state_properties[n].interface, interface))
+			return state_properties[n].type;
+	}
+
+	return NULL;
+}
+
+static void io_signal_cb(GDBusConnection *conn, const gchar *sender, const gchar *path,
+						 const gchar *interface, const gchar *signal, GVariant *parameters,
+						 gpointer user_data)
+{
+	struct ofono_io_thread *iot = user_data;
+	struct ofono_property_update *update;
+	const gchar *name = NULL;
+	const gchar *state_type;
+	GVariant *value = NULL;
+	gchar *key;
+
+	if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)")))
+		return;
+
+	g_variant_get(parameters, "(&sv)", &name, &value);
+
+	iot->received++;
+
+	state_type = state_property_type(interface, name);
+	if (state_type) {
+		if (!g_variant_is_of_type(value, G_VARIANT_TYPE(state_type))) {
+			g_warning("[ofono] Ignoring %s of %s with unexpected type %s", name, path,
+					  g_variant_get_type_string(value));
+			g_variant_unref(value);
+			return;
+		}
+
+		update = g_new0(struct ofono_property_update, 1);
+		update->object = g_strdup_printf("%s\n%s", path, interface);
+		update->name = g_strdup(name);
+		update->value = value;
+
+		g_queue_push_tail(iot->pending_order, update);
+		flush(iot);
+		return;
+	}
+
+	key = g_strdup_printf("%s\n%s\n%s", path, interface, name);
+
+	update = g_hash_table_lookup(iot->pending, key);
+	if (update) {
+		g_variant_unref(update->value);
+		update->value = value;
+		iot->coalesced++;
+		g_free(key);
+		return;
+	}
+
+	update = g_new0(struct ofono_property_update, 1);
+	update->key = key;
+	update->object = g_strdup_printf("%s\n%s", path, interface);
+	update->name = g_strdup(name);
+	update->value = value;
+
+	g_hash_table_insert(iot->pending, update->key, update);
+	g_queue_push_tail(iot->pending_order, update);
+
+	schedule_flush(iot);
+}
+
+static gpointer io_thread_func(gpointer user_data)
+{
+	struct ofono_io_thread *iot = user_data;
+	guint subscription;
+
+	g_main_context_push_thread_default(iot->context);
+
+	/* signals get dispatched to the thread default context of the subscriber */
+	subscription = g_dbus_connection_signal_subscribe(iot->conn, iot->sender, NULL, "PropertyChanged",
+													  NULL, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+													  io_signal_cb, iot, NULL);
+
+	g_main_loop_run(iot->loop);
+
+	g_dbus_connection_signal_unsubscribe(iot->conn, subscription);
+
+	cancel_flush(iot);
+
+	g_message("[ofono] I/O thread received %u property changes, %u of them coalesced",
+			  iot->received, iot->coalesced);
+
+	g_main_context_pop_thread_default(iot->context);
+
+	return NULL;
+}
+
+/* main thread */
+
+static void dispatch_update(struct ofono_io_thread *iot, struct ofono_property_update *update)
+{
+	struct ofono_io_watch *watch;
+	GList *iter;
+
+	/* a watch can go away while we're calling out to its owner */
+	for (iter = g_hash_table_lookup(iot->watches, update->object); iter != NULL; iter = iot->dispatch_next) {
+		iot->dispatch_next = g_list_next(iter);
+		watch = iter->data;
+		watch->cb(update->name, update->value, watch->data);
+	}
+
+	iot->dispatch_next = NULL;
+}
+
+static gboolean wakeup_cb(GIOChannel *channel, GIOCondition cond, gpointer user_data)
+{
+	struct ofono_io_thread *iot = user_data;
+	struct ofono_property_update *update;
+	guint64 value;
+
+	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP)) {
+		iot->wakeup_watch = 0;
+		return FALSE;
+	}
+
+	if (read(iot->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		g_warning("[ofono] Failed to read from wakeup fd: %s", strerror(errno));
+
+	while ((update = ring_pop(iot)) != NULL) {
+		dispatch_update(iot, update);
+		free_property_update(update);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Starts receiving property changes from sender on conn. Used directly by the
+ * storm benchmark which talks to a fake ofono over a peer to peer connection
+ * (sender NULL then); the daemon goes through ofono_io_thread_start.
+ */
+bool ofono_io_thread_start_with_connection(GDBusConnection *conn, const gchar *sender)
+{
+	struct ofono_io_thread *iot;
+	GIOChannel *channel;
+
+	if (io_thread)
+		return true;
+
+	iot = g_new0(struct ofono_io_thread, 1);
+
+	iot->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (iot->wakeup_fd < 0) {
+		g_warning("[ofono] Failed to create wakeup fd: %s", strerror(errno));
+		g_free(iot);
+		return false;
+	}
+
+	iot->conn = g_object_ref(conn);
+	iot->sender = g_strdup(sender);
+	iot->pending = g_hash_table_new(g_str_hash, g_str_equal);
+	iot->pending_order = g_queue_new();
+	iot->watches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	channel = g_io_channel_unix_new(iot->wakeup_fd);
+	g_io_channel_set_encoding(channel, NULL, NULL);
+	g_io_channel_set_buffered(channel, FALSE);
+	iot->wakeup_watch = g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
+									   wakeup_cb, iot);
+	g_io_channel_unref(channel);
+
+	iot->context = g_main_context_new();
+	iot->loop = g_main_loop_new(iot->context, FALSE);
+
+	iot->thread = g_thread_new("ofono-io", io_thread_func, iot);
+
+	io_thread = iot;
+
+	return true;
+}
+
+bool ofono_io_thread_start(void)
+{
+	GDBusConnection *conn;
+	GError *error = NULL;
+	bool result;
+
+	conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (!conn) {
+		g_warning("[ofono] Failed to connect to system bus: %s", error->message);
+		g_error_free(error);
+		return false;
+	}
+
+	result = ofono_io_thread_start_with_connection(conn, "org.ofono");
+
+	g_object_unref(conn);
+
+	return result;
+}
+
+static gboolean quit_cb(gpointer user_data)
+{
+	GMainLoop *loop = user_data;
+
+	g_main_loop_quit(loop);
+
+	return FALSE;
+}
+
+void ofono_io_thread_stop(void)
+{
+	struct ofono_io_thread *iot = io_thread;
+	struct ofono_property_update *update;
+	GSource *source;
+
+	if (!iot)
+		return;
+
+	/* the thread might not run its loop yet and quitting it now would be lost,
+	 * so the loop is quit from within once it runs */
+	source = g_idle_source_new();
+	g_source_set_callback(source, quit_cb, iot->loop, NULL);
+	g_source_attach(source, iot->context);
+	g_source_unref(source);
+
+	g_thread_join(iot->thread);
+
+	io_thread = NULL;
+
+	while ((update = ring_pop(iot)) != NULL)
+		free_property_update(update);
+
+	if (iot->wakeup_watch)
+		g_source_remove(iot->wakeup_watch);
+	close(iot->wakeup_fd);
+
+	g_queue_free_full(iot->pending_order, (GDestroyNotify) free_property_update);
+	g_hash_table_destroy(iot->pending);
+	g_hash_table_destroy(iot->watches);
+
+	g_main_loop_unref(iot->loop);
+	g_main_context_unref(iot->context);
+	g_object_unref(iot->conn);
+	g_free(iot->sender);
+
+	g_free(iot);
+}
+
+static void direct_signal_cb(GDBusConnection *conn, const gchar *sender, const gchar *path,
+							 const gchar *interface, const gchar *signal, GVariant *parameters,
+							 gpointer user_data)
+{
+	struct ofono_io_watch *watch = user_data;
+	const gchar *name = NULL;
+	GVariant *value = NULL;
+
+	if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)")))
+		return;
+
+	g_variant_get(parameters, "(&sv)", &name, &value);
+	watch->cb(name, value, watch->data);
+	g_variant_unref(value);
+}
+
+struct ofono_io_watch* ofono_io_thread_watch_properties(const gchar *path, const gchar *interface,
+														ofono_io_property_changed_cb cb, void *data)
+{
+	struct ofono_io_watch *watch;
+	GList *watches;
+
+	watch = g_new0(struct ofono_io_watch, 1);
+	watch->object = g_strdup_printf("%s\n%s", path, interface);
+	watch->cb = cb;
+	watch->data = data;
+
+	if (io_thread) {
+		watches = g_hash_table_lookup(io_thread->watches, watch->object);
+		g_hash_table_replace(io_thread->watches, g_strdup(watch->object), g_list_append(watches, watch));
+		return watch;
+	}
+
+	/* without the I/O thread we have to receive them on the main loop */
+	watch->conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+	if (watch->conn)
+		watch->subscription = g_dbus_connection_signal_subscribe(watch->conn, "org.ofono", interface,
+																 "PropertyChanged", path, NULL,
+																 G_DBUS_SIGNAL_FLAGS_NONE,
+																 direct_signal_cb, watch, NULL);
+
+	return watch;
+}
+
+void ofono_io_thread_unwatch(struct ofono_io_watch *watch)
+{
+	GList *watches, *link;
+
+	if (!watch)
+		return;
+
+	if (watch->conn) {
+		g_dbus_connection_signal_unsubscribe(watch->conn, watch->subscription);
+		g_object_unref(watch->conn);
+	}
+	else if (io_thread) {
+		watches = g_hash_table_lookup(io_thread->watches, watch->object);
+		link = g_list_find(watches, watch);
+
+		if (link && link == io_thread->dispatch_next)
+			io_thread->dispatch_next = g_list_next(link);
+
+		watches = g_list_delete_link(watches, link);
+
+		if (watches)
+			g_hash_table_replace(io_thread->watches, g_strdup(watch->object), watches);
+		else
+			g_hash_table_remove(io_thread->watches, watch->object);
+	}
+
+	g_free(watch->object);
+	g_free(watch);
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,40 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef OFONO_IO_THREAD_H_
+#define OFONO_IO_THREAD_H_
+
+#include <stdbool.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+struct ofono_io_watch;
+
+typedef void (*ofono_io_property_changed_cb)(const gchar *name, GVariant *value, void *data);
+
+bool ofono_io_thread_start(void);
+bool ofono_io_thread_start_with_connection(GDBusConnection *conn, const gchar *sender);
+void ofono_io_thread_stop(void);
+
+struct ofono_io_watch* ofono_io_thread_watch_properties(const gchar *path, const gchar *interface,
+														ofono_io_property_changed_cb cb, void *data);
+void ofono_io_thread_unwatch(struct ofono_io_watch *watch);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
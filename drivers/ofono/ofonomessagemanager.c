@@ -18,13 +18,17 @@
 
 #include <string.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <time.h>
 
 #include <glib-object.h>
 #include <gio/gio.h>
 
 #include "utils.h"
+#include "logging.h"
 #include "ofonomessagemanager.h"
 #include "ofonomessage.h"
+#include "timestamp.h"
 #include "ofono-interface.h"
 
 struct ofono_message_manager {
@@ -41,7 +45,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 {
 	struct ofono_message_manager *mm = user_data;
 
-	g_message("[MessageManager:%s] property %s changed", mm->path, name);
+	g_debug("[MessageManager:%s] property %s changed", mm->path, name);
 
 	if (mm->prop_changed_cb)
 		mm->prop_changed_cb(name, mm->prop_changed_data);
@@ -55,61 +59,18 @@ struct ofono_base_funcs mm_base_funcs = {
 	.get_properties_finish = ofono_interface_message_manager_call_get_properties_finish
 };
 
-/**
- * Taken from https://github.com/cmende/libmpdclient/blob/master/src/iso8601.c
- */
-static time_t timezone_offset(void)
+static time_t decode_sent_time(const char *str)
 {
-	const time_t t0 = 1234567890;
-	time_t t = t0;
-	struct tm tm_buffer, *tm;
+	time_t t;
 
-	tm = gmtime_r(&t, &tm_buffer);
-	if (tm == NULL)
-		return 0;
-
-	/* force the daylight saving time to be off; gmtime_r() should
-	   have set this already */
-	tm->tm_isdst = 0;
-
-	t = mktime(tm);
-	if (t == -1)
-		return 0;
-
-	return t0 - t;
-}
-
-static time_t decode_iso8601_time(const char *str)
-{
-	struct tm t;
-	unsigned int offset = 0;
-
-	memset(&t, 0, sizeof(struct tm));
-
-	sscanf(str, "%4d-%2d-%2dT%2d:%2d:%2d+%4u",
-		   &t.tm_year, &t.tm_mon, &t.tm_mday,
-		   &t.tm_hour, &t.tm_min, &t.tm_sec,
-		   &offset);
-
-	t.tm_year = abs(t.tm_year - 1900);
-
-	if (t.tm_mon > 0)
-		t.tm_mon -= 1;
-	if (t.tm_hour > 0)
-		t.tm_hour -= 1;
-	if (t.tm_min > 0)
-		t.tm_min -= 1;
-	if (t.tm_sec > 0)
-		t.tm_sec -= 1;
-
-	t.tm_isdst = 0;
-
-	time_t tres = mktime(&t);
+	if (!timestamp_decode_iso8601(str, &t)) {
+		g_warning("[MessageManager] Failed to decode timestamp '%s'", str ? str : "");
+		return time(NULL);
+	}
 
-	return tres + timezone_offset();
+	return t;
 }
 
-
 static void incoming_message_cb(OfonoInterfaceMessageManager *source, gchar *text, GVariant *properties, gpointer user_data)
 {
 	struct ofono_message_manager *manager = user_data;
@@ -137,11 +98,11 @@ static void incoming_message_cb(OfonoInterfaceMessageManager *source, gchar *tex
 			ofono_message_set_sender(message, g_variant_get_string(property_value, NULL));
 		}
 		else if (g_strcmp0(property_name, "SentTime") == 0) {
-			time_t sent_time = decode_iso8601_time(g_variant_get_string(property_value, NULL));
+			time_t sent_time = decode_sent_time(g_variant_get_string(property_value, NULL));
 			ofono_message_set_sent_time(message, sent_time);
 		}
 		else if (g_strcmp0(property_name, "LocalSentTime") == 0) {
-			time_t local_sent_time = decode_iso8601_time(g_variant_get_string(property_value, NULL));
+			time_t local_sent_time = decode_sent_time(g_variant_get_string(property_value, NULL));
 			ofono_message_set_local_sent_time(message, local_sent_time);
 		}
 	}
@@ -223,8 +184,9 @@ static void send_message_cb(GObject *source, GAsyncResult *res, gpointer user_da
 	gchar *path = NULL;
 
 	success = ofono_interface_message_manager_call_send_message_finish(manager->remote, &path, res, &error);
+	ofono_base_record_reply("SendMessage", error);
 	if (!success) {
-		oerr.type = OFONO_ERROR_TYPE_FAILED;
+		oerr.type = ofono_error_type_from_gerror(error);
 		oerr.message = error->message;
 		cb(&oerr, NULL, cbd->data);
 		g_error_free(error);
@@ -234,7 +196,7 @@ static void send_message_cb(GObject *source, GAsyncResult *res, gpointer user_da
 	cb(NULL, path, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 
@@ -244,7 +206,7 @@ void ofono_message_manager_send_message(struct ofono_message_manager *manager, c
 	struct cb_data *cbd;
 	struct ofono_error error;
 
-	g_message("[MessageManager:%s] sending SMS to '%s'' with text '%s'", manager->path, to, text);
+	g_message("[MessageManager:%s] sending SMS to '%s' with text '%s'", manager->path, to, logging_redact(text));
 
 	if (!manager) {
 		error.type = OFONO_ERROR_TYPE_INVALID_ARGUMENTS;
@@ -40,7 +40,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 {
 	struct ofono_message_watch *watch = user_data;
 
-	g_message("[Message:%s] property %s changed", watch->path, name);
+	g_debug("[Message:%s] property %s changed", watch->path, name);
 
 	if (g_strcmp0(name, "State") == 0) {
 		const gchar *state_str = g_variant_get_string(value, NULL);
@@ -78,7 +78,7 @@ struct ofono_message_watch* ofono_message_watch_create(const char *path)
 		return NULL;
 
 	watch->remote = ofono_interface_message_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.Message interface");
 		g_error_free(error);
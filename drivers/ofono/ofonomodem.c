@@ -51,7 +51,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	GVariant *child;
 	int n;
 
-	g_message("[Modem:%s] property %s changed", modem->path, name);
+	g_debug("[Modem:%s] property %s changed", modem->path, name);
 
 	if (g_str_equal(name, "Powered"))
 		modem->powered = g_variant_get_boolean(value);
@@ -145,7 +145,7 @@ struct ofono_modem* ofono_modem_create(const gchar *path)
 		return NULL;
 
 	modem->remote = ofono_interface_modem_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.modem interface");
 		g_error_free(error);
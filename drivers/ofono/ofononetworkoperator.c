@@ -65,7 +65,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	int n;
 	enum ofono_network_technology tech;
 
-	g_message("[NetworkOperator:%s] property %s changed", netop->path, name);
+	g_debug("[NetworkOperator:%s] property %s changed", netop->path, name);
 
 	if (g_str_equal(name, "Name")) {
 		if (netop->name)
@@ -123,7 +123,7 @@ struct ofono_network_operator* ofono_network_operator_create(const char *path)
 	}
 
 	netop->remote = ofono_interface_network_operator_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_warning("Unable to initialize proxy for the org.ofono.network interface");
 		g_error_free(error);
@@ -173,6 +173,7 @@ static void register_cb(GObject *source_object, GAsyncResult *res, gpointer user
 	GError *error = NULL;
 
 	success = ofono_interface_network_operator_call_register_finish(netop->remote, res, &error);
+	ofono_base_record_reply("Operator.Register", error);
 	if (!success) {
 		oerr.message = error->message;
 		cb(&oerr, cbd->data);
@@ -182,7 +183,7 @@ static void register_cb(GObject *source_object, GAsyncResult *res, gpointer user
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_network_operator_register(struct ofono_network_operator *netop, ofono_base_result_cb cb, void *user_data)
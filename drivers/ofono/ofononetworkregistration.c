@@ -99,7 +99,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 {
 	struct ofono_network_registration *netreg = user_data;
 
-	g_message("[NetworkRegistration:%s] property %s changed", netreg->path, name);
+	g_debug("[NetworkRegistration:%s] property %s changed", netreg->path, name);
 
 	if (g_str_equal(name, "Mode"))
 		netreg->mode = parse_ofono_network_registration_mode(g_variant_dup_string(value, NULL));
@@ -144,7 +144,7 @@ struct ofono_network_registration* ofono_network_registration_create(const gchar
 		return NULL;
 
 	netreg->remote = ofono_interface_network_registration_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.network interface");
 		g_error_free(error);
@@ -219,6 +219,7 @@ static void register_cb(GObject *source_object, GAsyncResult *res, gpointer user
 	GError *error = NULL;
 
 	success = ofono_interface_network_registration_call_register_finish(netreg->remote, res, &error);
+	ofono_base_record_reply("Registration.Register", error);
 	if (!success) {
 		oerr.message = error->message;
 		cb(&oerr, cbd->data);
@@ -228,7 +229,7 @@ static void register_cb(GObject *source_object, GAsyncResult *res, gpointer user
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_network_registration_register(struct ofono_network_registration *netreg, ofono_base_result_cb cb, void *data)
@@ -246,11 +247,9 @@ void ofono_network_registration_register(struct ofono_network_registration *netr
 
 static void get_operators_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-	struct cb_data *cbd = user_data;
-	struct cb_data *cbd2 = cbd->user;
-	struct ofono_network_registration *netreg = cbd2->user;
-	ofono_network_registration_operator_list_cb cb = cbd->cb;
-	_common_operators_finish_cb finish_cb = cbd2->cb;
+	struct ofono_completion *completion = user_data;
+	ofono_network_registration_operator_list_cb cb = completion->cb;
+	_common_operators_finish_cb finish_cb = completion->finish;
 	struct ofono_error oerr;
 	gboolean success;
 	GError *error = NULL;
@@ -260,10 +259,12 @@ static void get_operators_cb(GObject *source_object, GAsyncResult *res, gpointer
 	struct ofono_network_operator *network_operator;
 	GList *operators = NULL;
 
-	success = finish_cb(netreg->remote, &result, res, &error);
+	success = finish_cb(completion->remote, &result, res, &error);
+	ofono_base_record_reply(completion->method, error);
 	if (!success) {
+		oerr.type = ofono_error_type_from_gerror(error);
 		oerr.message = error->message;
-		cb(&oerr, NULL, cbd->data);
+		cb(&oerr, NULL, completion->data);
 		g_error_free(error);
 	}
 	else {
@@ -275,49 +276,42 @@ static void get_operators_cb(GObject *source_object, GAsyncResult *res, gpointer
 			operators = g_list_append(operators, network_operator);
 		}
 
-		cb(NULL, operators, cbd->data);
+		cb(NULL, operators, completion->data);
 		g_list_free_full(operators, (GDestroyNotify) ofono_network_operator_free);
 	}
 
-	g_free(cbd);
-	g_free(cbd2);
+	ofono_completion_free(completion);
 }
 
 void ofono_network_registration_scan(struct ofono_network_registration *netreg,
 			ofono_network_registration_operator_list_cb cb, GCancellable *cancellable, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
 	if (!netreg)
 		return;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_network_registration_call_scan_finish, NULL);
-	cbd2->user = netreg;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("Scan", netreg->remote,
+		ofono_interface_network_registration_call_scan_finish, cb, data);
 
 	// NOTE: We need to do the scan-operation through the direct call of g_dbus_proxy_call
 	// because we have to specify a higher timeout and don't want to touch the default one
 	g_dbus_proxy_call (G_DBUS_PROXY (netreg->remote), "Scan", g_variant_new ("()"),
-		G_DBUS_CALL_FLAGS_NONE, 40000, cancellable, get_operators_cb, cbd);
+		G_DBUS_CALL_FLAGS_NONE, 40000, cancellable, get_operators_cb, completion);
 }
 
 void ofono_network_registration_get_operators(struct ofono_network_registration *netreg,
 			ofono_network_registration_operator_list_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
 	if (!netreg)
 		return;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_network_registration_call_get_operators_finish, NULL);
-	cbd2->user = netreg;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("GetOperators", netreg->remote,
+		ofono_interface_network_registration_call_get_operators_finish, cb, data);
 
-	ofono_interface_network_registration_call_get_operators(netreg->remote, NULL, get_operators_cb, cbd);
+	ofono_interface_network_registration_call_get_operators(netreg->remote, NULL, get_operators_cb, completion);
 }
 
 enum ofono_network_registration_mode ofono_network_registration_get_mode(struct ofono_network_registration *netreg)
@@ -40,7 +40,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	struct ofono_radio_settings *ras = user_data;
 	char *technology_preference_str;
 
-	g_message("[RadioSettings:%s] property %s changed", ras->path, name);
+	g_debug("[RadioSettings:%s] property %s changed", ras->path, name);
 
 	if (g_str_equal(name, "TechnologyPreference")) {
 		technology_preference_str = g_variant_dup_string(value, NULL);
@@ -81,7 +81,7 @@ struct ofono_radio_settings* ofono_radio_settings_create(const char *path)
 	}
 
 	ras->remote = ofono_interface_radio_settings_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_warning("Unable to initialize proxy for the org.ofono.network interface");
 		g_error_free(error);
@@ -115,7 +115,7 @@ void set_technology_preference_cb(struct ofono_error *error, void *data)
 	ofono_base_result_cb cb = cbd->cb;
 
 	cb(error, cbd->data);
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_radio_settings_set_technology_preference(struct ofono_radio_settings *ras, enum ofono_radio_access_mode mode,
@@ -147,7 +147,7 @@ void ofono_radio_settings_set_technology_preference(struct ofono_radio_settings
 	default:
 		error.type = OFONO_ERROR_TYPE_INVALID_ARGUMENTS;
 		cb(&error, data);
-		g_free(cbd);
+		cb_data_free(cbd);
 		return;
 	}
 
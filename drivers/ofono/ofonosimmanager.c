@@ -22,7 +22,6 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
-#include "glib-helpers.h"
 #include "utils.h"
 #include "ofonosimmanager.h"
 #include "ofono-interface.h"
@@ -136,7 +135,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	GVariant *child, *prop_value, *prop_key;
 	enum ofono_sim_pin pin_type;
 
-	g_message("[SIM:%s] property %s changed", sim->path, name);
+	g_debug("[SIM:%s] property %s changed", sim->path, name);
 
 	if (g_str_equal(name, "Present"))
 		sim->present = g_variant_get_boolean(value);
@@ -236,7 +235,7 @@ struct ofono_sim_manager* ofono_sim_manager_create(const gchar *path)
 		return NULL;
 
 	sim->remote = ofono_interface_sim_manager_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.SimManager interface");
 		g_error_free(error);
@@ -295,115 +294,90 @@ void ofono_sim_manager_free(struct ofono_sim_manager *sim)
 	g_free(sim);
 }
 
-static void common_pin_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
-{
-	struct cb_data *cbd = user_data;
-	struct cb_data *cbd2 = cbd->user;
-	ofono_base_result_cb cb = cbd->cb;
-	struct ofono_sim_manager *sim = cbd2->data;
-	glib_common_async_finish_cb finish_cb = cbd2->cb;
-	struct ofono_error oerr;
-	gboolean success;
-	GError *error = NULL;
-
-	success = finish_cb(sim->remote, res, &error);
-	if (!success) {
-		oerr.message = error->message;
-		cb(&oerr, cbd->data);
-		g_error_free(error);
-	}
-	else {
-		cb(NULL, cbd->data);
-	}
-
-	g_free(cbd);
-	g_free(cbd2);
-}
-
 void ofono_sim_manager_enter_pin(struct ofono_sim_manager *sim, enum ofono_sim_pin type, const gchar *pin,
 						ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
+	struct ofono_completion *completion;
 
 	if (!sim) {
 		cb(NULL, data);
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd->user = cb_data_new(ofono_interface_sim_manager_call_enter_pin_finish, sim);
+	completion = ofono_completion_new("EnterPin", sim->remote,
+		ofono_interface_sim_manager_call_enter_pin_finish, cb, data);
 
 	ofono_interface_sim_manager_call_enter_pin(sim->remote, ofono_sim_pin_to_string(type),
-											pin, NULL, common_pin_cb, cbd);
+											pin, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_sim_manager_lock_pin(struct ofono_sim_manager *sim, enum ofono_sim_pin type, const gchar *pin,
 						ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
+	struct ofono_completion *completion;
 
 	if (!sim) {
 		cb(NULL, data);
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd->user = cb_data_new(ofono_interface_sim_manager_call_lock_pin_finish, sim);
+	completion = ofono_completion_new("LockPin", sim->remote,
+		ofono_interface_sim_manager_call_lock_pin_finish, cb, data);
 
 	ofono_interface_sim_manager_call_lock_pin(sim->remote, ofono_sim_pin_to_string(type),
-											  pin, NULL, common_pin_cb, cbd);
+											  pin, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_sim_manager_unlock_pin(struct ofono_sim_manager *sim, enum ofono_sim_pin type, const gchar *pin,
 						ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
+	struct ofono_completion *completion;
 
 	if (!sim) {
 		cb(NULL, data);
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd->user = cb_data_new(ofono_interface_sim_manager_call_unlock_pin_finish, sim);
+	completion = ofono_completion_new("UnlockPin", sim->remote,
+		ofono_interface_sim_manager_call_unlock_pin_finish, cb, data);
 
 	ofono_interface_sim_manager_call_unlock_pin(sim->remote, ofono_sim_pin_to_string(type),
-											  pin, NULL, common_pin_cb, cbd);
+											  pin, NULL, ofono_completion_result_cb, completion);
 
 }
 
 void ofono_sim_manager_change_pin(struct ofono_sim_manager *sim, enum ofono_sim_pin type, const gchar *old_pin,
 						const gchar *new_pin, ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
+	struct ofono_completion *completion;
 
 	if (!sim) {
 		cb(NULL, data);
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd->user = cb_data_new(ofono_interface_sim_manager_call_change_pin_finish, sim);
+	completion = ofono_completion_new("ChangePin", sim->remote,
+		ofono_interface_sim_manager_call_change_pin_finish, cb, data);
 
 	ofono_interface_sim_manager_call_change_pin(sim->remote, ofono_sim_pin_to_string(type),
-											old_pin, new_pin, NULL, common_pin_cb, cbd);
+											old_pin, new_pin, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_sim_manager_reset_pin(struct ofono_sim_manager *sim, enum ofono_sim_pin type, const gchar *puk,
 						const gchar *new_pin, ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
+	struct ofono_completion *completion;
 
 	if (!sim) {
 		cb(NULL, data);
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd->user = cb_data_new(ofono_interface_sim_manager_call_reset_pin_finish, sim);
+	completion = ofono_completion_new("ResetPin", sim->remote,
+		ofono_interface_sim_manager_call_reset_pin_finish, cb, data);
 
 	ofono_interface_sim_manager_call_reset_pin(sim->remote, ofono_sim_pin_to_string(type),
-											puk, new_pin, NULL, common_pin_cb, cbd);
+											puk, new_pin, NULL, ofono_completion_result_cb, completion);
 }
 
 const gchar* ofono_sim_manager_get_path(struct ofono_sim_manager *sim)
@@ -22,7 +22,6 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
-#include "glib-helpers.h"
 #include "utils.h"
 #include "ofonovoicecall.h"
 #include "ofono-interface.h"
@@ -68,7 +67,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	struct ofono_voicecall *call = user_data;
 	const char *state_str = NULL;
 
-	g_message("[VoiceCall:%s] property %s changed", call->path, name);
+	g_debug("[VoiceCall:%s] property %s changed", call->path, name);
 
 	if (g_str_equal(name, "LineIdentification")) {
 		if (call->line_identification)
@@ -129,7 +128,7 @@ struct ofono_voicecall* ofono_voicecall_create(const gchar *path)
 		return NULL;
 
 	call->remote = ofono_interface_voice_call_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-							G_DBUS_PROXY_FLAGS_NONE, "org.ofono", path, NULL, &error);
+							G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, "org.ofono", path, NULL, &error);
 	if (error) {
 		g_critical("Unable to initialize proxy for the org.ofono.VoiceCall interface");
 		g_error_free(error);
@@ -194,37 +193,9 @@ const char* ofono_voicecall_get_path(struct ofono_voicecall *call)
 	return call->path;
 }
 
-static void common_cb(GObject *source, GAsyncResult *res, gpointer data)
-{
-	struct cb_data *cbd = data;
-	struct cb_data *cbd2 = cbd->user;
-	ofono_base_result_cb cb = cbd->cb;
-	glib_common_async_finish_cb finish_cb = cbd2->cb;
-	struct ofono_voicecall *call = cbd2->user;
-	struct ofono_error oerr;
-	GError *error;
-	gboolean success = false;
-
-	success = finish_cb(call->remote, res, &error);
-	if (success == FALSE) {
-		oerr.type = OFONO_ERROR_TYPE_FAILED;
-		oerr.message = error->message;
-		cb(&oerr, cbd->data);
-		g_error_free(error);
-		goto cleanup;
-	}
-
-	cb(NULL, cbd->data);
-
-cleanup:
-	g_free(cbd2);
-	g_free(cbd);
-}
-
 void ofono_voicecall_deflect(struct ofono_voicecall *call, const char *number, ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 	struct ofono_error oerr;
 
 	if (!call) {
@@ -233,18 +204,15 @@ void ofono_voicecall_deflect(struct ofono_voicecall *call, const char *number, o
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_call_deflect_finish, NULL);
-	cbd2->user = call;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("Deflect", call->remote,
+		ofono_interface_voice_call_call_deflect_finish, cb, data);
 
-	ofono_interface_voice_call_call_deflect(call->remote, number, NULL, common_cb, cbd);
+	ofono_interface_voice_call_call_deflect(call->remote, number, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_hangup(struct ofono_voicecall *call, ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 	struct ofono_error oerr;
 
 	if (!call) {
@@ -253,18 +221,15 @@ void ofono_voicecall_hangup(struct ofono_voicecall *call, ofono_base_result_cb c
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_call_hangup_finish, NULL);
-	cbd2->user = call;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("Hangup", call->remote,
+		ofono_interface_voice_call_call_hangup_finish, cb, data);
 
-	ofono_interface_voice_call_call_hangup(call->remote, NULL, common_cb, cbd);
+	ofono_interface_voice_call_call_hangup(call->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_answer(struct ofono_voicecall *call, ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 	struct ofono_error oerr;
 
 	if (!call) {
@@ -273,12 +238,18 @@ void ofono_voicecall_answer(struct ofono_voicecall *call, ofono_base_result_cb c
 		return;
 	}
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_call_answer_finish, NULL);
-	cbd2->user = call;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("Answer", call->remote,
+		ofono_interface_voice_call_call_answer_finish, cb, data);
+
+	ofono_interface_voice_call_call_answer(call->remote, NULL, ofono_completion_result_cb, completion);
+}
+
+enum ofono_voicecall_state ofono_voicecall_get_state(struct ofono_voicecall *call)
+{
+	if (!call)
+		return OFONO_VOICECALL_STATE_DISCONNECTED;
 
-	ofono_interface_voice_call_call_answer(call->remote, NULL, common_cb, cbd);
+	return call->state;
 }
 
 const char* ofono_voicecall_get_line_identification(struct ofono_voicecall *call)
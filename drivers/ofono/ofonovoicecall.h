@@ -53,6 +53,7 @@ void ofono_voicecall_deflect(struct ofono_voicecall *call, const char *number, o
 void ofono_voicecall_hangup(struct ofono_voicecall *call, ofono_base_result_cb cb, void *data);
 void ofono_voicecall_answer(struct ofono_voicecall *call, ofono_base_result_cb cb, void *data);
 
+enum ofono_voicecall_state ofono_voicecall_get_state(struct ofono_voicecall *call);
 const char* ofono_voicecall_get_line_identification(struct ofono_voicecall *call);
 const char* ofono_voicecall_get_incoming_line(struct ofono_voicecall *call);
 const char* ofono_voicecall_get_name(struct ofono_voicecall *call);
@@ -22,7 +22,6 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
-#include "glib-helpers.h"
 #include "utils.h"
 #include "ofonovoicecallmanager.h"
 #include "ofonovoicecall.h"
@@ -66,7 +65,7 @@ static void update_property(const gchar *name, GVariant *value, void *user_data)
 	GVariant *child;
 	int n;
 
-	g_message("[VoicecallManager:%s] property %s changed", vm->path, name);
+	g_debug("[VoicecallManager:%s] property %s changed", vm->path, name);
 
 	if (g_strcmp0(name, "EmergencyNumbers") == 0) {
 		if (vm->emergency_numbers) {
@@ -150,6 +149,8 @@ void ofono_voicecall_manager_free(struct ofono_voicecall_manager *vm)
 	if (vm->remote)
 		g_object_unref(vm->remote);
 
+	g_list_free_full(vm->calls, (GDestroyNotify) ofono_voicecall_free);
+
 	g_free(vm);
 }
 
@@ -198,12 +199,13 @@ static void dial_cb(GObject *source, GAsyncResult *res, gpointer data)
 	struct cb_data *cbd = data;
 	ofono_voicecall_manager_dial_cb cb = cbd->cb;
 	struct ofono_voicecall_manager *vm = cbd->user;
-	GError *error;
+	GError *error = NULL;
 	gchar *path = NULL;
 	struct ofono_error oerr;
 	gboolean success = FALSE;
 
 	success = ofono_interface_voice_call_manager_call_dial_finish(vm->remote, &path, res, &error);
+	ofono_base_record_reply("Dial", error);
 	if (success == FALSE) {
 		oerr.type = OFONO_ERROR_TYPE_FAILED;
 		oerr.message = error->message;
@@ -215,7 +217,7 @@ static void dial_cb(GObject *source, GAsyncResult *res, gpointer data)
 	cb(NULL, path, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_voicecall_manager_dial(struct ofono_voicecall_manager *vm,
@@ -232,129 +234,81 @@ void ofono_voicecall_manager_dial(struct ofono_voicecall_manager *vm,
 												 NULL, dial_cb, cbd);
 }
 
-static void vm_common_cb(GObject *source, GAsyncResult *res, gpointer data)
-{
-	struct cb_data *cbd = data;
-	struct cb_data *cbd2 = cbd->user;
-	ofono_base_result_cb cb = cbd->cb;
-	glib_common_async_finish_cb finish_cb = cbd2->cb;
-	struct ofono_voicecall_manager *vm = cbd2->user;
-	GError *error;
-	struct ofono_error oerr;
-	gboolean success = FALSE;
-
-	success = finish_cb(vm->remote, res, &error);
-	if (success == FALSE) {
-		oerr.type = OFONO_ERROR_TYPE_FAILED;
-		oerr.message = error->message;
-		cb(&oerr, cbd->data);
-		g_error_free(error);
-		goto cleanup;
-	}
-
-	cb(NULL, cbd->data);
-
-cleanup:
-	g_free(cbd);
-	g_free(cbd2);
-}
-
 void ofono_voicecall_manager_transfer(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_transfer_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("Transfer", vm->remote,
+		ofono_interface_voice_call_manager_call_transfer_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_transfer(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_transfer(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_swap_calls(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_swap_calls_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("SwapCalls", vm->remote,
+		ofono_interface_voice_call_manager_call_swap_calls_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_swap_calls(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_swap_calls(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_release_and_answer(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_release_and_answer_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("ReleaseAndAnswer", vm->remote,
+		ofono_interface_voice_call_manager_call_release_and_answer_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_release_and_answer(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_release_and_answer(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_release_and_swap(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_release_and_swap_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("ReleaseAndSwap", vm->remote,
+		ofono_interface_voice_call_manager_call_release_and_swap_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_release_and_swap(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_release_and_swap(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_hold_and_answer(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_hold_and_answer_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("HoldAndAnswer", vm->remote,
+		ofono_interface_voice_call_manager_call_hold_and_answer_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_hold_and_answer(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_hold_and_answer(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_hangup_all(struct ofono_voicecall_manager *vm,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_hangup_all_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("HangupAll", vm->remote,
+		ofono_interface_voice_call_manager_call_hangup_all_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_hangup_all(vm->remote, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_hangup_all(vm->remote, NULL, ofono_completion_result_cb, completion);
 }
 
 void ofono_voicecall_manager_send_tones(struct ofono_voicecall_manager *vm, const char *tones,
 									  ofono_base_result_cb cb, void *data)
 {
-	struct cb_data *cbd;
-	struct cb_data *cbd2;
+	struct ofono_completion *completion;
 
-	cbd = cb_data_new(cb, data);
-	cbd2 = cb_data_new(ofono_interface_voice_call_manager_call_send_tones_finish, NULL);
-	cbd2->user = vm;
-	cbd->user = cbd2;
+	completion = ofono_completion_new("SendTones", vm->remote,
+		ofono_interface_voice_call_manager_call_send_tones_finish, cb, data);
 
-	ofono_interface_voice_call_manager_call_send_tones(vm->remote, tones, NULL, vm_common_cb, cbd);
+	ofono_interface_voice_call_manager_call_send_tones(vm->remote, tones, NULL, ofono_completion_result_cb, completion);
 }
 
 static void call_added_cb(OfonoInterfaceConnectionManager *source, const gchar *path,
@@ -404,7 +358,7 @@ static void call_removed_cb(OfonoInterfaceConnectionManager *source, const gchar
 	if (removable) {
 		call = removable->data;
 		ofono_voicecall_free(call);
-		vm->calls = g_list_remove(vm->calls, removable);
+		vm->calls = g_list_delete_link(vm->calls, removable);
 	}
 
 	if (vm->calls_changed_cb)
@@ -458,7 +412,7 @@ static void get_calls_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 	cb(NULL, vm->calls, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_voicecall_manager_get_calls(struct ofono_voicecall_manager *vm,
@@ -486,6 +440,24 @@ void ofono_voicecall_manager_get_calls(struct ofono_voicecall_manager *vm,
 	ofono_interface_voice_call_manager_call_get_calls(vm->remote, NULL, get_calls_cb, cbd);
 }
 
+struct ofono_voicecall* ofono_voicecall_manager_find_call(struct ofono_voicecall_manager *vm, const char *path)
+{
+	GList *iter;
+	struct ofono_voicecall *call;
+
+	if (!vm)
+		return NULL;
+
+	for (iter = vm->calls; iter != NULL; iter = g_list_next(iter)) {
+		call = iter->data;
+
+		if (g_strcmp0(ofono_voicecall_get_path(call), path) == 0)
+			return call;
+	}
+
+	return NULL;
+}
+
 GList* ofono_voicecall_manager_get_emergency_numbers(struct ofono_voicecall_manager *vm)
 {
 	if (!vm)
@@ -71,6 +71,7 @@ void ofono_voicecall_manager_send_tones(struct ofono_voicecall_manager *vm, cons
 
 void ofono_voicecall_manager_get_calls(struct ofono_voicecall_manager *vm,
 										ofono_voicecall_manager_get_calls_cb cb, void *data);
+struct ofono_voicecall* ofono_voicecall_manager_find_call(struct ofono_voicecall_manager *vm, const char *path);
 GList* ofono_voicecall_manager_get_emergency_numbers(struct ofono_voicecall_manager *vm);
 
 #endif
@@ -0,0 +1,113 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include "signalfilter.h"
+
+/* Strength samples go through an exponential moving average with a weight of
+ * 1/SIGNAL_FILTER_WEIGHT for the new sample. The bar count only moves once the
+ * average got SIGNAL_FILTER_HYSTERESIS units past the boundary of the current
+ * bar, then it goes straight to the bar of the average. A signal hovering
+ * around a boundary doesn't make it flap this way. */
+#define SIGNAL_FILTER_SCALE			256
+#define SIGNAL_FILTER_WEIGHT		4
+#define SIGNAL_FILTER_HYSTERESIS	4
+#define SIGNAL_FILTER_MAX_STRENGTH	100
+#define SIGNAL_FILTER_MAX_BARS		5
+
+static int strength_to_bars(int strength)
+{
+	return (strength * SIGNAL_FILTER_MAX_BARS) / SIGNAL_FILTER_MAX_STRENGTH;
+}
+
+/* Lowest strength mapping to the given number of bars */
+static int bars_to_strength(int bars)
+{
+	return (bars * SIGNAL_FILTER_MAX_STRENGTH) / SIGNAL_FILTER_MAX_BARS;
+}
+
+void signal_filter_init(struct signal_filter *filter)
+{
+	filter->average = 0;
+	filter->target = 0;
+	filter->bars = 0;
+	filter->primed = false;
+}
+
+/* Feeds a strength sample to the filter; returns true when the bar count
+ * changed */
+bool signal_filter_update(struct signal_filter *filter, int strength)
+{
+	int candidate;
+	int threshold;
+	int old_bars = filter->bars;
+
+	strength = CLAMP(strength, 0, SIGNAL_FILTER_MAX_STRENGTH);
+	filter->target = strength * SIGNAL_FILTER_SCALE;
+
+	/* the first sample is taken as is so queries right after startup are right */
+	if (!filter->primed) {
+		filter->average = filter->target;
+		filter->bars = strength_to_bars(strength);
+		filter->primed = true;
+		return true;
+	}
+
+	filter->average += (filter->target - filter->average) / SIGNAL_FILTER_WEIGHT;
+
+	/* integer steps stall short of the target */
+	if (abs(filter->target - filter->average) < SIGNAL_FILTER_SCALE)
+		filter->average = filter->target;
+
+	candidate = strength_to_bars(filter->average / SIGNAL_FILTER_SCALE);
+
+	if (candidate > filter->bars) {
+		threshold = MIN(bars_to_strength(filter->bars + 1) + SIGNAL_FILTER_HYSTERESIS,
+						SIGNAL_FILTER_MAX_STRENGTH);
+		if (filter->average >= threshold * SIGNAL_FILTER_SCALE)
+			filter->bars = candidate;
+	}
+	else if (candidate < filter->bars) {
+		threshold = bars_to_strength(filter->bars) - SIGNAL_FILTER_HYSTERESIS;
+		if (filter->average < threshold * SIGNAL_FILTER_SCALE)
+			filter->bars = candidate;
+	}
+
+	return filter->bars != old_bars;
+}
+
+/* Feeds the last sample again; to be called periodically until the filter is
+ * settled as ofono only reports changes */
+bool signal_filter_settle(struct signal_filter *filter)
+{
+	return signal_filter_update(filter, filter->target / SIGNAL_FILTER_SCALE);
+}
+
+bool signal_filter_is_settled(struct signal_filter *filter)
+{
+	return filter->average == filter->target;
+}
+
+int signal_filter_get_bars(struct signal_filter *filter)
+{
+	return filter->bars;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,41 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SIGNAL_FILTER_H_
+#define SIGNAL_FILTER_H_
+
+#include <stdbool.h>
+
+/* Smooths the 0-100 signal strength reported by ofono before it gets turned
+ * into bars; average is kept in 1/256 units */
+struct signal_filter {
+	int average;
+	int target;
+	int bars;
+	bool primed;
+};
+
+void signal_filter_init(struct signal_filter *filter);
+bool signal_filter_update(struct signal_filter *filter, int strength);
+bool signal_filter_settle(struct signal_filter *filter);
+bool signal_filter_is_settled(struct signal_filter *filter);
+int signal_filter_get_bars(struct signal_filter *filter);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
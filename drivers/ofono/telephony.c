@@ -35,6 +35,15 @@
 #include "ofonomessage.h"
 #include "ofonomessagewatch.h"
 #include "utils.h"
+#include "flightrecorder.h"
+#include "telephonysettings.h"
+#include "signalfilter.h"
+#include "plmn.h"
+#include "startuptimeline.h"
+
+#define SIGNAL_SETTLE_INTERVAL_SECONDS		2
+/* losing the registration for a shorter time isn't told to clients */
+#define REGISTRATION_DAMPING_DEFAULT_MS		3000
 
 struct ofono_data {
 	struct telephony_service *service;
@@ -47,92 +56,150 @@ struct ofono_data {
 	struct ofono_message_manager *mm;
 	enum telephony_sim_status sim_status;
 	bool initializing;
+	/* a Powered or Online change is on its way to ofono */
 	bool power_set_pending;
 	bool power_target;
+	bool power_step_target;
+	GSList *power_waiters;
 	guint service_watch;
 	GCancellable *network_scan_cancellable;
 	GHashTable *calls;
 	unsigned int next_call_id;
+	struct signal_filter signal_filter;
+	guint signal_settle_timeout;
+	guint registration_damping_timeout;
+	/* network status clients got last */
+	bool network_status_emitted;
+	enum telephony_network_state emitted_state;
+	enum telephony_network_registration emitted_registration;
+	gchar *emitted_name;
+	struct telephony_network_filter_stats filter_stats;
 };
 
+/* A call ofono told us about; the voicecall itself is owned by the voicecall
+ * manager and gone by the time we hear about its removal, so the number is
+ * kept to report the disconnect. */
 struct call_info {
 	int id;
 	struct ofono_voicecall *call;
+	gchar *number;
+	struct ofono_data *od;
 };
 
-void set_online_cb(struct ofono_error *error, gpointer user_data)
+static void power_transition_step(struct ofono_data *od, bool powered, bool online);
+
+/* Completes everyone who asked for the power state we're now in (or failed to
+ * reach); the list is detached first as callers may queue a new request */
+static void complete_power_waiters(struct ofono_data *od, const struct telephony_error *error)
+{
+	GSList *waiters = od->power_waiters;
+	GSList *iter;
+	struct cb_data *cbd;
+	telephony_result_cb cb;
+
+	od->power_waiters = NULL;
+
+	for (iter = waiters; iter != NULL; iter = g_slist_next(iter)) {
+		cbd = iter->data;
+		cb = cbd->cb;
+		cb(error, cbd->data);
+		cb_data_free(cbd);
+	}
+
+	g_slist_free(waiters);
+}
+
+/* A step failed; if the target changed meanwhile the error doesn't matter to
+ * anyone and we go on towards the new target */
+static void power_step_failed(struct ofono_data *od)
 {
-	struct cb_data *cbd = user_data;
-	struct ofono_data *od = cbd->user;
-	telephony_result_cb cb = cbd->cb;
 	struct telephony_error terr;
 
+	if (od->power_step_target != od->power_target) {
+		power_transition_step(od, ofono_modem_get_powered(od->modem), ofono_modem_get_online(od->modem));
+		return;
+	}
+
+	terr.code = TELEPHONY_ERROR_FAIL;
+	complete_power_waiters(od, &terr);
+}
+
+static void set_powered_cb(struct ofono_error *error, gpointer user_data)
+{
+	struct ofono_data *od = user_data;
+
+	od->power_set_pending = false;
+
 	if (error) {
-		terr.code = 1; /* FIXME */
-		cb(&terr, cbd->data);
-		goto cleanup;
+		power_step_failed(od);
+		return;
 	}
 
-	cb(NULL, cbd->data);
+	/* the property change may not have arrived yet */
+	power_transition_step(od, true, ofono_modem_get_online(od->modem));
+}
+
+static void set_online_cb(struct ofono_error *error, gpointer user_data)
+{
+	struct ofono_data *od = user_data;
+
 	od->power_set_pending = false;
 
-cleanup:
-	g_free(cbd);
+	if (error) {
+		power_step_failed(od);
+		return;
+	}
+
+	power_transition_step(od, ofono_modem_get_powered(od->modem), od->power_step_target);
 }
 
-void set_powered_cb(struct ofono_error *error, gpointer user_data)
+/* Issues the next property change on the way to the current power target or
+ * completes all waiters once it's reached. Powering off only takes the modem
+ * offline so it can still be queried. */
+static void power_transition_step(struct ofono_data *od, bool powered, bool online)
 {
-	struct cb_data *cbd = user_data;
-	struct ofono_data *od = cbd->user;
-	telephony_result_cb cb = cbd->cb;
 	struct telephony_error terr;
 
-	if (error) {
-		terr.code = 1; /* FIXME */
-		cb(&terr, cbd->data);
-		goto cleanup;
+	if (!od->modem) {
+		terr.code = TELEPHONY_ERROR_NOT_AVAILABLE;
+		complete_power_waiters(od, &terr);
+		return;
 	}
 
-	if (od->power_target) {
-		ofono_modem_set_online(od->modem, od->power_target, set_online_cb, cbd);
+	od->power_step_target = od->power_target;
+
+	if (od->power_target && !powered) {
+		od->power_set_pending = true;
+		ofono_modem_set_powered(od->modem, TRUE, set_powered_cb, od);
+	}
+	else if (od->power_target != online) {
+		od->power_set_pending = true;
+		ofono_modem_set_online(od->modem, od->power_target, set_online_cb, od);
 	}
 	else {
-		od->power_set_pending = false;
-		cb(NULL, cbd->data);
-		goto cleanup;
+		complete_power_waiters(od, NULL);
 	}
-
-	return;
-
-cleanup:
-	g_free(cbd);
 }
 
+/* Every request is queued; while a transition is running only the target is
+ * updated so a burst of toggles ends in the state asked for last */
 void ofono_power_set(struct telephony_service *service, bool power, telephony_result_cb cb, void *data)
 {
-	struct cb_data *cbd = cb_data_new(cb, data);
 	struct ofono_data *od = telephony_service_get_data(service);
-	bool powered = false;
-	struct telephony_error error;
+	struct cb_data *cbd;
 
-	if (od->power_set_pending) {
-		error.code = TELEPHONY_ERROR_ALREADY_INPROGRESS;
-		cb(&error, data);
-		return;
-	}
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, power, __func__);
+
+	cbd = cb_data_new(cb, data);
+	cbd->user = od;
 
-	od->power_set_pending = true;
 	od->power_target = power;
+	od->power_waiters = g_slist_append(od->power_waiters, cbd);
 
-	cbd->user = od;
+	if (od->power_set_pending)
+		return;
 
-	powered = ofono_modem_get_powered(od->modem);
-	if (!powered) {
-		ofono_modem_set_powered(od->modem, power, set_powered_cb, cbd);
-	}
-	else {
-		ofono_modem_set_online(od->modem, power, set_online_cb, cbd);
-	}
+	power_transition_step(od, ofono_modem_get_powered(od->modem), ofono_modem_get_online(od->modem));
 }
 
 void ofono_power_query(struct telephony_service *service, telephony_power_query_cb cb, void *data)
@@ -179,6 +246,8 @@ void ofono_platform_query(struct telephony_service *service, telephony_platform_
 		if (mcc && mnc) {
 			pinfo.mcc = g_ascii_strtoll(mcc, NULL, 0);
 			pinfo.mnc = g_ascii_strtoll(mnc, NULL, 0);
+			pinfo.carrier = plmn_lookup_name(mcc, mnc);
+			pinfo.country = plmn_lookup_country(mcc, mnc);
 		}
 	}
 
@@ -320,7 +389,7 @@ void pin1_common_cb(struct ofono_error *error, gpointer user_data)
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_pin1_verify(struct telephony_service *service, const gchar *pin, telephony_result_cb cb, void *data)
@@ -329,6 +398,8 @@ void ofono_pin1_verify(struct telephony_service *service, const gchar *pin, tele
 	struct telephony_error err;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_SIM_MANAGER)) {
 		err.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&err, data);
@@ -346,6 +417,8 @@ void ofono_pin1_enable(struct telephony_service *service, const gchar *pin, tele
 	struct telephony_error err;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_SIM_MANAGER)) {
 		err.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&err, data);
@@ -363,6 +436,8 @@ void ofono_pin1_disable(struct telephony_service *service, const gchar *pin, tel
 	struct telephony_error err;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_SIM_MANAGER)) {
 		err.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&err, data);
@@ -380,6 +455,8 @@ void ofono_pin1_change(struct telephony_service *service, const gchar *old_pin,
 	struct telephony_error err;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_SIM_MANAGER)) {
 		err.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&err, data);
@@ -397,6 +474,8 @@ void ofono_pin1_unblock(struct telephony_service *service, const gchar *puk, con
 	struct telephony_error err;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_SIM_MANAGER)) {
 		err.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&err, data);
@@ -454,6 +533,9 @@ static int retrieve_network_status(struct ofono_data *od, struct telephony_netwo
 	}
 
 	status->name = ofono_network_registration_get_operator_name(od->netreg);
+	if (!status->name || strlen(status->name) == 0)
+		status->name = plmn_lookup_name(ofono_network_registration_get_mcc(od->netreg),
+										ofono_network_registration_get_mnc(od->netreg));
 	/* FIXME when we support the relevant ofono interfaces set this correctly */
 	status->cause_code = 0;
 	status->data_registered = false;
@@ -484,38 +566,162 @@ void ofono_network_status_query(struct telephony_service *service, telephony_net
 	cb(NULL, &status, data);
 }
 
-static int convert_strength_to_bars(int rssi)
-{
-	return (rssi * 5) / 100;
-}
-
 void ofono_signal_strength_query(struct telephony_service *service, telephony_signal_strength_query_cb cb, void *data)
 {
 	struct ofono_data *od = telephony_service_get_data(service);
 	unsigned int strength = 0;
 
-	if (od->netreg)
-		strength = convert_strength_to_bars(ofono_network_registration_get_strength(od->netreg));
+	if (od->netreg) {
+		if (!od->signal_filter.primed)
+			signal_filter_update(&od->signal_filter, ofono_network_registration_get_strength(od->netreg));
+
+		strength = signal_filter_get_bars(&od->signal_filter);
+	}
 
 	cb(NULL, strength, data);
 }
 
-static void network_prop_changed_cb(const gchar *name, void *data)
+void ofono_network_filter_stats_query(struct telephony_service *service, telephony_network_filter_stats_query_cb cb, void *data)
+{
+	struct ofono_data *od = telephony_service_get_data(service);
+
+	cb(NULL, &od->filter_stats, data);
+}
+
+static void emit_signal_strength(struct ofono_data *od)
+{
+	od->filter_stats.emitted_strength_changes++;
+	telephony_service_signal_strength_changed_notify(od->service, signal_filter_get_bars(&od->signal_filter));
+}
+
+static gboolean signal_settle_cb(gpointer user_data)
+{
+	struct ofono_data *od = user_data;
+
+	if (signal_filter_settle(&od->signal_filter))
+		emit_signal_strength(od);
+
+	if (!signal_filter_is_settled(&od->signal_filter))
+		return TRUE;
+
+	od->signal_settle_timeout = 0;
+
+	return FALSE;
+}
+
+static void handle_strength_changed(struct ofono_data *od)
+{
+	od->filter_stats.raw_strength_changes++;
+
+	if (signal_filter_update(&od->signal_filter, ofono_network_registration_get_strength(od->netreg)))
+		emit_signal_strength(od);
+
+	/* ofono only tells us about changes so keep feeding the last sample until
+	 * the average caught up with it */
+	if (!signal_filter_is_settled(&od->signal_filter) && !od->signal_settle_timeout)
+		od->signal_settle_timeout = g_timeout_add_seconds(SIGNAL_SETTLE_INTERVAL_SECONDS, signal_settle_cb, od);
+}
+
+static unsigned int get_registration_damping(void)
+{
+	int damping = 0;
+
+	if (!telephony_settings_get_int(TELEPHONY_SETTINGS_TYPE_REGISTRATION_DAMPING, &damping) || damping < 0)
+		return REGISTRATION_DAMPING_DEFAULT_MS;
+
+	return damping;
+}
+
+static void emit_network_status(struct ofono_data *od, struct telephony_network_status *net_status)
+{
+	if (od->network_status_emitted &&
+		net_status->state == od->emitted_state &&
+		net_status->registration == od->emitted_registration &&
+		g_strcmp0(net_status->name, od->emitted_name) == 0)
+		return;
+
+	od->network_status_emitted = true;
+	od->emitted_state = net_status->state;
+	od->emitted_registration = net_status->registration;
+	g_free(od->emitted_name);
+	od->emitted_name = g_strdup(net_status->name);
+
+	od->filter_stats.emitted_registration_changes++;
+	telephony_service_network_status_changed_notify(od->service, net_status);
+}
+
+static gboolean registration_damping_cb(gpointer user_data)
+{
+	struct ofono_data *od = user_data;
+	struct telephony_network_status net_status;
+
+	od->registration_damping_timeout = 0;
+
+	/* the registration didn't come back in time so clients need to know */
+	if (od->netreg && retrieve_network_status(od, &net_status) == 0)
+		emit_network_status(od, &net_status);
+
+	return FALSE;
+}
+
+static void handle_network_status_changed(struct ofono_data *od, bool registration_changed)
 {
-	struct ofono_data *od = data;
 	struct telephony_network_status net_status;
-	int strength;
+	unsigned int damping;
+
+	if (registration_changed)
+		od->filter_stats.raw_registration_changes++;
+
+	if (retrieve_network_status(od, &net_status) < 0)
+		return;
+
+	if (od->registration_damping_timeout) {
+		/* still searching; everything else waits for the damping window to end */
+		if (net_status.state != TELEPHONY_NETWORK_STATE_SERVICE)
+			return;
 
-	if (g_str_equal(name, "Status") || g_str_equal(name, "Name")) {
-		if (retrieve_network_status(od, &net_status) < 0)
+		g_source_remove(od->registration_damping_timeout);
+		od->registration_damping_timeout = 0;
+	}
+	else if (od->network_status_emitted && od->emitted_state == TELEPHONY_NETWORK_STATE_SERVICE &&
+			 net_status.registration == TELEPHONY_NETWORK_REGISTRATION_SEARCHING) {
+		damping = get_registration_damping();
+		if (damping > 0) {
+			od->registration_damping_timeout = g_timeout_add(damping, registration_damping_cb, od);
 			return;
+		}
+	}
 
-		telephony_service_network_status_changed_notify(od->service, &net_status);
+	emit_network_status(od, &net_status);
+}
+
+static void reset_network_filter(struct ofono_data *od)
+{
+	if (od->signal_settle_timeout) {
+		g_source_remove(od->signal_settle_timeout);
+		od->signal_settle_timeout = 0;
 	}
-	else if (g_str_equal(name, "Strength")) {
-		strength = ofono_network_registration_get_strength(od->netreg);
-		telephony_service_signal_strength_changed_notify(od->service, convert_strength_to_bars(strength));
+
+	if (od->registration_damping_timeout) {
+		g_source_remove(od->registration_damping_timeout);
+		od->registration_damping_timeout = 0;
 	}
+
+	signal_filter_init(&od->signal_filter);
+
+	od->network_status_emitted = false;
+	g_free(od->emitted_name);
+	od->emitted_name = NULL;
+}
+
+static void network_prop_changed_cb(const gchar *name, void *data)
+{
+	struct ofono_data *od = data;
+
+	if (g_str_equal(name, "Status") || g_str_equal(name, "Name"))
+		handle_network_status_changed(od, g_str_equal(name, "Status"));
+	else if (g_str_equal(name, "Strength"))
+		handle_strength_changed(od);
 }
 
 enum telephony_radio_access_mode select_best_radio_access_mode(struct ofono_network_operator *netop)
@@ -552,6 +758,9 @@ void scan_operators_cb(struct ofono_error *error, GList *operators, void *data)
 
 			network->id = (mcc * 100) + mnc;
 			network->name = ofono_network_operator_get_name(netop);
+			if (!network->name || strlen(network->name) == 0)
+				network->name = plmn_lookup_name(ofono_network_operator_get_mcc(netop),
+												 ofono_network_operator_get_mnc(netop));
 			network->radio_access_mode = select_best_radio_access_mode(netop);
 
 			networks = g_list_append(networks, network);
@@ -571,6 +780,8 @@ void ofono_network_list_query(struct telephony_service *service, telephony_netwo
 	struct cb_data *cbd;
 	struct telephony_error error;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (od->netreg) {
 		od->network_scan_cancellable = g_cancellable_new();
 		cbd = cb_data_new(cb, data);
@@ -589,6 +800,8 @@ void ofono_network_list_query_cancel(struct telephony_service *service, telephon
 	struct ofono_data *od = telephony_service_get_data(service);
 	struct telephony_error error;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (od->network_scan_cancellable) {
 		g_cancellable_cancel(od->network_scan_cancellable);
 		cb(NULL, data);
@@ -653,7 +866,7 @@ void netop_register_cb(struct ofono_error *error, void *data)
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void get_operators_cb(struct ofono_error *err, GList *operators, void *data)
@@ -684,7 +897,7 @@ void get_operators_cb(struct ofono_error *err, GList *operators, void *data)
 	if (!found) {
 		terr.code = TELEPHONY_ERROR_INVALID_ARGUMENT;
 		cb(&terr, cbd->data);
-		g_free(cbd);
+		cb_data_free(cbd);
 	}
 }
 
@@ -702,7 +915,7 @@ void register_automatically_cb(struct ofono_error *error, void *data)
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_network_set(struct telephony_service *service, bool automatic, const char *id,
@@ -712,6 +925,8 @@ void ofono_network_set(struct telephony_service *service, bool automatic, const
 	struct telephony_error error;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, automatic, __func__);
+
 	if (od->netreg) {
 		cbd = cb_data_new(cb, data);
 
@@ -759,7 +974,7 @@ void rat_set_cb(struct ofono_error *error, void *data)
 		cb(NULL, cbd->data);
 	}
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_rat_set(struct telephony_service *service, enum telephony_radio_access_mode mode, telephony_result_cb cb, void *data)
@@ -768,6 +983,8 @@ void ofono_rat_set(struct telephony_service *service, enum telephony_radio_acces
 	struct telephony_error error;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, mode, __func__);
+
 	if (od->rs) {
 		cbd = cb_data_new(cb, data);
 		ofono_radio_settings_set_technology_preference(od->rs, mode, rat_set_cb, cbd);
@@ -819,7 +1036,7 @@ static void dial_cb(const struct ofono_error *error, const char *path, void *dat
 	cb(NULL, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_dial(struct telephony_service *service, const char *number, bool block_id, telephony_result_cb cb, void *data)
@@ -828,6 +1045,8 @@ void ofono_dial(struct telephony_service *service, const char *number, bool bloc
 	struct telephony_error error;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!od->vm) {
 		error.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&error, data);
@@ -846,6 +1065,8 @@ void ofono_answer(struct telephony_service *service, int call_id, telephony_resu
 	struct ofono_data *od = telephony_service_get_data(service);
 	struct telephony_error error;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, call_id, __func__);
+
 	if (!od->vm) {
 		error.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&error, data);
@@ -876,7 +1097,7 @@ cleanup:
 	if (watch)
 		ofono_message_watch_free(watch);
 
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 static void send_sms_cb(struct ofono_error *error, const char *path, void *data)
@@ -886,9 +1107,25 @@ static void send_sms_cb(struct ofono_error *error, const char *path, void *data)
 	struct telephony_error terr;
 
 	if (error) {
-		terr.code = TELEPHONY_ERROR_INTERNAL;
+		/* the SMS service decides on the error code whether retrying makes sense */
+		switch (error->type) {
+		case OFONO_ERROR_TYPE_INVALID_ARGUMENTS:
+		case OFONO_ERROR_TYPE_INVALID_FORMAT:
+			terr.code = TELEPHONY_ERROR_INVALID_ARGUMENT;
+			break;
+		case OFONO_ERROR_TYPE_NOT_IMPLEMENTED:
+			terr.code = TELEPHONY_ERROR_NOT_IMPLEMENTED;
+			break;
+		case OFONO_ERROR_TYPE_IN_PROGRESS:
+			terr.code = TELEPHONY_ERROR_ALREADY_INPROGRESS;
+			break;
+		default:
+			terr.code = TELEPHONY_ERROR_INTERNAL;
+			break;
+		}
+
 		cb(&terr, cbd->data);
-		g_free(cbd);
+		cb_data_free(cbd);
 		return;
 	}
 
@@ -903,6 +1140,8 @@ void ofono_send_sms(struct telephony_service *service, const char *to, const cha
 	struct telephony_error error;
 	struct cb_data *cbd;
 
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, 0, __func__);
+
 	if (!od->mm) {
 		error.code = TELEPHONY_ERROR_NOT_AVAILABLE;
 		cb(&error, data);
@@ -914,6 +1153,131 @@ void ofono_send_sms(struct telephony_service *service, const char *to, const cha
 	ofono_message_manager_send_message(od->mm, to, text, send_sms_cb, cbd);
 }
 
+static enum telephony_call_state convert_ofono_call_state(enum ofono_voicecall_state state)
+{
+	switch (state) {
+	case OFONO_VOICECALL_STATE_ACTIVE:
+		return TELEPHONY_CALL_STATE_ACTIVE;
+	case OFONO_VOICECALL_STATE_HELD:
+		return TELEPHONY_CALL_STATE_HELD;
+	case OFONO_VOICECALL_STATE_DIALING:
+		return TELEPHONY_CALL_STATE_DIALING;
+	case OFONO_VOICECALL_STATE_ALERTING:
+		return TELEPHONY_CALL_STATE_ALERTING;
+	case OFONO_VOICECALL_STATE_INCOMING:
+		return TELEPHONY_CALL_STATE_INCOMING;
+	case OFONO_VOICECALL_STATE_WAITING:
+		return TELEPHONY_CALL_STATE_WAITING;
+	default:
+		break;
+	}
+
+	return TELEPHONY_CALL_STATE_DISCONNECTED;
+}
+
+static void call_info_free(struct call_info *info)
+{
+	g_free(info->number);
+	g_free(info);
+}
+
+static void notify_call_status(struct call_info *info, enum telephony_call_state state)
+{
+	struct telephony_call_status call_status;
+
+	call_status.id = info->id;
+	call_status.state = state;
+	call_status.number = info->number;
+
+	telephony_service_call_status_changed_notify(info->od->service, &call_status);
+}
+
+static void call_prop_changed_cb(const gchar *name, void *data)
+{
+	struct call_info *info = data;
+
+	if (g_str_equal(name, "LineIdentification")) {
+		g_free(info->number);
+		info->number = g_strdup(ofono_voicecall_get_line_identification(info->call));
+	}
+	else if (!g_str_equal(name, "State")) {
+		return;
+	}
+
+	notify_call_status(info, convert_ofono_call_state(ofono_voicecall_get_state(info->call)));
+}
+
+/* Starts tracking a call; its state is reported once ofono delivered the
+ * call properties */
+static void add_call(struct ofono_data *od, struct ofono_voicecall *call)
+{
+	struct call_info *info;
+	const char *path = ofono_voicecall_get_path(call);
+
+	if (!path || g_hash_table_contains(od->calls, path))
+		return;
+
+	info = g_new0(struct call_info, 1);
+	info->id = ++od->next_call_id;
+	info->call = call;
+	info->od = od;
+
+	g_hash_table_insert(od->calls, g_strdup(path), info);
+
+	ofono_voicecall_register_prop_changed_cb(call, call_prop_changed_cb, info);
+}
+
+static void call_added_cb(const char *path, void *data)
+{
+	struct ofono_data *od = data;
+	struct ofono_voicecall *call;
+
+	call = ofono_voicecall_manager_find_call(od->vm, path);
+	if (call)
+		add_call(od, call);
+}
+
+static void call_removed_cb(const char *path, void *data)
+{
+	struct ofono_data *od = data;
+	struct call_info *info;
+
+	info = g_hash_table_lookup(od->calls, path);
+	if (!info)
+		return;
+
+	notify_call_status(info, TELEPHONY_CALL_STATE_DISCONNECTED);
+	g_hash_table_remove(od->calls, path);
+}
+
+static void get_calls_cb(const struct ofono_error *error, GList *calls, void *data)
+{
+	struct ofono_data *od = data;
+	GList *iter;
+
+	if (error) {
+		g_warning("[Telephony] Failed to retrieve calls from ofono; call state won't be published");
+		return;
+	}
+
+	for (iter = calls; iter != NULL; iter = g_list_next(iter))
+		add_call(od, iter->data);
+}
+
+/* Reports all calls we track as disconnected; used when the voicecall manager
+ * goes away and takes its calls along */
+static void remove_all_calls(struct ofono_data *od)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, od->calls);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		notify_call_status(value, TELEPHONY_CALL_STATE_DISCONNECTED);
+		g_hash_table_iter_remove(&iter);
+	}
+}
+
 static void incoming_message_cb(struct ofono_message *message, void *data)
 {
 	struct ofono_data *od = data;
@@ -958,8 +1322,12 @@ static void modem_prop_changed_cb(const gchar *name, void *data)
 	bool powered = false, online = false;
 	const char *path = ofono_modem_get_path(od->modem);
 
+	startup_timeline_mark(STARTUP_PHASE_MODEM_PROPERTIES);
+
 	if (g_str_equal(name, "Online")) {
 		online = ofono_modem_get_online(od->modem);
+		if (online)
+			startup_timeline_mark(STARTUP_PHASE_MODEM_ONLINE);
 		telephony_service_power_status_notify(od->service, online);
 	}
 	else if (g_str_equal(name, "Interfaces")) {
@@ -979,6 +1347,7 @@ static void modem_prop_changed_cb(const gchar *name, void *data)
 		else if (od->netreg && !ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)) {
 			ofono_network_registration_free(od->netreg);
 			od->netreg = NULL;
+			reset_network_filter(od);
 			notify_no_network_registration(od->service);
 		}
 
@@ -992,8 +1361,13 @@ static void modem_prop_changed_cb(const gchar *name, void *data)
 
 		if (!od->vm && ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_VOICE_CALL_MANAGER)) {
 			od->vm = ofono_voicecall_manager_create(path);
+			ofono_voicecall_manager_register_call_added_cb(od->vm, call_added_cb, od);
+			ofono_voicecall_manager_register_call_removed_cb(od->vm, call_removed_cb, od);
+			/* also connects us to the CallAdded and CallRemoved signals */
+			ofono_voicecall_manager_get_calls(od->vm, get_calls_cb, od);
 		}
 		else if (od->vm && !ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_VOICE_CALL_MANAGER)) {
+			remove_all_calls(od);
 			ofono_voicecall_manager_free(od->vm);
 			od->vm = NULL;
 		}
@@ -1009,6 +1383,9 @@ static void modem_prop_changed_cb(const gchar *name, void *data)
 	}
 	else if (g_str_equal(name, "Powered")) {
 		powered = ofono_modem_get_powered(od->modem);
+		if (powered)
+			startup_timeline_mark(STARTUP_PHASE_MODEM_POWERED);
+
 		/* We need to handle power status changes differently when in initialization phase */
 		if (od->initializing && powered) {
 			telephony_service_availability_changed_notify(od->service, true);
@@ -1026,6 +1403,8 @@ static void modems_changed_cb(gpointer user_data)
 
 	modems = ofono_manager_get_modems(data->manager);
 
+	startup_timeline_mark(STARTUP_PHASE_MODEMS_RETRIEVED);
+
 	/* select first modem from the list as default for now */
 	if (modems) {
 		ofono_modem_ref(modems->data);
@@ -1062,6 +1441,7 @@ static void free_used_instances(struct ofono_data *od)
 	}
 
 	if (od->vm) {
+		remove_all_calls(od);
 		ofono_voicecall_manager_free(od->vm);
 		od->vm = NULL;
 	}
@@ -1071,6 +1451,8 @@ static void free_used_instances(struct ofono_data *od)
 		od->netreg = NULL;
 	}
 
+	reset_network_filter(od);
+
 	if (od->sim) {
 		ofono_sim_manager_free(od->sim);
 		od->sim = NULL;
@@ -1092,6 +1474,8 @@ static void service_appeared_cb(GDBusConnection *conn, const gchar *name, const
 
 	g_message("ofono dbus service available");
 
+	startup_timeline_mark(STARTUP_PHASE_OFONO_APPEARED);
+
 	if (od->manager)
 		return;
 
@@ -1123,8 +1507,9 @@ int ofono_probe(struct telephony_service *service)
 
 	data->sim_status = TELEPHONY_SIM_STATUS_SIM_INVALID;
 	data->initializing = false;
+	signal_filter_init(&data->signal_filter);
 	data->calls = g_hash_table_new_full(g_str_hash, g_str_equal,
-										g_free, (GDestroyNotify) g_hash_table_destroy);
+										g_free, (GDestroyNotify) call_info_free);
 
 	data->service_watch = g_bus_watch_name(G_BUS_TYPE_SYSTEM, "org.ofono", G_BUS_NAME_WATCHER_FLAGS_NONE,
 					 service_appeared_cb, service_vanished_cb, data, NULL);
@@ -1138,10 +1523,10 @@ void ofono_remove(struct telephony_service *service)
 
 	data = telephony_service_get_data(service);
 
-	g_hash_table_destroy(data->calls);
-
 	free_used_instances(data);
 
+	g_hash_table_destroy(data->calls);
+
 	g_bus_unwatch_name(data->service_watch);
 
 	g_free(data);
@@ -1166,6 +1551,7 @@ struct telephony_driver ofono_telephony_driver = {
 	.fdn_status_query = ofono_fdn_status_query,
 	.network_status_query = ofono_network_status_query,
 	.signal_strength_query = ofono_signal_strength_query,
+	.network_filter_stats_query = ofono_network_filter_stats_query,
 	.network_list_query = ofono_network_list_query,
 	.network_list_query_cancel = ofono_network_list_query_cancel,
 	.network_id_query = ofono_network_id_query,
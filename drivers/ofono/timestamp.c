@@ -0,0 +1,266 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "timestamp.h"
+
+static bool parse_digits(const char *str, int count, int *value)
+{
+	int result = 0;
+	int n;
+
+	for (n = 0; n < count; n++) {
+		if (str[n] < '0' || str[n] > '9')
+			return false;
+		result = result * 10 + (str[n] - '0');
+	}
+
+	*value = result;
+
+	return true;
+}
+
+/* Days since 1970-01-01 for a date of the proleptic gregorian calendar */
+static gint64 days_from_civil(int year, int month, int day)
+{
+	int era, yoe, doy, doe;
+
+	year -= month <= 2;
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return (gint64) era * 146097 + doe - 719468;
+}
+
+/* The UTC offset of local time only changes with DST or a new timezone, so
+ * the last one is kept together with the span of time it is valid for. The
+ * span is found by probing in steps of a day, which is shorter than the time
+ * between two transitions of any real zone, and narrowed down to the second
+ * around a transition. It is limited to a month on both sides so a miss stays
+ * cheap. A change of TZ or of /etc/localtime (checked at most once a second)
+ * throws it away. Only used from the main loop. */
+#define OFFSET_PROBE_STEP		86400
+#define OFFSET_PROBE_STEPS		31
+#define LOCALTIME_PATH			"/etc/localtime"
+
+struct offset_cache {
+	bool valid;
+	long offset;
+	/* offset is in effect from start up to and including end */
+	time_t start;
+	time_t end;
+	gchar *tz;
+	time_t localtime_checked;
+	struct stat localtime_stat;
+};
+
+static struct offset_cache cache;
+
+static long utc_offset_at(time_t t)
+{
+	struct tm tm;
+
+	if (localtime_r(&t, &tm) == NULL)
+		return 0;
+
+	return tm.tm_gmtoff;
+}
+
+static bool localtime_changed(void)
+{
+	time_t now = time(NULL);
+	struct stat st;
+	bool changed;
+
+	if (now == cache.localtime_checked)
+		return false;
+
+	cache.localtime_checked = now;
+
+	if (stat(LOCALTIME_PATH, &st) < 0)
+		memset(&st, 0, sizeof(st));
+
+	changed = st.st_dev != cache.localtime_stat.st_dev || st.st_ino != cache.localtime_stat.st_ino ||
+			  st.st_mtime != cache.localtime_stat.st_mtime || st.st_size != cache.localtime_stat.st_size;
+
+	cache.localtime_stat = st;
+
+	return changed;
+}
+
+static void check_timezone(void)
+{
+	const char *tz = getenv("TZ");
+	bool changed;
+
+	changed = localtime_changed();
+
+	if (g_strcmp0(tz, cache.tz) != 0) {
+		g_free(cache.tz);
+		cache.tz = g_strdup(tz);
+		changed = true;
+	}
+
+	if (changed) {
+		cache.valid = false;
+		tzset();
+	}
+}
+
+/* Finds the last second from known on (in the direction of step) which still
+ * has the given offset, not looking further than OFFSET_PROBE_STEPS steps */
+static time_t find_transition(time_t known, long offset, long step)
+{
+	time_t probe, same = known, other;
+	long span;
+	int n;
+
+	for (n = 0; n < OFFSET_PROBE_STEPS; n++) {
+		probe = same + step;
+		if (utc_offset_at(probe) != offset)
+			break;
+		same = probe;
+	}
+
+	if (n == OFFSET_PROBE_STEPS)
+		return same;
+
+	other = probe;
+	span = labs(step);
+
+	while (span > 1) {
+		span /= 2;
+		probe = same + (step > 0 ? span : -span);
+		if (utc_offset_at(probe) == offset)
+			same = probe;
+		else
+			other = probe;
+		span = labs(other - same);
+	}
+
+	return same;
+}
+
+static long cached_utc_offset_at(time_t t)
+{
+	if (cache.valid && t >= cache.start && t <= cache.end)
+		return cache.offset;
+
+	cache.offset = utc_offset_at(t);
+	cache.start = find_transition(t, cache.offset, -OFFSET_PROBE_STEP);
+	cache.end = find_transition(t, cache.offset, OFFSET_PROBE_STEP);
+	cache.valid = true;
+
+	return cache.offset;
+}
+
+/* Converts a local wall clock time, given as if it were UTC, to UTC. The
+ * offset depends on the UTC time we're looking for, so the first guess is
+ * corrected with the offset in effect at that guess; this gets times right
+ * before and after a DST transition. */
+static time_t local_to_utc(time_t local_time)
+{
+	time_t guess;
+
+	check_timezone();
+
+	guess = local_time - cached_utc_offset_at(local_time);
+
+	return local_time - cached_utc_offset_at(guess);
+}
+
+/**
+ * Decodes timestamps like ofono sends them for the SentTime and LocalSentTime
+ * message properties: YYYY-MM-DDTHH:MM:SS followed by an optional UTC offset
+ * in the form +HHMM, -HHMM, +HH:MM, +HH or Z. Without an offset the time is
+ * taken as local time.
+ */
+bool timestamp_decode_iso8601(const char *str, time_t *result)
+{
+	int year, month, day, hour, min, sec;
+	int offset_hour = 0, offset_min = 0;
+	long offset = 0;
+	const char *p;
+	time_t t;
+
+	if (!str)
+		return false;
+
+	if (!parse_digits(str, 4, &year) || str[4] != '-' ||
+		!parse_digits(str + 5, 2, &month) || str[7] != '-' ||
+		!parse_digits(str + 8, 2, &day) || (str[10] != 'T' && str[10] != ' ') ||
+		!parse_digits(str + 11, 2, &hour) || str[13] != ':' ||
+		!parse_digits(str + 14, 2, &min) || str[16] != ':' ||
+		!parse_digits(str + 17, 2, &sec))
+		return false;
+
+	if (month < 1 || month > 12 || day < 1 || day > 31 ||
+		hour > 23 || min > 59 || sec > 60)
+		return false;
+
+	t = (time_t) (days_from_civil(year, month, day) * 86400 + hour * 3600 + min * 60 + sec);
+
+	p = str + 19;
+	switch (*p) {
+	case '\0':
+		*result = local_to_utc(t);
+		return true;
+	case 'Z':
+		if (p[1] != '\0')
+			return false;
+
+		*result = t;
+		return true;
+	case '+':
+	case '-':
+		if (!parse_digits(p + 1, 2, &offset_hour))
+			return false;
+
+		if (p[3] == ':') {
+			if (!parse_digits(p + 4, 2, &offset_min) || p[6] != '\0')
+				return false;
+		}
+		else if (p[3] != '\0') {
+			if (!parse_digits(p + 3, 2, &offset_min) || p[5] != '\0')
+				return false;
+		}
+
+		if (offset_hour > 23 || offset_min > 59)
+			return false;
+
+		offset = offset_hour * 3600 + offset_min * 60;
+		if (*p == '-')
+			offset = -offset;
+
+		*result = t - offset;
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,29 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef TIMESTAMP_H_
+#define TIMESTAMP_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+bool timestamp_decode_iso8601(const char *str, time_t *result);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
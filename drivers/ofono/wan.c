@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "utils.h"
+#include "flightrecorder.h"
 
 #include "wanservice.h"
 #include "wandriver.h"
@@ -31,10 +32,14 @@
 #include "ofonoconnectioncontext.h"
 #include "ofonoconnectionmanager.h"
 #include "ofononetworkregistration.h"
+#include "connmanclient.h"
+#include "wantraffic.h"
 
 #define is_flag_set(flags, flag) \
 	((flags & flag) == flag)
 
+#define WAN_USAGE_PATH		TELEPHONY_STATE_DIR "/wan-usage"
+
 struct ofono_wan_data {
 	struct wan_service *service;
 	guint service_watch;
@@ -44,13 +49,11 @@ struct ofono_wan_data {
 	struct ofono_network_registration *netreg;
 	bool status_update_pending;
 	struct wan_configuration *pending_configuration;
-	guint connman_watch;
-	GDBusProxy *connman_manager_proxy;
-	gboolean wan_disabled;
-	gboolean pending_wan_disabled;
-	gchar *current_service_path;
-	guint current_service_watch;
-	GDBusProxy *current_service_proxy;
+	struct connman_client *connman;
+	struct connman_service *current_service;
+	bool wan_disabled;
+	bool pending_wan_disabled;
+	struct wan_traffic_monitor *traffic;
 };
 
 enum wan_network_type convert_ofono_connection_bearer_to_wan_network_type(enum ofono_connection_bearer bearer)
@@ -103,81 +106,59 @@ static void free_used_instances(struct ofono_wan_data *od)
 	}
 }
 
-static void current_service_autoconnect_set_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+static void current_service_autoconnect_set_cb(struct ofono_error *error, void *data)
 {
-	struct cb_data *cbd = user_data;
+	struct cb_data *cbd = data;
 	struct ofono_wan_data *od = cbd->user;
-	wan_result_cb cb = cbd->cb;
-	struct wan_error werror;
-	GError *error = 0;
-	GDBusConnection *conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
-
-	GVariant *result = g_dbus_connection_call_finish(conn, res, &error);
-	if (error) {
-		g_warning("Failed to set auto connect field for cellular service %s: %s",
-				  od->current_service_path, error->message);
-		g_error_free(error);
+	ofono_base_result_cb cb = cbd->cb;
 
-		werror.code = WAN_ERROR_FAILED;
-		cb(&werror, cbd->data);
+	if (error)
+		g_warning("[WAN] Failed to set auto connect field for cellular service %s: %s",
+				  connman_service_get_path(od->current_service), error->message);
 
-		goto cleanup;
-	}
-
-	g_variant_unref(result);
-
-	cb(NULL, cbd->data);
+	if (cb)
+		cb(error, cbd->data);
 
-cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
-static void current_service_enabled_cb(GObject *source, GAsyncResult *res, gpointer user_data)
+static void current_service_enabled_cb(struct ofono_error *error, void *data)
 {
-	struct cb_data *cbd = user_data;
+	struct cb_data *cbd = data;
 	struct ofono_wan_data *od = cbd->user;
-	wan_result_cb cb = cbd->cb;
-	struct wan_error werror;
-	GError *error = 0;
-	GDBusConnection *conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+	ofono_base_result_cb cb = cbd->cb;
 
-	GVariant *result = g_dbus_connection_call_finish(conn, res, &error);
 	if (error) {
-		g_warning("Failed to %s current cellular service %s: %s",
-				  (!od->pending_configuration || !od->pending_configuration->disablewan) ? "enable" : "disable",
-				  od->current_service_path, error->message);
-		g_error_free(error);
-
-		if(cb) {
-			werror.code = WAN_ERROR_FAILED;
-			cb(&werror, cbd->data);
-		}
+		g_warning("[WAN] Failed to %s current cellular service %s: %s",
+				  od->pending_wan_disabled ? "disable" : "enable",
+				  connman_service_get_path(od->current_service), error->message);
 
-		g_free(cbd);
+		if (cb)
+			cb(error, cbd->data);
+
+		cb_data_free(cbd);
 
 		return;
 	}
 
-	g_variant_unref(result);
-
-	g_dbus_connection_call(conn, "net.connman", od->current_service_path,
-						   "net.connman.Service", "SetProperty",
-						   g_variant_new("(sv)", "AutoConnect", g_variant_new_boolean(!od->pending_configuration->disablewan)), NULL,
-						   G_DBUS_CALL_FLAGS_NONE, -1, NULL,
-						   current_service_autoconnect_set_cb, od);
+	connman_service_set_autoconnect(od->current_service, !od->pending_wan_disabled,
+									current_service_autoconnect_set_cb, cbd);
 }
 
 static void switch_current_service_state(struct ofono_wan_data *od, bool enable,
-										 wan_result_cb cb, void *data)
+										 ofono_base_result_cb cb, void *data)
 {
-	GDBusConnection *conn = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+	struct cb_data *cbd = NULL;
 
-	g_message("enable %d", enable);
+	cbd = cb_data_new(cb, data);
+	cbd->user = od;
 
-	g_dbus_connection_call(conn, "net.connman", od->current_service_path,
-						   "net.connman.Service", enable ? "Connect" : "Disconnect", NULL, NULL,
-						   G_DBUS_CALL_FLAGS_NONE, -1, NULL,
-						   (GAsyncReadyCallback) current_service_enabled_cb, data);
+	od->pending_wan_disabled = !enable;
+
+	if (enable)
+		connman_service_connect(od->current_service, current_service_enabled_cb, cbd);
+	else
+		connman_service_disconnect(od->current_service, current_service_enabled_cb, cbd);
 }
 
 static void context_prop_changed_cb(const char *name, void *data);
@@ -190,6 +171,9 @@ static void get_contexts_cb(const struct ofono_error *error, GSList *contexts, v
 	struct wan_status status;
 	struct ofono_connection_context *context;
 	struct wan_connected_service *wanservice;
+	struct wan_traffic_stats traffic;
+	const char *path;
+	bool active;
 	GSList *iter;
 
 	memset(&status, 0, sizeof(struct wan_status));
@@ -215,8 +199,12 @@ static void get_contexts_cb(const struct ofono_error *error, GSList *contexts, v
 		status.network_type = convert_ofono_connection_bearer_to_wan_network_type(bearer);
 	}
 
+	wan_traffic_monitor_begin_update(od->traffic);
+
 	for (iter = contexts; iter != NULL; iter = g_slist_next(iter)) {
 		context = iter->data;
+		path = ofono_connection_context_get_path(context);
+		active = ofono_connection_context_get_active(context);
 
 		ofono_connection_context_register_prop_changed_cb(context, context_prop_changed_cb, od);
 
@@ -234,23 +222,44 @@ static void get_contexts_cb(const struct ofono_error *error, GSList *contexts, v
 		}
 
 		wanservice->ipaddress = ofono_connection_context_get_address(context);
-		wanservice->connection_status = ofono_connection_context_get_active(context) ?
+		wanservice->connection_status = active ?
 					WAN_CONNECTION_STATUS_ACTIVE : WAN_CONNECTION_STATUS_DISCONNECTED;
 
+		wan_traffic_monitor_update(od->traffic, path,
+					active ? ofono_connection_context_get_interface(context) : NULL);
+
+		if (wan_traffic_monitor_get_stats(od->traffic, path, &traffic)) {
+			wanservice->rx_bytes = traffic.rx_bytes;
+			wanservice->tx_bytes = traffic.tx_bytes;
+			wanservice->total_rx_bytes = traffic.total_rx_bytes;
+			wanservice->total_tx_bytes = traffic.total_tx_bytes;
+			wanservice->rx_rate = traffic.rx_rate;
+			wanservice->tx_rate = traffic.tx_rate;
+
+			if (active && traffic.dormant)
+				wanservice->connection_status = WAN_CONNECTION_STATUS_DORMANT;
+		}
+
 		/* FIXME to what we have to set the following field? */
 		wanservice->req_status = WAN_REQUEST_STATUS_CONNECT_SUCCEEDED;
 
-		/* If at least one service is active we report a active connection */
+		/* If at least one service is active we report a active connection and
+		 * a dormant one if all connected services are idle */
 		if (wanservice->connection_status == WAN_CONNECTION_STATUS_ACTIVE)
 			status.connection_status = WAN_CONNECTION_STATUS_ACTIVE;
+		else if (wanservice->connection_status == WAN_CONNECTION_STATUS_DORMANT &&
+				 status.connection_status != WAN_CONNECTION_STATUS_ACTIVE)
+			status.connection_status = WAN_CONNECTION_STATUS_DORMANT;
 
 		status.connected_services = g_slist_append(status.connected_services, wanservice);
 	}
 
+	wan_traffic_monitor_end_update(od->traffic);
+
 	cb(NULL, &status, cbd->data);
 
 	g_slist_free_full(status.connected_services, g_free);
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_wan_get_status(struct wan_service *service, wan_get_status_cb cb, void *data)
@@ -265,14 +274,16 @@ void ofono_wan_get_status(struct wan_service *service, wan_get_status_cb cb, voi
 	ofono_connection_manager_get_contexts(od->cm, get_contexts_cb, cbd);
 }
 
-static void roamguard_set_cb(const struct wan_error* error, void *data)
+static void roamguard_set_cb(struct ofono_error *error, void *data)
 {
 	struct cb_data *cbd = data;
 	struct ofono_wan_data *od = cbd->user;
 	wan_result_cb cb = cbd->cb;
+	struct wan_error werror;
 
 	if (error) {
-		cb(error, cbd->data);
+		werror.code = WAN_ERROR_FAILED;
+		cb(&werror, cbd->data);
 		goto cleanup;
 	}
 
@@ -281,7 +292,7 @@ static void roamguard_set_cb(const struct wan_error* error, void *data)
 	cb(NULL, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 static void disablewan_set_cb(struct ofono_error *error, void *data)
@@ -305,10 +316,12 @@ static void disablewan_set_cb(struct ofono_error *error, void *data)
 		}
 	}
 
+	od->pending_configuration = NULL;
+
 	cb(NULL, cbd->data);
 
 cleanup:
-	g_free(cbd);
+	cb_data_free(cbd);
 }
 
 void ofono_wan_set_configuration(struct wan_service *service, struct wan_configuration *configuration,
@@ -318,7 +331,9 @@ void ofono_wan_set_configuration(struct wan_service *service, struct wan_configu
 	struct cb_data *cbd = NULL;
 	struct wan_error error;
 
-	if (!od->current_service_path) {
+	flight_recorder_record(FLIGHT_EVENT_DRIVER_CALL, 0, configuration->flags, __func__);
+
+	if (!od->current_service) {
 		error.code = WAN_ERROR_NOT_AVAILABLE;
 		cb(&error, data);
 		return;
@@ -326,27 +341,29 @@ void ofono_wan_set_configuration(struct wan_service *service, struct wan_configu
 
 	od->pending_configuration = configuration;
 
-	if (is_flag_set(configuration->flags, WAN_CONFIGURATION_TYPE_DISABLEWAN)) {
-		if (configuration->disablewan != od->wan_disabled) {
-			cbd = cb_data_new(cb, data);
-			cbd->user = od;
+	if (is_flag_set(configuration->flags, WAN_CONFIGURATION_TYPE_DISABLEWAN) &&
+		configuration->disablewan != od->wan_disabled) {
+		cbd = cb_data_new(cb, data);
+		cbd->user = od;
 
-			switch_current_service_state(od, !configuration->disablewan,
-										 disablewan_set_cb, cbd);
-		}
+		switch_current_service_state(od, !configuration->disablewan,
+									 disablewan_set_cb, cbd);
+		return;
 	}
-	else if (is_flag_set(configuration->flags, WAN_CONFIGURATION_TYPE_ROAMGUARD)) {
-		if (configuration->roamguard == ofono_connection_manager_get_roaming_allowed(od->cm)) {
-			cbd = cb_data_new(cb, data);
-			cbd->user = od;
 
-			ofono_connection_manager_set_roaming_allowed(od->cm, !configuration->roamguard,
-														 roamguard_set_cb, cbd);
-		}
-	}
-	else {
-		cb (NULL, data);
+	if (is_flag_set(configuration->flags, WAN_CONFIGURATION_TYPE_ROAMGUARD) &&
+		configuration->roamguard == ofono_connection_manager_get_roaming_allowed(od->cm)) {
+		cbd = cb_data_new(cb, data);
+		cbd->user = od;
+
+		ofono_connection_manager_set_roaming_allowed(od->cm, !configuration->roamguard,
+													 roamguard_set_cb, cbd);
+		return;
 	}
+
+	od->pending_configuration = NULL;
+
+	cb(NULL, data);
 }
 
 static void get_status_cb(const struct wan_error *error, struct wan_status *status, void *data)
@@ -399,6 +416,10 @@ static void modem_prop_changed_cb(const gchar *name, void *data)
 		else if (od->cm && !ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_CONNECTION_MANAGER)) {
 			ofono_connection_manager_free(od->cm);
 			od->cm = NULL;
+
+			/* all contexts are gone with the connection manager */
+			wan_traffic_monitor_begin_update(od->traffic);
+			wan_traffic_monitor_end_update(od->traffic);
 		}
 		if (!od->netreg && ofono_modem_is_interface_supported(od->modem, OFONO_MODEM_INTERFACE_NETWORK_REGISTRATION)) {
 			od->netreg = ofono_network_registration_create(path);
@@ -457,49 +478,23 @@ static void service_vanished_cb(GDBusConnection *conn, const gchar *name, gpoint
 	free_used_instances(od);
 }
 
-static void handle_current_service_property(struct ofono_wan_data *od, const gchar *name, GVariant *value)
+static void current_service_prop_changed_cb(const gchar *name, void *data)
 {
-	GVariant *state_v = 0;
-	const gchar *state = 0;
-	gboolean wan_disable_before = od->wan_disabled;
-
-	if (g_strcmp0(name, "State") == 0) {
-		state_v = g_variant_get_variant(value);
-		state = g_variant_get_string(state_v, NULL);
-
-		if (g_strcmp0(state, "ready") == 0 || g_strcmp0(state, "online") == 0)
-			od->wan_disabled = FALSE;
-		else
-			od->wan_disabled = TRUE;
-
-		g_variant_unref(state_v);
-	}
-
-	if (od->wan_disabled != wan_disable_before)
-		send_status_update_cb(od);
-}
-
-static void current_service_signal_cb(GDBusProxy *proxy, gchar *sender_name, gchar *signal_name,
-									  GVariant *parameters, gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-	GVariant *prop_name = 0, *prop_value = 0;
-	const gchar *name = 0;
+	struct ofono_wan_data *od = data;
+	bool wan_disabled;
 
-	if (g_strcmp0(signal_name, "PropertyChanged") != 0)
+	if (!g_str_equal(name, "State"))
 		return;
 
-	prop_name = g_variant_get_child_value(parameters, 0);
-	prop_value = g_variant_get_child_value(parameters, 1);
-	name = g_variant_get_string(prop_name, NULL);
-
-	handle_current_service_property(od, name, prop_value);
+	wan_disabled = !connman_service_is_connected(od->current_service);
+	if (wan_disabled == od->wan_disabled)
+		return;
 
-	g_variant_unref(prop_name);
-	g_variant_unref(prop_value);
+	od->wan_disabled = wan_disabled;
+	send_status_update_cb(od);
 }
 
-static void cellular_service_setup_cb(const struct wan_error* error, void *data)
+static void cellular_service_setup_cb(struct ofono_error *error, void *data)
 {
 	if (error) {
 		g_message("[WAN] Failed to connect to cellular service");
@@ -509,217 +504,28 @@ static void cellular_service_setup_cb(const struct wan_error* error, void *data)
 	g_message("[WAN] Successfully connected to celluar service the first time");
 }
 
-static void assign_current_cellular_service(struct ofono_wan_data *od, const gchar *path, GVariant *properties)
-{
-	GVariant *property = 0, *prop_name = 0, *prop_value = 0;
-	gsize n = 0;
-	const gchar *name = 0;
-	bool favorite = false;
-
-	if (!path) {
-		if (od->current_service_watch)
-			g_signal_handler_disconnect(od->current_service_proxy,
-								od->current_service_watch);
-
-		if (od->current_service_proxy)
-			g_object_unref(od->current_service_proxy);
-
-
-		od->current_service_path = NULL;
-		od->current_service_proxy = 0;
-		od->current_service_watch = 0;
-
-		return;
-	}
-
-	od->current_service_path = g_strdup(path);
-
-	od->current_service_proxy = g_dbus_proxy_new_for_bus_sync(G_BUS_TYPE_SYSTEM,
-															  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-															  NULL, "net.connman",
-															  path, "net.connman.Service",
-															  NULL, NULL);
-
-	od->current_service_watch = g_signal_connect(od->current_service_proxy, "g-signal",
-												 G_CALLBACK(current_service_signal_cb), od);
-
-	for (n = 0; n < g_variant_n_children(properties); n++) {
-		property = g_variant_get_child_value(properties, n);
-
-		prop_name = g_variant_get_child_value(property, 0);
-		prop_value = g_variant_get_child_value(property, 1);
-
-		name = g_variant_get_string(prop_name, NULL);
-
-		if (g_strcmp0(name, "Favorite") == 0) {
-			favorite = g_variant_get_boolean(g_variant_get_variant(prop_value));
-
-			if (!favorite) {
-				g_message("[WAN] Found a not yet configured cellular service; connecting to it for the first time");
-
-				struct cb_data *cbd = NULL;
-				cbd = cb_data_new(NULL, NULL);
-				cbd->user = od;
-				switch_current_service_state(od, true, cellular_service_setup_cb, cbd);
-			}
-		}
-
-		handle_current_service_property(od, name, prop_value);
-	}
-}
-
-static void update_from_service_list(struct ofono_wan_data *od, GVariant *service_list)
+static void cellular_service_changed_cb(struct connman_service *service, void *data)
 {
-	GVariant *service = 0, *object_path = 0, *properties = 0;
-	const gchar *path = 0;
-	gboolean found = FALSE;
-	gsize n = 0;
-
-	for (n = 0; n < g_variant_n_children(service_list); n++) {
-		service = g_variant_get_child_value(service_list, n);
-		object_path = g_variant_get_child_value(service, 0);
-		properties = g_variant_get_child_value(service, 1);
-		path = g_variant_get_string(object_path, NULL);
-
-		if (g_strrstr(path, "cellular") != 0) {
-			g_message("[WAN] Found a cellular service %s", path);
-			/* FIXME we assume here that we only have one cellular service. When
-			 * we come to the point where we support multi-sim modems we have to
-			 * revisit this decision */
-			assign_current_cellular_service(od, path, properties);
-			found = TRUE;
-		}
-
-		g_variant_unref(object_path);
-		g_variant_unref(service);
+	struct ofono_wan_data *od = data;
 
-		if (found)
-			break;
-	}
+	od->current_service = service;
 
-	if (!found) {
+	if (!service) {
 		g_message("[WAN] Didn't find a cellular service");
-		assign_current_cellular_service(od, NULL, NULL);
-	}
-}
-
-static void update_from_changed_services(struct ofono_wan_data *od, GVariant *parameters)
-{
-	GVariant *services_added = 0;
-	GVariant *services_removed = 0;
-	gsize n = 0;
-	gboolean done = FALSE;
-
-	services_added = g_variant_get_child_value(parameters, 0);
-	services_removed = g_variant_get_child_value(parameters, 1);
-
-	if (!od->current_service_path)
-		update_from_service_list(od, services_added);
-
-	if (!od->current_service_path)
-		return;
-
-	for (n = 0; n < g_variant_n_children(services_removed); n++) {
-		GVariant *service = g_variant_get_child_value(services_removed, n);
-		const gchar *path = g_variant_get_string(service, NULL);
-
-		if (g_strcmp0(od->current_service_path, path) == 0) {
-			g_warning("[WAN] Current cellular service %s disappeared", path);
-
-			g_object_unref(od->current_service_proxy);
-			od->current_service_proxy = 0;
-
-			g_source_remove(od->current_service_watch);
-			od->current_service_watch = 0;
-
-			g_free(od->current_service_path);
-			od->current_service_path = 0;
-
-			done = TRUE;
-		}
-
-		g_variant_unref(service);
-
-		if (done)
-			break;
-	}
-}
-
-static void services_changed_cb(GDBusProxy *proxy, gchar *sender_name, gchar *signal_name,
-									  GVariant *parameters, gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-
-	if (g_strcmp0(signal_name, "ServicesChanged") != 0)
-		return;
-
-	update_from_changed_services(od, parameters);
-}
-
-static void connman_manager_get_services_cb(GObject *source, GAsyncResult *res, gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-	GError *error = 0;
-	GVariant *service_list = 0, *response = 0;
-
-	response = g_dbus_proxy_call_finish(od->connman_manager_proxy, res, &error);
-	if (error) {
-		g_warning("Failed to create proxy for connman manager service: %s", error->message);
-		g_error_free(error);
+		wan_service_availability_changed_notify(od->service, false);
 		return;
 	}
 
-	service_list = g_variant_get_child_value(response, 0);
+	connman_service_register_prop_changed_cb(service, current_service_prop_changed_cb, od);
+	current_service_prop_changed_cb("State", od);
 
-	g_message("[WAN] got %d services from connman", g_variant_n_children(service_list));
-
-	update_from_service_list(od, service_list);
-}
-
-static void connman_manager_proxy_connect_cb(GObject *source, GAsyncResult *res, gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-	GError *error = 0;
-
-	od->connman_manager_proxy = g_dbus_proxy_new_finish(res, &error);
-	if (error) {
-		g_warning("Failed to create proxy for connman manager service: %s", error->message);
-		g_error_free(error);
-		return;
+	if (!connman_service_get_favorite(service)) {
+		g_message("[WAN] Found a not yet configured cellular service; connecting to it for the first time");
+		switch_current_service_state(od, true, cellular_service_setup_cb, NULL);
 	}
 
-	g_message("[WAN] successfully created proxy for connman manager");
-
-	g_signal_connect(od->connman_manager_proxy, "g-signal", G_CALLBACK(services_changed_cb), od);
-
-	g_dbus_proxy_call(od->connman_manager_proxy, "GetServices", NULL, G_DBUS_CALL_FLAGS_NONE,
-					  -1, NULL, (GAsyncReadyCallback) connman_manager_get_services_cb, od);
-}
-
-static void connman_appeared_cb(GDBusConnection *conn, const gchar *name, const gchar *name_owner,
-								gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-
-	g_message("connman dbus service available");
-
-	g_dbus_proxy_new_for_bus(G_BUS_TYPE_SYSTEM,
-							 G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-							 NULL, "net.connman", "/", "net.connman.Manager",
-							 NULL, (GAsyncReadyCallback) connman_manager_proxy_connect_cb,
-							 od);
-}
-
-static void connman_vanished_cb(GDBusConnection *conn, const gchar *name, gpointer user_data)
-{
-	struct ofono_wan_data *od = user_data;
-
-	g_message("connman dbus service disappeared");
-
-	if (od->connman_manager_proxy) {
-		g_object_unref(od->connman_manager_proxy);
-		od->connman_manager_proxy = 0;
-	}
+	/* the stored configuration can only be applied from now on */
+	wan_service_availability_changed_notify(od->service, true);
 }
 
 int ofono_wan_probe(struct wan_service *service)
@@ -736,8 +542,11 @@ int ofono_wan_probe(struct wan_service *service)
 	data->service_watch = g_bus_watch_name(G_BUS_TYPE_SYSTEM, "org.ofono", G_BUS_NAME_WATCHER_FLAGS_NONE,
 					 service_appeared_cb, service_vanished_cb, data, NULL);
 
-	data->connman_watch = g_bus_watch_name(G_BUS_TYPE_SYSTEM, "net.connman", G_BUS_NAME_WATCHER_FLAGS_NONE,
-					connman_appeared_cb, connman_vanished_cb, data, NULL);
+	data->connman = connman_client_create();
+	connman_client_register_cellular_service_changed_cb(data->connman, cellular_service_changed_cb, data);
+
+	data->traffic = wan_traffic_monitor_create(WAN_USAGE_PATH);
+	wan_traffic_monitor_register_dormancy_changed_cb(data->traffic, send_status_update_cb, data);
 
 	return 0;
 }
@@ -750,8 +559,12 @@ void ofono_wan_remove(struct wan_service *service)
 
 	g_bus_unwatch_name(data->service_watch);
 
+	connman_client_free(data->connman);
+
 	free_used_instances(data);
 
+	wan_traffic_monitor_free(data->traffic);
+
 	g_free(data);
 
 	wan_service_set_data(service, NULL);
@@ -0,0 +1,530 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "utils.h"
+#include "wantraffic.h"
+#include "telephonysettings.h"
+
+#define WAN_TRAFFIC_FILE_MAGIC				0x31555457 /* "WTU1" */
+#define WAN_TRAFFIC_FILE_VERSION			1
+
+/* Busy interfaces are sampled every second; every idle sample doubles the
+ * interval up to the maximum so an idle link doesn't keep waking us up */
+#define SAMPLE_INTERVAL_MIN_SECONDS			1
+#define SAMPLE_INTERVAL_MAX_SECONDS			16
+
+#define DORMANCY_TIMEOUT_DEFAULT_SECONDS	10
+
+/* Usage is written back in batches: once this much traffic wasn't stored yet
+ * or the oldest unstored traffic is this old, whatever comes first */
+#define USAGE_FLUSH_BYTES					(1024 * 1024)
+#define USAGE_FLUSH_DELAY_SECONDS			60
+
+#define USAGE_KEY_SIZE						64
+
+struct wan_traffic_file_header {
+	guint32 magic;
+	guint32 version;
+	guint32 count;
+	guint32 reserved;
+};
+
+struct wan_traffic_usage_record {
+	char key[USAGE_KEY_SIZE];
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+};
+
+struct traffic_entry {
+	gchar *key;
+	/* NULL while the context isn't active */
+	gchar *interface;
+	bool seen;
+	/* whether last_rx/last_tx hold a sample to compute the deltas against */
+	bool primed;
+	guint64 last_rx;
+	guint64 last_tx;
+	gint64 last_sample;
+	gint64 last_activity;
+	struct wan_traffic_stats stats;
+};
+
+struct wan_traffic_monitor {
+	gchar *path;
+	GHashTable *entries;
+	guint sample_timeout;
+	unsigned int interval;
+	guint flush_timeout;
+	guint64 unsaved_bytes;
+	bool dirty;
+	wan_traffic_dormancy_changed_cb dormancy_changed_cb;
+	void *dormancy_changed_data;
+};
+
+static unsigned int get_dormancy_timeout(void)
+{
+	int timeout = 0;
+
+	if (!telephony_settings_get_int(TELEPHONY_SETTINGS_TYPE_WAN_DORMANCY_TIMEOUT, &timeout) || timeout <= 0)
+		return DORMANCY_TIMEOUT_DEFAULT_SECONDS;
+
+	return timeout;
+}
+
+static struct traffic_entry* traffic_entry_new(const char *key)
+{
+	struct traffic_entry *entry;
+
+	entry = g_new0(struct traffic_entry, 1);
+	entry->key = g_strdup(key);
+
+	return entry;
+}
+
+static void traffic_entry_free(gpointer data)
+{
+	struct traffic_entry *entry = data;
+
+	g_free(entry->key);
+	g_free(entry->interface);
+	g_free(entry);
+}
+
+/* The interface name comes from ofono; make sure it can't point us anywhere
+ * outside of /sys/class/net */
+static bool is_valid_interface(const char *interface)
+{
+	return interface && interface[0] != '\0' && !strchr(interface, '/') &&
+		!g_str_equal(interface, ".") && !g_str_equal(interface, "..");
+}
+
+static bool read_counter(const char *interface, const char *name, guint64 *value)
+{
+	gchar *path, *contents = NULL;
+	bool result = false;
+
+	path = g_strdup_printf("/sys/class/net/%s/statistics/%s", interface, name);
+
+	if (!g_file_get_contents(path, &contents, NULL, NULL))
+		goto cleanup;
+
+	*value = g_ascii_strtoull(contents, NULL, 10);
+	result = true;
+
+cleanup:
+	g_free(contents);
+	g_free(path);
+
+	return result;
+}
+
+static void load_from_file(struct wan_traffic_monitor *monitor)
+{
+	struct wan_traffic_file_header *header;
+	const struct wan_traffic_usage_record *records;
+	struct traffic_entry *entry;
+	gchar *contents = NULL;
+	gsize length = 0;
+	unsigned int n;
+
+	if (!g_file_get_contents(monitor->path, &contents, &length, NULL))
+		return;
+
+	if (length < sizeof(*header))
+		goto invalid;
+
+	/* check the count before multiplying so a corrupted one can't overflow */
+	header = (struct wan_traffic_file_header*) contents;
+	if (header->magic != WAN_TRAFFIC_FILE_MAGIC || header->version != WAN_TRAFFIC_FILE_VERSION ||
+		header->count > (length - sizeof(*header)) / sizeof(struct wan_traffic_usage_record) ||
+		length != sizeof(*header) + header->count * sizeof(struct wan_traffic_usage_record))
+		goto invalid;
+
+	records = (const struct wan_traffic_usage_record*) (contents + sizeof(*header));
+
+	for (n = 0; n < header->count; n++) {
+		if (memchr(records[n].key, '\0', USAGE_KEY_SIZE) == NULL)
+			continue;
+
+		entry = traffic_entry_new(records[n].key);
+		entry->stats.total_rx_bytes = records[n].rx_bytes;
+		entry->stats.total_tx_bytes = records[n].tx_bytes;
+		g_hash_table_replace(monitor->entries, entry->key, entry);
+	}
+
+	g_free(contents);
+	return;
+
+invalid:
+	g_warning("Ignoring outdated or invalid WAN usage in %s", monitor->path);
+	g_free(contents);
+}
+
+static void write_to_file(struct wan_traffic_monitor *monitor)
+{
+	struct wan_traffic_file_header *header;
+	struct wan_traffic_usage_record *records;
+	struct traffic_entry *entry;
+	GHashTableIter iter;
+	gchar *contents;
+	gsize length;
+	unsigned int count = 0;
+	GError *error = NULL;
+
+	length = sizeof(*header) + g_hash_table_size(monitor->entries) * sizeof(*records);
+	contents = g_malloc0(length);
+
+	header = (struct wan_traffic_file_header*) contents;
+	records = (struct wan_traffic_usage_record*) (contents + sizeof(*header));
+
+	g_hash_table_iter_init(&iter, monitor->entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry)) {
+		/* context paths are short; one which doesn't fit can't be found again anyway */
+		if (strlen(entry->key) >= USAGE_KEY_SIZE)
+			continue;
+
+		strncpy(records[count].key, entry->key, USAGE_KEY_SIZE - 1);
+		records[count].rx_bytes = entry->stats.total_rx_bytes;
+		records[count].tx_bytes = entry->stats.total_tx_bytes;
+		count++;
+	}
+
+	header->magic = WAN_TRAFFIC_FILE_MAGIC;
+	header->version = WAN_TRAFFIC_FILE_VERSION;
+	header->count = count;
+	length = sizeof(*header) + count * sizeof(*records);
+
+	if (!utils_write_private_file(monitor->path, contents, length, &error)) {
+		g_warning("Failed to store WAN usage: %s", error->message);
+		g_error_free(error);
+	}
+	else {
+		monitor->dirty = false;
+		monitor->unsaved_bytes = 0;
+	}
+
+	g_free(contents);
+}
+
+static void flush_usage(struct wan_traffic_monitor *monitor)
+{
+	if (monitor->flush_timeout) {
+		g_source_remove(monitor->flush_timeout);
+		monitor->flush_timeout = 0;
+	}
+
+	if (monitor->dirty && monitor->path)
+		write_to_file(monitor);
+}
+
+static gboolean flush_timeout_cb(gpointer user_data)
+{
+	struct wan_traffic_monitor *monitor = user_data;
+
+	monitor->flush_timeout = 0;
+	flush_usage(monitor);
+
+	return FALSE;
+}
+
+static void usage_updated(struct wan_traffic_monitor *monitor, guint64 bytes)
+{
+	if (bytes == 0)
+		return;
+
+	monitor->dirty = true;
+	monitor->unsaved_bytes += bytes;
+
+	if (monitor->unsaved_bytes >= USAGE_FLUSH_BYTES)
+		flush_usage(monitor);
+	else if (!monitor->flush_timeout)
+		monitor->flush_timeout = g_timeout_add_seconds(USAGE_FLUSH_DELAY_SECONDS, flush_timeout_cb, monitor);
+}
+
+/* Takes a sample of the interface counters and returns whether there was any
+ * traffic since the last one */
+static bool sample_entry(struct wan_traffic_monitor *monitor, struct traffic_entry *entry,
+						 gint64 now, bool *dormancy_changed)
+{
+	guint64 rx = 0, tx = 0, rx_delta, tx_delta;
+	gint64 elapsed;
+	bool dormant;
+
+	if (!read_counter(entry->interface, "rx_bytes", &rx) ||
+		!read_counter(entry->interface, "tx_bytes", &tx))
+		return false;
+
+	if (!entry->primed) {
+		entry->last_rx = rx;
+		entry->last_tx = tx;
+		entry->last_sample = now;
+		entry->last_activity = now;
+		entry->primed = true;
+		return false;
+	}
+
+	/* counters start over when the interface gets recreated */
+	rx_delta = rx >= entry->last_rx ? rx - entry->last_rx : rx;
+	tx_delta = tx >= entry->last_tx ? tx - entry->last_tx : tx;
+	elapsed = now - entry->last_sample;
+
+	entry->last_rx = rx;
+	entry->last_tx = tx;
+	entry->last_sample = now;
+
+	entry->stats.rx_bytes += rx_delta;
+	entry->stats.tx_bytes += tx_delta;
+	entry->stats.total_rx_bytes += rx_delta;
+	entry->stats.total_tx_bytes += tx_delta;
+	entry->stats.rx_rate = elapsed > 0 ? (rx_delta * G_USEC_PER_SEC) / elapsed : 0;
+	entry->stats.tx_rate = elapsed > 0 ? (tx_delta * G_USEC_PER_SEC) / elapsed : 0;
+
+	usage_updated(monitor, rx_delta + tx_delta);
+
+	if (rx_delta > 0 || tx_delta > 0)
+		entry->last_activity = now;
+
+	dormant = (now - entry->last_activity) >= (gint64) get_dormancy_timeout() * G_USEC_PER_SEC;
+	if (dormant != entry->stats.dormant) {
+		g_message("[WAN] Interface %s is %s", entry->interface, dormant ? "dormant" : "active again");
+		entry->stats.dormant = dormant;
+		*dormancy_changed = true;
+	}
+
+	return rx_delta > 0 || tx_delta > 0;
+}
+
+static gboolean sample_timeout_cb(gpointer user_data);
+
+/* Picks the next sampling interval; it never extends past the point where an
+ * idle interface would become dormant so that gets reported in time */
+static void schedule_sample(struct wan_traffic_monitor *monitor, bool busy)
+{
+	struct traffic_entry *entry;
+	GHashTableIter iter;
+	gint64 now = g_get_monotonic_time();
+	gint64 idle, remaining;
+	unsigned int timeout = get_dormancy_timeout();
+	unsigned int delay;
+	bool active = false;
+
+	if (monitor->sample_timeout) {
+		g_source_remove(monitor->sample_timeout);
+		monitor->sample_timeout = 0;
+	}
+
+	if (busy)
+		monitor->interval = SAMPLE_INTERVAL_MIN_SECONDS;
+	else
+		monitor->interval = MIN(monitor->interval * 2, SAMPLE_INTERVAL_MAX_SECONDS);
+
+	delay = monitor->interval;
+
+	g_hash_table_iter_init(&iter, monitor->entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry)) {
+		if (!entry->interface)
+			continue;
+
+		active = true;
+
+		if (!entry->primed || entry->stats.dormant)
+			continue;
+
+		idle = (now - entry->last_activity) / G_USEC_PER_SEC;
+		remaining = (gint64) timeout - idle;
+		if (remaining < delay)
+			delay = MAX(remaining, SAMPLE_INTERVAL_MIN_SECONDS);
+	}
+
+	if (!active) {
+		monitor->interval = SAMPLE_INTERVAL_MIN_SECONDS;
+		return;
+	}
+
+	monitor->sample_timeout = g_timeout_add_seconds(delay, sample_timeout_cb, monitor);
+}
+
+static gboolean sample_timeout_cb(gpointer user_data)
+{
+	struct wan_traffic_monitor *monitor = user_data;
+	struct traffic_entry *entry;
+	GHashTableIter iter;
+	gint64 now = g_get_monotonic_time();
+	bool busy = false;
+	bool dormancy_changed = false;
+
+	monitor->sample_timeout = 0;
+
+	g_hash_table_iter_init(&iter, monitor->entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry)) {
+		if (entry->interface)
+			busy |= sample_entry(monitor, entry, now, &dormancy_changed);
+	}
+
+	schedule_sample(monitor, busy);
+
+	if (dormancy_changed && monitor->dormancy_changed_cb)
+		monitor->dormancy_changed_cb(monitor->dormancy_changed_data);
+
+	return FALSE;
+}
+
+/* Switches the entry over to another interface or stops monitoring it when
+ * interface is NULL; the session counters start over in both cases */
+static void set_entry_interface(struct wan_traffic_monitor *monitor, struct traffic_entry *entry,
+								const char *interface)
+{
+	bool dormancy_changed = false;
+
+	if (g_strcmp0(entry->interface, interface) == 0)
+		return;
+
+	/* account whatever went through the old interface since the last sample */
+	if (entry->interface && entry->primed)
+		sample_entry(monitor, entry, g_get_monotonic_time(), &dormancy_changed);
+
+	g_free(entry->interface);
+	entry->interface = g_strdup(interface);
+	entry->primed = false;
+	entry->stats.rx_bytes = 0;
+	entry->stats.tx_bytes = 0;
+	entry->stats.rx_rate = 0;
+	entry->stats.tx_rate = 0;
+	entry->stats.dormant = false;
+
+	if (entry->interface)
+		sample_entry(monitor, entry, g_get_monotonic_time(), &dormancy_changed);
+}
+
+struct wan_traffic_monitor* wan_traffic_monitor_create(const char *usage_path)
+{
+	struct wan_traffic_monitor *monitor;
+
+	monitor = g_new0(struct wan_traffic_monitor, 1);
+	monitor->path = g_strdup(usage_path);
+	monitor->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, traffic_entry_free);
+	monitor->interval = SAMPLE_INTERVAL_MIN_SECONDS;
+
+	if (monitor->path)
+		load_from_file(monitor);
+
+	return monitor;
+}
+
+void wan_traffic_monitor_free(struct wan_traffic_monitor *monitor)
+{
+	if (!monitor)
+		return;
+
+	if (monitor->sample_timeout)
+		g_source_remove(monitor->sample_timeout);
+
+	flush_usage(monitor);
+
+	g_hash_table_destroy(monitor->entries);
+	g_free(monitor->path);
+	g_free(monitor);
+}
+
+void wan_traffic_monitor_register_dormancy_changed_cb(struct wan_traffic_monitor *monitor,
+													  wan_traffic_dormancy_changed_cb cb, void *data)
+{
+	monitor->dormancy_changed_cb = cb;
+	monitor->dormancy_changed_data = data;
+}
+
+/* An update reports the state of all known contexts: every context which isn't
+ * mentioned between begin and end isn't monitored anymore */
+void wan_traffic_monitor_begin_update(struct wan_traffic_monitor *monitor)
+{
+	struct traffic_entry *entry;
+	GHashTableIter iter;
+
+	g_hash_table_iter_init(&iter, monitor->entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry))
+		entry->seen = false;
+}
+
+void wan_traffic_monitor_update(struct wan_traffic_monitor *monitor, const char *key, const char *interface)
+{
+	struct traffic_entry *entry;
+
+	if (!key)
+		return;
+
+	if (interface && !is_valid_interface(interface)) {
+		g_warning("[WAN] Not monitoring traffic on invalid interface %s", interface);
+		interface = NULL;
+	}
+
+	entry = g_hash_table_lookup(monitor->entries, key);
+	if (!entry) {
+		entry = traffic_entry_new(key);
+		g_hash_table_replace(monitor->entries, entry->key, entry);
+	}
+
+	entry->seen = true;
+	set_entry_interface(monitor, entry, interface);
+}
+
+void wan_traffic_monitor_end_update(struct wan_traffic_monitor *monitor)
+{
+	struct traffic_entry *entry;
+	GHashTableIter iter;
+	bool active = false;
+
+	g_hash_table_iter_init(&iter, monitor->entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*) &entry)) {
+		if (!entry->seen)
+			set_entry_interface(monitor, entry, NULL);
+
+		active |= (entry->interface != NULL);
+	}
+
+	if (active && !monitor->sample_timeout)
+		monitor->sample_timeout = g_timeout_add_seconds(SAMPLE_INTERVAL_MIN_SECONDS,
+														sample_timeout_cb, monitor);
+	else if (!active && monitor->sample_timeout) {
+		g_source_remove(monitor->sample_timeout);
+		monitor->sample_timeout = 0;
+		monitor->interval = SAMPLE_INTERVAL_MIN_SECONDS;
+	}
+}
+
+bool wan_traffic_monitor_get_stats(struct wan_traffic_monitor *monitor, const char *key,
+								   struct wan_traffic_stats *stats)
+{
+	struct traffic_entry *entry;
+
+	if (!key)
+		return false;
+
+	entry = g_hash_table_lookup(monitor->entries, key);
+	if (!entry)
+		return false;
+
+	*stats = entry->stats;
+
+	return true;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,57 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef WAN_TRAFFIC_H_
+#define WAN_TRAFFIC_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+struct wan_traffic_stats {
+	/* since the context got activated */
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+	/* over all sessions of the context; kept across restarts */
+	guint64 total_rx_bytes;
+	guint64 total_tx_bytes;
+	/* bytes per second over the last sampling interval */
+	guint32 rx_rate;
+	guint32 tx_rate;
+	bool dormant;
+};
+
+typedef void (*wan_traffic_dormancy_changed_cb)(void *data);
+
+struct wan_traffic_monitor;
+
+struct wan_traffic_monitor* wan_traffic_monitor_create(const char *usage_path);
+void wan_traffic_monitor_free(struct wan_traffic_monitor *monitor);
+
+void wan_traffic_monitor_register_dormancy_changed_cb(struct wan_traffic_monitor *monitor,
+													  wan_traffic_dormancy_changed_cb cb, void *data);
+
+void wan_traffic_monitor_begin_update(struct wan_traffic_monitor *monitor);
+void wan_traffic_monitor_update(struct wan_traffic_monitor *monitor, const char *key, const char *interface);
+void wan_traffic_monitor_end_update(struct wan_traffic_monitor *monitor);
+
+bool wan_traffic_monitor_get_stats(struct wan_traffic_monitor *monitor, const char *key,
+								   struct wan_traffic_stats *stats);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
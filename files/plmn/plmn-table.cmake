@@ -0,0 +1,78 @@
+# Generates the operator name table from plmn.csv
+#
+#   cmake -DPLMN_CSV=<plmn.csv> -DPLMN_TABLE=<plmn-table.c> -P plmn-table.cmake
+#
+# Entries are sorted by their id (mcc followed by mnc) so plmn.c can look them
+# up with a binary search. Names are stored once in a single string pool.
+
+if(NOT PLMN_CSV OR NOT PLMN_TABLE)
+	message(FATAL_ERROR "PLMN_CSV and PLMN_TABLE have to be set")
+endif()
+
+file(STRINGS ${PLMN_CSV} lines)
+
+set(entries)
+set(ids)
+
+foreach(line ${lines})
+	if(line MATCHES "^#" OR line STREQUAL "")
+		continue()
+	endif()
+
+	if(NOT line MATCHES "^([0-9][0-9][0-9]),([0-9][0-9][0-9]?),([a-z][a-z]),(.+)$")
+		message(FATAL_ERROR "Invalid line in ${PLMN_CSV}: ${line}")
+	endif()
+
+	set(id "${CMAKE_MATCH_1}${CMAKE_MATCH_2}")
+	list(FIND ids ${id} duplicate)
+	if(NOT duplicate EQUAL -1)
+		message(FATAL_ERROR "Duplicate entry for ${CMAKE_MATCH_1}/${CMAKE_MATCH_2} in ${PLMN_CSV}")
+	endif()
+
+	list(APPEND ids ${id})
+	# the blank sorts before any digit so the order matches strcmp for ids of
+	# different length
+	list(APPEND entries "${id} |${CMAKE_MATCH_3}|${CMAKE_MATCH_4}")
+endforeach()
+
+list(SORT entries)
+
+set(names)
+set(pool "")
+set(pool_size 0)
+set(table "")
+
+foreach(entry ${entries})
+	string(REPLACE "|" ";" fields "${entry}")
+	list(GET fields 0 id)
+	string(STRIP "${id}" id)
+	list(GET fields 1 country)
+	list(GET fields 2 name)
+
+	list(FIND names "${name}" index)
+	if(index EQUAL -1)
+		list(APPEND names "${name}")
+		list(APPEND offsets ${pool_size})
+		set(offset ${pool_size})
+
+		string(REPLACE "\\" "\\\\" escaped "${name}")
+		string(REPLACE "\"" "\\\"" escaped "${escaped}")
+		set(pool "${pool}\t\"${escaped}\\0\"\n")
+
+		string(LENGTH "${name}" length)
+		math(EXPR pool_size "${pool_size} + ${length} + 1")
+	else()
+		list(GET offsets ${index} offset)
+	endif()
+
+	set(table "${table}\t{ \"${id}\", \"${country}\", ${offset} },\n")
+endforeach()
+
+list(LENGTH entries count)
+
+file(WRITE ${PLMN_TABLE}
+"/* generated from plmn.csv by plmn-table.cmake, do not edit */\n\n"
+"#include \"plmn.h\"\n\n"
+"const char plmn_names[] =\n${pool}\t;\n\n"
+"const struct plmn_entry plmn_table[] = {\n${table}};\n\n"
+"const unsigned int plmn_table_size = ${count};\n")
@@ -0,0 +1,139 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <glib.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+#include "displaystate.h"
+#include "luna_service_utils.h"
+
+/* Tracks whether the display is on by subscribing to the display manager. The
+ * source can be pointed to any service posting the same replies (e.g. a stand-in
+ * when testing) or disabled with "none" in which case the display is assumed
+ * to be on unless display_state_set is called. */
+
+static gchar *source_uri = NULL;
+static LSMessageToken watch_token = LSMESSAGE_TOKEN_INVALID;
+static bool display_on = true;
+static display_state_changed_cb changed_cb = NULL;
+static void *changed_data = NULL;
+
+void display_state_set_source(const char *uri)
+{
+	g_free(source_uri);
+	source_uri = g_strdup(uri);
+}
+
+void display_state_set(bool on)
+{
+	if (display_on == on)
+		return;
+
+	g_message("[Display] Display turned %s", on ? "on" : "off");
+
+	display_on = on;
+
+	if (changed_cb)
+		changed_cb(on, changed_data);
+}
+
+bool display_state_is_on(void)
+{
+	return display_on;
+}
+
+static bool display_status_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	jvalue_ref parsed_obj = NULL;
+	jvalue_ref value_obj = NULL;
+	bool return_value = true;
+
+	parsed_obj = luna_service_message_parse_and_validate(LSMessageGetPayload(message));
+	if (jis_null(parsed_obj))
+		return true;
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("returnValue"), &value_obj))
+		jboolean_get(value_obj, &return_value);
+
+	if (!return_value) {
+		/* never hold back notifications when we can't tell */
+		g_warning("[Display] Lost display status subscription");
+		display_state_set(true);
+		goto cleanup;
+	}
+
+	/* the first reply carries the state, later ones the event */
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("state"), &value_obj)) {
+		display_state_set(!jstring_equal2(value_obj, J_CSTR_TO_BUF("off")));
+	}
+	else if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("event"), &value_obj)) {
+		if (jstring_equal2(value_obj, J_CSTR_TO_BUF("displayOff")))
+			display_state_set(false);
+		else if (jstring_equal2(value_obj, J_CSTR_TO_BUF("displayOn")) ||
+				 jstring_equal2(value_obj, J_CSTR_TO_BUF("displayDimmed")) ||
+				 jstring_equal2(value_obj, J_CSTR_TO_BUF("displayActive")))
+			display_state_set(true);
+	}
+
+cleanup:
+	j_release(&parsed_obj);
+
+	return true;
+}
+
+bool display_state_watch(LSHandle *handle, display_state_changed_cb cb, void *user_data)
+{
+	jvalue_ref req_obj = NULL;
+	const char *uri = source_uri ? source_uri : DISPLAY_STATE_DEFAULT_URI;
+	bool result;
+
+	changed_cb = cb;
+	changed_data = user_data;
+
+	if (g_strcmp0(uri, "none") == 0)
+		return true;
+
+	req_obj = jobject_create();
+	jobject_put(req_obj, J_CSTR_TO_JVAL("subscribe"), jboolean_create(true));
+
+	result = luna_service_call_multi_validate_and_send(handle, uri, req_obj, display_status_cb, NULL, &watch_token);
+	if (!result) {
+		g_warning("[Display] Failed to subscribe to %s; assuming the display is on", uri);
+		watch_token = LSMESSAGE_TOKEN_INVALID;
+	}
+
+	j_release(&req_obj);
+
+	return result;
+}
+
+void display_state_unwatch(LSHandle *handle)
+{
+	if (watch_token != LSMESSAGE_TOKEN_INVALID)
+		LSCallCancel(handle, watch_token, NULL);
+
+	watch_token = LSMESSAGE_TOKEN_INVALID;
+	changed_cb = NULL;
+	changed_data = NULL;
+
+	g_free(source_uri);
+	source_uri = NULL;
+}
+
+// vim:ts=4:sw=4:noexpandtab
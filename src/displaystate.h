@@ -0,0 +1,38 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef DISPLAYSTATE_H_
+#define DISPLAYSTATE_H_
+
+#include <stdbool.h>
+#include <luna-service2/lunaservice.h>
+
+#define DISPLAY_STATE_DEFAULT_URI	"luna://com.palm.display/control/status"
+
+typedef void (*display_state_changed_cb)(bool on, void *user_data);
+
+void display_state_set_source(const char *uri);
+bool display_state_watch(LSHandle *handle, display_state_changed_cb cb, void *user_data);
+void display_state_unwatch(LSHandle *handle);
+
+void display_state_set(bool on);
+bool display_state_is_on(void);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
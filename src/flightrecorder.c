@@ -0,0 +1,265 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "flightrecorder.h"
+#include "utils.h"
+
+/* The recorder is a fixed size ring of compact records in a shared mapping of
+ * a file. Recording an event is a single atomic increment plus a 48 byte write
+ * so it can stay enabled all the time; as the mapping lives in a file the last
+ * events are even still around after we crashed. */
+
+/* number of snapshots kept in the state directory; older ones are removed */
+#define MAX_SNAPSHOTS			5
+#define SNAPSHOT_PREFIX			"flight-recorder-"
+#define SNAPSHOT_SUFFIX			".bin"
+
+struct flight_recorder {
+	struct flight_recorder_header *header;
+	struct flight_recorder_record *records;
+	gsize size;
+};
+
+static struct flight_recorder *recorder = NULL;
+static unsigned int snapshot_sequence = 0;
+
+/* Creates a new recording file which only we can access. Whatever is at the
+ * path is removed first and the file is created exclusively without following
+ * symlinks, so nobody can redirect us to another file. */
+static int create_recording_file(const char *path)
+{
+	struct stat st;
+	gchar *dirname;
+	int fd;
+
+	dirname = g_path_get_dirname(path);
+	g_mkdir_with_parents(dirname, 0700);
+
+	if (lstat(dirname, &st) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+		(st.st_mode & (S_IWGRP | S_IWOTH))) {
+		g_warning("[FlightRecorder] Refusing to record into %s: not a private directory", dirname);
+		g_free(dirname);
+		errno = EPERM;
+		return -1;
+	}
+
+	g_free(dirname);
+
+	if (unlink(path) < 0 && errno != ENOENT)
+		return -1;
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+		close(fd);
+		errno = EPERM;
+		return -1;
+	}
+
+	return fd;
+}
+
+bool flight_recorder_open(const char *path, unsigned int capacity)
+{
+	struct flight_recorder *fr;
+	void *base;
+	gsize size;
+	int fd;
+
+	if (recorder)
+		return true;
+
+	size = sizeof(struct flight_recorder_header) + capacity * sizeof(struct flight_recorder_record);
+
+	/* we start a new recording each time so a previous one is lost unless it
+	 * was dumped before */
+	fd = create_recording_file(path);
+	if (fd < 0) {
+		g_warning("[FlightRecorder] Failed to open %s: %s", path, strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, size) < 0) {
+		g_warning("[FlightRecorder] Failed to allocate %s: %s", path, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (base == MAP_FAILED) {
+		g_warning("[FlightRecorder] Failed to map %s: %s", path, strerror(errno));
+		return false;
+	}
+
+	fr = g_new0(struct flight_recorder, 1);
+	fr->size = size;
+	fr->header = base;
+	fr->records = (struct flight_recorder_record*) (fr->header + 1);
+
+	fr->header->record_size = sizeof(struct flight_recorder_record);
+	fr->header->capacity = capacity;
+	fr->header->head = 0;
+	fr->header->realtime_offset = g_get_real_time() - g_get_monotonic_time();
+	fr->header->magic = FLIGHT_RECORDER_MAGIC;
+
+	recorder = fr;
+
+	return true;
+}
+
+void flight_recorder_close(void)
+{
+	if (!recorder)
+		return;
+
+	munmap(recorder->header, recorder->size);
+	g_free(recorder);
+	recorder = NULL;
+}
+
+void flight_recorder_record(enum flight_event_type type, uint16_t code, uint32_t arg, const char *tag)
+{
+	struct flight_recorder_record *record;
+	uint64_t index;
+
+	if (!recorder)
+		return;
+
+	index = __atomic_fetch_add(&recorder->header->head, 1, __ATOMIC_RELAXED);
+	record = &recorder->records[index % recorder->header->capacity];
+
+	__atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+
+	record->timestamp = g_get_monotonic_time();
+	record->type = type;
+	record->code = code;
+	record->arg = arg;
+	strncpy(record->tag, tag ? tag : "", FLIGHT_RECORDER_TAG_SIZE);
+
+	__atomic_store_n(&record->seq, (uint32_t) (index + 1), __ATOMIC_RELEASE);
+}
+
+/* Writes a copy of the recording to the given path which can be read with the
+ * webos-telephonyd-flightrec tool. Records which were just being written are
+ * recognized by their sequence number and skipped by the tool. */
+bool flight_recorder_dump(const char *path)
+{
+	GError *error = NULL;
+	gchar *snapshot;
+	bool result;
+
+	if (!recorder)
+		return false;
+
+	snapshot = g_malloc(recorder->size);
+	memcpy(snapshot, recorder->header, recorder->size);
+
+	result = utils_write_private_file(path, snapshot, recorder->size, &error);
+	if (!result) {
+		g_warning("[FlightRecorder] Failed to dump to %s: %s", path, error->message);
+		g_error_free(error);
+	}
+	else {
+		g_message("[FlightRecorder] Dumped %llu events to %s",
+				  (unsigned long long) MIN(((struct flight_recorder_header*) snapshot)->head,
+										   recorder->header->capacity), path);
+	}
+
+	g_free(snapshot);
+
+	return result;
+}
+
+static int compare_names(gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0(*(const gchar**) a, *(const gchar**) b);
+}
+
+/* Removes all but the newest MAX_SNAPSHOTS snapshots. The names sort by the
+ * time they were taken in, so the oldest ones come first. */
+static void prune_snapshots(void)
+{
+	GPtrArray *names;
+	const gchar *name;
+	gchar *path;
+	GDir *dir;
+	guint n;
+
+	dir = g_dir_open(TELEPHONY_STATE_DIR, 0, NULL);
+	if (!dir)
+		return;
+
+	names = g_ptr_array_new_with_free_func(g_free);
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		if (g_str_has_prefix(name, SNAPSHOT_PREFIX) && g_str_has_suffix(name, SNAPSHOT_SUFFIX))
+			g_ptr_array_add(names, g_strdup(name));
+	}
+
+	g_dir_close(dir);
+
+	g_ptr_array_sort(names, compare_names);
+
+	for (n = 0; n + MAX_SNAPSHOTS < names->len; n++) {
+		path = g_build_filename(TELEPHONY_STATE_DIR, g_ptr_array_index(names, n), NULL);
+		if (unlink(path) < 0 && errno != ENOENT)
+			g_warning("[FlightRecorder] Failed to remove old snapshot %s: %s", path, strerror(errno));
+		g_free(path);
+	}
+
+	g_ptr_array_free(names, TRUE);
+}
+
+/* Dumps the recording to a new file in our state directory and returns its
+ * path. The sequence number keeps snapshots taken within the same second
+ * apart; only the last MAX_SNAPSHOTS of them are kept. */
+bool flight_recorder_snapshot(char *path, size_t size)
+{
+	time_t now = time(NULL);
+	char timestamp[32];
+	struct tm tm;
+	bool result;
+
+	localtime_r(&now, &tm);
+	strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", &tm);
+
+	snprintf(path, size, TELEPHONY_STATE_DIR "/" SNAPSHOT_PREFIX "%s-%04u" SNAPSHOT_SUFFIX,
+			 timestamp, snapshot_sequence++ % 10000);
+
+	result = flight_recorder_dump(path);
+
+	prune_snapshots();
+
+	return result;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,83 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef FLIGHT_RECORDER_H_
+#define FLIGHT_RECORDER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* This header describes the on-disk format as well and is shared with the
+ * offline decoder so it must not depend on anything but libc. */
+
+#define FLIGHT_RECORDER_MAGIC		0x31524654 /* "TFR1" */
+#define FLIGHT_RECORDER_TAG_SIZE	24
+
+enum flight_event_type {
+	FLIGHT_EVENT_NONE = 0,
+	FLIGHT_EVENT_LUNA_REQUEST,
+	FLIGHT_EVENT_DRIVER_CALL,
+	FLIGHT_EVENT_OFONO_REPLY,
+	FLIGHT_EVENT_PROPERTY_CHANGE,
+	FLIGHT_EVENT_SUBSCRIPTION_POST,
+	FLIGHT_EVENT_SMS_STATE,
+	FLIGHT_EVENT_TYPE_MAX
+};
+
+/* code of a FLIGHT_EVENT_SMS_STATE record */
+enum flight_sms_state {
+	FLIGHT_SMS_STATE_SENDING = 1,
+	FLIGHT_SMS_STATE_SUCCESSFUL,
+	FLIGHT_SMS_STATE_FAILED,
+};
+
+struct flight_recorder_header {
+	uint32_t magic;
+	uint32_t record_size;
+	uint32_t capacity;
+	uint32_t reserved;
+	/* number of records ever written; the newest one is at (head - 1) % capacity */
+	uint64_t head;
+	/* add to a record timestamp to get the wall clock time in microseconds */
+	int64_t realtime_offset;
+};
+
+struct flight_recorder_record {
+	/* monotonic time in microseconds */
+	uint64_t timestamp;
+	/* lower 32 bits of the record index plus one; zero while being written */
+	uint32_t seq;
+	uint16_t type;
+	/* event specific, e.g. the error of an ofono reply */
+	uint16_t code;
+	uint32_t arg;
+	uint32_t reserved;
+	char tag[FLIGHT_RECORDER_TAG_SIZE];
+};
+
+bool flight_recorder_open(const char *path, unsigned int capacity);
+void flight_recorder_close(void);
+
+void flight_recorder_record(enum flight_event_type type, uint16_t code, uint32_t arg, const char *tag);
+bool flight_recorder_dump(const char *path);
+bool flight_recorder_snapshot(char *path, size_t size);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,493 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <glib.h>
+
+#include "logging.h"
+
+/* Log messages are formatted by the caller into a fixed size ring and written
+ * out by a background thread so logging never blocks on the output. Producers
+ * claim slots lock-free (bounded MPMC ring with per slot sequence numbers) and
+ * messages are dropped instead of waiting when the writer can't keep up. */
+
+#define LOG_RING_SIZE			1024
+#define LOG_RING_MASK			(LOG_RING_SIZE - 1)
+#define LOG_LINE_MAX			256
+/* replaces the end of lines which don't fit into a slot */
+#define LOG_TRUNCATION_MARKER	"[...]"
+
+#define LOG_DOMAIN_MAX			32
+#define LOG_DOMAIN_NAME_MAX		32
+
+/* Defaults for telephony_message_ratelimited */
+#define LOG_RATE_LIMIT_BURST			5
+#define LOG_RATE_LIMIT_INTERVAL_SECONDS	10
+
+struct log_slot {
+	guint seq;
+	char line[LOG_LINE_MAX];
+};
+
+struct log_domain {
+	char name[LOG_DOMAIN_NAME_MAX];
+	int level;
+};
+
+struct log_ring {
+	struct log_slot slots[LOG_RING_SIZE];
+	guint head;
+	guint tail;
+	int wakeup_fd;
+	int writer_sleeping;
+	int quit;
+	GThread *writer;
+};
+
+static struct log_ring *log_ring = NULL;
+/* Serializes everything which writes to the output: the writer thread while
+ * draining the ring and threads writing synchronously, which drain the ring
+ * first so their message doesn't overtake older ones */
+static GMutex output_lock;
+
+static int default_level = LOG_LEVEL_MESSAGE;
+/* domains are only ever added; the count is published after the entry is
+ * complete so the handler can look them up without a lock */
+static struct log_domain domains[LOG_DOMAIN_MAX];
+static int domain_count = 0;
+static bool redact = true;
+/* private data may only end up in the log when the daemon was started with
+ * --debug */
+static bool redact_optional = false;
+
+static struct logging_stats stats;
+/* dropped messages the writer didn't report yet */
+static unsigned int dropped_unreported = 0;
+
+static const char *level_names[LOG_LEVEL_MAX] = {
+	[LOG_LEVEL_ERROR] = "error",
+	[LOG_LEVEL_WARNING] = "warning",
+	[LOG_LEVEL_MESSAGE] = "message",
+	[LOG_LEVEL_INFO] = "info",
+	[LOG_LEVEL_DEBUG] = "debug",
+};
+
+static enum log_level level_from_flags(GLogLevelFlags flags)
+{
+	if (flags & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL))
+		return LOG_LEVEL_ERROR;
+	if (flags & G_LOG_LEVEL_WARNING)
+		return LOG_LEVEL_WARNING;
+	if (flags & G_LOG_LEVEL_MESSAGE)
+		return LOG_LEVEL_MESSAGE;
+	if (flags & G_LOG_LEVEL_INFO)
+		return LOG_LEVEL_INFO;
+
+	return LOG_LEVEL_DEBUG;
+}
+
+/* We don't use GLib log domains; instead all our messages start with a tag
+ * like "[Telephony:SMS]" or "[NetworkRegistration:/ril_0]" and we take the
+ * part up to the first colon as the domain. */
+static void domain_from_message(const char *message, char *domain, gsize size)
+{
+	gsize n = 0;
+
+	domain[0] = '\0';
+
+	if (!message || message[0] != '[')
+		return;
+
+	for (message++; *message && *message != ':' && *message != ']' && n < size - 1; message++)
+		domain[n++] = *message;
+
+	domain[n] = '\0';
+}
+
+static struct log_domain* find_domain(const char *name)
+{
+	int count = __atomic_load_n(&domain_count, __ATOMIC_ACQUIRE);
+	int n;
+
+	for (n = 0; n < count; n++) {
+		if (strcmp(domains[n].name, name) == 0)
+			return &domains[n];
+	}
+
+	return NULL;
+}
+
+static enum log_level effective_level(const char *domain)
+{
+	struct log_domain *entry = NULL;
+
+	if (domain && domain[0] != '\0')
+		entry = find_domain(domain);
+
+	if (entry)
+		return __atomic_load_n(&entry->level, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&default_level, __ATOMIC_RELAXED);
+}
+
+static void write_line(const char *line)
+{
+	fprintf(stdout, "%s\n", line);
+}
+
+static bool ring_is_empty(struct log_ring *ring)
+{
+	struct log_slot *slot = &ring->slots[ring->tail & LOG_RING_MASK];
+
+	return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->tail + 1;
+}
+
+static void copy_line(char *line, const char *message)
+{
+	gsize length = strlen(message);
+	gsize cut;
+
+	if (length < LOG_LINE_MAX) {
+		memcpy(line, message, length + 1);
+		return;
+	}
+
+	/* don't cut a UTF-8 sequence in half */
+	cut = LOG_LINE_MAX - sizeof(LOG_TRUNCATION_MARKER);
+	while (cut > 0 && (message[cut] & 0xc0) == 0x80)
+		cut--;
+
+	memcpy(line, message, cut);
+	memcpy(line + cut, LOG_TRUNCATION_MARKER, sizeof(LOG_TRUNCATION_MARKER));
+
+	__atomic_add_fetch(&stats.truncated, 1, __ATOMIC_RELAXED);
+}
+
+static bool ring_push(struct log_ring *ring, const char *message)
+{
+	struct log_slot *slot;
+	guint pos, seq;
+	gint diff;
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	for (;;) {
+		slot = &ring->slots[pos & LOG_RING_MASK];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (gint) (seq - pos);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, TRUE,
+											__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0) {
+			/* the writer didn't catch up yet */
+			return false;
+		}
+		else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	copy_line(slot->line, message);
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* Has to be called with output_lock held */
+static void ring_drain(struct log_ring *ring)
+{
+	struct log_slot *slot;
+	unsigned int dropped;
+
+	while (!ring_is_empty(ring)) {
+		slot = &ring->slots[ring->tail & LOG_RING_MASK];
+		write_line(slot->line);
+		__atomic_store_n(&slot->seq, ring->tail + LOG_RING_SIZE, __ATOMIC_RELEASE);
+		ring->tail++;
+		__atomic_add_fetch(&stats.written, 1, __ATOMIC_RELAXED);
+	}
+
+	dropped = __atomic_exchange_n(&dropped_unreported, 0, __ATOMIC_RELAXED);
+	if (dropped > 0)
+		fprintf(stdout, "[Logging] %u messages dropped\n", dropped);
+
+	fflush(stdout);
+}
+
+static gpointer writer_func(gpointer user_data)
+{
+	struct log_ring *ring = user_data;
+	guint64 value;
+
+	bool empty;
+
+	for (;;) {
+		g_mutex_lock(&output_lock);
+		ring_drain(ring);
+		g_mutex_unlock(&output_lock);
+
+		if (__atomic_load_n(&ring->quit, __ATOMIC_ACQUIRE))
+			break;
+
+		/* tell producers to wake us up and check once more so we don't miss
+		 * anything pushed in between */
+		__atomic_store_n(&ring->writer_sleeping, 1, __ATOMIC_SEQ_CST);
+
+		g_mutex_lock(&output_lock);
+		empty = ring_is_empty(ring);
+		g_mutex_unlock(&output_lock);
+
+		if (!empty || __atomic_load_n(&ring->quit, __ATOMIC_SEQ_CST)) {
+			__atomic_store_n(&ring->writer_sleeping, 0, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		if (read(ring->wakeup_fd, &value, sizeof(value)) < 0 && errno != EINTR)
+			break;
+	}
+
+	g_mutex_lock(&output_lock);
+	ring_drain(ring);
+	g_mutex_unlock(&output_lock);
+
+	return NULL;
+}
+
+static void wakeup_writer(struct log_ring *ring)
+{
+	guint64 value = 1;
+
+	if (__atomic_exchange_n(&ring->writer_sleeping, 0, __ATOMIC_SEQ_CST)) {
+		if (write(ring->wakeup_fd, &value, sizeof(value)) < 0)
+			return;
+	}
+}
+
+static void log_handler(const gchar *log_domain, GLogLevelFlags log_level,
+						const gchar *message, gpointer user_data)
+{
+	struct log_ring *ring = __atomic_load_n(&log_ring, __ATOMIC_ACQUIRE);
+	char domain[LOG_DOMAIN_NAME_MAX];
+	enum log_level level = level_from_flags(log_level);
+
+	domain_from_message(message, domain, sizeof(domain));
+
+	if (level > effective_level(domain)) {
+		__atomic_add_fetch(&stats.filtered, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* fatal messages have to be out before we abort; whatever is still
+	 * queued goes out first to keep the order */
+	if (!ring || (log_level & G_LOG_FLAG_FATAL) || level == LOG_LEVEL_ERROR) {
+		g_mutex_lock(&output_lock);
+		if (ring)
+			ring_drain(ring);
+		write_line(message);
+		fflush(stdout);
+		g_mutex_unlock(&output_lock);
+		return;
+	}
+
+	if (!ring_push(ring, message)) {
+		__atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&dropped_unreported, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	wakeup_writer(ring);
+}
+
+void logging_init(bool debug)
+{
+	struct log_ring *ring;
+	guint n;
+
+	default_level = debug ? LOG_LEVEL_DEBUG : LOG_LEVEL_MESSAGE;
+	redact_optional = debug;
+
+	g_log_set_handler(NULL, G_LOG_LEVEL_MASK | G_LOG_FLAG_FATAL | G_LOG_FLAG_RECURSION,
+					  log_handler, NULL);
+
+	ring = g_new0(struct log_ring, 1);
+
+	ring->wakeup_fd = eventfd(0, EFD_CLOEXEC);
+	if (ring->wakeup_fd < 0) {
+		g_warning("[Logging] Failed to create wakeup fd, logging synchronously: %s",
+				  strerror(errno));
+		g_free(ring);
+		return;
+	}
+
+	for (n = 0; n < LOG_RING_SIZE; n++)
+		ring->slots[n].seq = n;
+
+	ring->writer = g_thread_new("log-writer", writer_func, ring);
+
+	__atomic_store_n(&log_ring, ring, __ATOMIC_RELEASE);
+}
+
+void logging_shutdown(void)
+{
+	struct log_ring *ring = log_ring;
+	guint64 value = 1;
+
+	if (!ring)
+		return;
+
+	/* everything logged from now on goes out synchronously */
+	__atomic_store_n(&log_ring, NULL, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&ring->quit, 1, __ATOMIC_SEQ_CST);
+	if (write(ring->wakeup_fd, &value, sizeof(value)) < 0)
+		g_warning("[Logging] Failed to wake up writer: %s", strerror(errno));
+
+	g_thread_join(ring->writer);
+
+	close(ring->wakeup_fd);
+	g_free(ring);
+}
+
+bool logging_set_level(const char *domain, enum log_level level)
+{
+	struct log_domain *entry;
+	int count;
+
+	if (level >= LOG_LEVEL_MAX)
+		return false;
+
+	if (!domain || domain[0] == '\0') {
+		__atomic_store_n(&default_level, level, __ATOMIC_RELAXED);
+		return true;
+	}
+
+	if (strlen(domain) >= LOG_DOMAIN_NAME_MAX)
+		return false;
+
+	entry = find_domain(domain);
+	if (entry) {
+		__atomic_store_n(&entry->level, level, __ATOMIC_RELAXED);
+		return true;
+	}
+
+	/* domains are only added from the main thread */
+	count = domain_count;
+	if (count >= LOG_DOMAIN_MAX)
+		return false;
+
+	g_strlcpy(domains[count].name, domain, LOG_DOMAIN_NAME_MAX);
+	domains[count].level = level;
+	__atomic_store_n(&domain_count, count + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+enum log_level logging_get_level(const char *domain)
+{
+	return effective_level(domain);
+}
+
+bool log_level_from_string(const char *str, enum log_level *level)
+{
+	int n;
+
+	for (n = 0; n < LOG_LEVEL_MAX; n++) {
+		if (g_strcmp0(str, level_names[n]) == 0) {
+			*level = n;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* log_level_to_string(enum log_level level)
+{
+	if (level >= LOG_LEVEL_MAX)
+		return "unknown";
+
+	return level_names[level];
+}
+
+bool logging_set_redact(bool value)
+{
+	if (!value && !redact_optional)
+		return false;
+
+	redact = value;
+
+	return true;
+}
+
+bool logging_get_redact(void)
+{
+	return redact;
+}
+
+/* Message bodies and similar private data only show up in the log when asked
+ * for explicitly */
+const char* logging_redact(const char *text)
+{
+	if (!text)
+		return "(null)";
+
+	return redact ? "<redacted>" : text;
+}
+
+void logging_get_stats(struct logging_stats *result)
+{
+	result->written = __atomic_load_n(&stats.written, __ATOMIC_RELAXED);
+	result->filtered = __atomic_load_n(&stats.filtered, __ATOMIC_RELAXED);
+	result->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+	result->rate_limited = __atomic_load_n(&stats.rate_limited, __ATOMIC_RELAXED);
+	result->truncated = __atomic_load_n(&stats.truncated, __ATOMIC_RELAXED);
+}
+
+bool log_rate_limit_allow(struct log_rate_limit *limit, const char *file, int line)
+{
+	gint64 now = g_get_monotonic_time();
+
+	if (now - limit->window_start >= LOG_RATE_LIMIT_INTERVAL_SECONDS * G_USEC_PER_SEC) {
+		if (limit->suppressed > 0)
+			g_message("[Logging] %u messages from %s:%d suppressed", limit->suppressed, file, line);
+
+		limit->window_start = now;
+		limit->count = 0;
+		limit->suppressed = 0;
+	}
+
+	if (limit->count < LOG_RATE_LIMIT_BURST) {
+		limit->count++;
+		return true;
+	}
+
+	limit->suppressed++;
+	__atomic_add_fetch(&stats.rate_limited, 1, __ATOMIC_RELAXED);
+
+	return false;
+}
+
+// vim:ts=4:sw=4:noexpandtab
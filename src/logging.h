@@ -0,0 +1,74 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef LOGGING_H_
+#define LOGGING_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+enum log_level {
+	LOG_LEVEL_ERROR = 0,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_MESSAGE,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_MAX
+};
+
+struct logging_stats {
+	unsigned int written;
+	unsigned int filtered;
+	unsigned int dropped;
+	unsigned int rate_limited;
+	unsigned int truncated;
+};
+
+struct log_rate_limit {
+	gint64 window_start;
+	unsigned int count;
+	unsigned int suppressed;
+};
+
+void logging_init(bool debug);
+void logging_shutdown(void);
+
+bool logging_set_level(const char *domain, enum log_level level);
+enum log_level logging_get_level(const char *domain);
+bool log_level_from_string(const char *str, enum log_level *level);
+const char* log_level_to_string(enum log_level level);
+
+bool logging_set_redact(bool redact);
+bool logging_get_redact(void);
+const char* logging_redact(const char *text);
+
+void logging_get_stats(struct logging_stats *stats);
+
+bool log_rate_limit_allow(struct log_rate_limit *limit, const char *file, int line);
+
+/* Logs at most a few messages per interval from the call site it is used at */
+#define telephony_message_ratelimited(...) \
+	do { \
+		static struct log_rate_limit _log_rate_limit; \
+		if (log_rate_limit_allow(&_log_rate_limit, __FILE__, __LINE__)) \
+			g_message(__VA_ARGS__); \
+	} while (0)
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
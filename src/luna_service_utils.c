@@ -16,7 +16,24 @@
 *
 * LICENSE@@@ */
 
+#include <glib.h>
+
 #include "luna_service_utils.h"
+#include "flightrecorder.h"
+#include "displaystate.h"
+
+/* Subscription posts held back while the display is off; only the latest
+ * one per method is kept */
+struct deferred_post {
+	LSHandle *handle;
+	gchar *path;
+	gchar *method;
+	gchar *payload;
+};
+
+static GSList *deferred_posts = NULL;
+static unsigned int immediate_post_count = 0;
+static unsigned int deferred_post_count = 0;
 
 void luna_service_message_reply_custom_error(LSHandle *handle, LSMessage *message, const char *error_text)
 {
@@ -159,6 +176,31 @@ bool luna_service_check_for_subscription_and_process(LSHandle *handle, LSMessage
 	return subscribed;
 }
 
+static void deferred_post_free(struct deferred_post *post)
+{
+	g_free(post->path);
+	g_free(post->method);
+	g_free(post->payload);
+	g_free(post);
+}
+
+/* Drops a post held back for the method as a newer one supersedes it */
+static void drop_deferred_post(LSHandle *handle, const char *path, const char *method)
+{
+	struct deferred_post *post;
+	GSList *iter;
+
+	for (iter = deferred_posts; iter != NULL; iter = g_slist_next(iter)) {
+		post = iter->data;
+
+		if (post->handle == handle && g_strcmp0(post->path, path) == 0 && g_strcmp0(post->method, method) == 0) {
+			deferred_posts = g_slist_delete_link(deferred_posts, iter);
+			deferred_post_free(post);
+			return;
+		}
+	}
+}
+
 void luna_service_post_subscription(LSHandle *handle, const char *path, const char *method, jvalue_ref reply_obj)
 {
 	jschema_ref response_schema = NULL;
@@ -166,10 +208,14 @@ void luna_service_post_subscription(LSHandle *handle, const char *path, const ch
 
 	LSErrorInit(&lserror);
 
+	drop_deferred_post(handle, path, method);
+
 	response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
 	if(!response_schema)
 		goto cleanup;
 
+	flight_recorder_record(FLIGHT_EVENT_SUBSCRIPTION_POST, 0, 0, method);
+
 	if (!LSSubscriptionPost(handle, path, method,
 						jvalue_tostring(reply_obj, response_schema), &lserror)) {
 		LSErrorPrint(&lserror, stderr);
@@ -181,4 +227,162 @@ cleanup:
 		jschema_release(&response_schema);
 }
 
+/* Like luna_service_post_subscription but while the display is off the post is
+ * held back until luna_service_flush_deferred_posts is called; a later post
+ * for the same method, deferrable or not, replaces it */
+void luna_service_post_subscription_deferrable(LSHandle *handle, const char *path, const char *method,
+											   jvalue_ref reply_obj)
+{
+	jschema_ref response_schema = NULL;
+	struct deferred_post *post = NULL;
+	GSList *iter;
+
+	if (display_state_is_on()) {
+		immediate_post_count++;
+		luna_service_post_subscription(handle, path, method, reply_obj);
+		return;
+	}
+
+	response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+		return;
+
+	for (iter = deferred_posts; iter != NULL; iter = g_slist_next(iter)) {
+		post = iter->data;
+		if (post->handle == handle && g_strcmp0(post->path, path) == 0 && g_strcmp0(post->method, method) == 0)
+			break;
+		post = NULL;
+	}
+
+	if (!post) {
+		post = g_new0(struct deferred_post, 1);
+		post->handle = handle;
+		post->path = g_strdup(path);
+		post->method = g_strdup(method);
+		deferred_posts = g_slist_append(deferred_posts, post);
+	}
+
+	g_free(post->payload);
+	post->payload = g_strdup(jvalue_tostring(reply_obj, response_schema));
+
+	deferred_post_count++;
+
+	jschema_release(&response_schema);
+}
+
+void luna_service_flush_deferred_posts(void)
+{
+	struct deferred_post *post;
+	LSError lserror;
+	GSList *iter;
+
+	for (iter = deferred_posts; iter != NULL; iter = g_slist_next(iter)) {
+		post = iter->data;
+
+		flight_recorder_record(FLIGHT_EVENT_SUBSCRIPTION_POST, 0, 0, post->method);
+
+		LSErrorInit(&lserror);
+
+		if (!LSSubscriptionPost(post->handle, post->path, post->method, post->payload, &lserror)) {
+			LSErrorPrint(&lserror, stderr);
+			LSErrorFree(&lserror);
+		}
+
+		deferred_post_free(post);
+	}
+
+	g_slist_free(deferred_posts);
+	deferred_posts = NULL;
+}
+
+void luna_service_get_deferred_post_counts(unsigned int *immediate, unsigned int *deferred)
+{
+	*immediate = immediate_post_count;
+	*deferred = deferred_post_count;
+}
+
+/* Like luna_service_call_validate_and_send but the callback gets all replies until
+ * the call is canceled with the returned token */
+bool luna_service_call_multi_validate_and_send(LSHandle *handle, const char *uri, jvalue_ref req_obj,
+                                               LSFilterFunc callback, void *user_data, LSMessageToken *token)
+{
+	jschema_ref request_schema = NULL;
+	LSError lserror;
+	bool success = true;
+
+	LSErrorInit(&lserror);
+
+	request_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!request_schema)
+		return false;
+
+	if (!LSCall(handle, uri, jvalue_tostring(req_obj, request_schema), callback, user_data, token, &lserror)) {
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		success = false;
+	}
+
+	jschema_release(&request_schema);
+
+	return success;
+}
+
+struct luna_service_category {
+	LSMethod *methods;
+	void *data;
+};
+
+static bool recording_method_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct luna_service_category *category = user_data;
+	const char *method = LSMessageGetMethod(message);
+	LSMethod *m;
+
+	for (m = category->methods; m->name != NULL; m++) {
+		if (g_strcmp0(m->name, method) != 0)
+			continue;
+
+		flight_recorder_record(FLIGHT_EVENT_LUNA_REQUEST, 0, 0, method);
+		return m->function(handle, message, category->data);
+	}
+
+	return false;
+}
+
+/* Registers the methods of a category and its data like LSRegisterCategory plus
+ * LSCategorySetData would do but records each incoming request in the flight
+ * recorder before it is dispatched. The registration lives as long as the
+ * process does. */
+bool luna_service_register_category(LSHandle *handle, const char *category_name, LSMethod *methods,
+									void *data, LSError *error)
+{
+	struct luna_service_category *category;
+	LSMethod *recording_methods;
+	int count = 0;
+	int n;
+
+	while (methods[count].name != NULL)
+		count++;
+
+	category = g_new0(struct luna_service_category, 1);
+	category->methods = methods;
+	category->data = data;
+
+	/* same table but everything goes through the recording callback */
+	recording_methods = g_new0(LSMethod, count + 1);
+	for (n = 0; n < count; n++) {
+		recording_methods[n] = methods[n];
+		recording_methods[n].function = recording_method_cb;
+	}
+
+	if (!LSRegisterCategory(handle, category_name, recording_methods, NULL, NULL, error) ||
+		!LSCategorySetData(handle, category_name, category, error)) {
+		g_free(recording_methods);
+		g_free(category);
+		return false;
+	}
+
+	return true;
+}
+
 // vim:ts=4:sw=4:noexpandtab
@@ -34,9 +34,18 @@ jvalue_ref luna_service_message_parse_and_validate(const char *payload);
 bool luna_service_message_validate_and_send(LSHandle *handle, LSMessage *message, jvalue_ref reply_obj);
 bool luna_service_check_for_subscription_and_process(LSHandle *handle, LSMessage *message);
 void luna_service_post_subscription(LSHandle *handle, const char *path, const char *method, jvalue_ref reply_obj);
+void luna_service_post_subscription_deferrable(LSHandle *handle, const char *path, const char *method,
+											   jvalue_ref reply_obj);
+void luna_service_flush_deferred_posts(void);
+void luna_service_get_deferred_post_counts(unsigned int *immediate, unsigned int *deferred);
+
+bool luna_service_register_category(LSHandle *handle, const char *category_name, LSMethod *methods,
+									void *data, LSError *error);
 
 bool luna_service_call_validate_and_send(LSHandle *handle, const char *uri, jvalue_ref req_obj,
                                          LSFilterFunc callback, void *user_data);
+bool luna_service_call_multi_validate_and_send(LSHandle *handle, const char *uri, jvalue_ref req_obj,
+                                               LSFilterFunc callback, void *user_data, LSMessageToken *token);
 
 #endif
 
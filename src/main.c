@@ -22,6 +22,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <limits.h>
 #include <sys/signalfd.h>
 
 #include <luna-service2/lunaservice.h>
@@ -30,14 +31,26 @@
 
 #include "telephonyservice.h"
 #include "wanservice.h"
+#include "telephonysettings.h"
+#include "logging.h"
+#include "flightrecorder.h"
+#include "displaystate.h"
+#include "startuptimeline.h"
+#include "statecache.h"
+#include "utils.h"
 
 #define SHUTDOWN_GRACE_SECONDS		0
 #define VERSION						"0.1"
+/* on tmpfs so recording doesn't touch the flash */
+#define FLIGHT_RECORDER_PATH		TELEPHONY_RUNTIME_DIR "/flight-recorder"
+#define FLIGHT_RECORDER_CAPACITY	4096
+#define STATE_SNAPSHOT_PATH			TELEPHONY_STATE_DIR "/state-snapshot"
 
 GMainLoop *event_loop;
 static gboolean option_detach = FALSE;
 static gboolean option_version = FALSE;
 static gboolean option_debug = FALSE;
+static gchar *option_display_status = NULL;
 static unsigned int __terminated = 0;
 
 extern void ofono_init(void);
@@ -49,9 +62,12 @@ static GOptionEntry options[] = {
 				"Don't run as daemon in background" },
 	{ "version", 'v', 0, G_OPTION_ARG_NONE, &option_version,
 				"Show version information and exit" },
-	{ "debug", 'd', G_OPTION_FLAG_REVERSE,
+	{ "debug", 'd', 0,
 				G_OPTION_ARG_NONE, &option_debug,
 				"Output debug information" },
+	{ "display-status", 0, 0,
+				G_OPTION_ARG_STRING, &option_display_status,
+				"Luna URI to get display state changes from or \"none\"", "URI" },
 	{ NULL },
 };
 
@@ -65,6 +81,7 @@ static gboolean signal_handler(GIOChannel *channel, GIOCondition cond,
 							gpointer user_data)
 {
 	struct signalfd_siginfo si;
+	char path[PATH_MAX];
 	ssize_t result;
 	int fd;
 
@@ -88,6 +105,9 @@ static gboolean signal_handler(GIOChannel *channel, GIOCondition cond,
 
 		__terminated = 1;
 		break;
+	case SIGUSR1:
+		flight_recorder_snapshot(path, sizeof(path));
+		break;
 	}
 
 	return TRUE;
@@ -103,6 +123,7 @@ static guint setup_signalfd(void)
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGUSR1);
 
 	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
 		perror("Failed to set signal mask");
@@ -130,12 +151,6 @@ static guint setup_signalfd(void)
 	return source;
 }
 
-static void log_handler(const gchar *log_domain, GLogLevelFlags log_level,
-						const gchar *message, gpointer user_data)
-{
-	g_print("%s\n", message);
-}
-
 int main(int argc, char **argv)
 {
 	GOptionContext *context;
@@ -144,11 +159,9 @@ int main(int argc, char **argv)
 	struct telephony_service *telservice;
 	struct wan_service *wanservice;
 
-	g_type_init();
-
-	g_log_set_handler (NULL, G_LOG_LEVEL_MASK, log_handler, NULL);
+	startup_timeline_mark(STARTUP_PHASE_PROCESS_START);
 
-	g_message("Telephony Interface Layer Daemon %s", VERSION);
+	g_type_init();
 
 	context = g_option_context_new(NULL);
 	g_option_context_add_main_entries(context, options, NULL);
@@ -178,10 +191,24 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* the log writer thread wouldn't survive daemonizing */
+	logging_init(option_debug);
+
+	g_message("Telephony Interface Layer Daemon %s", VERSION);
+
+	flight_recorder_open(FLIGHT_RECORDER_PATH, FLIGHT_RECORDER_CAPACITY);
+
 	signal = setup_signalfd();
 
 	event_loop = g_main_loop_new(NULL, FALSE);
 
+	telephony_settings_init();
+
+	state_cache_init(STATE_SNAPSHOT_PATH);
+
+	if (option_display_status)
+		display_state_set_source(option_display_status);
+
 	ofono_init();
 
 	telservice = telephony_service_create();
@@ -200,10 +227,22 @@ int main(int argc, char **argv)
 
 	ofono_exit();
 
+	state_cache_shutdown();
+
+	utils_pools_shutdown();
+
+	telephony_settings_shutdown();
+
+	g_free(option_display_status);
+
 	g_source_remove(signal);
 
 	g_main_loop_unref(event_loop);
 
+	flight_recorder_close();
+
+	logging_shutdown();
+
 	return 0;
 }
 
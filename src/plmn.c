@@ -0,0 +1,61 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "plmn.h"
+
+/* The table is compiled in and sorted by id (mcc followed by mnc) so a lookup
+ * is a binary search over read-only data without any I/O */
+
+static int compare_entry(const void *key, const void *member)
+{
+	const struct plmn_entry *entry = member;
+
+	return strcmp(key, entry->id);
+}
+
+static const struct plmn_entry* lookup_entry(const char *mcc, const char *mnc)
+{
+	char id[PLMN_ID_MAX_LENGTH + 1];
+
+	if (!mcc || !mnc || strlen(mcc) != 3 || strlen(mnc) < 2 || strlen(mnc) > 3)
+		return NULL;
+
+	g_snprintf(id, sizeof(id), "%s%s", mcc, mnc);
+
+	return bsearch(id, plmn_table, plmn_table_size, sizeof(struct plmn_entry), compare_entry);
+}
+
+const char* plmn_lookup_name(const char *mcc, const char *mnc)
+{
+	const struct plmn_entry *entry = lookup_entry(mcc, mnc);
+
+	return entry ? &plmn_names[entry->name] : NULL;
+}
+
+const char* plmn_lookup_country(const char *mcc, const char *mnc)
+{
+	const struct plmn_entry *entry = lookup_entry(mcc, mnc);
+
+	return entry ? entry->country : NULL;
+}
+
+// vim:ts=4:sw=4:noexpandtab
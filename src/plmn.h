@@ -0,0 +1,41 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef PLMN_H_
+#define PLMN_H_
+
+#define PLMN_ID_MAX_LENGTH		6
+
+/* Entry of the operator table generated from files/plmn/plmn.csv at build
+ * time; name is an offset into plmn_names */
+struct plmn_entry {
+	char id[PLMN_ID_MAX_LENGTH + 1];
+	char country[3];
+	unsigned short name;
+};
+
+extern const char plmn_names[];
+extern const struct plmn_entry plmn_table[];
+extern const unsigned int plmn_table_size;
+
+const char* plmn_lookup_name(const char *mcc, const char *mnc);
+const char* plmn_lookup_country(const char *mcc, const char *mnc);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
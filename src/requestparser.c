@@ -0,0 +1,495 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <glib.h>
+
+#include "requestparser.h"
+
+/* keys longer than this can't be one we're looking for */
+#define KEY_BUFFER_SIZE		64
+/* nesting of values we skip */
+#define MAX_DEPTH			32
+
+struct parser {
+	const char *start;
+	const char *pos;
+	char *error_text;
+	size_t error_size;
+};
+
+static bool syntax_error(struct parser *parser)
+{
+	snprintf(parser->error_text, parser->error_size, "Malformed json at offset %d",
+			 (int) (parser->pos - parser->start));
+	return false;
+}
+
+/* Values we can't hand on as C strings get the same error text as other
+ * invalid parameters */
+static bool invalid_error(struct parser *parser)
+{
+	snprintf(parser->error_text, parser->error_size, "Invalid parameters.");
+	return false;
+}
+
+static void skip_whitespace(struct parser *parser)
+{
+	while (*parser->pos == ' ' || *parser->pos == '\t' || *parser->pos == '\n' || *parser->pos == '\r')
+		parser->pos++;
+}
+
+static bool expect_literal(struct parser *parser, const char *literal)
+{
+	size_t length = strlen(literal);
+
+	if (strncmp(parser->pos, literal, length) != 0)
+		return syntax_error(parser);
+
+	parser->pos += length;
+
+	return true;
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static bool read_hex4(struct parser *parser, unsigned int *value)
+{
+	int n, digit;
+
+	*value = 0;
+
+	for (n = 0; n < 4; n++) {
+		digit = hex_value(parser->pos[n]);
+		if (digit < 0)
+			return syntax_error(parser);
+		*value = (*value << 4) | digit;
+	}
+
+	parser->pos += 4;
+
+	return true;
+}
+
+/* Decodes the string at the current position into buffer; without a buffer the
+ * string is only validated. Returns the decoded length which may be larger
+ * than the buffer (nothing is written past it) or -1 on a syntax error or if
+ * a string to decode contains a NUL character. */
+static long decode_string(struct parser *parser, char *buffer, size_t size)
+{
+	char utf8[4];
+	unsigned int code, low;
+	long length = 0;
+	size_t count, n;
+
+	if (*parser->pos != '"') {
+		syntax_error(parser);
+		return -1;
+	}
+
+	parser->pos++;
+
+	while (*parser->pos != '"') {
+		if ((unsigned char) *parser->pos < 0x20) {
+			syntax_error(parser);
+			return -1;
+		}
+
+		if (*parser->pos != '\\') {
+			if (buffer && (size_t) length < size)
+				buffer[length] = *parser->pos;
+			length++;
+			parser->pos++;
+			continue;
+		}
+
+		parser->pos++;
+
+		switch (*parser->pos) {
+		case '"': case '\\': case '/':
+			utf8[0] = *parser->pos;
+			break;
+		case 'b':
+			utf8[0] = '\b';
+			break;
+		case 'f':
+			utf8[0] = '\f';
+			break;
+		case 'n':
+			utf8[0] = '\n';
+			break;
+		case 'r':
+			utf8[0] = '\r';
+			break;
+		case 't':
+			utf8[0] = '\t';
+			break;
+		case 'u':
+			break;
+		default:
+			syntax_error(parser);
+			return -1;
+		}
+
+		parser->pos++;
+		count = 1;
+
+		if (parser->pos[-1] == 'u') {
+			if (!read_hex4(parser, &code))
+				return -1;
+
+			/* characters outside the BMP come as a surrogate pair */
+			if (code >= 0xd800 && code <= 0xdbff) {
+				if (parser->pos[0] != '\\' || parser->pos[1] != 'u') {
+					syntax_error(parser);
+					return -1;
+				}
+				parser->pos += 2;
+				if (!read_hex4(parser, &low))
+					return -1;
+				if (low < 0xdc00 || low > 0xdfff) {
+					syntax_error(parser);
+					return -1;
+				}
+				code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+			}
+			else if (code >= 0xdc00 && code <= 0xdfff) {
+				syntax_error(parser);
+				return -1;
+			}
+			else if (code == 0 && buffer) {
+				/* would silently cut the decoded string short */
+				invalid_error(parser);
+				return -1;
+			}
+
+			count = g_unichar_to_utf8(code, utf8);
+		}
+
+		for (n = 0; n < count; n++) {
+			if (buffer && (size_t) length < size)
+				buffer[length] = utf8[n];
+			length++;
+		}
+	}
+
+	parser->pos++;
+
+	return length;
+}
+
+/* Checks the syntax of a number and tells wether it has a fraction or exponent */
+static bool scan_number(struct parser *parser, bool *integral)
+{
+	const char *p = parser->pos;
+
+	*integral = true;
+
+	if (*p == '-')
+		p++;
+
+	if (*p == '0')
+		p++;
+	else if (*p >= '1' && *p <= '9')
+		while (*p >= '0' && *p <= '9')
+			p++;
+	else
+		return syntax_error(parser);
+
+	if (*p == '.') {
+		*integral = false;
+		p++;
+		if (*p < '0' || *p > '9')
+			return syntax_error(parser);
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	if (*p == 'e' || *p == 'E') {
+		*integral = false;
+		p++;
+		if (*p == '+' || *p == '-')
+			p++;
+		if (*p < '0' || *p > '9')
+			return syntax_error(parser);
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	parser->pos = p;
+
+	return true;
+}
+
+static bool skip_value(struct parser *parser, int depth)
+{
+	bool integral;
+	char close;
+
+	if (depth > MAX_DEPTH)
+		return syntax_error(parser);
+
+	switch (*parser->pos) {
+	case '"':
+		return decode_string(parser, NULL, 0) >= 0;
+	case 't':
+		return expect_literal(parser, "true");
+	case 'f':
+		return expect_literal(parser, "false");
+	case 'n':
+		return expect_literal(parser, "null");
+	case '{':
+	case '[':
+		close = (*parser->pos == '{') ? '}' : ']';
+		parser->pos++;
+		skip_whitespace(parser);
+
+		if (*parser->pos == close) {
+			parser->pos++;
+			return true;
+		}
+
+		while (true) {
+			if (close == '}') {
+				if (decode_string(parser, NULL, 0) < 0)
+					return false;
+				skip_whitespace(parser);
+				if (*parser->pos != ':')
+					return syntax_error(parser);
+				parser->pos++;
+				skip_whitespace(parser);
+			}
+
+			if (!skip_value(parser, depth + 1))
+				return false;
+
+			skip_whitespace(parser);
+
+			if (*parser->pos == close) {
+				parser->pos++;
+				return true;
+			}
+
+			if (*parser->pos != ',')
+				return syntax_error(parser);
+
+			parser->pos++;
+			skip_whitespace(parser);
+		}
+	default:
+		return scan_number(parser, &integral);
+	}
+}
+
+static bool type_error(struct parser *parser, const struct request_key *key)
+{
+	static const char *type_names[] = {
+		[REQUEST_VALUE_STRING] = "a string",
+		[REQUEST_VALUE_BOOLEAN] = "a boolean",
+		[REQUEST_VALUE_INTEGER] = "an integer",
+	};
+
+	snprintf(parser->error_text, parser->error_size, "Value of '%s' has to be %s",
+			 key->name, type_names[key->type]);
+	return false;
+}
+
+static bool parse_value(struct parser *parser, const struct request_key *key, char *target)
+{
+	const char *number_start = parser->pos;
+	char *member = target + key->offset;
+	bool integral;
+	long long value;
+	long length;
+
+	switch (key->type) {
+	case REQUEST_VALUE_STRING:
+		if (*parser->pos != '"')
+			return type_error(parser, key);
+
+		length = decode_string(parser, member, key->size);
+		if (length < 0)
+			return false;
+
+		if ((size_t) length >= key->size) {
+			member[key->size - 1] = '\0';
+			snprintf(parser->error_text, parser->error_size, "Value of '%s' is too long", key->name);
+			return false;
+		}
+
+		member[length] = '\0';
+
+		/* raw bytes of the payload are copied as they are */
+		if (!g_utf8_validate(member, length, NULL)) {
+			member[0] = '\0';
+			return invalid_error(parser);
+		}
+
+		return true;
+	case REQUEST_VALUE_BOOLEAN:
+		if (strncmp(parser->pos, "true", 4) == 0) {
+			*((bool*) member) = true;
+			parser->pos += 4;
+			return true;
+		}
+
+		if (strncmp(parser->pos, "false", 5) == 0) {
+			*((bool*) member) = false;
+			parser->pos += 5;
+			return true;
+		}
+
+		return type_error(parser, key);
+	case REQUEST_VALUE_INTEGER:
+		if (*parser->pos != '-' && (*parser->pos < '0' || *parser->pos > '9'))
+			return type_error(parser, key);
+
+		if (!scan_number(parser, &integral))
+			return false;
+
+		if (!integral)
+			return type_error(parser, key);
+
+		value = strtoll(number_start, NULL, 10);
+		if (value < INT_MIN || value > INT_MAX || parser->pos - number_start > 11) {
+			snprintf(parser->error_text, parser->error_size, "Value of '%s' is out of range", key->name);
+			return false;
+		}
+
+		*((int*) member) = (int) value;
+		return true;
+	}
+
+	return type_error(parser, key);
+}
+
+static const struct request_key* find_key(const struct request_key *keys, const char *name, unsigned int *index)
+{
+	for (*index = 0; keys[*index].name != NULL; (*index)++) {
+		if (strcmp(keys[*index].name, name) == 0)
+			return &keys[*index];
+	}
+
+	return NULL;
+}
+
+/**
+ * Parses a request payload which has to be a JSON object and writes the values
+ * of the keys given in the table to the matching members of target. Members of
+ * keys not in the payload are left alone so they can be initialized with the
+ * defaults. If present is given a bit is set for every key found (by its index
+ * in the table).
+ *
+ * Returns false with a description of the problem in error_text if the payload
+ * is malformed, a value has the wrong type or a required key is missing.
+ **/
+bool request_parse(const char *payload, const struct request_key *keys, void *target,
+				   unsigned int *present, char *error_text, size_t error_size)
+{
+	struct parser parser;
+	const struct request_key *key;
+	char name[KEY_BUFFER_SIZE];
+	unsigned int found = 0;
+	unsigned int index;
+	long length;
+
+	parser.start = payload ? payload : "";
+	parser.pos = parser.start;
+	parser.error_text = error_text;
+	parser.error_size = error_size;
+
+	skip_whitespace(&parser);
+
+	if (*parser.pos != '{')
+		return syntax_error(&parser);
+
+	parser.pos++;
+	skip_whitespace(&parser);
+
+	if (*parser.pos == '}')
+		parser.pos++;
+	else while (true) {
+		length = decode_string(&parser, name, sizeof(name));
+		if (length < 0)
+			return false;
+
+		key = NULL;
+		if ((size_t) length < sizeof(name)) {
+			name[length] = '\0';
+			key = find_key(keys, name, &index);
+		}
+
+		skip_whitespace(&parser);
+		if (*parser.pos != ':')
+			return syntax_error(&parser);
+		parser.pos++;
+		skip_whitespace(&parser);
+
+		if (key) {
+			if (!parse_value(&parser, key, target))
+				return false;
+			found |= (1u << index);
+		}
+		else if (!skip_value(&parser, 1)) {
+			return false;
+		}
+
+		skip_whitespace(&parser);
+
+		if (*parser.pos == '}') {
+			parser.pos++;
+			break;
+		}
+
+		if (*parser.pos != ',')
+			return syntax_error(&parser);
+
+		parser.pos++;
+		skip_whitespace(&parser);
+	}
+
+	skip_whitespace(&parser);
+	if (*parser.pos != '\0')
+		return syntax_error(&parser);
+
+	for (index = 0; keys[index].name != NULL; index++) {
+		if (keys[index].required && !(found & (1u << index))) {
+			snprintf(error_text, error_size, "Missing required key '%s'", keys[index].name);
+			return false;
+		}
+	}
+
+	if (present)
+		*present = found;
+
+	return true;
+}
+
+// vim:ts=4:sw=4:noexpandtab
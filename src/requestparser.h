@@ -0,0 +1,60 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef REQUEST_PARSER_H_
+#define REQUEST_PARSER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Extracts a few scalar values from a request payload straight into a struct
+ * without building a DOM. Handlers describe what they expect in a static table
+ * of keys; anything else in the payload is checked for syntax and skipped. */
+
+enum request_value_type {
+	/* member has to be a char array */
+	REQUEST_VALUE_STRING = 0,
+	/* member has to be a bool */
+	REQUEST_VALUE_BOOLEAN,
+	/* member has to be an int */
+	REQUEST_VALUE_INTEGER,
+};
+
+struct request_key {
+	const char *name;
+	enum request_value_type type;
+	size_t offset;
+	size_t size;
+	bool required;
+};
+
+#define REQUEST_KEY(struct_type, member, key_name, value_type, is_required) \
+	{ key_name, value_type, offsetof(struct_type, member), sizeof(((struct_type*) 0)->member), is_required }
+
+#define REQUEST_KEYS_END	{ NULL, 0, 0, 0, false }
+
+/* at most that many keys per table as present is a bit mask */
+#define REQUEST_KEYS_MAX	32
+#define REQUEST_ERROR_SIZE	96
+
+bool request_parse(const char *payload, const struct request_key *keys, void *target,
+				   unsigned int *present, char *error_text, size_t error_size);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,184 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "slabpool.h"
+
+/* A pool of equally sized objects which are carved out of larger slabs and
+ * recycled through a freelist instead of going back to the heap. Slabs are
+ * never returned before the pool is freed. The pool isn't thread safe and is
+ * meant for objects which only live on the main loop.
+ *
+ * Debug builds (without NDEBUG) remember the state and owner of each object so
+ * a double release, a release to the wrong pool or a release of a pointer the
+ * pool never handed out gets reported instead of corrupting the freelist, and
+ * objects which are still in use when the pool is freed get reported as
+ * leaked. */
+
+#define SLAB_POOL_ALIGN			(2 * sizeof(gpointer))
+
+#define CHUNK_STATE_FREE		0x46524545 /* "FREE" */
+#define CHUNK_STATE_IN_USE		0x55534544 /* "USED" */
+#define CHUNK_POISON			0xa5
+
+struct slab_chunk {
+	struct slab_chunk *next;
+#ifndef NDEBUG
+	struct slab_pool *owner;
+	guint32 state;
+#endif
+};
+
+struct slab_pool {
+	const char *name;
+	gsize object_size;
+	gsize chunk_size;
+	gsize header_size;
+	unsigned int objects_per_slab;
+	GSList *slabs;
+	struct slab_chunk *free_chunks;
+	struct slab_pool_stats stats;
+#ifndef NDEBUG
+	GThread *thread;
+#endif
+};
+
+struct slab_pool* slab_pool_new(const char *name, gsize object_size, unsigned int objects_per_slab)
+{
+	struct slab_pool *pool;
+
+	g_return_val_if_fail(object_size > 0 && objects_per_slab > 0, NULL);
+
+	pool = g_new0(struct slab_pool, 1);
+	pool->name = name;
+	pool->object_size = object_size;
+	pool->objects_per_slab = objects_per_slab;
+	pool->header_size = (sizeof(struct slab_chunk) + SLAB_POOL_ALIGN - 1) & ~(SLAB_POOL_ALIGN - 1);
+	pool->chunk_size = (pool->header_size + object_size + SLAB_POOL_ALIGN - 1) & ~(SLAB_POOL_ALIGN - 1);
+#ifndef NDEBUG
+	pool->thread = g_thread_self();
+#endif
+
+	return pool;
+}
+
+void slab_pool_free(struct slab_pool *pool)
+{
+	if (!pool)
+		return;
+
+#ifndef NDEBUG
+	if (pool->stats.in_use > 0)
+		g_warning("[SlabPool] %u %s objects leaked", pool->stats.in_use, pool->name);
+#endif
+
+	g_slist_free_full(pool->slabs, g_free);
+	g_free(pool);
+}
+
+static void add_slab(struct slab_pool *pool)
+{
+	char *slab;
+	struct slab_chunk *chunk;
+	int n;
+
+	slab = g_malloc(pool->chunk_size * pool->objects_per_slab);
+	pool->slabs = g_slist_prepend(pool->slabs, slab);
+	pool->stats.slabs++;
+
+	/* chain backwards so objects get handed out in address order */
+	for (n = pool->objects_per_slab - 1; n >= 0; n--) {
+		chunk = (struct slab_chunk*) (slab + n * pool->chunk_size);
+		chunk->next = pool->free_chunks;
+#ifndef NDEBUG
+		chunk->owner = pool;
+		chunk->state = CHUNK_STATE_FREE;
+#endif
+		pool->free_chunks = chunk;
+	}
+}
+
+gpointer slab_pool_alloc0(struct slab_pool *pool)
+{
+	struct slab_chunk *chunk;
+	gpointer object;
+
+#ifndef NDEBUG
+	g_assert(pool->thread == g_thread_self());
+#endif
+
+	if (!pool->free_chunks)
+		add_slab(pool);
+
+	chunk = pool->free_chunks;
+	pool->free_chunks = chunk->next;
+
+#ifndef NDEBUG
+	g_assert(chunk->owner == pool && chunk->state == CHUNK_STATE_FREE);
+	chunk->state = CHUNK_STATE_IN_USE;
+#endif
+
+	pool->stats.allocations++;
+	pool->stats.in_use++;
+	if (pool->stats.in_use > pool->stats.peak)
+		pool->stats.peak = pool->stats.in_use;
+
+	object = (char*) chunk + pool->header_size;
+	memset(object, 0, pool->object_size);
+
+	return object;
+}
+
+void slab_pool_release(struct slab_pool *pool, gpointer object)
+{
+	struct slab_chunk *chunk;
+
+	if (!object)
+		return;
+
+	chunk = (struct slab_chunk*) ((char*) object - pool->header_size);
+
+#ifndef NDEBUG
+	g_assert(pool->thread == g_thread_self());
+
+	if (chunk->owner != pool || chunk->state != CHUNK_STATE_IN_USE) {
+		g_critical("[SlabPool] Bad release of %s object %p (%s)", pool->name, object,
+				   chunk->owner == pool && chunk->state == CHUNK_STATE_FREE ?
+				   "already released" : "not owned by this pool");
+		pool->stats.bad_releases++;
+		return;
+	}
+
+	chunk->state = CHUNK_STATE_FREE;
+	/* make use after release show up */
+	memset(object, CHUNK_POISON, pool->object_size);
+#endif
+
+	chunk->next = pool->free_chunks;
+	pool->free_chunks = chunk;
+	pool->stats.in_use--;
+}
+
+void slab_pool_get_stats(struct slab_pool *pool, struct slab_pool_stats *stats)
+{
+	*stats = pool->stats;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,46 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SLAB_POOL_H_
+#define SLAB_POOL_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+struct slab_pool;
+
+struct slab_pool_stats {
+	unsigned int slabs;
+	unsigned int in_use;
+	unsigned int peak;
+	unsigned int allocations;
+	/* only counted in debug builds */
+	unsigned int bad_releases;
+};
+
+struct slab_pool* slab_pool_new(const char *name, gsize object_size, unsigned int objects_per_slab);
+void slab_pool_free(struct slab_pool *pool);
+
+gpointer slab_pool_alloc0(struct slab_pool *pool);
+void slab_pool_release(struct slab_pool *pool, gpointer object);
+
+void slab_pool_get_stats(struct slab_pool *pool, struct slab_pool_stats *stats);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
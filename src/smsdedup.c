@@ -0,0 +1,279 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "smsdedup.h"
+#include "utils.h"
+
+#define SMS_DEDUP_FILE_MAGIC		0x31444453 /* "SDD1" */
+
+/* Changes to the window are written back to disk once nothing changed for this
+ * amount of time */
+#define SMS_DEDUP_FLUSH_DELAY_SECONDS	5
+
+struct sms_dedup_file_header {
+	guint32 magic;
+	guint32 size;
+	guint32 count;
+	guint32 hits;
+};
+
+/* We only remember a 64 bit fingerprint of each message we've seen. The ring
+ * holds them in arrival order so the oldest one gets evicted first and the
+ * hash table points into the ring for the lookup. */
+struct sms_dedup {
+	gchar *path;
+	guint64 *ring;
+	unsigned int size;
+	unsigned int count;
+	unsigned int head;
+	GHashTable *seen;
+	unsigned int hits;
+	guint flush_timeout;
+	bool dirty;
+};
+
+#define FNV_OFFSET_BASIS	14695981039346656037ULL
+#define FNV_PRIME			1099511628211ULL
+
+static guint64 fnv1a_update(guint64 hash, const void *data, gsize length)
+{
+	const guchar *p = data;
+	gsize n;
+
+	for (n = 0; n < length; n++) {
+		hash ^= p[n];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static guint64 message_fingerprint(const char *sender, time_t sent_time, const char *text)
+{
+	guint64 hash = FNV_OFFSET_BASIS;
+	gint64 timestamp = sent_time;
+
+	/* include the terminating NUL so sender and text can't shift into each other */
+	if (sender)
+		hash = fnv1a_update(hash, sender, strlen(sender) + 1);
+	hash = fnv1a_update(hash, &timestamp, sizeof(timestamp));
+	if (text)
+		hash = fnv1a_update(hash, text, strlen(text));
+
+	return hash;
+}
+
+static void add_fingerprint(struct sms_dedup *dedup, guint64 fingerprint)
+{
+	guint64 *slot = &dedup->ring[dedup->head];
+
+	if (dedup->count == dedup->size)
+		g_hash_table_remove(dedup->seen, slot);
+	else
+		dedup->count++;
+
+	*slot = fingerprint;
+	g_hash_table_add(dedup->seen, slot);
+
+	dedup->head = (dedup->head + 1) % dedup->size;
+}
+
+static void load_from_file(struct sms_dedup *dedup)
+{
+	struct sms_dedup_file_header *header;
+	const guint64 *entries;
+	gchar *contents = NULL;
+	gsize length = 0;
+	unsigned int first, n;
+
+	if (!g_file_get_contents(dedup->path, &contents, &length, NULL))
+		return;
+
+	if (length < sizeof(*header))
+		goto invalid;
+
+	/* check the count before multiplying so a corrupted one can't overflow */
+	header = (struct sms_dedup_file_header*) contents;
+	if (header->magic != SMS_DEDUP_FILE_MAGIC ||
+		header->count > (length - sizeof(*header)) / sizeof(guint64) ||
+		length != sizeof(*header) + header->count * sizeof(guint64))
+		goto invalid;
+
+	entries = (const guint64*) (contents + sizeof(*header));
+
+	/* if the window got smaller in the meantime we only keep the newest ones */
+	first = header->count > dedup->size ? header->count - dedup->size : 0;
+	for (n = first; n < header->count; n++) {
+		/* the table only points to one slot per fingerprint; a second slot
+		 * would remove the entry of the first one once it gets evicted */
+		if (g_hash_table_contains(dedup->seen, &entries[n]))
+			continue;
+
+		add_fingerprint(dedup, entries[n]);
+	}
+
+	dedup->hits = header->hits;
+
+	g_message("[Telephony:SMS] Restored %u entries of the duplicate detection window", dedup->count);
+
+	g_free(contents);
+	return;
+
+invalid:
+	g_warning("[Telephony:SMS] Ignoring invalid duplicate detection state in %s", dedup->path);
+	g_free(contents);
+}
+
+static void write_to_file(struct sms_dedup *dedup)
+{
+	struct sms_dedup_file_header *header;
+	guint64 *entries;
+	gchar *contents;
+	gsize length;
+	unsigned int first, n;
+	GError *error = NULL;
+
+	length = sizeof(*header) + dedup->count * sizeof(guint64);
+	contents = g_malloc(length);
+
+	header = (struct sms_dedup_file_header*) contents;
+	header->magic = SMS_DEDUP_FILE_MAGIC;
+	header->size = dedup->size;
+	header->count = dedup->count;
+	header->hits = dedup->hits;
+
+	/* store entries from the oldest to the newest one */
+	entries = (guint64*) (contents + sizeof(*header));
+	first = (dedup->head + dedup->size - dedup->count) % dedup->size;
+	for (n = 0; n < dedup->count; n++)
+		entries[n] = dedup->ring[(first + n) % dedup->size];
+
+	if (!utils_write_private_file(dedup->path, contents, length, &error)) {
+		g_warning("[Telephony:SMS] Failed to store duplicate detection state: %s", error->message);
+		g_error_free(error);
+	}
+	else {
+		dedup->dirty = false;
+	}
+
+	g_free(contents);
+}
+
+static gboolean flush_timeout_cb(gpointer user_data)
+{
+	struct sms_dedup *dedup = user_data;
+
+	dedup->flush_timeout = 0;
+	write_to_file(dedup);
+
+	return FALSE;
+}
+
+static void schedule_flush(struct sms_dedup *dedup)
+{
+	if (!dedup->path)
+		return;
+
+	dedup->dirty = true;
+
+	if (dedup->flush_timeout)
+		g_source_remove(dedup->flush_timeout);
+
+	dedup->flush_timeout = g_timeout_add_seconds(SMS_DEDUP_FLUSH_DELAY_SECONDS, flush_timeout_cb, dedup);
+}
+
+struct sms_dedup* sms_dedup_create(const char *path, unsigned int size)
+{
+	struct sms_dedup *dedup;
+
+	if (size == 0)
+		return NULL;
+
+	dedup = g_try_new0(struct sms_dedup, 1);
+	if (!dedup)
+		return NULL;
+
+	dedup->path = g_strdup(path);
+	dedup->size = size;
+	dedup->ring = g_new0(guint64, size);
+	dedup->seen = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+	if (dedup->path)
+		load_from_file(dedup);
+
+	return dedup;
+}
+
+void sms_dedup_free(struct sms_dedup *dedup)
+{
+	if (!dedup)
+		return;
+
+	if (dedup->flush_timeout)
+		g_source_remove(dedup->flush_timeout);
+
+	if (dedup->dirty && dedup->path)
+		write_to_file(dedup);
+
+	g_hash_table_destroy(dedup->seen);
+	g_free(dedup->ring);
+	g_free(dedup->path);
+	g_free(dedup);
+}
+
+/**
+ * Checks wether we've seen a message with the same sender, sent time and text
+ * recently. Returns true if the message is a duplicate; otherwise the message
+ * is remembered and false is returned.
+ */
+bool sms_dedup_check_and_add(struct sms_dedup *dedup, const char *sender, time_t sent_time,
+							 const char *text)
+{
+	guint64 fingerprint;
+
+	if (!dedup)
+		return false;
+
+	fingerprint = message_fingerprint(sender, sent_time, text);
+
+	if (g_hash_table_contains(dedup->seen, &fingerprint)) {
+		dedup->hits++;
+		schedule_flush(dedup);
+		return true;
+	}
+
+	add_fingerprint(dedup, fingerprint);
+	schedule_flush(dedup);
+
+	return false;
+}
+
+unsigned int sms_dedup_get_hits(struct sms_dedup *dedup)
+{
+	if (!dedup)
+		return 0;
+
+	return dedup->hits;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,36 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SMS_DEDUP_H_
+#define SMS_DEDUP_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+struct sms_dedup;
+
+struct sms_dedup* sms_dedup_create(const char *path, unsigned int size);
+void sms_dedup_free(struct sms_dedup *dedup);
+
+bool sms_dedup_check_and_add(struct sms_dedup *dedup, const char *sender, time_t sent_time,
+							 const char *text);
+unsigned int sms_dedup_get_hits(struct sms_dedup *dedup);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,266 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "smsencoding.h"
+
+/* Limits as defined by 3GPP TS 23.040; messages which need more than one
+ * segment lose some room per segment to the concatenation header */
+#define GSM7_SINGLE_SEGMENT_SEPTETS		160
+#define GSM7_MULTI_SEGMENT_SEPTETS		153
+#define UCS2_SINGLE_SEGMENT_UNITS		70
+#define UCS2_MULTI_SEGMENT_UNITS		67
+
+/* Septets needed for a character in the GSM 7-bit default alphabet: 1 for the
+ * default table, 2 for the extension table (escape + character) and 0 if it
+ * can't be represented at all. */
+static const uint8_t ascii_septets[128] = {
+	[0x0a] = 1, [0x0c] = 2, [0x0d] = 1,
+	[0x20] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x20 - 0x2f */
+	[0x30] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x30 - 0x3f */
+	[0x40] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x40 - 0x4f */
+	[0x50] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 1,	/* 0x50 - 0x5f */
+	[0x60] = 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x60 - 0x6f */
+	[0x70] = 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 0,	/* 0x70 - 0x7f */
+};
+
+static unsigned int gsm7_septets(uint32_t cp)
+{
+	if (cp < 0x80)
+		return ascii_septets[cp];
+
+	switch (cp) {
+	case 0xa1: case 0xa3: case 0xa4: case 0xa5: case 0xa7: case 0xbf:
+	case 0xc4: case 0xc5: case 0xc6: case 0xc7: case 0xc9: case 0xd1:
+	case 0xd6: case 0xd8: case 0xdc: case 0xdf: case 0xe0: case 0xe4:
+	case 0xe5: case 0xe6: case 0xe8: case 0xe9: case 0xec: case 0xf1:
+	case 0xf2: case 0xf6: case 0xf8: case 0xf9: case 0xfc:
+	case 0x393: case 0x394: case 0x398: case 0x39b: case 0x39e: case 0x3a0:
+	case 0x3a3: case 0x3a6: case 0x3a8: case 0x3a9:
+		return 1;
+	case 0x20ac:
+		return 2;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+struct segment_packer {
+	unsigned int limit;
+	unsigned int segments;
+	unsigned int fill;
+};
+
+/* Adds a character which takes units and must not be split between segments */
+static inline void packer_add(struct segment_packer *packer, unsigned int units)
+{
+	if (packer->fill + units > packer->limit) {
+		packer->segments++;
+		packer->fill = 0;
+	}
+
+	packer->fill += units;
+}
+
+/* Adds a run of characters which take one unit each */
+static inline void packer_add_run(struct segment_packer *packer, unsigned int count)
+{
+	packer->fill += count;
+
+	while (packer->fill > packer->limit) {
+		packer->segments++;
+		packer->fill -= packer->limit;
+	}
+}
+
+static inline unsigned int packer_count(struct segment_packer *packer)
+{
+	return packer->segments + (packer->fill > 0 ? 1 : 0);
+}
+
+/* Returns the length of the valid UTF-8 sequence at str or 0 if it's invalid */
+static size_t decode_utf8(const unsigned char *str, size_t length, uint32_t *cp)
+{
+	uint32_t c = str[0];
+
+	if (c < 0x80) {
+		*cp = c;
+		return 1;
+	}
+
+	if (c >= 0xc2 && c <= 0xdf) {
+		if (length < 2 || (str[1] & 0xc0) != 0x80)
+			return 0;
+		*cp = ((c & 0x1f) << 6) | (str[1] & 0x3f);
+		return 2;
+	}
+
+	if (c >= 0xe0 && c <= 0xef) {
+		if (length < 3 || (str[1] & 0xc0) != 0x80 || (str[2] & 0xc0) != 0x80)
+			return 0;
+		*cp = ((c & 0x0f) << 12) | ((str[1] & 0x3f) << 6) | (str[2] & 0x3f);
+		/* reject overlong encodings and surrogates */
+		if (*cp < 0x800 || (*cp >= 0xd800 && *cp <= 0xdfff))
+			return 0;
+		return 3;
+	}
+
+	if (c >= 0xf0 && c <= 0xf4) {
+		if (length < 4 || (str[1] & 0xc0) != 0x80 || (str[2] & 0xc0) != 0x80 ||
+			(str[3] & 0xc0) != 0x80)
+			return 0;
+		*cp = ((c & 0x07) << 18) | ((str[1] & 0x3f) << 12) | ((str[2] & 0x3f) << 6) | (str[3] & 0x3f);
+		if (*cp < 0x10000 || *cp > 0x10ffff)
+			return 0;
+		return 4;
+	}
+
+	return 0;
+}
+
+/* Returns true if all 16 bytes at str are printable ASCII characters which are
+ * part of the GSM 7-bit default table, i.e. 0x20 - 0x7a without [\]^ and `.
+ * Those take a single septet and a single UCS-2 unit each. */
+#if defined(__SSE2__)
+static inline bool is_plain_block(const unsigned char *str)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*) str);
+	/* signed compares: bytes >= 0x80 are negative and fail the first check */
+	__m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+							   _mm_cmplt_epi8(v, _mm_set1_epi8(0x7b)));
+	__m128i brackets = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x5a)),
+									 _mm_cmplt_epi8(v, _mm_set1_epi8(0x5f)));
+	__m128i bad = _mm_or_si128(brackets, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x60)));
+
+	return _mm_movemask_epi8(_mm_andnot_si128(bad, ok)) == 0xffff;
+}
+#define HAVE_PLAIN_BLOCK_SCAN 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline bool is_plain_block(const unsigned char *str)
+{
+	uint8x16_t v = vld1q_u8(str);
+	uint8x16_t ok = vandq_u8(vcgeq_u8(v, vdupq_n_u8(0x20)), vcltq_u8(v, vdupq_n_u8(0x7b)));
+	uint8x16_t brackets = vandq_u8(vcgeq_u8(v, vdupq_n_u8(0x5b)), vcleq_u8(v, vdupq_n_u8(0x5e)));
+	uint8x16_t bad = vorrq_u8(brackets, vceqq_u8(v, vdupq_n_u8(0x60)));
+
+	ok = vbicq_u8(ok, bad);
+
+#if defined(__aarch64__)
+	return vminvq_u8(ok) == 0xff;
+#else
+	uint8x8_t m = vpmin_u8(vget_low_u8(ok), vget_high_u8(ok));
+	m = vpmin_u8(m, m);
+	m = vpmin_u8(m, m);
+	m = vpmin_u8(m, m);
+	return vget_lane_u8(m, 0) == 0xff;
+#endif
+}
+#define HAVE_PLAIN_BLOCK_SCAN 1
+#endif
+
+/**
+ * Validates the UTF-8 text and determines the encoding an outgoing message
+ * will be sent with and how many segments it takes. Returns false if the text
+ * is not valid UTF-8.
+ */
+bool sms_analyze_text(const char *text, size_t length, struct sms_segment_info *info)
+{
+	const unsigned char *str = (const unsigned char*) text;
+	struct segment_packer gsm7 = { .limit = GSM7_MULTI_SEGMENT_SEPTETS };
+	struct segment_packer ucs2 = { .limit = UCS2_MULTI_SEGMENT_UNITS };
+	unsigned int septets = 0, units = 0, cp_septets, cp_units;
+	bool gsm7_ok = true;
+	size_t pos = 0, n;
+	uint32_t cp;
+
+	if (!text || !info)
+		return false;
+
+	while (pos < length) {
+#ifdef HAVE_PLAIN_BLOCK_SCAN
+		if (length - pos >= 16 && is_plain_block(str + pos)) {
+			septets += 16;
+			units += 16;
+			packer_add_run(&gsm7, 16);
+			packer_add_run(&ucs2, 16);
+			pos += 16;
+			continue;
+		}
+#endif
+
+		n = decode_utf8(str + pos, length - pos, &cp);
+		if (n == 0)
+			return false;
+
+		pos += n;
+
+		cp_units = cp >= 0x10000 ? 2 : 1;
+		units += cp_units;
+		packer_add(&ucs2, cp_units);
+
+		if (gsm7_ok) {
+			cp_septets = gsm7_septets(cp);
+			if (cp_septets == 0) {
+				gsm7_ok = false;
+				continue;
+			}
+
+			septets += cp_septets;
+			packer_add(&gsm7, cp_septets);
+		}
+	}
+
+	if (gsm7_ok) {
+		info->encoding = SMS_ENCODING_GSM7;
+		info->units = septets;
+		info->segments = septets <= GSM7_SINGLE_SEGMENT_SEPTETS ? 1 : packer_count(&gsm7);
+	}
+	else {
+		info->encoding = SMS_ENCODING_UCS2;
+		info->units = units;
+		info->segments = units <= UCS2_SINGLE_SEGMENT_UNITS ? 1 : packer_count(&ucs2);
+	}
+
+	return true;
+}
+
+const char* sms_encoding_to_string(enum sms_encoding encoding)
+{
+	switch (encoding) {
+	case SMS_ENCODING_GSM7:
+		return "gsm7";
+	case SMS_ENCODING_UCS2:
+		return "ucs2";
+	default:
+		break;
+	}
+
+	return "unknown";
+}
+
+// vim:ts=4:sw=4:noexpandtab
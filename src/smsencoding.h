@@ -0,0 +1,42 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SMS_ENCODING_H_
+#define SMS_ENCODING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum sms_encoding {
+	SMS_ENCODING_GSM7 = 0,
+	SMS_ENCODING_UCS2,
+};
+
+struct sms_segment_info {
+	enum sms_encoding encoding;
+	/* septets for GSM 7-bit, UTF-16 code units for UCS-2 */
+	unsigned int units;
+	unsigned int segments;
+};
+
+bool sms_analyze_text(const char *text, size_t length, struct sms_segment_info *info);
+const char* sms_encoding_to_string(enum sms_encoding encoding);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,637 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "smsjournal.h"
+
+#define SMS_JOURNAL_MAGIC			0x314a5453 /* "STJ1" */
+#define SMS_JOURNAL_MIN_SIZE		(64 * 1024)
+
+#define ALIGN8(x)	(((x) + 7) & ~((gsize) 7))
+
+/* The journal is an append-only sequence of records following the file header.
+ * The file is preallocated with zeros; a record only becomes visible once its
+ * type is written, which happens after the payload is in place, so a crash in
+ * the middle of an append leaves a zero type which marks the end of the
+ * journal on the next start. */
+enum journal_record_type {
+	JOURNAL_RECORD_END = 0,
+	/* segments, inhibit flag, number of recipients, id, text, recipients */
+	JOURNAL_RECORD_QUEUED,
+	/* number of recipients delivered so far, id */
+	JOURNAL_RECORD_DELIVERED,
+	/* id */
+	JOURNAL_RECORD_DONE,
+	/* number of failed attempts so far, id */
+	JOURNAL_RECORD_ATTEMPTED,
+};
+
+struct journal_file_header {
+	guint32 magic;
+	guint32 reserved;
+};
+
+struct journal_record {
+	guint32 type;
+	guint32 length;
+};
+
+struct sms_journal {
+	gchar *path;
+	int fd;
+	guchar *base;
+	gsize size;
+	gsize offset;
+	/* pending entries in the order they were queued and indexed by their id */
+	GList *pending;
+	GHashTable *entries;
+};
+
+static void free_entry(struct sms_journal_entry *entry)
+{
+	if (!entry)
+		return;
+
+	g_free(entry->id);
+	g_free(entry->text);
+	g_strfreev(entry->to);
+	g_free(entry);
+}
+
+static void add_entry(struct sms_journal *journal, struct sms_journal_entry *entry)
+{
+	struct sms_journal_entry *old;
+
+	old = g_hash_table_lookup(journal->entries, entry->id);
+	if (old) {
+		journal->pending = g_list_remove(journal->pending, old);
+		g_hash_table_remove(journal->entries, old->id);
+		free_entry(old);
+	}
+
+	journal->pending = g_list_append(journal->pending, entry);
+	g_hash_table_insert(journal->entries, entry->id, entry);
+}
+
+static void remove_entry(struct sms_journal *journal, const char *id)
+{
+	struct sms_journal_entry *entry;
+
+	entry = g_hash_table_lookup(journal->entries, id);
+	if (!entry)
+		return;
+
+	journal->pending = g_list_remove(journal->pending, entry);
+	g_hash_table_remove(journal->entries, id);
+	free_entry(entry);
+}
+
+struct payload_reader {
+	const guchar *data;
+	gsize length;
+	gsize pos;
+};
+
+static bool read_u32(struct payload_reader *reader, guint32 *value)
+{
+	if (reader->length - reader->pos < sizeof(guint32))
+		return false;
+
+	memcpy(value, reader->data + reader->pos, sizeof(guint32));
+	reader->pos += sizeof(guint32);
+
+	return true;
+}
+
+static const char* read_string(struct payload_reader *reader)
+{
+	const guchar *str = reader->data + reader->pos;
+	const guchar *end;
+
+	end = memchr(str, '\0', reader->length - reader->pos);
+	if (!end)
+		return NULL;
+
+	reader->pos += end - str + 1;
+
+	return (const char*) str;
+}
+
+static bool replay_record(struct sms_journal *journal, guint32 type, const guchar *data, gsize length)
+{
+	struct payload_reader reader = { .data = data, .length = length, .pos = 0 };
+	struct sms_journal_entry *entry;
+	guint32 segments, inhibit, count, delivered, attempts, n;
+	const char *id, *text, *to;
+
+	switch (type) {
+	case JOURNAL_RECORD_QUEUED:
+		if (!read_u32(&reader, &segments) || !read_u32(&reader, &inhibit) ||
+			!read_u32(&reader, &count) || count > length)
+			return false;
+
+		if (!(id = read_string(&reader)) || !(text = read_string(&reader)))
+			return false;
+
+		entry = g_new0(struct sms_journal_entry, 1);
+		entry->to = g_new0(gchar*, count + 1);
+
+		for (n = 0; n < count; n++) {
+			if (!(to = read_string(&reader))) {
+				free_entry(entry);
+				return false;
+			}
+			entry->to[n] = g_strdup(to);
+		}
+
+		entry->id = g_strdup(id);
+		entry->text = g_strdup(text);
+		entry->segments = segments;
+		entry->inhibit_network_send = (inhibit != 0);
+
+		add_entry(journal, entry);
+		break;
+	case JOURNAL_RECORD_DELIVERED:
+		if (!read_u32(&reader, &delivered) || !(id = read_string(&reader)))
+			return false;
+
+		entry = g_hash_table_lookup(journal->entries, id);
+		if (entry && delivered <= g_strv_length(entry->to))
+			entry->delivered = delivered;
+		break;
+	case JOURNAL_RECORD_DONE:
+		if (!(id = read_string(&reader)))
+			return false;
+
+		remove_entry(journal, id);
+		break;
+	case JOURNAL_RECORD_ATTEMPTED:
+		if (!read_u32(&reader, &attempts) || !(id = read_string(&reader)))
+			return false;
+
+		entry = g_hash_table_lookup(journal->entries, id);
+		if (entry)
+			entry->attempts = attempts;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static void replay(struct sms_journal *journal)
+{
+	struct journal_record *record;
+	gsize offset = sizeof(struct journal_file_header);
+
+	while (offset + sizeof(struct journal_record) <= journal->size) {
+		record = (struct journal_record*) (journal->base + offset);
+
+		if (record->type == JOURNAL_RECORD_END)
+			break;
+
+		/* the record is followed by padding which has to fit as well; a
+		 * truncated file can end in the middle of it */
+		if (record->length > journal->size - offset - sizeof(struct journal_record) ||
+			ALIGN8(record->length) > journal->size - offset - sizeof(struct journal_record) ||
+			!replay_record(journal, record->type, journal->base + offset + sizeof(struct journal_record),
+						   record->length)) {
+			g_warning("[Telephony:SMS] Journal is corrupted at offset %zu; ignoring the rest", offset);
+			break;
+		}
+
+		offset += sizeof(struct journal_record) + ALIGN8(record->length);
+	}
+
+	/* make sure everything behind the last valid record reads as end marker */
+	memset(journal->base + offset, 0, journal->size - offset);
+	journal->offset = offset;
+}
+
+static bool map_file(struct sms_journal *journal, int fd, gsize size)
+{
+	void *base;
+
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		g_warning("[Telephony:SMS] Failed to map journal: %s", strerror(errno));
+		return false;
+	}
+
+	if (journal->base)
+		munmap(journal->base, journal->size);
+	if (journal->fd >= 0 && journal->fd != fd)
+		close(journal->fd);
+
+	journal->fd = fd;
+	journal->base = base;
+	journal->size = size;
+
+	return true;
+}
+
+static int create_file(const char *path, gsize size)
+{
+	struct journal_file_header header = { .magic = SMS_JOURNAL_MAGIC };
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+
+	if (ftruncate(fd, size) < 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+struct sms_journal* sms_journal_open(const char *path)
+{
+	struct sms_journal *journal;
+	struct journal_file_header *header;
+	struct stat st;
+	gchar *dirname;
+	int fd;
+
+	journal = g_try_new0(struct sms_journal, 1);
+	if (!journal)
+		return NULL;
+
+	journal->fd = -1;
+	journal->path = g_strdup(path);
+	journal->entries = g_hash_table_new(g_str_hash, g_str_equal);
+
+	dirname = g_path_get_dirname(path);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd >= 0 && (fstat(fd, &st) < 0 || st.st_size < SMS_JOURNAL_MIN_SIZE)) {
+		close(fd);
+		fd = -1;
+	}
+
+	if (fd < 0) {
+		fd = create_file(path, SMS_JOURNAL_MIN_SIZE);
+		if (fd < 0)
+			goto failed;
+		st.st_size = SMS_JOURNAL_MIN_SIZE;
+	}
+
+	if (!map_file(journal, fd, st.st_size)) {
+		close(fd);
+		goto failed;
+	}
+
+	header = (struct journal_file_header*) journal->base;
+	if (header->magic != SMS_JOURNAL_MAGIC) {
+		g_warning("[Telephony:SMS] Ignoring journal with unknown format");
+		memset(journal->base, 0, journal->size);
+		header->magic = SMS_JOURNAL_MAGIC;
+	}
+
+	replay(journal);
+
+	g_message("[Telephony:SMS] Journal has %u pending messages", g_list_length(journal->pending));
+
+	return journal;
+
+failed:
+	g_warning("[Telephony:SMS] Failed to open journal %s: %s", path, strerror(errno));
+	g_hash_table_destroy(journal->entries);
+	g_free(journal->path);
+	g_free(journal);
+	return NULL;
+}
+
+void sms_journal_close(struct sms_journal *journal)
+{
+	if (!journal)
+		return;
+
+	if (journal->base) {
+		msync(journal->base, journal->size, MS_SYNC);
+		munmap(journal->base, journal->size);
+	}
+
+	if (journal->fd >= 0)
+		close(journal->fd);
+
+	g_list_free_full(journal->pending, (GDestroyNotify) free_entry);
+	g_hash_table_destroy(journal->entries);
+	g_free(journal->path);
+	g_free(journal);
+}
+
+static gsize record_size(gsize length)
+{
+	return sizeof(struct journal_record) + ALIGN8(length);
+}
+
+static void write_record(guchar *base, gsize offset, guint32 type, const GByteArray *payload)
+{
+	struct journal_record *record = (struct journal_record*) (base + offset);
+
+	memcpy(base + offset + sizeof(struct journal_record), payload->data, payload->len);
+	record->length = payload->len;
+
+	/* the type makes the record visible so it has to come last */
+	__atomic_store_n(&record->type, type, __ATOMIC_RELEASE);
+}
+
+static void append_u32(GByteArray *payload, guint32 value)
+{
+	g_byte_array_append(payload, (const guint8*) &value, sizeof(value));
+}
+
+static void append_string(GByteArray *payload, const char *str)
+{
+	g_byte_array_append(payload, (const guint8*) str, strlen(str) + 1);
+}
+
+static GByteArray* build_queued_payload(const char *id, const char *text, gchar **to,
+										bool inhibit_network_send, unsigned int segments)
+{
+	GByteArray *payload;
+	unsigned int n;
+
+	payload = g_byte_array_new();
+	append_u32(payload, segments);
+	append_u32(payload, inhibit_network_send ? 1 : 0);
+	append_u32(payload, g_strv_length(to));
+	append_string(payload, id);
+	append_string(payload, text);
+
+	for (n = 0; to[n] != NULL; n++)
+		append_string(payload, to[n]);
+
+	return payload;
+}
+
+/* Payload of the records which update a counter of an entry */
+static GByteArray* build_counter_payload(const char *id, unsigned int value)
+{
+	GByteArray *payload;
+
+	payload = g_byte_array_new();
+	append_u32(payload, value);
+	append_string(payload, id);
+
+	return payload;
+}
+
+/* Rewrites the journal with only the pending entries into a new file which then
+ * atomically replaces the old one. At least extra bytes are left for further
+ * records. */
+static bool rewrite(struct sms_journal *journal, gsize extra)
+{
+	struct sms_journal_entry *entry;
+	GPtrArray *payloads;
+	GArray *types;
+	GByteArray *payload;
+	gchar *tmp_path;
+	guchar *base;
+	gsize size, needed, offset;
+	guint32 type;
+	const GList *iter;
+	unsigned int n;
+	int fd;
+
+	payloads = g_ptr_array_new_with_free_func((GDestroyNotify) g_byte_array_unref);
+	types = g_array_new(FALSE, FALSE, sizeof(guint32));
+	needed = sizeof(struct journal_file_header) + sizeof(struct journal_record) + extra;
+
+	for (iter = journal->pending; iter != NULL; iter = g_list_next(iter)) {
+		entry = iter->data;
+
+		payload = build_queued_payload(entry->id, entry->text, entry->to,
+									   entry->inhibit_network_send, entry->segments);
+		type = JOURNAL_RECORD_QUEUED;
+		needed += record_size(payload->len);
+		g_ptr_array_add(payloads, payload);
+		g_array_append_val(types, type);
+
+		if (entry->delivered > 0) {
+			payload = build_counter_payload(entry->id, entry->delivered);
+			type = JOURNAL_RECORD_DELIVERED;
+			needed += record_size(payload->len);
+			g_ptr_array_add(payloads, payload);
+			g_array_append_val(types, type);
+		}
+
+		if (entry->attempts > 0) {
+			payload = build_counter_payload(entry->id, entry->attempts);
+			type = JOURNAL_RECORD_ATTEMPTED;
+			needed += record_size(payload->len);
+			g_ptr_array_add(payloads, payload);
+			g_array_append_val(types, type);
+		}
+	}
+
+	/* keep some room so we don't have to rewrite again right away */
+	size = SMS_JOURNAL_MIN_SIZE;
+	while (size < needed * 2)
+		size *= 2;
+
+	tmp_path = g_strdup_printf("%s.tmp", journal->path);
+
+	fd = create_file(tmp_path, size);
+	if (fd < 0)
+		goto failed;
+
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		goto failed;
+	}
+
+	offset = sizeof(struct journal_file_header);
+	for (n = 0; n < payloads->len; n++) {
+		payload = g_ptr_array_index(payloads, n);
+		write_record(base, offset, g_array_index(types, guint32, n), payload);
+		offset += record_size(payload->len);
+	}
+
+	msync(base, size, MS_SYNC);
+	munmap(base, size);
+
+	if (g_rename(tmp_path, journal->path) < 0 || !map_file(journal, fd, size)) {
+		close(fd);
+		goto failed;
+	}
+
+	journal->offset = offset;
+
+	g_free(tmp_path);
+	g_ptr_array_free(payloads, TRUE);
+	g_array_free(types, TRUE);
+	return true;
+
+failed:
+	g_warning("[Telephony:SMS] Failed to rewrite journal: %s", strerror(errno));
+	g_unlink(tmp_path);
+	g_free(tmp_path);
+	g_ptr_array_free(payloads, TRUE);
+	g_array_free(types, TRUE);
+	return false;
+}
+
+static void append(struct sms_journal *journal, guint32 type, GByteArray *payload)
+{
+	gsize needed = record_size(payload->len) + sizeof(struct journal_record);
+
+	if (journal->offset + needed > journal->size && !rewrite(journal, needed)) {
+		g_warning("[Telephony:SMS] Journal is full; dropping record");
+		return;
+	}
+
+	write_record(journal->base, journal->offset, type, payload);
+	journal->offset += record_size(payload->len);
+}
+
+const GList* sms_journal_get_pending(struct sms_journal *journal)
+{
+	if (!journal)
+		return NULL;
+
+	return journal->pending;
+}
+
+bool sms_journal_contains(struct sms_journal *journal, const char *id)
+{
+	if (!journal)
+		return false;
+
+	return g_hash_table_contains(journal->entries, id);
+}
+
+void sms_journal_queued(struct sms_journal *journal, const char *id, GQueue *to, const char *text,
+						bool inhibit_network_send, unsigned int segments)
+{
+	struct sms_journal_entry *entry;
+	GByteArray *payload;
+	GList *iter;
+	unsigned int n = 0;
+
+	if (!journal)
+		return;
+
+	entry = g_new0(struct sms_journal_entry, 1);
+	entry->id = g_strdup(id);
+	entry->text = g_strdup(text);
+	entry->inhibit_network_send = inhibit_network_send;
+	entry->segments = segments;
+	entry->to = g_new0(gchar*, g_queue_get_length(to) + 1);
+
+	for (iter = to->head; iter != NULL; iter = g_list_next(iter))
+		entry->to[n++] = g_strdup(iter->data);
+
+	payload = build_queued_payload(entry->id, entry->text, entry->to, inhibit_network_send, segments);
+	append(journal, JOURNAL_RECORD_QUEUED, payload);
+	g_byte_array_unref(payload);
+
+	add_entry(journal, entry);
+}
+
+void sms_journal_delivered(struct sms_journal *journal, const char *id, unsigned int delivered)
+{
+	struct sms_journal_entry *entry;
+	GByteArray *payload;
+
+	if (!journal)
+		return;
+
+	entry = g_hash_table_lookup(journal->entries, id);
+	if (!entry)
+		return;
+
+	entry->delivered = delivered;
+
+	payload = build_counter_payload(id, delivered);
+	append(journal, JOURNAL_RECORD_DELIVERED, payload);
+	g_byte_array_unref(payload);
+}
+
+void sms_journal_attempted(struct sms_journal *journal, const char *id, unsigned int attempts)
+{
+	struct sms_journal_entry *entry;
+	GByteArray *payload;
+
+	if (!journal)
+		return;
+
+	entry = g_hash_table_lookup(journal->entries, id);
+	if (!entry)
+		return;
+
+	entry->attempts = attempts;
+
+	payload = build_counter_payload(id, attempts);
+	append(journal, JOURNAL_RECORD_ATTEMPTED, payload);
+	g_byte_array_unref(payload);
+}
+
+void sms_journal_done(struct sms_journal *journal, const char *id)
+{
+	GByteArray *payload;
+
+	if (!journal || !g_hash_table_contains(journal->entries, id))
+		return;
+
+	payload = g_byte_array_new();
+	append_string(payload, id);
+	append(journal, JOURNAL_RECORD_DONE, payload);
+	g_byte_array_unref(payload);
+
+	remove_entry(journal, id);
+}
+
+/**
+ * Drops all records of messages which are done. Meant to be called when the
+ * TX queue is idle.
+ */
+void sms_journal_compact(struct sms_journal *journal)
+{
+	if (!journal || journal->offset == sizeof(struct journal_file_header))
+		return;
+
+	if (!journal->pending && journal->size == SMS_JOURNAL_MIN_SIZE) {
+		/* nothing pending: just start over in the existing file. Zeroing goes
+		 * front to back so the first record disappears first. */
+		memset(journal->base + sizeof(struct journal_file_header), 0,
+			   journal->offset - sizeof(struct journal_file_header));
+		journal->offset = sizeof(struct journal_file_header);
+		msync(journal->base, journal->size, MS_ASYNC);
+		return;
+	}
+
+	rewrite(journal, 0);
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,55 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SMS_JOURNAL_H_
+#define SMS_JOURNAL_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+struct sms_journal;
+
+struct sms_journal_entry {
+	gchar *id;
+	gchar *text;
+	/* all recipients; the first delivered ones already got the message */
+	gchar **to;
+	unsigned int delivered;
+	bool inhibit_network_send;
+	unsigned int segments;
+	/* failed attempts to send it so far */
+	unsigned int attempts;
+};
+
+struct sms_journal* sms_journal_open(const char *path);
+void sms_journal_close(struct sms_journal *journal);
+
+const GList* sms_journal_get_pending(struct sms_journal *journal);
+bool sms_journal_contains(struct sms_journal *journal, const char *id);
+
+void sms_journal_queued(struct sms_journal *journal, const char *id, GQueue *to, const char *text,
+						bool inhibit_network_send, unsigned int segments);
+void sms_journal_delivered(struct sms_journal *journal, const char *id, unsigned int delivered);
+void sms_journal_attempted(struct sms_journal *journal, const char *id, unsigned int attempts);
+void sms_journal_done(struct sms_journal *journal, const char *id);
+
+void sms_journal_compact(struct sms_journal *journal);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,255 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <glib.h>
+
+#include "smstxqueue.h"
+
+/* Each class gets a share of the air time proportional to its quantum. The
+ * cost of a message is the number of segments it takes on the air so a few
+ * long bulk messages can't crowd out short interactive ones either. */
+static const int priority_quantum[SMS_PRIORITY_MAX] = {
+	[SMS_PRIORITY_INTERACTIVE] = 8,
+	[SMS_PRIORITY_RETRY] = 3,
+	[SMS_PRIORITY_BULK] = 1,
+};
+
+static const char *priority_names[SMS_PRIORITY_MAX] = {
+	[SMS_PRIORITY_INTERACTIVE] = "interactive",
+	[SMS_PRIORITY_RETRY] = "retry",
+	[SMS_PRIORITY_BULK] = "bulk",
+};
+
+struct sms_tx_queue_entry {
+	gpointer item;
+	unsigned int cost;
+};
+
+/* Deficit round robin over a fixed number of classes: selecting the next
+ * message only looks at the head of each class so it doesn't depend on the
+ * number of queued messages. */
+struct sms_tx_queue {
+	GQueue *classes[SMS_PRIORITY_MAX];
+	int deficit[SMS_PRIORITY_MAX];
+	unsigned int current;
+	bool quantum_granted;
+	unsigned int length;
+};
+
+struct sms_tx_queue* sms_tx_queue_new(void)
+{
+	struct sms_tx_queue *queue;
+	int n;
+
+	queue = g_new0(struct sms_tx_queue, 1);
+
+	for (n = 0; n < SMS_PRIORITY_MAX; n++)
+		queue->classes[n] = g_queue_new();
+
+	return queue;
+}
+
+void sms_tx_queue_free(struct sms_tx_queue *queue, GDestroyNotify free_func)
+{
+	struct sms_tx_queue_entry *entry;
+	int n;
+
+	if (!queue)
+		return;
+
+	for (n = 0; n < SMS_PRIORITY_MAX; n++) {
+		while ((entry = g_queue_pop_head(queue->classes[n])) != NULL) {
+			if (free_func)
+				free_func(entry->item);
+			g_free(entry);
+		}
+
+		g_queue_free(queue->classes[n]);
+	}
+
+	g_free(queue);
+}
+
+void sms_tx_queue_push(struct sms_tx_queue *queue, enum sms_priority priority,
+					   gpointer item, unsigned int cost)
+{
+	struct sms_tx_queue_entry *entry;
+
+	if (priority >= SMS_PRIORITY_MAX)
+		priority = SMS_PRIORITY_BULK;
+
+	entry = g_new0(struct sms_tx_queue_entry, 1);
+	entry->item = item;
+	entry->cost = cost > 0 ? cost : 1;
+
+	g_queue_push_tail(queue->classes[priority], entry);
+	queue->length++;
+}
+
+/* Number of quanta the class still needs before it can afford its head */
+static unsigned int quanta_needed(struct sms_tx_queue *queue, unsigned int class, unsigned int cost)
+{
+	int missing = (int) cost - queue->deficit[class];
+
+	if (missing <= 0)
+		return 0;
+
+	return (missing + priority_quantum[class] - 1) / priority_quantum[class];
+}
+
+/* Picks the class which can send next. Instead of going round after round
+ * until some class saved up enough for its head we compute how many rounds
+ * each class needs and credit the quanta of all those rounds at once; with a
+ * fixed number of classes this takes constant time. */
+static unsigned int select_class(struct sms_tx_queue *queue)
+{
+	struct sms_tx_queue_entry *entry;
+	unsigned int current = queue->current;
+	unsigned int rounds, best_rounds = 0;
+	unsigned int n, class, best = current;
+	bool found = false;
+
+	entry = g_queue_peek_head(queue->classes[current]);
+	if (entry) {
+		if (!queue->quantum_granted) {
+			queue->deficit[current] += priority_quantum[current];
+			queue->quantum_granted = true;
+		}
+
+		if ((unsigned int) queue->deficit[current] >= entry->cost)
+			return current;
+	}
+	else {
+		/* an idle class doesn't get to save up credit */
+		queue->deficit[current] = 0;
+	}
+
+	/* Visit the classes in the order the round robin would, the current one
+	 * last. A class gets its first quantum in round 0, so one needing q quanta
+	 * sends in round q - 1; the first one with the lowest round wins. */
+	for (n = 1; n <= SMS_PRIORITY_MAX; n++) {
+		class = (current + n) % SMS_PRIORITY_MAX;
+		entry = g_queue_peek_head(queue->classes[class]);
+		if (!entry)
+			continue;
+
+		rounds = MAX(quanta_needed(queue, class, entry->cost), 1) - 1;
+		if (!found || rounds < best_rounds) {
+			best = class;
+			best_rounds = rounds;
+			found = true;
+		}
+	}
+
+	/* classes visited before the winner got one more quantum than the ones
+	 * after it */
+	for (n = 1; n <= SMS_PRIORITY_MAX; n++) {
+		class = (current + n) % SMS_PRIORITY_MAX;
+
+		if (g_queue_is_empty(queue->classes[class]))
+			queue->deficit[class] = 0;
+		else
+			queue->deficit[class] += priority_quantum[class] * (best_rounds + 1);
+
+		if (class == best)
+			break;
+	}
+
+	for (n++; n <= SMS_PRIORITY_MAX; n++) {
+		class = (current + n) % SMS_PRIORITY_MAX;
+
+		if (g_queue_is_empty(queue->classes[class]))
+			queue->deficit[class] = 0;
+		else
+			queue->deficit[class] += priority_quantum[class] * best_rounds;
+	}
+
+	queue->current = best;
+	queue->quantum_granted = true;
+
+	return best;
+}
+
+gpointer sms_tx_queue_pop(struct sms_tx_queue *queue, enum sms_priority *priority)
+{
+	struct sms_tx_queue_entry *entry;
+	unsigned int current;
+	gpointer item;
+
+	if (!queue || queue->length == 0)
+		return NULL;
+
+	current = select_class(queue);
+	entry = g_queue_pop_head(queue->classes[current]);
+	queue->deficit[current] -= entry->cost;
+	queue->length--;
+
+	if (g_queue_is_empty(queue->classes[current]))
+		queue->deficit[current] = 0;
+
+	if (priority)
+		*priority = current;
+
+	item = entry->item;
+	g_free(entry);
+
+	return item;
+}
+
+unsigned int sms_tx_queue_get_length(struct sms_tx_queue *queue)
+{
+	return queue ? queue->length : 0;
+}
+
+unsigned int sms_tx_queue_get_class_length(struct sms_tx_queue *queue, enum sms_priority priority)
+{
+	if (!queue || priority >= SMS_PRIORITY_MAX)
+		return 0;
+
+	return g_queue_get_length(queue->classes[priority]);
+}
+
+bool sms_tx_queue_is_empty(struct sms_tx_queue *queue)
+{
+	return sms_tx_queue_get_length(queue) == 0;
+}
+
+enum sms_priority sms_priority_from_string(const char *str, enum sms_priority fallback)
+{
+	int n;
+
+	if (!str)
+		return fallback;
+
+	for (n = 0; n < SMS_PRIORITY_MAX; n++) {
+		if (g_strcmp0(str, priority_names[n]) == 0)
+			return n;
+	}
+
+	return fallback;
+}
+
+const char* sms_priority_to_string(enum sms_priority priority)
+{
+	if (priority >= SMS_PRIORITY_MAX)
+		return "unknown";
+
+	return priority_names[priority];
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,50 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SMS_TX_QUEUE_H_
+#define SMS_TX_QUEUE_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+enum sms_priority {
+	SMS_PRIORITY_INTERACTIVE = 0,
+	SMS_PRIORITY_RETRY,
+	SMS_PRIORITY_BULK,
+	SMS_PRIORITY_MAX
+};
+
+struct sms_tx_queue;
+
+struct sms_tx_queue* sms_tx_queue_new(void);
+void sms_tx_queue_free(struct sms_tx_queue *queue, GDestroyNotify free_func);
+
+void sms_tx_queue_push(struct sms_tx_queue *queue, enum sms_priority priority,
+					   gpointer item, unsigned int cost);
+gpointer sms_tx_queue_pop(struct sms_tx_queue *queue, enum sms_priority *priority);
+
+unsigned int sms_tx_queue_get_length(struct sms_tx_queue *queue);
+unsigned int sms_tx_queue_get_class_length(struct sms_tx_queue *queue, enum sms_priority priority);
+bool sms_tx_queue_is_empty(struct sms_tx_queue *queue);
+
+enum sms_priority sms_priority_from_string(const char *str, enum sms_priority fallback);
+const char* sms_priority_to_string(enum sms_priority priority);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,98 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <glib.h>
+
+#include "startuptimeline.h"
+
+static const char *phase_names[STARTUP_PHASE_MAX] = {
+	[STARTUP_PHASE_PROCESS_START] = "processStart",
+	[STARTUP_PHASE_SERVICE_REGISTERED] = "serviceRegistered",
+	[STARTUP_PHASE_OFONO_APPEARED] = "ofonoAppeared",
+	[STARTUP_PHASE_MODEMS_RETRIEVED] = "modemsRetrieved",
+	[STARTUP_PHASE_MODEM_PROPERTIES] = "modemProperties",
+	[STARTUP_PHASE_MODEM_POWERED] = "modemPowered",
+	[STARTUP_PHASE_SERVICE_CONFIGURED] = "serviceConfigured",
+	[STARTUP_PHASE_MODEM_ONLINE] = "modemOnline",
+	[STARTUP_PHASE_SIM_READY] = "simReady",
+	[STARTUP_PHASE_NETWORK_REGISTERED] = "networkRegistered",
+};
+
+/* monotonic time in microseconds each phase was first reached; zero if not */
+static gint64 phase_times[STARTUP_PHASE_MAX];
+
+const char* startup_phase_to_string(enum startup_phase phase)
+{
+	if (phase >= STARTUP_PHASE_MAX)
+		return NULL;
+
+	return phase_names[phase];
+}
+
+static void log_timeline(void)
+{
+	GString *line;
+	int n;
+
+	line = g_string_new(STARTUP_TIMELINE_LOG_PREFIX);
+
+	for (n = 0; n < STARTUP_PHASE_MAX; n++) {
+		if (phase_times[n] == 0)
+			g_string_append_printf(line, " %s=-", phase_names[n]);
+		else
+			g_string_append_printf(line, " %s=%lld", phase_names[n],
+								   (long long) (phase_times[n] - phase_times[STARTUP_PHASE_PROCESS_START]));
+	}
+
+	g_message("%s", line->str);
+
+	g_string_free(line, TRUE);
+}
+
+/* Only the first time a phase is reached counts; later ones (e.g. after ofono
+ * restarted) are part of normal operation */
+void startup_timeline_mark(enum startup_phase phase)
+{
+	if (phase >= STARTUP_PHASE_MAX || phase_times[phase] != 0)
+		return;
+
+	phase_times[phase] = g_get_monotonic_time();
+
+	if (phase == STARTUP_PHASE_PROCESS_START)
+		return;
+
+	g_debug("Reached startup phase %s after %lld us", phase_names[phase],
+			(long long) (phase_times[phase] - phase_times[STARTUP_PHASE_PROCESS_START]));
+
+	if (phase == STARTUP_PHASE_NETWORK_REGISTERED)
+		log_timeline();
+}
+
+/* Returns the time in microseconds from the process start until the phase was
+ * reached */
+bool startup_timeline_get(enum startup_phase phase, int64_t *offset)
+{
+	if (phase >= STARTUP_PHASE_MAX || phase_times[phase] == 0)
+		return false;
+
+	*offset = phase_times[phase] - phase_times[STARTUP_PHASE_PROCESS_START];
+
+	return true;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,51 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef STARTUP_TIMELINE_H_
+#define STARTUP_TIMELINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Phases in the order we normally go through them when starting up; the
+ * service counts as ready once the network registration is reached. */
+enum startup_phase {
+	STARTUP_PHASE_PROCESS_START = 0,
+	STARTUP_PHASE_SERVICE_REGISTERED,
+	STARTUP_PHASE_OFONO_APPEARED,
+	STARTUP_PHASE_MODEMS_RETRIEVED,
+	STARTUP_PHASE_MODEM_PROPERTIES,
+	STARTUP_PHASE_MODEM_POWERED,
+	STARTUP_PHASE_SERVICE_CONFIGURED,
+	STARTUP_PHASE_MODEM_ONLINE,
+	STARTUP_PHASE_SIM_READY,
+	STARTUP_PHASE_NETWORK_REGISTERED,
+	STARTUP_PHASE_MAX
+};
+
+/* prefix of the log line summarizing the timeline; parsed by
+ * webos-telephonyd-startupbench */
+#define STARTUP_TIMELINE_LOG_PREFIX		"Startup timeline (us):"
+
+void startup_timeline_mark(enum startup_phase phase);
+bool startup_timeline_get(enum startup_phase phase, int64_t *offset);
+const char* startup_phase_to_string(enum startup_phase phase);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,410 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "statecache.h"
+#include "utils.h"
+
+#define STATE_CACHE_FILE_MAGIC			0x31535354 /* "TSS1" */
+/* bump whenever struct state_snapshot changes; older files are ignored then */
+#define STATE_CACHE_FILE_VERSION		2
+
+/* Updates usually come in bursts (e.g. while registering to a network) so we
+ * wait for things to settle before writing */
+#define STATE_CACHE_FLUSH_DELAY_SECONDS	2
+
+#define STATE_CACHE_NAME_SIZE			64
+#define STATE_CACHE_ID_SIZE				24
+
+struct state_cache_file_header {
+	guint32 magic;
+	guint32 version;
+	/* size of the snapshot following the header */
+	guint32 size;
+	/* one bit per enum state_cache_field stored in the snapshot */
+	guint32 valid;
+};
+
+struct state_snapshot {
+	guint8 power;
+	guint8 sim_status;
+	guint8 network_state;
+	guint8 registration;
+	guint8 rat_mode;
+	guint8 platform_type;
+	guint8 subscriber_type;
+	guint8 wan_state;
+	guint8 wan_roam_guard;
+	guint8 wan_network_type;
+	guint8 wan_connection_status;
+	guint8 wan_status;
+	guint8 wan_dataaccess_usable;
+	guint8 wan_network_attached;
+	guint8 wan_disablewan;
+	guint8 reserved;
+	gint32 mcc;
+	gint32 mnc;
+	char network_name[STATE_CACHE_NAME_SIZE];
+	char network_id[8];
+	char imei[STATE_CACHE_ID_SIZE];
+	char carrier[STATE_CACHE_NAME_SIZE];
+	char country[4];
+	char version[STATE_CACHE_NAME_SIZE];
+	/* IMSI/MSISDN or MIN/MDN depending on the subscriber type */
+	char subscriber_id[STATE_CACHE_ID_SIZE];
+	char subscriber_number[STATE_CACHE_ID_SIZE];
+};
+
+static gchar *cache_path = NULL;
+static struct state_snapshot snapshot;
+static guint32 valid_fields = 0;
+/* fields updated since we started; everything else came from the file */
+static guint32 live_fields = 0;
+static guint flush_timeout = 0;
+static bool dirty = false;
+
+#define FIELD_BIT(field)	(1u << (field))
+
+/* strncpy pads with zeros so unchanged fields compare equal */
+static void copy_string(char *dest, size_t size, const char *src)
+{
+	strncpy(dest, src ? src : "", size - 1);
+	dest[size - 1] = '\0';
+}
+
+static void terminate_strings(void)
+{
+	snapshot.network_name[sizeof(snapshot.network_name) - 1] = '\0';
+	snapshot.network_id[sizeof(snapshot.network_id) - 1] = '\0';
+	snapshot.imei[sizeof(snapshot.imei) - 1] = '\0';
+	snapshot.carrier[sizeof(snapshot.carrier) - 1] = '\0';
+	snapshot.country[sizeof(snapshot.country) - 1] = '\0';
+	snapshot.version[sizeof(snapshot.version) - 1] = '\0';
+	snapshot.subscriber_id[sizeof(snapshot.subscriber_id) - 1] = '\0';
+	snapshot.subscriber_number[sizeof(snapshot.subscriber_number) - 1] = '\0';
+}
+
+static void load_from_file(void)
+{
+	struct state_cache_file_header *header;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	if (!g_file_get_contents(cache_path, &contents, &length, NULL))
+		return;
+
+	if (length != sizeof(*header) + sizeof(snapshot))
+		goto invalid;
+
+	header = (struct state_cache_file_header*) contents;
+	if (header->magic != STATE_CACHE_FILE_MAGIC || header->version != STATE_CACHE_FILE_VERSION ||
+		header->size != sizeof(snapshot))
+		goto invalid;
+
+	memcpy(&snapshot, contents + sizeof(*header), sizeof(snapshot));
+	terminate_strings();
+	valid_fields = header->valid & (FIELD_BIT(STATE_CACHE_FIELD_MAX) - 1);
+
+	g_message("Restored last known state from %s", cache_path);
+
+	g_free(contents);
+	return;
+
+invalid:
+	g_warning("Ignoring outdated or invalid state snapshot in %s", cache_path);
+	g_free(contents);
+}
+
+/* The snapshot is written to a temporary file which then gets renamed so a
+ * crash never leaves a half written one behind */
+static void write_to_file(void)
+{
+	struct state_cache_file_header *header;
+	gchar *contents;
+	gsize length;
+	GError *error = NULL;
+
+	length = sizeof(*header) + sizeof(snapshot);
+	contents = g_malloc0(length);
+
+	header = (struct state_cache_file_header*) contents;
+	header->magic = STATE_CACHE_FILE_MAGIC;
+	header->version = STATE_CACHE_FILE_VERSION;
+	header->size = sizeof(snapshot);
+	header->valid = valid_fields;
+
+	memcpy(contents + sizeof(*header), &snapshot, sizeof(snapshot));
+
+	if (!utils_write_private_file(cache_path, contents, length, &error)) {
+		g_warning("Failed to store state snapshot: %s", error->message);
+		g_error_free(error);
+	}
+	else {
+		dirty = false;
+	}
+
+	g_free(contents);
+}
+
+static gboolean flush_timeout_cb(gpointer user_data)
+{
+	flush_timeout = 0;
+	write_to_file();
+
+	return FALSE;
+}
+
+/* Takes over an update of a field and schedules writing the snapshot if
+ * something actually changed compared to the old one */
+static void field_updated(enum state_cache_field field, const struct state_snapshot *old)
+{
+	bool changed = !(valid_fields & FIELD_BIT(field)) || memcmp(old, &snapshot, sizeof(snapshot)) != 0;
+
+	valid_fields |= FIELD_BIT(field);
+	live_fields |= FIELD_BIT(field);
+
+	if (!changed || !cache_path)
+		return;
+
+	dirty = true;
+
+	if (flush_timeout == 0)
+		flush_timeout = g_timeout_add_seconds(STATE_CACHE_FLUSH_DELAY_SECONDS, flush_timeout_cb, NULL);
+}
+
+void state_cache_init(const char *path)
+{
+	cache_path = g_strdup(path);
+
+	if (cache_path)
+		load_from_file();
+}
+
+void state_cache_shutdown(void)
+{
+	if (flush_timeout)
+		g_source_remove(flush_timeout);
+	flush_timeout = 0;
+
+	if (dirty && cache_path)
+		write_to_file();
+
+	g_free(cache_path);
+	cache_path = NULL;
+}
+
+bool state_cache_is_live(enum state_cache_field field)
+{
+	return (live_fields & FIELD_BIT(field)) != 0;
+}
+
+void state_cache_set_power(bool power)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.power = power;
+	field_updated(STATE_CACHE_FIELD_POWER, &old);
+}
+
+void state_cache_set_sim_status(enum telephony_sim_status sim_status)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.sim_status = sim_status;
+	field_updated(STATE_CACHE_FIELD_SIM_STATUS, &old);
+}
+
+void state_cache_set_network_status(struct telephony_network_status *net_status)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.network_state = net_status->state;
+	snapshot.registration = net_status->registration;
+	copy_string(snapshot.network_name, sizeof(snapshot.network_name), net_status->name);
+	field_updated(STATE_CACHE_FIELD_NETWORK_STATUS, &old);
+}
+
+void state_cache_set_network_id(const char *id)
+{
+	struct state_snapshot old = snapshot;
+
+	copy_string(snapshot.network_id, sizeof(snapshot.network_id), id);
+	field_updated(STATE_CACHE_FIELD_NETWORK_ID, &old);
+}
+
+void state_cache_set_platform(struct telephony_platform_info *platform_info)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.platform_type = platform_info->platform_type;
+	copy_string(snapshot.imei, sizeof(snapshot.imei), platform_info->imei);
+	copy_string(snapshot.carrier, sizeof(snapshot.carrier), platform_info->carrier);
+	copy_string(snapshot.country, sizeof(snapshot.country), platform_info->country);
+	snapshot.mcc = platform_info->mcc;
+	snapshot.mnc = platform_info->mnc;
+	copy_string(snapshot.version, sizeof(snapshot.version), platform_info->version);
+	field_updated(STATE_CACHE_FIELD_PLATFORM, &old);
+}
+
+void state_cache_set_subscriber(struct telephony_subscriber_info *info)
+{
+	struct state_snapshot old = snapshot;
+	bool cdma = (info->platform_type == TELEPHONY_PLATFORM_TYPE_CDMA);
+
+	snapshot.subscriber_type = info->platform_type;
+	copy_string(snapshot.subscriber_id, sizeof(snapshot.subscriber_id), cdma ? info->min : info->imsi);
+	copy_string(snapshot.subscriber_number, sizeof(snapshot.subscriber_number), cdma ? info->mdn : info->msisdn);
+	field_updated(STATE_CACHE_FIELD_SUBSCRIBER, &old);
+}
+
+void state_cache_set_rat(enum telephony_radio_access_mode mode)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.rat_mode = mode;
+	field_updated(STATE_CACHE_FIELD_RAT, &old);
+}
+
+/* The connected services aren't kept; their addresses are meaningless after
+ * the contexts got set up again */
+void state_cache_set_wan(struct wan_status *status)
+{
+	struct state_snapshot old = snapshot;
+
+	snapshot.wan_state = status->state;
+	snapshot.wan_roam_guard = status->roam_guard;
+	snapshot.wan_network_type = status->network_type;
+	snapshot.wan_connection_status = status->connection_status;
+	snapshot.wan_status = status->wan_status;
+	snapshot.wan_dataaccess_usable = status->dataaccess_usable;
+	snapshot.wan_network_attached = status->network_attached;
+	snapshot.wan_disablewan = status->disablewan;
+	field_updated(STATE_CACHE_FIELD_WAN, &old);
+}
+
+bool state_cache_get_power(bool *power)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_POWER)))
+		return false;
+
+	*power = snapshot.power;
+
+	return true;
+}
+
+bool state_cache_get_sim_status(enum telephony_sim_status *sim_status)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_SIM_STATUS)))
+		return false;
+
+	*sim_status = snapshot.sim_status;
+
+	return true;
+}
+
+bool state_cache_get_network_status(struct telephony_network_status *net_status)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_NETWORK_STATUS)))
+		return false;
+
+	memset(net_status, 0, sizeof(*net_status));
+	net_status->state = snapshot.network_state;
+	net_status->registration = snapshot.registration;
+	net_status->name = snapshot.network_name;
+
+	return true;
+}
+
+bool state_cache_get_network_id(const char **id)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_NETWORK_ID)))
+		return false;
+
+	*id = snapshot.network_id;
+
+	return true;
+}
+
+bool state_cache_get_platform(struct telephony_platform_info *platform_info)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_PLATFORM)))
+		return false;
+
+	platform_info->platform_type = snapshot.platform_type;
+	platform_info->imei = snapshot.imei[0] != '\0' ? snapshot.imei : NULL;
+	platform_info->carrier = snapshot.carrier[0] != '\0' ? snapshot.carrier : NULL;
+	platform_info->country = snapshot.country[0] != '\0' ? snapshot.country : NULL;
+	platform_info->mcc = snapshot.mcc;
+	platform_info->mnc = snapshot.mnc;
+	platform_info->version = snapshot.version[0] != '\0' ? snapshot.version : NULL;
+
+	return true;
+}
+
+bool state_cache_get_subscriber(struct telephony_subscriber_info *info)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_SUBSCRIBER)))
+		return false;
+
+	memset(info, 0, sizeof(*info));
+	info->platform_type = snapshot.subscriber_type;
+
+	if (info->platform_type == TELEPHONY_PLATFORM_TYPE_CDMA) {
+		info->min = snapshot.subscriber_id;
+		info->mdn = snapshot.subscriber_number;
+	}
+	else {
+		info->imsi = snapshot.subscriber_id;
+		info->msisdn = snapshot.subscriber_number;
+	}
+
+	return true;
+}
+
+bool state_cache_get_rat(enum telephony_radio_access_mode *mode)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_RAT)))
+		return false;
+
+	*mode = snapshot.rat_mode;
+
+	return true;
+}
+
+bool state_cache_get_wan(struct wan_status *status)
+{
+	if (!(valid_fields & FIELD_BIT(STATE_CACHE_FIELD_WAN)))
+		return false;
+
+	memset(status, 0, sizeof(*status));
+	status->state = snapshot.wan_state;
+	status->roam_guard = snapshot.wan_roam_guard;
+	status->network_type = snapshot.wan_network_type;
+	status->connection_status = snapshot.wan_connection_status;
+	status->wan_status = snapshot.wan_status;
+	status->dataaccess_usable = snapshot.wan_dataaccess_usable;
+	status->network_attached = snapshot.wan_network_attached;
+	status->disablewan = snapshot.wan_disablewan;
+
+	return true;
+}
+
+// vim:ts=4:sw=4:noexpandtab
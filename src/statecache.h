@@ -0,0 +1,69 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef STATE_CACHE_H_
+#define STATE_CACHE_H_
+
+#include <stdbool.h>
+
+#include "telephonydriver.h"
+#include "wandriver.h"
+
+/* The last known state of the modem survives restarts of the daemon so
+ * queries can be answered (flagged as cached) before ofono is back. */
+
+enum state_cache_field {
+	STATE_CACHE_FIELD_POWER = 0,
+	STATE_CACHE_FIELD_SIM_STATUS,
+	STATE_CACHE_FIELD_NETWORK_STATUS,
+	STATE_CACHE_FIELD_NETWORK_ID,
+	STATE_CACHE_FIELD_PLATFORM,
+	STATE_CACHE_FIELD_SUBSCRIBER,
+	STATE_CACHE_FIELD_RAT,
+	STATE_CACHE_FIELD_WAN,
+	STATE_CACHE_FIELD_MAX
+};
+
+void state_cache_init(const char *path);
+void state_cache_shutdown(void);
+
+bool state_cache_is_live(enum state_cache_field field);
+
+void state_cache_set_power(bool power);
+void state_cache_set_sim_status(enum telephony_sim_status sim_status);
+void state_cache_set_network_status(struct telephony_network_status *net_status);
+void state_cache_set_network_id(const char *id);
+void state_cache_set_platform(struct telephony_platform_info *platform_info);
+void state_cache_set_subscriber(struct telephony_subscriber_info *info);
+void state_cache_set_rat(enum telephony_radio_access_mode mode);
+void state_cache_set_wan(struct wan_status *status);
+
+/* The strings returned by the getters stay valid until the next update of the
+ * same field */
+bool state_cache_get_power(bool *power);
+bool state_cache_get_sim_status(enum telephony_sim_status *sim_status);
+bool state_cache_get_network_status(struct telephony_network_status *net_status);
+bool state_cache_get_network_id(const char **id);
+bool state_cache_get_platform(struct telephony_platform_info *platform_info);
+bool state_cache_get_subscriber(struct telephony_subscriber_info *info);
+bool state_cache_get_rat(enum telephony_radio_access_mode *mode);
+bool state_cache_get_wan(struct wan_status *status);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
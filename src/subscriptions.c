@@ -0,0 +1,569 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+#include "subscriptions.h"
+#include "displaystate.h"
+
+/* Registry for clients which subscribe to a set of topics and only want to see
+ * some of the fields of each topic. An event is serialized once for every
+ * distinct field mask among the subscribers of its topic and a subscriber
+ * isn't woken up when the fields it asked for didn't change since the last
+ * post it got.
+ *
+ * Subscribers in delta mode get the current state of their topics together
+ * with its version when subscribing and afterwards only the fields which
+ * changed. Every delta carries the new version and the one it applies to so
+ * a client can tell when it missed a post and has to subscribe again.
+ *
+ * While the display is off changes which only touch deferrable fields (the
+ * ones nobody needs to react to before the user looks at the screen again)
+ * aren't posted but collapsed into the topic state and flushed once the
+ * display turns on. Any other change of the topic takes the deferred ones
+ * along. */
+
+/* luna-service keeps our subscribers under this key so we get told when one
+ * of them goes away; nothing gets posted through it */
+#define SUBSCRIPTIONS_KEY			"/subscribe"
+#define MAX_TOPIC_FIELDS			32
+
+struct topic_info {
+	const char *name;
+	const char *fields[MAX_TOPIC_FIELDS + 1];
+	const char *deferrable_fields[MAX_TOPIC_FIELDS + 1];
+};
+
+static const struct topic_info topic_infos[SUBSCRIPTION_TOPIC_MAX] = {
+	[SUBSCRIPTION_TOPIC_SIGNAL] = { "signal", { "bars", NULL }, { "bars", NULL } },
+	[SUBSCRIPTION_TOPIC_REGISTRATION] = { "registration", { "state", "registration", "causeCode", NULL } },
+	[SUBSCRIPTION_TOPIC_OPERATOR] = { "operator", { "networkName", NULL }, { "networkName", NULL } },
+	[SUBSCRIPTION_TOPIC_SIM] = { "sim", { "state", "enabled", "pinrequired", "pukrequired", "pinpermblocked",
+		"devicelocked", "pinAttemptsRemaining", "pukAttemptsRemaining", NULL } },
+	[SUBSCRIPTION_TOPIC_POWER] = { "power", { "powerState", NULL } },
+	[SUBSCRIPTION_TOPIC_CALLS] = { "calls", { "id", "state", "number", NULL } },
+	[SUBSCRIPTION_TOPIC_SMS] = { "sms", { "event", "id", "status", "from", "timestamp", NULL } },
+	[SUBSCRIPTION_TOPIC_WAN] = { "wan", { "state", "roamguard", "networktype", "dataaccess", "networkstatus",
+		"wanstate", "disablewan", "connectedservices", NULL }, { "networktype", NULL } },
+};
+
+struct subscriber {
+	LSHandle *handle;
+	LSMessage *message;
+	/* fields of each topic the subscriber wants; zero if it doesn't want the topic */
+	guint32 field_masks[SUBSCRIPTION_TOPIC_MAX];
+	gchar *last_payload[SUBSCRIPTION_TOPIC_MAX];
+	bool delta;
+	/* version of each topic the subscriber is at and changed fields we failed
+	 * to post to it */
+	guint32 versions[SUBSCRIPTION_TOPIC_MAX];
+	guint32 unsent_masks[SUBSCRIPTION_TOPIC_MAX];
+};
+
+static GList *topic_subscribers[SUBSCRIPTION_TOPIC_MAX];
+/* last known value of every field of a topic and how often it changed */
+static jvalue_ref topic_states[SUBSCRIPTION_TOPIC_MAX];
+static guint32 topic_versions[SUBSCRIPTION_TOPIC_MAX];
+/* changes held back while the display is off */
+static guint32 deferred_changes[SUBSCRIPTION_TOPIC_MAX];
+static struct subscription_stats topic_stats[SUBSCRIPTION_TOPIC_MAX];
+static GHashTable *subscribers_by_message = NULL;
+
+bool subscription_topic_from_string(const char *str, enum subscription_topic *topic)
+{
+	int n;
+
+	for (n = 0; n < SUBSCRIPTION_TOPIC_MAX; n++) {
+		if (g_strcmp0(str, topic_infos[n].name) == 0) {
+			*topic = n;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* subscription_topic_to_string(enum subscription_topic topic)
+{
+	if (topic >= SUBSCRIPTION_TOPIC_MAX)
+		return NULL;
+
+	return topic_infos[topic].name;
+}
+
+static void subscriber_free(struct subscriber *subscriber)
+{
+	int n;
+
+	for (n = 0; n < SUBSCRIPTION_TOPIC_MAX; n++) {
+		topic_subscribers[n] = g_list_remove(topic_subscribers[n], subscriber);
+		g_free(subscriber->last_payload[n]);
+	}
+
+	LSMessageUnref(subscriber->message);
+	g_free(subscriber);
+}
+
+static bool subscription_cancel_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	/* frees the subscriber if the message is one of ours */
+	if (subscribers_by_message)
+		g_hash_table_remove(subscribers_by_message, message);
+
+	return true;
+}
+
+bool subscriptions_attach(LSHandle *handle)
+{
+	LSError lserror;
+
+	LSErrorInit(&lserror);
+
+	if (!LSSubscriptionSetCancelFunction(handle, subscription_cancel_cb, NULL, &lserror)) {
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		return false;
+	}
+
+	return true;
+}
+
+void subscriptions_shutdown(void)
+{
+	int n;
+
+	for (n = 0; n < SUBSCRIPTION_TOPIC_MAX; n++) {
+		j_release(&topic_states[n]);
+		topic_versions[n] = 0;
+		deferred_changes[n] = 0;
+	}
+
+	if (!subscribers_by_message)
+		return;
+
+	g_hash_table_destroy(subscribers_by_message);
+	subscribers_by_message = NULL;
+}
+
+bool subscriptions_add(LSHandle *handle, LSMessage *message, jvalue_ref topics_obj,
+					   jvalue_ref fields_obj, bool delta, const char **error_text)
+{
+	guint32 field_masks[SUBSCRIPTION_TOPIC_MAX];
+	struct subscriber *subscriber;
+	enum subscription_topic topic;
+	jvalue_ref value_obj;
+	raw_buffer value_buf;
+	guint32 mask;
+	LSError lserror;
+	bool subscribed = false;
+	int n, m;
+
+	memset(field_masks, 0, sizeof(field_masks));
+
+	if (!jis_array(topics_obj) || jarray_size(topics_obj) == 0) {
+		*error_text = "No topics given";
+		return false;
+	}
+
+	for (n = 0; n < jarray_size(topics_obj); n++) {
+		value_buf = jstring_get_fast(jarray_get(topics_obj, n));
+		if (!value_buf.m_str || !subscription_topic_from_string(value_buf.m_str, &topic)) {
+			*error_text = "Unknown topic";
+			return false;
+		}
+
+		/* without a field list the subscriber gets everything */
+		for (m = 0; topic_infos[topic].fields[m] != NULL; m++)
+			field_masks[topic] |= (1u << m);
+	}
+
+	if (jis_array(fields_obj)) {
+		guint32 requested[SUBSCRIPTION_TOPIC_MAX];
+
+		memset(requested, 0, sizeof(requested));
+
+		for (n = 0; n < jarray_size(fields_obj); n++) {
+			value_obj = jarray_get(fields_obj, n);
+			value_buf = jstring_get_fast(value_obj);
+			mask = 0;
+
+			for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++) {
+				if (!field_masks[topic])
+					continue;
+
+				for (m = 0; topic_infos[topic].fields[m] != NULL; m++) {
+					if (value_buf.m_str && strlen(topic_infos[topic].fields[m]) == value_buf.m_len &&
+						strncmp(topic_infos[topic].fields[m], value_buf.m_str, value_buf.m_len) == 0) {
+						requested[topic] |= (1u << m);
+						mask |= (1u << m);
+					}
+				}
+			}
+
+			if (!mask) {
+				*error_text = "Unknown field";
+				return false;
+			}
+		}
+
+		/* topics none of the requested fields belong to are dropped */
+		memcpy(field_masks, requested, sizeof(field_masks));
+	}
+
+	for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++)
+		subscribed |= (field_masks[topic] != 0);
+
+	if (!subscribed) {
+		*error_text = "Nothing to subscribe to";
+		return false;
+	}
+
+	LSErrorInit(&lserror);
+
+	if (!LSSubscriptionAdd(handle, SUBSCRIPTIONS_KEY, message, &lserror)) {
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		*error_text = "Failed to add subscription";
+		return false;
+	}
+
+	if (!subscribers_by_message)
+		subscribers_by_message = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+													   NULL, (GDestroyNotify) subscriber_free);
+
+	subscriber = g_new0(struct subscriber, 1);
+	subscriber->handle = handle;
+	subscriber->message = message;
+	subscriber->delta = delta;
+	memcpy(subscriber->field_masks, field_masks, sizeof(field_masks));
+	memcpy(subscriber->versions, topic_versions, sizeof(topic_versions));
+
+	LSMessageRef(message);
+
+	for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++) {
+		if (field_masks[topic])
+			topic_subscribers[topic] = g_list_append(topic_subscribers[topic], subscriber);
+	}
+
+	g_hash_table_insert(subscribers_by_message, message, subscriber);
+
+	return true;
+}
+
+/* Copies the fields of the mask which are present in source_obj; NULL if
+ * there are none */
+static jvalue_ref create_fields_object(enum subscription_topic topic, guint32 mask, jvalue_ref source_obj)
+{
+	jvalue_ref fields_obj = NULL;
+	jvalue_ref value_obj = NULL;
+	const char *name;
+	int count = 0;
+	int n;
+
+	fields_obj = jobject_create();
+
+	for (n = 0; topic_infos[topic].fields[n] != NULL; n++) {
+		name = topic_infos[topic].fields[n];
+
+		if (!(mask & (1u << n)) || !jobject_get_exists(source_obj, j_cstr_to_buffer(name), &value_obj))
+			continue;
+
+		jobject_put(fields_obj, jstring_create(name), jvalue_copy(value_obj));
+		count++;
+	}
+
+	if (count == 0)
+		j_release(&fields_obj);
+
+	return fields_obj;
+}
+
+/* Builds the payload for all subscribers of the topic with the given field
+ * mask; an empty string if none of their fields is part of the event. Deltas
+ * carry the current version of the topic. */
+static gchar* create_payload(enum subscription_topic topic, guint32 mask, jvalue_ref fields_obj, bool delta)
+{
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref extended_obj = NULL;
+	jschema_ref response_schema = NULL;
+	gchar *payload = NULL;
+
+	extended_obj = create_fields_object(topic, mask, fields_obj);
+	if (!extended_obj)
+		return g_strdup("");
+
+	reply_obj = jobject_create();
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("topic"), jstring_create(topic_infos[topic].name));
+	if (delta) {
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("delta"), jboolean_create(true));
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("version"), jnumber_create_i64(topic_versions[topic]));
+	}
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
+
+	response_schema = jschema_parse(j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if (response_schema) {
+		payload = g_strdup(jvalue_tostring(reply_obj, response_schema));
+		jschema_release(&response_schema);
+	}
+
+	j_release(&reply_obj);
+
+	return payload ? payload : g_strdup("");
+}
+
+/* Merges the fields of an event into the last known state of the topic and
+ * returns the mask of the fields whose value changed */
+static guint32 update_topic_state(enum subscription_topic topic, jvalue_ref fields_obj)
+{
+	jvalue_ref value_obj = NULL;
+	jvalue_ref old_value_obj = NULL;
+	const char *name;
+	guint32 changed = 0;
+	int n;
+
+	if (!topic_states[topic])
+		topic_states[topic] = jobject_create();
+
+	for (n = 0; topic_infos[topic].fields[n] != NULL; n++) {
+		name = topic_infos[topic].fields[n];
+
+		if (!jobject_get_exists(fields_obj, j_cstr_to_buffer(name), &value_obj))
+			continue;
+
+		if (jobject_get_exists(topic_states[topic], j_cstr_to_buffer(name), &old_value_obj) &&
+			g_strcmp0(jvalue_tostring_simple(value_obj), jvalue_tostring_simple(old_value_obj)) == 0)
+			continue;
+
+		jobject_put(topic_states[topic], jstring_create(name), jvalue_copy(value_obj));
+		changed |= (1u << n);
+	}
+
+	if (changed)
+		topic_versions[topic]++;
+
+	return changed;
+}
+
+static bool post_payload(struct subscriber *subscriber, const gchar *payload)
+{
+	LSError lserror;
+
+	LSErrorInit(&lserror);
+
+	if (!LSMessageReply(subscriber->handle, subscriber->message, payload, &lserror)) {
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		return false;
+	}
+
+	return true;
+}
+
+static void post_delta(struct subscriber *subscriber, enum subscription_topic topic, guint32 changed,
+					   GHashTable *deltas)
+{
+	guint32 mask;
+	gchar *body;
+	gchar *payload;
+
+	mask = subscriber->field_masks[topic] & (changed | subscriber->unsent_masks[topic]);
+	if (!mask)
+		return;
+
+	/* deltas are built from the topic state so fields of a post which got
+	 * lost are sent along with the next one */
+	body = g_hash_table_lookup(deltas, GUINT_TO_POINTER(mask));
+	if (!body) {
+		body = create_payload(topic, mask, topic_states[topic], true);
+		g_hash_table_insert(deltas, GUINT_TO_POINTER(mask), body);
+	}
+
+	if (body[0] == '\0')
+		return;
+
+	/* the version the delta applies to differs between subscribers so it's
+	 * spliced in front of the shared body */
+	payload = g_strdup_printf("{\"previousVersion\":%u,%s", subscriber->versions[topic], body + 1);
+
+	if (post_payload(subscriber, payload)) {
+		subscriber->versions[topic] = topic_versions[topic];
+		subscriber->unsent_masks[topic] = 0;
+	}
+	else {
+		subscriber->unsent_masks[topic] = mask;
+	}
+
+	g_free(payload);
+}
+
+static guint32 get_deferrable_mask(enum subscription_topic topic)
+{
+	guint32 mask = 0;
+	int n, m;
+
+	for (n = 0; topic_infos[topic].fields[n] != NULL; n++) {
+		for (m = 0; topic_infos[topic].deferrable_fields[m] != NULL; m++) {
+			if (g_strcmp0(topic_infos[topic].fields[n], topic_infos[topic].deferrable_fields[m]) == 0)
+				mask |= (1u << n);
+		}
+	}
+
+	return mask;
+}
+
+static void post_to_subscribers(enum subscription_topic topic, jvalue_ref fields_obj, guint32 changed)
+{
+	GHashTable *payloads;
+	GHashTable *deltas;
+	struct subscriber *subscriber;
+	gchar *payload;
+	GList *iter;
+
+	if (!topic_subscribers[topic])
+		return;
+
+	payloads = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	deltas = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+	for (iter = topic_subscribers[topic]; iter != NULL; iter = g_list_next(iter)) {
+		subscriber = iter->data;
+
+		if (subscriber->delta) {
+			post_delta(subscriber, topic, changed, deltas);
+			continue;
+		}
+
+		payload = g_hash_table_lookup(payloads, GUINT_TO_POINTER(subscriber->field_masks[topic]));
+		if (!payload) {
+			payload = create_payload(topic, subscriber->field_masks[topic], fields_obj, false);
+			g_hash_table_insert(payloads, GUINT_TO_POINTER(subscriber->field_masks[topic]), payload);
+		}
+
+		if (payload[0] == '\0' || g_strcmp0(payload, subscriber->last_payload[topic]) == 0)
+			continue;
+
+		if (!post_payload(subscriber, payload))
+			continue;
+
+		g_free(subscriber->last_payload[topic]);
+		subscriber->last_payload[topic] = g_strdup(payload);
+	}
+
+	g_hash_table_destroy(payloads);
+	g_hash_table_destroy(deltas);
+}
+
+/* Posts an event to every subscriber of the topic; fields_obj holds the fields
+ * of the event and stays owned by the caller */
+void subscriptions_publish(enum subscription_topic topic, jvalue_ref fields_obj)
+{
+	guint32 changed;
+
+	/* the state is tracked without subscribers too so the first delta
+	 * subscriber gets a complete snapshot */
+	changed = update_topic_state(topic, fields_obj);
+
+	if (!display_state_is_on() && !(changed & ~get_deferrable_mask(topic))) {
+		if (changed) {
+			deferred_changes[topic] |= changed;
+			topic_stats[topic].deferred++;
+		}
+		return;
+	}
+
+	if (changed)
+		topic_stats[topic].immediate++;
+
+	if (deferred_changes[topic]) {
+		changed |= deferred_changes[topic];
+		deferred_changes[topic] = 0;
+		post_to_subscribers(topic, topic_states[topic], changed);
+		return;
+	}
+
+	post_to_subscribers(topic, fields_obj, changed);
+}
+
+/* Posts the latest state of every topic with changes held back while the
+ * display was off */
+void subscriptions_flush_deferred(void)
+{
+	enum subscription_topic topic;
+
+	for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++) {
+		if (!deferred_changes[topic])
+			continue;
+
+		post_to_subscribers(topic, topic_states[topic], deferred_changes[topic]);
+		deferred_changes[topic] = 0;
+		topic_stats[topic].flushed++;
+	}
+}
+
+/* Puts the current state of the topics a delta subscriber asked for into the
+ * reply to its subscribe call; does nothing for other subscribers */
+void subscriptions_put_snapshot(LSMessage *message, jvalue_ref reply_obj)
+{
+	struct subscriber *subscriber = NULL;
+	jvalue_ref snapshot_obj = NULL;
+	jvalue_ref topic_obj = NULL;
+	jvalue_ref extended_obj = NULL;
+	enum subscription_topic topic;
+
+	if (subscribers_by_message)
+		subscriber = g_hash_table_lookup(subscribers_by_message, message);
+
+	if (!subscriber || !subscriber->delta)
+		return;
+
+	snapshot_obj = jobject_create();
+
+	for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++) {
+		if (!subscriber->field_masks[topic])
+			continue;
+
+		extended_obj = NULL;
+		if (topic_states[topic])
+			extended_obj = create_fields_object(topic, subscriber->field_masks[topic], topic_states[topic]);
+
+		topic_obj = jobject_create();
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("version"), jnumber_create_i64(subscriber->versions[topic]));
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("extended"), extended_obj ? extended_obj : jobject_create());
+		jobject_put(snapshot_obj, jstring_create(topic_infos[topic].name), topic_obj);
+	}
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("delta"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("snapshot"), snapshot_obj);
+}
+
+unsigned int subscriptions_get_count(enum subscription_topic topic)
+{
+	return g_list_length(topic_subscribers[topic]);
+}
+
+void subscriptions_get_stats(enum subscription_topic topic, struct subscription_stats *stats)
+{
+	*stats = topic_stats[topic];
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,64 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef SUBSCRIPTIONS_H_
+#define SUBSCRIPTIONS_H_
+
+#include <stdbool.h>
+#include <glib.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+enum subscription_topic {
+	SUBSCRIPTION_TOPIC_SIGNAL = 0,
+	SUBSCRIPTION_TOPIC_REGISTRATION,
+	SUBSCRIPTION_TOPIC_OPERATOR,
+	SUBSCRIPTION_TOPIC_SIM,
+	SUBSCRIPTION_TOPIC_POWER,
+	SUBSCRIPTION_TOPIC_CALLS,
+	SUBSCRIPTION_TOPIC_SMS,
+	SUBSCRIPTION_TOPIC_WAN,
+	SUBSCRIPTION_TOPIC_MAX
+};
+
+/* immediate and deferred count published changes, flushed how often deferred
+ * changes were posted when the display turned on */
+struct subscription_stats {
+	unsigned int immediate;
+	unsigned int deferred;
+	unsigned int flushed;
+};
+
+bool subscription_topic_from_string(const char *str, enum subscription_topic *topic);
+const char* subscription_topic_to_string(enum subscription_topic topic);
+
+bool subscriptions_attach(LSHandle *handle);
+void subscriptions_shutdown(void);
+
+bool subscriptions_add(LSHandle *handle, LSMessage *message, jvalue_ref topics_obj,
+					   jvalue_ref fields_obj, bool delta, const char **error_text);
+void subscriptions_put_snapshot(LSMessage *message, jvalue_ref reply_obj);
+void subscriptions_publish(enum subscription_topic topic, jvalue_ref fields_obj);
+void subscriptions_flush_deferred(void);
+
+unsigned int subscriptions_get_count(enum subscription_topic topic);
+void subscriptions_get_stats(enum subscription_topic topic, struct subscription_stats *stats);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
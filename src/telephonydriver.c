@@ -128,4 +128,28 @@ enum telephony_radio_access_mode telephony_radio_access_mode_from_string(const c
 	return result;
 }
 
+const char* telephony_call_state_to_string(enum telephony_call_state state)
+{
+	switch (state) {
+		case TELEPHONY_CALL_STATE_ACTIVE:
+			return "active";
+		case TELEPHONY_CALL_STATE_HELD:
+			return "held";
+		case TELEPHONY_CALL_STATE_DIALING:
+			return "dialing";
+		case TELEPHONY_CALL_STATE_ALERTING:
+			return "alerting";
+		case TELEPHONY_CALL_STATE_INCOMING:
+			return "incoming";
+		case TELEPHONY_CALL_STATE_WAITING:
+			return "waiting";
+		case TELEPHONY_CALL_STATE_DISCONNECTED:
+			return "disconnected";
+		default:
+			break;
+	}
+
+	return "unknown";
+}
+
 // vim:ts=4:sw=4:noexpandtab
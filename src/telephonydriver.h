@@ -76,14 +76,34 @@ enum telephony_platform_type {
 	TELEPHONY_PLATFORM_TYPE_CDMA,
 };
 
+enum telephony_call_state {
+	TELEPHONY_CALL_STATE_ACTIVE = 0,
+	TELEPHONY_CALL_STATE_HELD,
+	TELEPHONY_CALL_STATE_DIALING,
+	TELEPHONY_CALL_STATE_ALERTING,
+	TELEPHONY_CALL_STATE_INCOMING,
+	TELEPHONY_CALL_STATE_WAITING,
+	TELEPHONY_CALL_STATE_DISCONNECTED
+};
+
 const char* telephony_platform_type_to_string(enum telephony_platform_type type);
 const char* telephony_sim_status_to_string(enum telephony_sim_status sim_status);
 const char* telephony_network_state_to_string(enum telephony_network_state state);
 const char* telephony_network_registration_to_string(enum telephony_network_registration netreg);
 const char* telephony_radio_access_mode_to_string(enum telephony_radio_access_mode mode);
+const char* telephony_call_state_to_string(enum telephony_call_state state);
 
 enum telephony_radio_access_mode telephony_radio_access_mode_from_string(const char *mode);
 
+/* changes reported by the modem vs. the ones passed on to clients after
+ * smoothing and damping */
+struct telephony_network_filter_stats {
+	unsigned int raw_strength_changes;
+	unsigned int emitted_strength_changes;
+	unsigned int raw_registration_changes;
+	unsigned int emitted_registration_changes;
+};
+
 struct telephony_network_status {
 	enum telephony_network_state state;
 	enum telephony_network_registration registration;
@@ -97,6 +117,8 @@ struct telephony_platform_info {
 	enum telephony_platform_type platform_type;
 	const gchar *imei;
 	const gchar *carrier;
+	/* ISO 3166 code of the country the SIM belongs to */
+	const gchar *country;
 	int mcc;
 	int mnc;
 	/* FIXME: whats with "capabilities":{"dataCategory":10} ? */
@@ -124,6 +146,12 @@ struct telephony_network {
 	enum telephony_radio_access_mode radio_access_mode;
 };
 
+struct telephony_call_status {
+	int id;
+	enum telephony_call_state state;
+	const gchar *number;
+};
+
 struct telephony_subscriber_info {
 	enum telephony_platform_type platform_type;
 	const gchar *imsi;
@@ -139,6 +167,7 @@ typedef int (*telephony_power_query_cb)(const struct telephony_error* error, boo
 typedef int (*telephony_sim_status_query_cb)(const struct telephony_error* error, enum telephony_sim_status status, void *data);
 typedef int (*telephony_network_status_query_cb)(const struct telephony_error* error, struct telephony_network_status *status, void *data);
 typedef int (*telephony_signal_strength_query_cb)(const struct telephony_error* error, unsigned int bars, void *data);
+typedef int (*telephony_network_filter_stats_query_cb)(const struct telephony_error* error, struct telephony_network_filter_stats *stats, void *data);
 typedef int (*telephony_pin_status_query_cb)(const struct telephony_error* error, struct telephony_pin_status *status, void *data);
 typedef int (*telephony_network_list_query_cb)(const struct telephony_error* error, GList *networks, void *data);
 typedef int (*telephony_platform_query_cb)(const struct telephony_error* error, struct telephony_platform_info *platform_info, void *data);
@@ -172,6 +201,7 @@ struct telephony_driver {
 	/* network */
 	void (*network_status_query)(struct telephony_service *service, telephony_network_status_query_cb cb, void *data);
 	void (*signal_strength_query)(struct telephony_service *service, telephony_signal_strength_query_cb cb, void *data);
+	void (*network_filter_stats_query)(struct telephony_service *service, telephony_network_filter_stats_query_cb cb, void *data);
 	void (*network_list_query)(struct telephony_service *service, telephony_network_list_query_cb cb, void *data);
 	void (*network_list_query_cancel)(struct telephony_service *service, telephony_result_cb cb, void *data);
 	void (*network_set)(struct telephony_service *service, bool automatic, const char *id, telephony_result_cb cb, void *data);
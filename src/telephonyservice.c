@@ -31,12 +31,16 @@
 #include "telephonyservice_sms.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "subscriptions.h"
+#include "displaystate.h"
+#include "startuptimeline.h"
 
 extern GMainLoop *event_loop;
 static GSList *g_driver_list;
 
 bool _service_subscribe_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_is_telephony_ready_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_get_all_status_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_power_set_cb(LSHandle* lshandle, LSMessage *message, void *user_data);
 bool _service_power_query_cb(LSHandle *lshandle, LSMessage *message, void *user_data);
 bool _service_platform_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
@@ -51,6 +55,7 @@ bool _service_pin1_unblock_cb(LSHandle *handle, LSMessage *message, void *user_d
 bool _service_fdn_status_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_signal_strength_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_network_status_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_network_filter_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_network_list_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_network_list_query_cancel_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_network_id_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
@@ -65,12 +70,18 @@ bool _service_dial_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_answer_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_ignore_cb(LSHandle *handle, LSMessage *message, void *user_data);
 bool _service_hangup_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_log_level_set_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_flight_recorder_dump_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_notification_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_startup_timeline_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 
 bool _service_internal_send_sms_from_db_cb(LSHandle *handle, LSMessage *message, void *user_data);
+bool _service_sms_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data);
 
 static LSMethod _telephony_service_methods[]  = {
 	{ "subscribe", _service_subscribe_cb },
 	{ "isTelephonyReady", _service_is_telephony_ready_cb },
+	{ "getAllStatus", _service_get_all_status_cb },
 	{ "powerSet", _service_power_set_cb },
 	{ "powerQuery", _service_power_query_cb },
 	{ "platformQuery", _service_platform_query_cb },
@@ -85,6 +96,7 @@ static LSMethod _telephony_service_methods[]  = {
 	{ "fdnStatusQuery", _service_fdn_status_query_cb },
 	{ "signalStrengthQuery", _service_signal_strength_query_cb },
 	{ "networkStatusQuery", _service_network_status_query_cb },
+	{ "networkFilterStatsQuery", _service_network_filter_stats_query_cb },
 	{ "networkListQuery", _service_network_list_query_cb },
 	{ "networkListQueryCancel", _service_network_list_query_cancel_cb },
 	{ "networkIdQuery", _service_network_id_query_cb },
@@ -99,30 +111,22 @@ static LSMethod _telephony_service_methods[]  = {
 	{ "answer", _service_answer_cb },
 	{ "ignore", _service_ignore_cb },
 	{ "hangup", _service_hangup_cb },
+	{ "logLevelSet", _service_log_level_set_cb },
+	{ "flightRecorderDump", _service_flight_recorder_dump_cb },
+	{ "notificationStatsQuery", _service_notification_stats_query_cb },
+	{ "startupTimelineQuery", _service_startup_timeline_query_cb },
 	{ "sendSmsFromDb", _service_internal_send_sms_from_db_cb },
+	{ "smsStatsQuery", _service_sms_stats_query_cb },
 	{ 0, 0 }
 };
 
 static bool retrieve_power_state_from_settings(void)
 {
-	const char *setting_value = NULL;
-	jvalue_ref parsed_obj;
-	jvalue_ref state_obj;
 	bool power_state = true;
 
-	setting_value = telephony_settings_load(TELEPHONY_SETTINGS_TYPE_POWER_STATE);
-	if (setting_value == NULL)
+	if (!telephony_settings_get_bool(TELEPHONY_SETTINGS_TYPE_POWER_STATE, &power_state))
 		return true;
 
-	parsed_obj = luna_service_message_parse_and_validate(setting_value);
-	if (jis_null(parsed_obj))
-		return true;
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("state"), &state_obj))
-		return true;
-
-	jboolean_get(state_obj, &power_state);
-	j_release(&parsed_obj);
 	return power_state;
 }
 
@@ -143,9 +147,20 @@ static int configure_service(struct telephony_service *service)
 
 	service->driver->power_set(service, power_state, _service_initial_power_set_finish, service);
 
+	startup_timeline_mark(STARTUP_PHASE_SERVICE_CONFIGURED);
+
 	return 0;
 }
 
+static void display_changed_cb(bool on, void *user_data)
+{
+	if (!on)
+		return;
+
+	subscriptions_flush_deferred();
+	luna_service_flush_deferred_posts();
+}
+
 struct telephony_service* telephony_service_create()
 {
 	struct telephony_service *service;
@@ -168,7 +183,6 @@ struct telephony_service* telephony_service_create()
 	}
 
 	service->initialized = false;
-	service->power_off_pending = false;
 	service->powered = false;
 	service->network_status_query_pending = false;
 	service->network_registered = false;
@@ -189,17 +203,11 @@ struct telephony_service* telephony_service_create()
 		goto failed;
 	}
 
-	if (!LSRegisterCategory(service->palmHandle, "/", _telephony_service_methods, NULL, NULL, &error)) {
+	if (!luna_service_register_category(service->palmHandle, "/", _telephony_service_methods, service, &error)) {
 		g_warning("Could not register palm service category");
 		LSErrorFree(&error);
 		goto failed;
 	}
-	
-	if (!LSCategorySetData(service->palmHandle, "/", service, &error)) {
-		g_warning("Could not set data for palm service category");
-		LSErrorFree(&error);
-		goto failed;
-	}
 
 	if (!LSRegister("com.webos.service.telephony", &service->webosHandle, &error)) {
 		g_critical("Failed to initialize the Luna webOS service: %s", error.message);
@@ -213,20 +221,21 @@ struct telephony_service* telephony_service_create()
 		goto failed;
 	}
 
-	if (!LSRegisterCategory(service->webosHandle, "/", _telephony_service_methods, NULL, NULL, &error)) {
+	if (!luna_service_register_category(service->webosHandle, "/", _telephony_service_methods, service, &error)) {
 		g_warning("Could not register webos service category");
 		LSErrorFree(&error);
 		goto failed;
 	}
-	
-	if (!LSCategorySetData(service->webosHandle, "/", service, &error)) {
-		g_warning("Could not set data for webos service category");
-		LSErrorFree(&error);
-		goto failed;
-	}
+
+	subscriptions_attach(service->palmHandle);
+	subscriptions_attach(service->webosHandle);
+
+	display_state_watch(service->palmHandle, display_changed_cb, service);
 
 	telephonyservice_sms_setup(service);
 
+	startup_timeline_mark(STARTUP_PHASE_SERVICE_REGISTERED);
+
 	return service;
 
 failed:
@@ -240,6 +249,13 @@ void telephony_service_free(struct telephony_service *service)
 
 	LSErrorInit(&error);
 
+	telephonyservice_sms_cleanup(service);
+
+	display_state_unwatch(service->palmHandle);
+	luna_service_flush_deferred_posts();
+
+	subscriptions_shutdown();
+
 	if (service->palmHandle != NULL &&
 		LSUnregister(service->palmHandle, &error) < 0) {
 		g_critical("Could not unregister palm service: %s", error.message);
@@ -252,7 +268,6 @@ void telephony_service_free(struct telephony_service *service)
 		LSErrorFree(&error);
 	}
 
-
 	if (service->driver) {
 		service->driver->remove(service);
 		service->driver = NULL;
@@ -40,6 +40,8 @@ void telephony_service_sim_status_notify(struct telephony_service *service, enum
 void telephony_service_network_status_changed_notify(struct telephony_service *service, struct telephony_network_status *net_status);
 void telephony_service_signal_strength_changed_notify(struct telephony_service *service, int bars);
 
+void telephony_service_call_status_changed_notify(struct telephony_service *service, struct telephony_call_status *call_status);
+
 enum telephony_message_type {
 	TELEPHONY_MESSAGE_TYPE_UNKNOWN,
 	TELEPHONY_MESSAGE_TYPE_CLASS0,
@@ -29,17 +29,39 @@
 #include "telephonyservice_internal.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "requestparser.h"
+#include "subscriptions.h"
+
+/* dial strings may carry DTMF tones after the number */
+#define DIAL_NUMBER_SIZE	128
+
+struct dial_request {
+	char number[DIAL_NUMBER_SIZE];
+	bool block_id;
+};
+
+static const struct request_key dial_request_keys[] = {
+	REQUEST_KEY(struct dial_request, number, "number", REQUEST_VALUE_STRING, true),
+	REQUEST_KEY(struct dial_request, block_id, "blockId", REQUEST_VALUE_BOOLEAN, false),
+	REQUEST_KEYS_END
+};
+
+/* answer, ignore and hangup only need the id of the call */
+struct call_id_request {
+	int id;
+};
+
+static const struct request_key call_id_request_keys[] = {
+	REQUEST_KEY(struct call_id_request, id, "id", REQUEST_VALUE_INTEGER, true),
+	REQUEST_KEYS_END
+};
 
 bool _service_dial_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref number_obj = NULL;
-	jvalue_ref block_id_obj = NULL;
-	const char *payload;
-	bool block_id = false;
-	raw_buffer number_buf;
+	struct dial_request request = { .block_id = false };
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -52,33 +74,18 @@ bool _service_dial_cb(LSHandle *handle, LSMessage *message, void *user_data)
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), dial_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("number"), &number_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("blockId"), &block_id_obj)) {
-		jboolean_get(block_id_obj, &block_id);
-	}
-
-	number_buf = jstring_get(number_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->user_data = service;
 
-	service->driver->dial(service, number_buf.m_str, block_id, telephonyservice_common_finish, req_data);
+	service->driver->dial(service, request.number, request.block_id, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -86,10 +93,8 @@ bool _service_answer_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref id_obj = NULL;
-	const char *payload;
-	int call_id = 0;
+	struct call_id_request request = { .id = 0 };
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -102,29 +107,18 @@ bool _service_answer_cb(LSHandle *handle, LSMessage *message, void *user_data)
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("id"), &id_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), call_id_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	jnumber_get_i32(id_obj, &call_id);
-
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->user_data = service;
 
-	service->driver->answer(service, call_id, telephonyservice_common_finish, req_data);
+	service->driver->answer(service, request.id, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -132,10 +126,8 @@ bool _service_ignore_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref id_obj = NULL;
-	const char *payload;
-	int call_id = 0;
+	struct call_id_request request = { .id = 0 };
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -148,29 +140,18 @@ bool _service_ignore_cb(LSHandle *handle, LSMessage *message, void *user_data)
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), call_id_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("id"), &id_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	jnumber_get_i32(id_obj, &call_id);
-
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->user_data = service;
 
-	service->driver->ignore(service, call_id, telephonyservice_common_finish, req_data);
+	service->driver->ignore(service, request.id, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -178,10 +159,8 @@ bool _service_hangup_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref id_obj = NULL;
-	const char *payload;
-	int call_id = 0;
+	struct call_id_request request = { .id = 0 };
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -194,28 +173,33 @@ bool _service_hangup_cb(LSHandle *handle, LSMessage *message, void *user_data)
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("id"), &id_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), call_id_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	jnumber_get_i32(id_obj, &call_id);
-
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->user_data = service;
 
-	service->driver->hangup(service, call_id, telephonyservice_common_finish, req_data);
+	service->driver->hangup(service, request.id, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
+
+void telephony_service_call_status_changed_notify(struct telephony_service *service, struct telephony_call_status *call_status)
+{
+	jvalue_ref extended_obj = NULL;
+
+	extended_obj = jobject_create();
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("id"), jnumber_create_i32(call_status->id));
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("state"),
+				jstring_create(telephony_call_state_to_string(call_status->state)));
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("number"),
+				jstring_create(call_status->number ? call_status->number : ""));
+
+	subscriptions_publish(SUBSCRIPTION_TOPIC_CALLS, extended_obj);
+
+	j_release(&extended_obj);
+}
@@ -19,17 +19,23 @@
 #ifndef TELEPHONY_SERVICE_INTERNAL_H_
 #define TELEPHONY_SERVICE_INTERNAL_H_
 
+struct sms_dedup;
+
 struct telephony_service {
 	struct telephony_driver *driver;
 	void *data;
 	LSHandle *palmHandle;
 	LSHandle *webosHandle;
 	bool initialized;
-	bool power_off_pending;
 	bool network_status_query_pending;
 	bool network_registered;
+	/* network status networkStatusQuery subscribers got last */
+	bool network_status_posted;
+	enum telephony_network_state posted_network_state;
+	enum telephony_network_registration posted_network_registration;
 	bool powered;
 	bool data_registered;
+	struct sms_dedup *sms_dedup;
 };
 
 int telephonyservice_common_finish(const struct telephony_error *error, void *data);
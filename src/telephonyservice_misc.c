@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 #include <glib.h>
 #include <pbnjson.h>
 #include <luna-service2/lunaservice.h>
@@ -30,6 +31,13 @@
 #include "telephonyservice_internal.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "logging.h"
+#include "flightrecorder.h"
+#include "subscriptions.h"
+#include "displaystate.h"
+#include "startuptimeline.h"
+#include "statecache.h"
+#include "requestparser.h"
 
 int telephonyservice_common_finish(const struct telephony_error *error, void *data)
 {
@@ -61,6 +69,7 @@ void telephony_service_power_status_notify(struct telephony_service *service, bo
 	jvalue_ref extended_obj = NULL;
 
 	service->powered = power;
+	state_cache_set_power(power);
 
 	if (!service->initialized) {
 		g_message("Service not yet successfully initialized. Not sending power status notification");
@@ -76,6 +85,7 @@ void telephony_service_power_status_notify(struct telephony_service *service, bo
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
 
 	luna_service_post_subscription(service->palmHandle, "/", "powerQuery", reply_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_POWER, extended_obj);
 
 	j_release(&reply_obj);
 }
@@ -83,13 +93,10 @@ void telephony_service_power_status_notify(struct telephony_service *service, bo
 int _service_power_set_finish(const struct telephony_error *error, void *data)
 {
 	struct luna_service_req_data *req_data = data;
-	struct telephony_service *service = req_data->user_data;
 	jvalue_ref reply_obj = NULL;
 
 	reply_obj = jobject_create();
 
-	service->power_off_pending = false;
-
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create((error == NULL)));
 
 	if(!luna_service_message_validate_and_send(req_data->handle, req_data->message, reply_obj))
@@ -100,6 +107,17 @@ int _service_power_set_finish(const struct telephony_error *error, void *data)
 	return 0;
 }
 
+struct power_set_request {
+	char state[16];
+	bool save;
+};
+
+static const struct request_key power_set_request_keys[] = {
+	REQUEST_KEY(struct power_set_request, state, "state", REQUEST_VALUE_STRING, true),
+	REQUEST_KEY(struct power_set_request, save, "save", REQUEST_VALUE_BOOLEAN, false),
+	REQUEST_KEYS_END
+};
+
 /**
  * @brief Set power mode for the telephony service
  *
@@ -112,11 +130,8 @@ bool _service_power_set_cb(LSHandle *handle, LSMessage *message, void *user_data
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
 	bool power = false;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref state_obj = NULL;
-	jvalue_ref save_obj = NULL;
-	const char *payload;
-	bool should_save = false;
+	struct power_set_request request = { .save = false };
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -129,23 +144,17 @@ bool _service_power_set_cb(LSHandle *handle, LSMessage *message, void *user_data
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("state"), &state_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), power_set_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (jstring_equal2(state_obj, J_CSTR_TO_BUF("on")))
+	if (strcmp(request.state, "on") == 0)
 		power = true;
-	else if (jstring_equal2(state_obj, J_CSTR_TO_BUF("off")))
+	else if (strcmp(request.state, "off") == 0)
 		power = false;
-	else if (jstring_equal2(state_obj, J_CSTR_TO_BUF("default"))) {
+	else if (strcmp(request.state, "default") == 0) {
 		power = true;
 	}
 	else {
@@ -153,14 +162,8 @@ bool _service_power_set_cb(LSHandle *handle, LSMessage *message, void *user_data
 		goto cleanup;
 	}
 
-	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("save"), &save_obj)) {
-		jboolean_get(save_obj, &should_save);
-		if (should_save)
-			telephony_settings_store(TELEPHONY_SETTINGS_TYPE_POWER_STATE,
-									 power ? "{\"state\":true}" : "{\"state\":false}");
-	}
-
-	service->power_off_pending = !power;
+	if (request.save)
+		telephony_settings_set_bool(TELEPHONY_SETTINGS_TYPE_POWER_STATE, power);
 
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->user_data = service;
@@ -168,9 +171,6 @@ bool _service_power_set_cb(LSHandle *handle, LSMessage *message, void *user_data
 	service->driver->power_set(service, power, _service_power_set_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -190,6 +190,11 @@ int _service_power_query_finish(const struct telephony_error *error, bool power,
 	if (req_data->subscribed)
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(req_data->subscribed));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_power(power);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("powerState"), jstring_create(power ? "on" : "off"));
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
@@ -219,6 +224,7 @@ bool _service_power_query_cb(LSHandle *handle, LSMessage *message, void *user_da
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
 	struct telephony_error terr;
+	bool power = false;
 
 	if (!service->driver || !service->driver->power_query) {
 		g_warning("No implementation available for service powerQuery API method");
@@ -229,7 +235,11 @@ bool _service_power_query_cb(LSHandle *handle, LSMessage *message, void *user_da
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->subscribed = luna_service_check_for_subscription_and_process(req_data->handle, req_data->message);
 
-	if (!service->initialized) {
+	if (!service->initialized && state_cache_get_power(&power)) {
+		req_data->cached = true;
+		_service_power_query_finish(NULL, power, req_data);
+	}
+	else if (!service->initialized) {
 		// no service -> no power. But still process the subscription and return an answer.
 		terr.code = 1;
 		g_warning("Backend not initialized yet.");
@@ -254,6 +264,11 @@ static int _service_platform_query_finish(const struct telephony_error *error, s
 
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(success));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_platform(platform_info);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("platformType"),
 			jstring_create(telephony_platform_type_to_string(platform_info->platform_type)));
@@ -264,6 +279,9 @@ static int _service_platform_query_finish(const struct telephony_error *error, s
 		if (platform_info->carrier != NULL)
 			jobject_put(extended_obj, J_CSTR_TO_JVAL("carrier"), jstring_create(platform_info->carrier));
 
+		if (platform_info->country != NULL)
+			jobject_put(extended_obj, J_CSTR_TO_JVAL("country"), jstring_create(platform_info->country));
+
 		if (platform_info->mcc > 0 && platform_info->mnc > 0) {
 			jobject_put(extended_obj, J_CSTR_TO_JVAL("mcc"), jnumber_create_i32(platform_info->mcc));
 			jobject_put(extended_obj, J_CSTR_TO_JVAL("mnc"), jnumber_create_i32(platform_info->mnc));
@@ -299,6 +317,15 @@ bool _service_platform_query_cb(LSHandle *handle, LSMessage *message, void *user
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
+	struct telephony_platform_info platform_info;
+
+	if (!service->initialized && state_cache_get_platform(&platform_info)) {
+		req_data = luna_service_req_data_new(handle, message);
+		req_data->subscribed = luna_service_check_for_subscription_and_process(req_data->handle, req_data->message);
+		req_data->cached = true;
+		_service_platform_query_finish(NULL, &platform_info, req_data);
+		return true;
+	}
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -332,6 +359,11 @@ static int _service_subscriber_id_query_finish(const struct telephony_error *err
 
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(success));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_subscriber(info);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("platformType"),
 					jstring_create(telephony_platform_type_to_string(info->platform_type)));
@@ -373,6 +405,14 @@ bool _service_subscriber_id_query_cb(LSHandle *handle, LSMessage *message, void
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
+	struct telephony_subscriber_info info;
+
+	if (!service->initialized && state_cache_get_subscriber(&info)) {
+		req_data = luna_service_req_data_new(handle, message);
+		req_data->cached = true;
+		_service_subscriber_id_query_finish(NULL, &info, req_data);
+		return true;
+	}
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -523,16 +563,42 @@ bool _service_is_telephony_ready_cb(LSHandle *handle, LSMessage *message, void *
  * @brief Subscribe for a specific group of events
  *
  * JSON format:
- *    {"events":"<type>"}
+ *    {"events":"<network|signal>"}
+ *  or
+ *    {
+ *       "topics": [ "<signal|registration|operator|sim|power|calls|sms|wan>", ... ],
+ *       "fields": [ "<string>", ... ] # optional, e.g. [ "bars" ]; all fields of the topics if omitted
+ *       "delta": <boolean> # optional, only post changed fields; false if omitted
+ *    }
+ *
+ *  With topics each update is posted as
+ *    {
+ *       "returnValue": true,
+ *       "subscribed": true,
+ *       "topic": "<string>",
+ *       "extended": { ... } # only the requested fields which are part of the update
+ *    }
+ *
+ *  In delta mode the reply contains the current state of each topic
+ *    "snapshot": { "<topic>": { "version": <number>, "extended": { ... } }, ... }
+ *  and updates only carry the changed fields along with
+ *    "delta": true, "version": <number>, "previousVersion": <number>
+ *  A client whose version doesn't match previousVersion missed an update and
+ *  has to subscribe again.
  **/
 bool _service_subscribe_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	jvalue_ref parsed_obj = NULL;
 	jvalue_ref events_obj = NULL;
+	jvalue_ref topics_obj = NULL;
+	jvalue_ref fields_obj = NULL;
+	jvalue_ref delta_obj = NULL;
 	jvalue_ref reply_obj = NULL;
 	bool result = false;
+	bool delta = false;
 	LSError lserror;
 	const char *payload;
+	const char *error_text = NULL;
 	bool subscribed = false;
 
 	payload = LSMessageGetPayload(message);
@@ -542,12 +608,24 @@ bool _service_subscribe_cb(LSHandle *handle, LSMessage *message, void *user_data
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("events"), &events_obj)) {
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("topics"), &topics_obj)) {
+		jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("fields"), &fields_obj);
+
+		if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("delta"), &delta_obj))
+			jboolean_get(delta_obj, &delta);
+
+		if (!subscriptions_add(handle, message, topics_obj, fields_obj, delta, &error_text)) {
+			luna_service_message_reply_custom_error(handle, message, error_text);
+			goto cleanup;
+		}
+
+		subscribed = true;
+	}
+	else if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("events"), &events_obj)) {
 		luna_service_message_reply_error_invalid_params(handle, message);
 		goto cleanup;
 	}
-
-	if (jstring_equal2(events_obj, J_CSTR_TO_BUF("network"))) {
+	else if (jstring_equal2(events_obj, J_CSTR_TO_BUF("network"))) {
 		result = LSSubscriptionAdd(handle, "/networkStatusQuery", message, &lserror);
 		if (!result) {
 			LSErrorPrint(&lserror, stderr);
@@ -577,6 +655,7 @@ bool _service_subscribe_cb(LSHandle *handle, LSMessage *message, void *user_data
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create("success"));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(subscribed));
+	subscriptions_put_snapshot(message, reply_obj);
 
 	if (!luna_service_message_validate_and_send(handle, message, reply_obj)) {
 		luna_service_message_reply_error_internal(handle, message);
@@ -584,9 +663,258 @@ bool _service_subscribe_cb(LSHandle *handle, LSMessage *message, void *user_data
 	}
 
 cleanup:
+	j_release(&reply_obj);
 	j_release(&parsed_obj);
 
 	return true;
 }
 
+/**
+ * @brief Change the log level at runtime
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *       "level": "<error|warning|message|info|debug>",
+ *       "domain": "<string>", # optional, e.g. "Telephony" for all "[Telephony:*]" messages
+ *       "redact": <boolean> # optional, hide message bodies in the log (default); can
+ *                           # only be turned off when the daemon runs with --debug
+ *    }
+ **/
+
+bool _service_log_level_set_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	jvalue_ref parsed_obj = NULL;
+	jvalue_ref level_obj = NULL;
+	jvalue_ref domain_obj = NULL;
+	jvalue_ref redact_obj = NULL;
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref stats_obj = NULL;
+	raw_buffer level_buf;
+	raw_buffer domain_buf;
+	const char *payload;
+	enum log_level level;
+	char *domain = NULL;
+	bool redact = true;
+	struct logging_stats stats;
+
+	payload = LSMessageGetPayload(message);
+	parsed_obj = luna_service_message_parse_and_validate(payload);
+	if (jis_null(parsed_obj)) {
+		luna_service_message_reply_error_bad_json(handle, message);
+		goto cleanup;
+	}
+
+	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("level"), &level_obj)) {
+		luna_service_message_reply_error_bad_json(handle, message);
+		goto cleanup;
+	}
+
+	level_buf = jstring_get(level_obj);
+	if (!log_level_from_string(level_buf.m_str, &level)) {
+		luna_service_message_reply_custom_error(handle, message, "Invalid log level");
+		goto cleanup;
+	}
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("domain"), &domain_obj)) {
+		domain_buf = jstring_get(domain_obj);
+		domain = g_strdup(domain_buf.m_str);
+	}
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("redact"), &redact_obj)) {
+		jboolean_get(redact_obj, &redact);
+		if (!logging_set_redact(redact)) {
+			luna_service_message_reply_custom_error(handle, message,
+													"Redaction can only be turned off in debug mode");
+			goto cleanup;
+		}
+	}
+
+	if (!logging_set_level(domain, level)) {
+		luna_service_message_reply_custom_error(handle, message, "Invalid log domain");
+		goto cleanup;
+	}
+
+	g_message("[Telephony] Log level of %s set to %s", domain ? domain : "all domains",
+			  log_level_to_string(level));
+
+	logging_get_stats(&stats);
+
+	reply_obj = jobject_create();
+	stats_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("redact"), jboolean_create(logging_get_redact()));
+
+	jobject_put(stats_obj, J_CSTR_TO_JVAL("written"), jnumber_create_i32(stats.written));
+	jobject_put(stats_obj, J_CSTR_TO_JVAL("filtered"), jnumber_create_i32(stats.filtered));
+	jobject_put(stats_obj, J_CSTR_TO_JVAL("dropped"), jnumber_create_i32(stats.dropped));
+	jobject_put(stats_obj, J_CSTR_TO_JVAL("rateLimited"), jnumber_create_i32(stats.rate_limited));
+	jobject_put(stats_obj, J_CSTR_TO_JVAL("truncated"), jnumber_create_i32(stats.truncated));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("stats"), stats_obj);
+
+	if(!luna_service_message_validate_and_send(handle, message, reply_obj))
+		luna_service_message_reply_error_internal(handle, message);
+
+cleanup:
+	if (!jis_null(parsed_obj))
+		j_release(&parsed_obj);
+
+	if (!jis_null(reply_obj))
+		j_release(&reply_obj);
+
+	g_free(domain);
+
+	return true;
+}
+
+/**
+ * @brief Write the events recorded by the flight recorder to a file for offline
+ * analysis with webos-telephonyd-flightrec
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *    }
+ *  response:
+ *    {
+ *       "returnValue": <boolean>,
+ *       "path": "<string>"
+ *    }
+ **/
+
+bool _service_flight_recorder_dump_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	jvalue_ref reply_obj = NULL;
+	char path[PATH_MAX];
+
+	if (!flight_recorder_snapshot(path, sizeof(path))) {
+		luna_service_message_reply_custom_error(handle, message, "Failed to dump flight recorder");
+		return true;
+	}
+
+	reply_obj = jobject_create();
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("path"), jstring_create(path));
+
+	if (!luna_service_message_validate_and_send(handle, message, reply_obj))
+		luna_service_message_reply_error_internal(handle, message);
+
+	j_release(&reply_obj);
+
+	return true;
+}
+
+/**
+ * @brief Report how many notifications were posted right away and how many were
+ * held back while the display was off
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *    }
+ *  response:
+ *    {
+ *       "returnValue": <boolean>,
+ *       "displayOn": <boolean>,
+ *       "topics": {
+ *          "<topic>": { "subscribers": <number>, "immediate": <number>,
+ *                       "deferred": <number>, "flushed": <number> },
+ *          ...
+ *       },
+ *       "legacy": { "immediate": <number>, "deferred": <number> }
+ *    }
+ **/
+
+bool _service_notification_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref topics_obj = NULL;
+	jvalue_ref topic_obj = NULL;
+	jvalue_ref legacy_obj = NULL;
+	struct subscription_stats stats;
+	enum subscription_topic topic;
+	unsigned int immediate = 0;
+	unsigned int deferred = 0;
+
+	reply_obj = jobject_create();
+	topics_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("displayOn"), jboolean_create(display_state_is_on()));
+
+	for (topic = 0; topic < SUBSCRIPTION_TOPIC_MAX; topic++) {
+		subscriptions_get_stats(topic, &stats);
+
+		topic_obj = jobject_create();
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("subscribers"), jnumber_create_i32(subscriptions_get_count(topic)));
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("immediate"), jnumber_create_i32(stats.immediate));
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("deferred"), jnumber_create_i32(stats.deferred));
+		jobject_put(topic_obj, J_CSTR_TO_JVAL("flushed"), jnumber_create_i32(stats.flushed));
+		jobject_put(topics_obj, jstring_create(subscription_topic_to_string(topic)), topic_obj);
+	}
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("topics"), topics_obj);
+
+	luna_service_get_deferred_post_counts(&immediate, &deferred);
+
+	legacy_obj = jobject_create();
+	jobject_put(legacy_obj, J_CSTR_TO_JVAL("immediate"), jnumber_create_i32(immediate));
+	jobject_put(legacy_obj, J_CSTR_TO_JVAL("deferred"), jnumber_create_i32(deferred));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("legacy"), legacy_obj);
+
+	if (!luna_service_message_validate_and_send(handle, message, reply_obj))
+		luna_service_message_reply_error_internal(handle, message);
+
+	j_release(&reply_obj);
+
+	return true;
+}
+
+/**
+ * @brief Report when the phases of the service startup were reached
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *    }
+ *  response:
+ *    {
+ *       "returnValue": <boolean>,
+ *       "phases": {
+ *          "<phase>": <microseconds since process start>,
+ *          ...
+ *       }
+ *    }
+ *
+ *  Phases not reached yet are left out.
+ **/
+
+bool _service_startup_timeline_query_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref phases_obj = NULL;
+	int64_t offset = 0;
+	int phase;
+
+	reply_obj = jobject_create();
+	phases_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+
+	for (phase = 0; phase < STARTUP_PHASE_MAX; phase++) {
+		if (startup_timeline_get(phase, &offset))
+			jobject_put(phases_obj, jstring_create(startup_phase_to_string(phase)), jnumber_create_i64(offset));
+	}
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("phases"), phases_obj);
+
+	if (!luna_service_message_validate_and_send(handle, message, reply_obj))
+		luna_service_message_reply_error_internal(handle, message);
+
+	j_release(&reply_obj);
+
+	return true;
+}
+
 // vim:ts=4:sw=4:noexpandtab
@@ -30,15 +30,15 @@
 #include "telephonyservice_internal.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "subscriptions.h"
+#include "startuptimeline.h"
+#include "statecache.h"
 
 void telephony_service_signal_strength_changed_notify(struct telephony_service *service, int bars)
 {
 	jvalue_ref reply_obj = NULL;
 	jvalue_ref signal_obj = NULL;
 
-	if (service->power_off_pending)
-		return;
-
 	reply_obj = jobject_create();
 	signal_obj = jobject_create();
 
@@ -49,7 +49,8 @@ void telephony_service_signal_strength_changed_notify(struct telephony_service *
 	jobject_put(signal_obj, J_CSTR_TO_JVAL("bars"), jnumber_create_i32(bars));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), signal_obj);
 
-	luna_service_post_subscription(service->palmHandle, "/", "signalStrengthQuery", reply_obj);
+	luna_service_post_subscription_deferrable(service->palmHandle, "/", "signalStrengthQuery", reply_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_SIGNAL, signal_obj);
 
 	j_release(&reply_obj);
 }
@@ -59,8 +60,7 @@ void telephony_service_network_status_changed_notify(struct telephony_service *s
 	jvalue_ref reply_obj = NULL;
 	jvalue_ref network_obj = NULL;
 
-	if (service->power_off_pending)
-		return;
+	state_cache_set_network_status(net_status);
 
 	reply_obj = jobject_create();
 	network_obj = jobject_create();
@@ -70,6 +70,8 @@ void telephony_service_network_status_changed_notify(struct telephony_service *s
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create(""));
 
 	service->network_registered = (net_status->state == TELEPHONY_NETWORK_STATE_SERVICE);
+	if (service->network_registered)
+		startup_timeline_mark(STARTUP_PHASE_NETWORK_REGISTERED);
 
 	jobject_put(network_obj, J_CSTR_TO_JVAL("state"),
 				jstring_create(telephony_network_state_to_string(net_status->state)));
@@ -80,7 +82,22 @@ void telephony_service_network_status_changed_notify(struct telephony_service *s
 
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), network_obj);
 
-	luna_service_post_subscription(service->palmHandle, "/", "networkStatusQuery", reply_obj);
+	/* nobody has to react to a new operator name before the user looks at the
+	 * screen again */
+	if (service->network_status_posted &&
+		net_status->state == service->posted_network_state &&
+		net_status->registration == service->posted_network_registration) {
+		luna_service_post_subscription_deferrable(service->palmHandle, "/", "networkStatusQuery", reply_obj);
+	}
+	else {
+		luna_service_post_subscription(service->palmHandle, "/", "networkStatusQuery", reply_obj);
+	}
+
+	service->network_status_posted = true;
+	service->posted_network_state = net_status->state;
+	service->posted_network_registration = net_status->registration;
+	subscriptions_publish(SUBSCRIPTION_TOPIC_REGISTRATION, network_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_OPERATOR, network_obj);
 
 	j_release(&reply_obj);
 }
@@ -185,6 +202,11 @@ static int _service_network_status_query_finish(const struct telephony_error *er
 	if (req_data->subscribed)
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(req_data->subscribed));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_network_status(net_status);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("state"),
 					jstring_create(telephony_network_state_to_string(net_status->state)));
@@ -218,6 +240,7 @@ cleanup:
  *       "errorCode": <integer>,
  *       "errorString": <string>,
  *       "subscribed": <boolean>;
+ *       "cached": <boolean>, # last known state while the backend isn't available
  *       "extended": {
  *           "state": <string>,
  *           "registration": <string>,
@@ -233,6 +256,7 @@ bool _service_network_status_query_cb(LSHandle *handle, LSMessage *message, void
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
 	struct telephony_error terr;
+	struct telephony_network_status net_status;
 
 	if (!service->driver || !service->driver->network_status_query) {
 		g_warning("No implementation available for service networkStatusQuery API method");
@@ -243,7 +267,11 @@ bool _service_network_status_query_cb(LSHandle *handle, LSMessage *message, void
 	req_data = luna_service_req_data_new(handle, message);
 	req_data->subscribed = luna_service_check_for_subscription_and_process(req_data->handle, req_data->message);
 
-	if (!service->initialized) {
+	if (!service->initialized && state_cache_get_network_status(&net_status)) {
+		req_data->cached = true;
+		_service_network_status_query_finish(NULL, &net_status, req_data);
+	}
+	else if (!service->initialized) {
 		// no service -> no networks. But still process the subscription and return an answer.
 		g_warning("Backend not initialized yet.");
 		terr.code = 1;
@@ -453,6 +481,11 @@ static int _service_network_id_query_finish(const struct telephony_error *error,
 	if (req_data->subscribed)
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(req_data->subscribed));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_network_id(id);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("mccmnc"), jstring_create(id));
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
@@ -482,6 +515,7 @@ cleanup:
  *       "errorCode": <integer>,
  *       "errorString": <string>,
  *       "subscribed": <boolean>,
+ *       "cached": <boolean>, # see networkStatusQuery
  *       "extended": {
  *            "mccmnc": <string>,
  *       },
@@ -491,6 +525,15 @@ bool _service_network_id_query_cb(LSHandle *handle, LSMessage *message, void *us
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
+	const char *id = NULL;
+
+	if (!service->initialized && state_cache_get_network_id(&id)) {
+		req_data = luna_service_req_data_new(handle, message);
+		req_data->subscribed = luna_service_check_for_subscription_and_process(req_data->handle, req_data->message);
+		req_data->cached = true;
+		_service_network_id_query_finish(NULL, id, req_data);
+		return true;
+	}
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -663,6 +706,11 @@ static int _service_rat_query_finish(const struct telephony_error *error,
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create(success ? "success" : ""));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_rat(mode);
+
 	if (success) {
 		extended_obj = jobject_create();
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("mode"),
@@ -692,6 +740,7 @@ cleanup:
  *       "returnValue": <boolean>,
  *       "errorCode": <integer>,
  *       "errorString": <string>,
+ *       "cached": <boolean>, # see networkStatusQuery
  *       "extended": {
  *          "mode": <string>,
  *       }
@@ -701,6 +750,14 @@ bool _service_rat_query_cb(LSHandle *handle, LSMessage *message, void *user_data
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
+	enum telephony_radio_access_mode mode;
+
+	if (!service->initialized && state_cache_get_rat(&mode)) {
+		req_data = luna_service_req_data_new(handle, message);
+		req_data->cached = true;
+		_service_rat_query_finish(NULL, mode, req_data);
+		return true;
+	}
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -787,4 +844,83 @@ cleanup:
 	return true;
 }
 
+static int _service_network_filter_stats_query_finish(const struct telephony_error *error,
+															struct telephony_network_filter_stats *stats, void *data)
+{
+	struct luna_service_req_data *req_data = data;
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref extended_obj = NULL;
+	jvalue_ref signal_obj = NULL;
+	jvalue_ref registration_obj = NULL;
+	bool success = (error == NULL);
+
+	reply_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(success));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create(""));
+
+	if (success) {
+		extended_obj = jobject_create();
+
+		signal_obj = jobject_create();
+		jobject_put(signal_obj, J_CSTR_TO_JVAL("raw"), jnumber_create_i32(stats->raw_strength_changes));
+		jobject_put(signal_obj, J_CSTR_TO_JVAL("emitted"), jnumber_create_i32(stats->emitted_strength_changes));
+		jobject_put(extended_obj, J_CSTR_TO_JVAL("signal"), signal_obj);
+
+		registration_obj = jobject_create();
+		jobject_put(registration_obj, J_CSTR_TO_JVAL("raw"), jnumber_create_i32(stats->raw_registration_changes));
+		jobject_put(registration_obj, J_CSTR_TO_JVAL("emitted"),
+					jnumber_create_i32(stats->emitted_registration_changes));
+		jobject_put(extended_obj, J_CSTR_TO_JVAL("registration"), registration_obj);
+
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
+	}
+
+	if(!luna_service_message_validate_and_send(req_data->handle, req_data->message, reply_obj)) {
+		luna_service_message_reply_error_internal(req_data->handle, req_data->message);
+		goto cleanup;
+	}
+
+cleanup:
+	j_release(&reply_obj);
+	luna_service_req_data_free(req_data);
+	return 0;
+}
+
+/**
+ * @brief Query how many signal strength and registration changes the modem
+ * reported and how many of them were passed on to clients
+ *
+ * JSON format:
+ *  request:
+ *    { }
+ *  response:
+ *    {
+ *       "returnValue": <boolean>,
+ *       "errorCode": <integer>,
+ *       "errorText": <string>,
+ *       "extended": {
+ *           "signal": { "raw": <integer>, "emitted": <integer> },
+ *           "registration": { "raw": <integer>, "emitted": <integer> }
+ *       }
+ *    }
+ **/
+bool _service_network_filter_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct telephony_service *service = user_data;
+	struct luna_service_req_data *req_data = NULL;
+
+	if (!service->driver || !service->driver->network_filter_stats_query) {
+		g_warning("No implementation available for service networkFilterStatsQuery API method");
+		luna_service_message_reply_error_not_implemented(handle, message);
+		return true;
+	}
+
+	req_data = luna_service_req_data_new(handle, message);
+	service->driver->network_filter_stats_query(service, _service_network_filter_stats_query_finish, req_data);
+
+	return true;
+}
+
 // vim:ts=4:sw=4:noexpandtab
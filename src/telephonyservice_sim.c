@@ -30,12 +30,55 @@
 #include "telephonyservice_internal.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "subscriptions.h"
+#include "startuptimeline.h"
+#include "statecache.h"
+#include "requestparser.h"
+
+/* PUKs have eight digits, PINs up to eight */
+#define PIN_CODE_SIZE	16
+
+struct pin_request {
+	char pin[PIN_CODE_SIZE];
+};
+
+static const struct request_key pin_request_keys[] = {
+	REQUEST_KEY(struct pin_request, pin, "pin", REQUEST_VALUE_STRING, true),
+	REQUEST_KEYS_END
+};
+
+struct pin_change_request {
+	char old_pin[PIN_CODE_SIZE];
+	char new_pin[PIN_CODE_SIZE];
+};
+
+static const struct request_key pin_change_request_keys[] = {
+	REQUEST_KEY(struct pin_change_request, old_pin, "oldPin", REQUEST_VALUE_STRING, true),
+	REQUEST_KEY(struct pin_change_request, new_pin, "newPin", REQUEST_VALUE_STRING, true),
+	REQUEST_KEYS_END
+};
+
+struct pin_unblock_request {
+	char puk[PIN_CODE_SIZE];
+	char new_pin[PIN_CODE_SIZE];
+};
+
+static const struct request_key pin_unblock_request_keys[] = {
+	REQUEST_KEY(struct pin_unblock_request, puk, "puk", REQUEST_VALUE_STRING, true),
+	REQUEST_KEY(struct pin_unblock_request, new_pin, "newPin", REQUEST_VALUE_STRING, true),
+	REQUEST_KEYS_END
+};
 
 void telephony_service_sim_status_notify(struct telephony_service *service, enum telephony_sim_status sim_status)
 {
 	jvalue_ref reply_obj = NULL;
 	jvalue_ref extended_obj = NULL;
 
+	if (sim_status == TELEPHONY_SIM_STATUS_SIM_READY)
+		startup_timeline_mark(STARTUP_PHASE_SIM_READY);
+
+	state_cache_set_sim_status(sim_status);
+
 	reply_obj = jobject_create();
 	extended_obj = jobject_create();
 
@@ -44,6 +87,7 @@ void telephony_service_sim_status_notify(struct telephony_service *service, enum
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
 
 	luna_service_post_subscription(service->palmHandle, "/", "simStatusQuery", reply_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_SIM, extended_obj);
 
 	j_release(&reply_obj);
 }
@@ -73,6 +117,7 @@ void telephony_service_pin1_status_changed_notify(struct telephony_service *serv
 	create_pin_status_response(reply_obj, pin_status);
 
 	luna_service_post_subscription(service->palmHandle, "/", "pin1StatusQuery", reply_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_SIM, jobject_get(reply_obj, J_CSTR_TO_BUF("extended")));
 
 	j_release(&reply_obj);
 }
@@ -93,6 +138,11 @@ static int _service_sim_status_query_finish(const struct telephony_error *error,
 	if (req_data->subscribed)
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(req_data->subscribed));
 
+	if (req_data->cached)
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	else if (success)
+		state_cache_set_sim_status(sim_status);
+
 	if (success) {
 		jobject_put(extended_obj, J_CSTR_TO_JVAL("state"),
 			jstring_create(telephony_sim_status_to_string(sim_status)));
@@ -123,6 +173,15 @@ bool _service_sim_status_query_cb(LSHandle *handle, LSMessage *message, void *us
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
+	enum telephony_sim_status sim_status;
+
+	if (!service->initialized && state_cache_get_sim_status(&sim_status)) {
+		req_data = luna_service_req_data_new(handle, message);
+		req_data->subscribed = luna_service_check_for_subscription_and_process(req_data->handle, req_data->message);
+		req_data->cached = true;
+		_service_sim_status_query_finish(NULL, sim_status, req_data);
+		return true;
+	}
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -234,10 +293,8 @@ bool _service_pin1_verify_cb(LSHandle *handle, LSMessage *message, void *user_da
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref pin_obj = NULL;
-	const char *payload;
-	raw_buffer pin_buf;
+	struct pin_request request;
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -250,28 +307,17 @@ bool _service_pin1_verify_cb(LSHandle *handle, LSMessage *message, void *user_da
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), pin_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("pin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	pin_buf = jstring_get(pin_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 
-	service->driver->pin1_verify(service, pin_buf.m_str, telephonyservice_common_finish, req_data);
+	service->driver->pin1_verify(service, request.pin, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -285,10 +331,8 @@ bool _service_pin1_enable_cb(LSHandle *handle, LSMessage *message, void *user_da
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref pin_obj = NULL;
-	const char *payload;
-	raw_buffer pin_buf;
+	struct pin_request request;
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -301,28 +345,17 @@ bool _service_pin1_enable_cb(LSHandle *handle, LSMessage *message, void *user_da
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), pin_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("pin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	pin_buf = jstring_get(pin_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 
-	service->driver->pin1_enable(service, pin_buf.m_str, telephonyservice_common_finish, req_data);
+	service->driver->pin1_enable(service, request.pin, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -336,10 +369,8 @@ bool _service_pin1_disable_cb(LSHandle *handle, LSMessage *message, void *user_d
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref pin_obj = NULL;
-	const char *payload;
-	raw_buffer pin_buf;
+	struct pin_request request;
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -352,28 +383,17 @@ bool _service_pin1_disable_cb(LSHandle *handle, LSMessage *message, void *user_d
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), pin_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("pin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	pin_buf = jstring_get(pin_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 
-	service->driver->pin1_disable(service, pin_buf.m_str, telephonyservice_common_finish, req_data);
+	service->driver->pin1_disable(service, request.pin, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -388,10 +408,8 @@ bool _service_pin1_change_cb(LSHandle *handle, LSMessage *message, void *user_da
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref pin_obj = NULL;
-	const char *payload;
-	raw_buffer oldpin_buf, newpin_buf;
+	struct pin_change_request request;
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -404,35 +422,17 @@ bool _service_pin1_change_cb(LSHandle *handle, LSMessage *message, void *user_da
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("oldPin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	oldpin_buf = jstring_get(pin_obj);
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("newPin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), pin_change_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	newpin_buf = jstring_get(pin_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 
-	service->driver->pin1_change(service, oldpin_buf.m_str, newpin_buf.m_str, telephonyservice_common_finish, req_data);
+	service->driver->pin1_change(service, request.old_pin, request.new_pin, telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
@@ -447,10 +447,8 @@ bool _service_pin1_unblock_cb(LSHandle *handle, LSMessage *message, void *user_d
 {
 	struct telephony_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref pin_obj = NULL;
-	const char *payload;
-	raw_buffer puk_buf, newpin_buf;
+	struct pin_unblock_request request;
+	char error_text[REQUEST_ERROR_SIZE];
 
 	if (!service->initialized) {
 		luna_service_message_reply_custom_error(handle, message, "Backend not initialized");
@@ -463,36 +461,18 @@ bool _service_pin1_unblock_cb(LSHandle *handle, LSMessage *message, void *user_d
 		goto cleanup;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), pin_unblock_request_keys, &request, NULL,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("puk"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	puk_buf = jstring_get(pin_obj);
-
-	if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("newPin"), &pin_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
-		goto cleanup;
-	}
-
-	newpin_buf = jstring_get(pin_obj);
-
 	req_data = luna_service_req_data_new(handle, message);
 
-	service->driver->pin1_unblock(service, puk_buf.m_str, newpin_buf.m_str,
+	service->driver->pin1_unblock(service, request.puk, request.new_pin,
 								  telephonyservice_common_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
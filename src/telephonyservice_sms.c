@@ -32,17 +32,94 @@
 #include "telephonyservice.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "logging.h"
+#include "smsdedup.h"
+#include "smsencoding.h"
+#include "smsjournal.h"
+#include "smstxqueue.h"
+#include "timerwheel.h"
+#include "flightrecorder.h"
+#include "subscriptions.h"
 #include <sys/time.h>
 
-GQueue *tx_queue = 0;
+/* Number of recently received messages we remember to detect duplicates which
+ * get delivered again after a modem reset or ofono restart */
+#define SMS_DEDUP_WINDOW_SIZE		256
+#define SMS_DEDUP_STATE_FILE		TELEPHONY_STATE_DIR "/sms-dedup"
+#define SMS_JOURNAL_FILE			TELEPHONY_STATE_DIR "/sms-journal"
+
+/* Outgoing messages by priority class; see smstxqueue.c for how the next one
+ * gets picked */
+struct sms_tx_queue *tx_queue = 0;
 guint tx_timeout = 0;
 gboolean tx_active = FALSE;
+/* Number of segments all queued messages will take on the air */
+unsigned int tx_queued_segments = 0;
+/* Keeps track of the TX state so we can resume after a restart */
+static struct sms_journal *tx_journal = 0;
+
+/* The outbox is fetched from db8 in pages; the next page is only requested
+ * once the TX queue runs low */
+#define OUTBOX_PAGE_SIZE			20
+#define TX_QUEUE_LOW_WATER_MARK		5
+
+/* Transient failures are retried with exponential backoff until the retry
+ * budget is used up; the budget can be changed with the smsRetryBudget setting */
+#define SMS_RETRY_DEFAULT_BUDGET		5
+#define SMS_RETRY_BASE_DELAY_SECONDS	15
+#define SMS_RETRY_MAX_DELAY_SECONDS		(30 * 60)
+
+/* Messages waiting for their next attempt */
+static struct timer_wheel *retry_wheel = 0;
+
+struct retry_stats {
+	unsigned int scheduled;
+	unsigned int transient_failures;
+	unsigned int permanent_failures;
+	unsigned int budget_exhausted;
+};
+
+static struct retry_stats retry_stats;
+
+static gchar *outbox_next_page = 0;
+static bool outbox_query_pending = false;
+
+/* While running we hold our own db8 watch on the outbox; the activity is only
+ * there to launch us when a message is waiting and we're not running */
+static LSMessageToken outbox_watch_token = LSMESSAGE_TOKEN_INVALID;
+
+enum outbox_trigger {
+	OUTBOX_TRIGGER_WATCH = 0,
+	OUTBOX_TRIGGER_ACTIVITY,
+	OUTBOX_TRIGGER_MAX
+};
+
+/* Time from being notified about new outbox messages until the first one is
+ * handed to the modem, per notification path */
+struct trigger_latency {
+	gint64 triggered_at;
+	unsigned int count;
+	gint64 last;
+	gint64 total;
+};
+
+static struct trigger_latency trigger_latencies[OUTBOX_TRIGGER_MAX];
+static enum outbox_trigger last_trigger = OUTBOX_TRIGGER_ACTIVITY;
+static bool trigger_measurement_pending = false;
+
+static void query_outbox(struct telephony_service *service, const char *page);
+static void arm_outbox_watch(struct telephony_service *service);
 
 struct pending_sms {
 	char *id;
 	GQueue *to;
 	char *text;
-	bool inhibit_network_send;
+	enum sms_priority priority;
+	unsigned int segments;
+	/* number of recipients the message was already sent to */
+	unsigned int delivered;
+	/* number of failed attempts so far */
+	unsigned int attempts;
 };
 
 static void process_message(struct telephony_service *service, struct pending_sms *msg);
@@ -88,6 +165,11 @@ void telephony_service_incoming_message_notify(struct telephony_service *service
 	jvalue_ref flags_obj = NULL;
 	jvalue_ref from_obj = NULL;
 
+	if (sms_dedup_check_and_add(service->sms_dedup, message->sender, message->sent_time, message->text)) {
+		g_message("[Telephony:SMS] Dropping duplicate of an already received message");
+		return;
+	}
+
 	req_obj = jobject_create();
 	objects_obj = jarray_create(NULL);
 
@@ -122,6 +204,15 @@ void telephony_service_incoming_message_notify(struct telephony_service *service
 		g_warning("Failed to create db8 message object for incoming SMS message");
 
 	j_release(&req_obj);
+
+	req_obj = jobject_create();
+	jobject_put(req_obj, J_CSTR_TO_JVAL("event"), jstring_create("received"));
+	jobject_put(req_obj, J_CSTR_TO_JVAL("from"), jstring_create(message->sender));
+	jobject_put(req_obj, J_CSTR_TO_JVAL("timestamp"), jnumber_create_i64(message->sent_time));
+
+	subscriptions_publish(SUBSCRIPTION_TOPIC_SMS, req_obj);
+
+	j_release(&req_obj);
 }
 
 static void restart_activity(struct telephony_service *service)
@@ -146,24 +237,19 @@ static bool message_updated_cb(LSHandle *handle, LSMessage *message, void *user_
 {
 	// FIXME parse response and handle result correctly
 
-	g_message("[Telephony:SMS] Message object successfully updated");
+	telephony_message_ratelimited("[Telephony:SMS] Message object successfully updated");
 
 	return true;
 }
 
-static void update_message_status(struct telephony_service *service, const char *id, const char *status)
+static void merge_message_object(struct telephony_service *service, jvalue_ref msg_obj)
 {
 	jvalue_ref req_obj = 0;
 	jvalue_ref objects_obj = 0;
-	jvalue_ref msg_obj = 0;
 
 	req_obj = jobject_create();
 	objects_obj = jarray_create(NULL);
 
-	msg_obj = jobject_create();
-	jobject_put(msg_obj, J_CSTR_TO_JVAL("_id"), jstring_create(id));
-	jobject_put(msg_obj, J_CSTR_TO_JVAL("status"), jstring_create(status));
-
 	jarray_append(objects_obj, msg_obj);
 
 	jobject_put(req_obj, J_CSTR_TO_JVAL("objects"), objects_obj);
@@ -177,6 +263,51 @@ static void update_message_status(struct telephony_service *service, const char
 	j_release(&req_obj);
 }
 
+static void publish_message_status(const char *id, const char *status)
+{
+	jvalue_ref fields_obj = 0;
+
+	fields_obj = jobject_create();
+	jobject_put(fields_obj, J_CSTR_TO_JVAL("event"), jstring_create("status"));
+	jobject_put(fields_obj, J_CSTR_TO_JVAL("id"), jstring_create(id));
+	jobject_put(fields_obj, J_CSTR_TO_JVAL("status"), jstring_create(status));
+
+	subscriptions_publish(SUBSCRIPTION_TOPIC_SMS, fields_obj);
+
+	j_release(&fields_obj);
+}
+
+static void update_message_status(struct telephony_service *service, const char *id, const char *status)
+{
+	jvalue_ref msg_obj = 0;
+
+	flight_recorder_record(FLIGHT_EVENT_SMS_STATE,
+						   g_strcmp0(status, "successful") == 0 ? FLIGHT_SMS_STATE_SUCCESSFUL : FLIGHT_SMS_STATE_FAILED,
+						   0, id);
+
+	msg_obj = jobject_create();
+	jobject_put(msg_obj, J_CSTR_TO_JVAL("_id"), jstring_create(id));
+	jobject_put(msg_obj, J_CSTR_TO_JVAL("status"), jstring_create(status));
+
+	merge_message_object(service, msg_obj);
+	publish_message_status(id, status);
+}
+
+static void mark_message_sending(struct telephony_service *service, struct pending_sms *msg)
+{
+	jvalue_ref msg_obj = 0;
+
+	flight_recorder_record(FLIGHT_EVENT_SMS_STATE, FLIGHT_SMS_STATE_SENDING, msg->segments, msg->id);
+
+	msg_obj = jobject_create();
+	jobject_put(msg_obj, J_CSTR_TO_JVAL("_id"), jstring_create(msg->id));
+	jobject_put(msg_obj, J_CSTR_TO_JVAL("status"), jstring_create("sending"));
+	jobject_put(msg_obj, J_CSTR_TO_JVAL("segmentCount"), jnumber_create_i32(msg->segments));
+
+	merge_message_object(service, msg_obj);
+	publish_message_status(msg->id, "sending");
+}
+
 static void free_pending_message(struct pending_sms *msg)
 {
 	if (!msg)
@@ -188,6 +319,87 @@ static void free_pending_message(struct pending_sms *msg)
 	g_free(msg);
 }
 
+static gboolean tx_timeout_cb(gpointer user_data);
+static void queue_message(struct pending_sms *msg);
+
+static bool is_transient_error(const struct telephony_error *error)
+{
+	switch (error->code) {
+	case TELEPHONY_ERROR_INVALID_ARGUMENT:
+	case TELEPHONY_ERROR_NOT_IMPLEMENTED:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static unsigned int get_retry_budget(void)
+{
+	int budget = 0;
+
+	if (!telephony_settings_get_int(TELEPHONY_SETTINGS_TYPE_SMS_RETRY_BUDGET, &budget) || budget < 0)
+		return SMS_RETRY_DEFAULT_BUDGET;
+
+	return budget;
+}
+
+/* Exponential backoff with the upper half of the delay randomized so messages
+ * which failed together don't hit the network together again */
+static unsigned int get_retry_delay(unsigned int attempt)
+{
+	unsigned int delay = SMS_RETRY_MAX_DELAY_SECONDS;
+
+	if (attempt <= 8)
+		delay = MIN(SMS_RETRY_BASE_DELAY_SECONDS << (attempt - 1), SMS_RETRY_MAX_DELAY_SECONDS);
+
+	return delay / 2 + g_random_int_range(0, delay / 2 + 1);
+}
+
+static void free_retry(void *data)
+{
+	struct cb_data *cbd = data;
+
+	free_pending_message(cbd->user);
+	cb_data_free(cbd);
+}
+
+static void retry_message_cb(void *data)
+{
+	struct cb_data *cbd = data;
+	struct telephony_service *service = cbd->data;
+	struct pending_sms *msg = cbd->user;
+
+	g_message("[Telephony:SMS] Retrying message %s (attempt %u)", msg->id, msg->attempts + 1);
+
+	msg->priority = SMS_PRIORITY_RETRY;
+	queue_message(msg);
+
+	cb_data_free(cbd);
+
+	if (!tx_timeout)
+		tx_timeout = g_timeout_add(1000, tx_timeout_cb, service);
+}
+
+static void schedule_retry(struct telephony_service *service, struct pending_sms *msg)
+{
+	struct cb_data *cbd;
+	unsigned int delay;
+
+	msg->attempts++;
+	delay = get_retry_delay(msg->attempts);
+
+	/* so the retry budget isn't reset by a restart */
+	sms_journal_attempted(tx_journal, msg->id, msg->attempts);
+
+	g_message("[Telephony:SMS] Sending message %s failed; retrying in %u seconds", msg->id, delay);
+
+	cbd = cb_data_new(NULL, service);
+	cbd->user = msg;
+
+	timer_wheel_add(retry_wheel, delay, retry_message_cb, cbd);
+	retry_stats.scheduled++;
+}
+
 static int send_msg_cb(const struct telephony_error* error, void *user_data)
 {
 	struct cb_data *cbd = user_data;
@@ -196,22 +408,45 @@ static int send_msg_cb(const struct telephony_error* error, void *user_data)
 
 	bool success = (error == NULL);
 
-	/* Check if we have any further recipients we need to send the message to */
-	if (success && !g_queue_is_empty(msg->to)) {
-		g_free(cbd);
-		process_message(service, msg);
-		return 0;
+	if (success) {
+		g_free(g_queue_pop_head(msg->to));
+
+		/* Check if we have any further recipients we need to send the message to */
+		if (!g_queue_is_empty(msg->to)) {
+			msg->delivered++;
+			sms_journal_delivered(tx_journal, msg->id, msg->delivered);
+
+			cb_data_free(cbd);
+			process_message(service, msg);
+			return 0;
+		}
+	}
+	else if (!is_transient_error(error)) {
+		retry_stats.permanent_failures++;
+	}
+	else {
+		retry_stats.transient_failures++;
+
+		/* the message stays in the journal so it survives a restart while
+		 * waiting for the next attempt */
+		if (msg->attempts < get_retry_budget()) {
+			schedule_retry(service, msg);
+			goto cleanup;
+		}
+
+		g_warning("[Telephony:SMS] Giving up on message %s after %u attempts", msg->id, msg->attempts + 1);
+		retry_stats.budget_exhausted++;
 	}
 
 	g_message("[Telephony:SMS] sending message %s", success ? "succeedded" : "failed");
 
 	update_message_status(service, msg->id, success ? "successful" : "failed");
-
-	/* FIXME eventually retry failed messages after some time again */
+	sms_journal_done(tx_journal, msg->id);
 
 	free_pending_message(msg);
 
-	g_free(cbd);
+cleanup:
+	cb_data_free(cbd);
 
 	/* now we can send the next message */
 	tx_active = FALSE;
@@ -219,8 +454,6 @@ static int send_msg_cb(const struct telephony_error* error, void *user_data)
 	return 0;
 }
 
-static gboolean tx_timeout_cb(gpointer user_data);
-
 static gboolean restart_tx_queue_cb(gpointer user_data)
 {
 	tx_timeout = g_timeout_add(100, tx_timeout_cb, user_data);
@@ -239,11 +472,22 @@ static void process_message(struct telephony_service *service, struct pending_sm
 	/* block others from sending at the same time */
 	tx_active = TRUE;
 
-	to_addr = g_queue_pop_head(msg->to);
+	if (trigger_measurement_pending) {
+		struct trigger_latency *latency = &trigger_latencies[last_trigger];
 
-	service->driver->send_sms(service, to_addr, msg->text, send_msg_cb, cbd);
+		latency->last = (g_get_monotonic_time() - latency->triggered_at) / 1000;
+		latency->total += latency->last;
+		latency->count++;
+		trigger_measurement_pending = false;
 
-	g_free(to_addr);
+		g_message("[Telephony:SMS] %lld ms from %s notification until handing message to the modem",
+				  (long long) latency->last, last_trigger == OUTBOX_TRIGGER_WATCH ? "watch" : "activity");
+	}
+
+	/* the recipient is only dropped once the message went out to it */
+	to_addr = g_queue_peek_head(msg->to);
+
+	service->driver->send_sms(service, to_addr, msg->text, send_msg_cb, cbd);
 }
 
 static gboolean tx_timeout_cb(gpointer user_data)
@@ -252,13 +496,22 @@ static gboolean tx_timeout_cb(gpointer user_data)
 	struct pending_sms *msg = 0;
 
 	if (tx_active) {
-		g_message("[Telephony:SMS] TX still active. Waiting for next free slot.");
+		g_debug("[Telephony:SMS] TX still active. Waiting for next free slot.");
 		return TRUE;
 	}
 
-	if (tx_queue == NULL || g_queue_is_empty(tx_queue)) {
+	if (sms_tx_queue_is_empty(tx_queue)) {
 		tx_timeout = 0;
-		restart_activity(service);
+
+		/* the TX timeout gets started again once the next page arrived */
+		if (outbox_next_page || outbox_query_pending) {
+			if (!outbox_query_pending)
+				query_outbox(service, outbox_next_page);
+			return FALSE;
+		}
+
+		sms_journal_compact(tx_journal);
+		arm_outbox_watch(service);
 		return FALSE;
 	}
 
@@ -266,35 +519,52 @@ static gboolean tx_timeout_cb(gpointer user_data)
 		/* if service isn't initialized yet we have to wait a bit before trying
 		 * again to send all messages */
 		tx_timeout = g_timeout_add_seconds(5, restart_tx_queue_cb, service);
-		restart_activity(service);
 		return FALSE;
 	}
 
-	msg = g_queue_pop_head(tx_queue);
+	msg = sms_tx_queue_pop(tx_queue, NULL);
 
-	if (msg->inhibit_network_send) {
-		g_message("[Telephony:SMS] didn't send message %s cause it was inhibited to be "
-				  "send over the network but marking it as successful.", msg->id);
+	if (outbox_next_page && !outbox_query_pending &&
+		sms_tx_queue_get_length(tx_queue) < TX_QUEUE_LOW_WATER_MARK)
+		query_outbox(service, outbox_next_page);
 
-		update_message_status(service, msg->id, "successful");
-		free_pending_message(msg);
+	tx_queued_segments -= msg->segments * g_queue_get_length(msg->to);
 
-		return TRUE;
-	}
+	g_message("[Telephony:SMS] Sending %s message %s (%u segments per recipient, %u segments left in queue)",
+			  sms_priority_to_string(msg->priority), msg->id, msg->segments, tx_queued_segments);
 
 	process_message(service, msg);
 
 	return TRUE;
 }
 
+static void queue_message(struct pending_sms *msg)
+{
+	unsigned int segments = msg->segments * g_queue_get_length(msg->to);
+
+	/* if we're the first one using it then create the queue */
+	if (!tx_queue)
+		tx_queue = sms_tx_queue_new();
+
+	sms_tx_queue_push(tx_queue, msg->priority, msg, segments);
+	tx_queued_segments += segments;
+}
+
 static bool query_pending_messages_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct telephony_service *service = user_data;
 	const char *payload = 0;
 	jvalue_ref parsed_obj = 0;
 	jvalue_ref results_obj = 0;
+	jvalue_ref next_obj = 0;
+	raw_buffer next_buf;
 	int n = 0, m = 0;
 
+	outbox_query_pending = false;
+
+	g_free(outbox_next_page);
+	outbox_next_page = 0;
+
 	// FIXME:
 	// - record all messages in a list and sent them one after another and mark them
 	// as successfully sent in the database
@@ -309,6 +579,11 @@ static bool query_pending_messages_cb(LSHandle *handle, LSMessage *message, void
 	    !jis_array(results_obj))
 		goto cleanup;
 
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("next"), &next_obj)) {
+		next_buf = jstring_get(next_obj);
+		outbox_next_page = g_strdup(next_buf.m_str);
+	}
+
 	for (n = 0; n < jarray_size(results_obj); n++) {
 		jvalue_ref result_obj = jarray_get(results_obj, n);
 		jvalue_ref id_obj = 0;
@@ -316,11 +591,16 @@ static bool query_pending_messages_cb(LSHandle *handle, LSMessage *message, void
 		jvalue_ref text_obj = 0;
 		jvalue_ref addr_obj = 0;
 		jvalue_ref inhibit_network_send_obj = 0;
+		jvalue_ref priority_obj = 0;
 		raw_buffer id_buf;
+		raw_buffer priority_buf;
 		raw_buffer addr_buf;
 		raw_buffer text_buf;
+		struct sms_segment_info segment_info;
 		struct pending_sms *msg;
 		GQueue *recipients = 0;
+		bool inhibit_network_send = false;
+		enum sms_priority priority = SMS_PRIORITY_INTERACTIVE;
 
 		if (!jobject_get_exists(result_obj, J_CSTR_TO_BUF("_id"), &id_obj)) {
 			g_warning("Found pending outgoing SMS message without a id. Skipping it.");
@@ -329,6 +609,29 @@ static bool query_pending_messages_cb(LSHandle *handle, LSMessage *message, void
 
 		id_buf = jstring_get(id_obj);
 
+		/* already queued when we resumed from the journal */
+		if (sms_journal_contains(tx_journal, id_buf.m_str))
+			continue;
+
+		/* inhibited messages never go on the air so they don't have to wait
+		 * for their turn in the queue */
+		if (jobject_get_exists(result_obj, J_CSTR_TO_BUF("inhibitNetworkSend"), &inhibit_network_send_obj))
+			jboolean_get(inhibit_network_send_obj, &inhibit_network_send);
+
+		if (inhibit_network_send) {
+			g_message("[Telephony:SMS] didn't send message %s cause it was inhibited to be "
+					  "send over the network but marking it as successful.", id_buf.m_str);
+			update_message_status(service, id_buf.m_str, "successful");
+			continue;
+		}
+
+		/* messages the user is waiting for are the default; senders of bulk
+		 * traffic have to say so */
+		if (jobject_get_exists(result_obj, J_CSTR_TO_BUF("txPriority"), &priority_obj)) {
+			priority_buf = jstring_get(priority_obj);
+			priority = sms_priority_from_string(priority_buf.m_str, SMS_PRIORITY_INTERACTIVE);
+		}
+
 		if (!jobject_get_exists(result_obj, J_CSTR_TO_BUF("to"), &to_obj)) {
 			g_warning("Found pending outgoing SMS message without a recipient. Skipping it.");
 			update_message_status(service, id_buf.m_str, "failed");
@@ -378,28 +681,32 @@ static bool query_pending_messages_cb(LSHandle *handle, LSMessage *message, void
 
 		text_buf = jstring_get(text_obj);
 
-		msg = g_new(struct pending_sms, 1);
+		if (!sms_analyze_text(text_buf.m_str, text_buf.m_len, &segment_info)) {
+			g_warning("Found pending outgoing SMS message with invalid text. Skipping it.");
+			g_queue_free_full(recipients, g_free);
+			update_message_status(service, id_buf.m_str, "failed");
+			continue;
+		}
+
+		msg = g_new0(struct pending_sms, 1);
 
 		g_message("New message to %s", addr_buf.m_str);
 
 		msg->id = g_strdup(id_buf.m_str);
 		msg->to = recipients;
 		msg->text = g_strdup(text_buf.m_str);
-		msg->inhibit_network_send = false;
-
-		if (jobject_get_exists(result_obj, J_CSTR_TO_BUF("inhibitNetworkSend"), &inhibit_network_send_obj))
-			jboolean_get(inhibit_network_send_obj, &msg->inhibit_network_send);
+		msg->priority = priority;
+		msg->segments = segment_info.segments;
+		msg->delivered = 0;
 
-		/* if we're the first one using it then create the queue */
-		if (!tx_queue)
-			tx_queue = g_queue_new();
+		queue_message(msg);
 
-		g_queue_push_tail(tx_queue, msg);
+		sms_journal_queued(tx_journal, msg->id, msg->to, msg->text, false, msg->segments);
 
-		update_message_status(service, id_buf.m_str, "sending");
+		mark_message_sending(service, msg);
 	}
 
-	g_message("[Telephony:SMS] tx_timeout %d", tx_timeout);
+	g_debug("[Telephony:SMS] tx_timeout %d", tx_timeout);
 
 	/* if the tx queue isn't already processed trigger it */
 	if (!tx_timeout) {
@@ -413,22 +720,12 @@ cleanup:
 	return true;
 }
 
-bool _service_internal_send_sms_from_db_cb(LSHandle *handle, LSMessage *message, void *user_data)
+static jvalue_ref create_outbox_where_obj(void)
 {
-	struct telephony_service *service = user_data;
-	jvalue_ref req_obj = 0;
-	jvalue_ref query_obj = 0;
 	jvalue_ref where_obj = 0;
 	jvalue_ref folder_obj = 0;
 	jvalue_ref status_obj = 0;
 
-	luna_service_message_reply_success(handle, message);
-
-	req_obj = jobject_create();
-	query_obj = jobject_create();
-
-	jobject_put(query_obj, J_CSTR_TO_JVAL("from"), jstring_create("com.palm.smsmessage:1"));
-
 	where_obj = jarray_create(0);
 
 	folder_obj = jobject_create();
@@ -445,24 +742,276 @@ bool _service_internal_send_sms_from_db_cb(LSHandle *handle, LSMessage *message,
 
 	jarray_append(where_obj, status_obj);
 
-	jobject_put(query_obj, J_CSTR_TO_JVAL("where"), where_obj);
+	return where_obj;
+}
+
+static void query_outbox(struct telephony_service *service, const char *page)
+{
+	jvalue_ref req_obj = 0;
+	jvalue_ref query_obj = 0;
+	jvalue_ref select_obj = 0;
+
+	req_obj = jobject_create();
+	query_obj = jobject_create();
+
+	jobject_put(query_obj, J_CSTR_TO_JVAL("from"), jstring_create("com.palm.smsmessage:1"));
+
+	/* we're only interested in the few properties we need for sending */
+	select_obj = jarray_create(0);
+	jarray_append(select_obj, jstring_create("_id"));
+	jarray_append(select_obj, jstring_create("to"));
+	jarray_append(select_obj, jstring_create("messageText"));
+	jarray_append(select_obj, jstring_create("inhibitNetworkSend"));
+	jarray_append(select_obj, jstring_create("txPriority"));
+
+	jobject_put(query_obj, J_CSTR_TO_JVAL("select"), select_obj);
+
+	jobject_put(query_obj, J_CSTR_TO_JVAL("where"), create_outbox_where_obj());
+
 	jobject_put(query_obj, J_CSTR_TO_JVAL("orderBy"), jstring_create("localTimestamp"));
+	jobject_put(query_obj, J_CSTR_TO_JVAL("limit"), jnumber_create_i32(OUTBOX_PAGE_SIZE));
+
+	if (page)
+		jobject_put(query_obj, J_CSTR_TO_JVAL("page"), jstring_create(page));
 
 	jobject_put(req_obj, J_CSTR_TO_JVAL("query"), query_obj);
 
-	if (!luna_service_call_validate_and_send(service->palmHandle, "luna://com.palm.db/find",
-	                                         req_obj, query_pending_messages_cb, service))
+	if (luna_service_call_validate_and_send(service->palmHandle, "luna://com.palm.db/find",
+											req_obj, query_pending_messages_cb, service))
+		outbox_query_pending = true;
+	else
 		// FIXME eventually add a time to try again a bit later but if this fails
 		// something should be really broken and it doubtfull that a later try will
 		// work again.
 		g_warning("Failed to query for pending SMS messages!?");
 
 	j_release(&req_obj);
+}
+
+static void outbox_triggered(struct telephony_service *service, enum outbox_trigger trigger)
+{
+	if (!trigger_measurement_pending) {
+		trigger_latencies[trigger].triggered_at = g_get_monotonic_time();
+		last_trigger = trigger;
+		trigger_measurement_pending = true;
+	}
+
+	/* a query already in flight will be followed by all further pages anyway */
+	if (!outbox_query_pending)
+		query_outbox(service, NULL);
+}
+
+static bool outbox_watch_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct telephony_service *service = user_data;
+	const char *payload;
+	jvalue_ref parsed_obj = 0;
+	jvalue_ref return_value_obj = 0;
+	jvalue_ref fired_obj = 0;
+	bool return_value = true;
+	bool fired = false;
+
+	payload = LSMessageGetPayload(message);
+	parsed_obj = luna_service_message_parse_and_validate(payload);
+	if (jis_null(parsed_obj))
+		return true;
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("returnValue"), &return_value_obj))
+		jboolean_get(return_value_obj, &return_value);
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("fired"), &fired_obj))
+		jboolean_get(fired_obj, &fired);
+
+	if (!return_value) {
+		g_warning("[Telephony:SMS] Watch for outgoing messages failed: %s", payload);
+		outbox_watch_token = LSMESSAGE_TOKEN_INVALID;
+		goto cleanup;
+	}
+
+	if (!fired)
+		goto cleanup;
+
+	/* a db8 watch only fires once; we arm it again once the TX queue is idle
+	 * as until then it would fire right away again for the messages we're
+	 * still processing */
+	LSCallCancel(handle, outbox_watch_token, NULL);
+	outbox_watch_token = LSMESSAGE_TOKEN_INVALID;
+
+	outbox_triggered(service, OUTBOX_TRIGGER_WATCH);
+
+cleanup:
+	j_release(&parsed_obj);
+
+	return true;
+}
+
+static void arm_outbox_watch(struct telephony_service *service)
+{
+	jvalue_ref req_obj = 0;
+	jvalue_ref query_obj = 0;
+
+	if (outbox_watch_token != LSMESSAGE_TOKEN_INVALID)
+		return;
+
+	req_obj = jobject_create();
+	query_obj = jobject_create();
+
+	jobject_put(query_obj, J_CSTR_TO_JVAL("from"), jstring_create("com.palm.smsmessage:1"));
+	jobject_put(query_obj, J_CSTR_TO_JVAL("where"), create_outbox_where_obj());
+
+	jobject_put(req_obj, J_CSTR_TO_JVAL("query"), query_obj);
+
+	if (!luna_service_call_multi_validate_and_send(service->palmHandle, "luna://com.palm.db/watch",
+												   req_obj, outbox_watch_cb, service, &outbox_watch_token)) {
+		g_warning("[Telephony:SMS] Failed to watch for outgoing messages; falling back to activity");
+		outbox_watch_token = LSMESSAGE_TOKEN_INVALID;
+		restart_activity(service);
+	}
+
+	j_release(&req_obj);
+}
+
+bool _service_internal_send_sms_from_db_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct telephony_service *service = user_data;
+
+	luna_service_message_reply_success(handle, message);
+
+	outbox_triggered(service, OUTBOX_TRIGGER_ACTIVITY);
+
+	return true;
+}
+
+bool _service_sms_stats_query_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct telephony_service *service = user_data;
+	jvalue_ref reply_obj = NULL;
+	jvalue_ref extended_obj = NULL;
+	jvalue_ref latency_obj = NULL;
+	jvalue_ref queued_obj = NULL;
+	jvalue_ref retry_obj = NULL;
+	int n;
+
+	reply_obj = jobject_create();
+	extended_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("duplicatesDropped"),
+				jnumber_create_i32(sms_dedup_get_hits(service->sms_dedup)));
+
+	for (n = 0; n < OUTBOX_TRIGGER_MAX; n++) {
+		latency_obj = jobject_create();
+		jobject_put(latency_obj, J_CSTR_TO_JVAL("count"), jnumber_create_i32(trigger_latencies[n].count));
+		jobject_put(latency_obj, J_CSTR_TO_JVAL("lastMs"), jnumber_create_i64(trigger_latencies[n].last));
+		jobject_put(latency_obj, J_CSTR_TO_JVAL("averageMs"),
+					jnumber_create_i64(trigger_latencies[n].count > 0 ?
+									   trigger_latencies[n].total / trigger_latencies[n].count : 0));
+		jobject_put(extended_obj, n == OUTBOX_TRIGGER_WATCH ? J_CSTR_TO_JVAL("watchLatency") :
+					J_CSTR_TO_JVAL("activityLatency"), latency_obj);
+	}
+
+	queued_obj = jobject_create();
+	for (n = 0; n < SMS_PRIORITY_MAX; n++)
+		jobject_put(queued_obj, jstring_create(sms_priority_to_string(n)),
+					jnumber_create_i32(sms_tx_queue_get_class_length(tx_queue, n)));
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("queued"), queued_obj);
+
+	retry_obj = jobject_create();
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("pending"), jnumber_create_i32(timer_wheel_get_count(retry_wheel)));
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("scheduled"), jnumber_create_i32(retry_stats.scheduled));
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("transientFailures"), jnumber_create_i32(retry_stats.transient_failures));
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("permanentFailures"), jnumber_create_i32(retry_stats.permanent_failures));
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("budgetExhausted"), jnumber_create_i32(retry_stats.budget_exhausted));
+	jobject_put(retry_obj, J_CSTR_TO_JVAL("budget"), jnumber_create_i32(get_retry_budget()));
+	jobject_put(extended_obj, J_CSTR_TO_JVAL("retry"), retry_obj);
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), extended_obj);
+
+	if(!luna_service_message_validate_and_send(handle, message, reply_obj))
+		luna_service_message_reply_error_internal(handle, message);
+
+	j_release(&reply_obj);
 
 	return true;
 }
 
+/* Queues all messages the journal has as not yet done so we can continue to
+ * send them right away without waiting for db8 */
+static void resume_from_journal(struct telephony_service *service)
+{
+	const GList *iter, *next;
+	struct sms_journal_entry *entry;
+	struct pending_sms *msg;
+	unsigned int n;
+
+	for (iter = sms_journal_get_pending(tx_journal); iter != NULL; iter = next) {
+		next = g_list_next(iter);
+		entry = iter->data;
+
+		msg = g_new0(struct pending_sms, 1);
+		msg->id = g_strdup(entry->id);
+		msg->text = g_strdup(entry->text);
+		/* these were interrupted by us going down so they don't get to jump
+		 * ahead of what the user is sending right now */
+		msg->priority = SMS_PRIORITY_RETRY;
+		msg->segments = entry->segments;
+		msg->delivered = entry->delivered;
+		msg->attempts = entry->attempts;
+		msg->to = g_queue_new();
+
+		/* skip all recipients which already got the message */
+		for (n = entry->delivered; entry->to[n] != NULL; n++)
+			g_queue_push_tail(msg->to, g_strdup(entry->to[n]));
+
+		/* we went down before we could mark it as done */
+		if (g_queue_is_empty(msg->to) || entry->inhibit_network_send) {
+			update_message_status(service, msg->id, "successful");
+			sms_journal_done(tx_journal, msg->id);
+			free_pending_message(msg);
+			continue;
+		}
+
+		queue_message(msg);
+
+		g_message("[Telephony:SMS] Resuming message %s with %u of %u recipients left",
+				  msg->id, g_queue_get_length(msg->to), g_strv_length(entry->to));
+	}
+
+	if (!sms_tx_queue_is_empty(tx_queue) && !tx_timeout)
+		tx_timeout = g_timeout_add(1000, tx_timeout_cb, service);
+}
+
 void telephonyservice_sms_setup(struct telephony_service *service)
 {
+	service->sms_dedup = sms_dedup_create(SMS_DEDUP_STATE_FILE, SMS_DEDUP_WINDOW_SIZE);
+	retry_wheel = timer_wheel_new();
+
+	tx_journal = sms_journal_open(SMS_JOURNAL_FILE);
+	resume_from_journal(service);
+
+	/* keep the activity armed so we get launched again for new messages
+	 * after we went down */
 	restart_activity(service);
+
+	if (!tx_timeout)
+		arm_outbox_watch(service);
+}
+
+void telephonyservice_sms_cleanup(struct telephony_service *service)
+{
+	sms_dedup_free(service->sms_dedup);
+	service->sms_dedup = NULL;
+
+	/* messages waiting for a retry are still in the journal and get resumed
+	 * from there next time */
+	timer_wheel_free(retry_wheel, free_retry);
+	retry_wheel = NULL;
+
+	sms_journal_close(tx_journal);
+	tx_journal = NULL;
+
+	if (outbox_watch_token != LSMESSAGE_TOKEN_INVALID) {
+		LSCallCancel(service->palmHandle, outbox_watch_token, NULL);
+		outbox_watch_token = LSMESSAGE_TOKEN_INVALID;
+	}
 }
@@ -22,5 +22,6 @@
 struct telephony_service;
 
 void telephonyservice_sms_setup(struct telephony_service *service);
+void telephonyservice_sms_cleanup(struct telephony_service *service);
 
 #endif // TELEPHONYSERVICE_SMS_H
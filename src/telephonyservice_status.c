@@ -0,0 +1,500 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+#include "telephonydriver.h"
+#include "telephonyservice_internal.h"
+#include "utils.h"
+#include "luna_service_utils.h"
+#include "subscriptions.h"
+
+/* getAllStatus answers what clients otherwise ask with up to eight separate
+ * calls. All driver queries of a request are issued back to back and the
+ * reply goes out once the last of them completed. */
+
+enum status_section {
+	STATUS_SECTION_READY = 0,
+	STATUS_SECTION_POWER,
+	STATUS_SECTION_SIM,
+	STATUS_SECTION_NETWORK,
+	STATUS_SECTION_SIGNAL,
+	STATUS_SECTION_PLATFORM,
+	STATUS_SECTION_SUBSCRIBER,
+	STATUS_SECTION_NETWORK_ID,
+	STATUS_SECTION_MAX
+};
+
+static const char *section_names[STATUS_SECTION_MAX] = {
+	[STATUS_SECTION_READY] = "ready",
+	[STATUS_SECTION_POWER] = "power",
+	[STATUS_SECTION_SIM] = "sim",
+	[STATUS_SECTION_NETWORK] = "network",
+	[STATUS_SECTION_SIGNAL] = "signal",
+	[STATUS_SECTION_PLATFORM] = "platform",
+	[STATUS_SECTION_SUBSCRIBER] = "subscriber",
+	[STATUS_SECTION_NETWORK_ID] = "networkId",
+};
+
+struct status_request {
+	struct telephony_service *service;
+	struct luna_service_req_data *req_data;
+	jvalue_ref extended_obj;
+	guint32 sections;
+	bool subscribe;
+	bool delta;
+	/* driver queries not completed yet plus one while they're issued */
+	unsigned int pending;
+};
+
+#define SECTION_BIT(section)	(1u << (section))
+
+static void put_section_error(struct status_request *req, enum status_section section,
+							  const struct telephony_error *error)
+{
+	jvalue_ref section_obj = NULL;
+
+	section_obj = jobject_create();
+	jobject_put(section_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
+	jobject_put(section_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(error ? error->code : -1));
+	jobject_put(req->extended_obj, jstring_create(section_names[section]), section_obj);
+}
+
+static bool add_subscription(struct status_request *req)
+{
+	jvalue_ref topics_obj = NULL;
+	const char *error_text = NULL;
+	bool result;
+
+	topics_obj = jarray_create(NULL);
+
+	if (req->sections & SECTION_BIT(STATUS_SECTION_POWER))
+		jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_POWER)));
+	if (req->sections & SECTION_BIT(STATUS_SECTION_SIM))
+		jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_SIM)));
+	if (req->sections & SECTION_BIT(STATUS_SECTION_NETWORK)) {
+		jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_REGISTRATION)));
+		jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_OPERATOR)));
+	}
+	if (req->sections & SECTION_BIT(STATUS_SECTION_SIGNAL))
+		jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_SIGNAL)));
+
+	/* the remaining sections don't change while we're running */
+	if (jarray_size(topics_obj) == 0) {
+		j_release(&topics_obj);
+		return false;
+	}
+
+	result = subscriptions_add(req->req_data->handle, req->req_data->message, topics_obj, NULL,
+							   req->delta, &error_text);
+	if (!result)
+		g_warning("Failed to subscribe getAllStatus client: %s", error_text);
+
+	j_release(&topics_obj);
+
+	return result;
+}
+
+static void status_request_unref(struct status_request *req)
+{
+	jvalue_ref reply_obj = NULL;
+	bool subscribed = false;
+
+	if (--req->pending > 0)
+		return;
+
+	/* subscribing only now keeps updates from overtaking the reply */
+	if (req->subscribe)
+		subscribed = add_subscription(req);
+
+	reply_obj = jobject_create();
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create("success"));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(subscribed));
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("extended"), req->extended_obj);
+	subscriptions_put_snapshot(req->req_data->message, reply_obj);
+
+	if (!luna_service_message_validate_and_send(req->req_data->handle, req->req_data->message, reply_obj))
+		luna_service_message_reply_error_internal(req->req_data->handle, req->req_data->message);
+
+	j_release(&reply_obj);
+	luna_service_req_data_free(req->req_data);
+	g_free(req);
+}
+
+static int power_query_finish(const struct telephony_error *error, bool power, void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_POWER, error);
+	}
+	else {
+		section_obj = jobject_create();
+		jobject_put(section_obj, J_CSTR_TO_JVAL("powerState"), jstring_create(power ? "on" : "off"));
+		jobject_put(req->extended_obj, J_CSTR_TO_JVAL("power"), section_obj);
+	}
+
+	status_request_unref(req);
+	return 0;
+}
+
+static int sim_status_query_finish(const struct telephony_error *error, enum telephony_sim_status sim_status,
+								   void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_SIM, error);
+	}
+	else {
+		section_obj = jobject_create();
+		jobject_put(section_obj, J_CSTR_TO_JVAL("state"), jstring_create(telephony_sim_status_to_string(sim_status)));
+		jobject_put(req->extended_obj, J_CSTR_TO_JVAL("sim"), section_obj);
+	}
+
+	status_request_unref(req);
+	return 0;
+}
+
+static int network_status_query_finish(const struct telephony_error *error, struct telephony_network_status *net_status,
+									   void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_NETWORK, error);
+	}
+	else {
+		section_obj = jobject_create();
+		jobject_put(section_obj, J_CSTR_TO_JVAL("state"),
+					jstring_create(telephony_network_state_to_string(net_status->state)));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("registration"),
+					jstring_create(telephony_network_registration_to_string(net_status->registration)));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("networkName"),
+					jstring_create(net_status->name != NULL ? net_status->name : ""));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("causeCode"), jstring_create(""));
+		jobject_put(req->extended_obj, J_CSTR_TO_JVAL("network"), section_obj);
+	}
+
+	status_request_unref(req);
+	return 0;
+}
+
+static int signal_strength_query_finish(const struct telephony_error *error, unsigned int bars, void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_SIGNAL, error);
+	}
+	else {
+		section_obj = jobject_create();
+		jobject_put(section_obj, J_CSTR_TO_JVAL("bars"), jnumber_create_i32(bars));
+		jobject_put(req->extended_obj, J_CSTR_TO_JVAL("signal"), section_obj);
+	}
+
+	status_request_unref(req);
+	return 0;
+}
+
+static int platform_query_finish(const struct telephony_error *error, struct telephony_platform_info *platform_info,
+								 void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_PLATFORM, error);
+		goto done;
+	}
+
+	section_obj = jobject_create();
+	jobject_put(section_obj, J_CSTR_TO_JVAL("platformType"),
+				jstring_create(telephony_platform_type_to_string(platform_info->platform_type)));
+
+	if (platform_info->imei != NULL)
+		jobject_put(section_obj, J_CSTR_TO_JVAL("imei"), jstring_create(platform_info->imei));
+
+	if (platform_info->carrier != NULL)
+		jobject_put(section_obj, J_CSTR_TO_JVAL("carrier"), jstring_create(platform_info->carrier));
+
+	if (platform_info->country != NULL)
+		jobject_put(section_obj, J_CSTR_TO_JVAL("country"), jstring_create(platform_info->country));
+
+	if (platform_info->mcc > 0 && platform_info->mnc > 0) {
+		jobject_put(section_obj, J_CSTR_TO_JVAL("mcc"), jnumber_create_i32(platform_info->mcc));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("mnc"), jnumber_create_i32(platform_info->mnc));
+	}
+
+	if (platform_info->version != NULL)
+		jobject_put(section_obj, J_CSTR_TO_JVAL("version"), jstring_create(platform_info->version));
+
+	jobject_put(req->extended_obj, J_CSTR_TO_JVAL("platform"), section_obj);
+
+done:
+	status_request_unref(req);
+	return 0;
+}
+
+static int subscriber_id_query_finish(const struct telephony_error *error, struct telephony_subscriber_info *info,
+									  void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_SUBSCRIBER, error);
+		goto done;
+	}
+
+	section_obj = jobject_create();
+	jobject_put(section_obj, J_CSTR_TO_JVAL("platformType"),
+				jstring_create(telephony_platform_type_to_string(info->platform_type)));
+
+	switch (info->platform_type) {
+	case TELEPHONY_PLATFORM_TYPE_GSM:
+		jobject_put(section_obj, J_CSTR_TO_JVAL("imsi"), jstring_create(info->imsi));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("msisdn"), jstring_create(info->msisdn));
+		break;
+	case TELEPHONY_PLATFORM_TYPE_CDMA:
+		jobject_put(section_obj, J_CSTR_TO_JVAL("min"), jstring_create(info->min));
+		jobject_put(section_obj, J_CSTR_TO_JVAL("mdn"), jstring_create(info->mdn));
+		break;
+	}
+
+	jobject_put(req->extended_obj, J_CSTR_TO_JVAL("subscriber"), section_obj);
+
+done:
+	status_request_unref(req);
+	return 0;
+}
+
+static int network_id_query_finish(const struct telephony_error *error, const char *id, void *data)
+{
+	struct status_request *req = data;
+	jvalue_ref section_obj = NULL;
+
+	if (error) {
+		put_section_error(req, STATUS_SECTION_NETWORK_ID, error);
+	}
+	else {
+		section_obj = jobject_create();
+		jobject_put(section_obj, J_CSTR_TO_JVAL("mccmnc"), jstring_create(id));
+		jobject_put(req->extended_obj, J_CSTR_TO_JVAL("networkId"), section_obj);
+	}
+
+	status_request_unref(req);
+	return 0;
+}
+
+static void put_ready_section(struct status_request *req)
+{
+	jvalue_ref section_obj = NULL;
+
+	section_obj = jobject_create();
+	jobject_put(section_obj, J_CSTR_TO_JVAL("radioConnected"), jboolean_create(req->service->initialized));
+	jobject_put(section_obj, J_CSTR_TO_JVAL("power"), jboolean_create(req->service->powered));
+	jobject_put(section_obj, J_CSTR_TO_JVAL("ready"), jboolean_create(req->service->initialized));
+	jobject_put(section_obj, J_CSTR_TO_JVAL("networkRegistered"), jboolean_create(req->service->network_registered));
+	jobject_put(section_obj, J_CSTR_TO_JVAL("dataRegistered"), jboolean_create(req->service->data_registered));
+	jobject_put(req->extended_obj, J_CSTR_TO_JVAL("ready"), section_obj);
+}
+
+/* Issues the driver query of a section; sections the driver can't answer get
+ * an error entry right away */
+static void query_section(struct status_request *req, enum status_section section)
+{
+	struct telephony_service *service = req->service;
+	struct telephony_driver *driver = service->driver;
+	struct telephony_error terr;
+
+	terr.code = TELEPHONY_ERROR_NOT_AVAILABLE;
+
+	if (section == STATUS_SECTION_READY) {
+		put_ready_section(req);
+		return;
+	}
+
+	if (!service->initialized || !driver) {
+		put_section_error(req, section, &terr);
+		return;
+	}
+
+	req->pending++;
+
+	switch (section) {
+	case STATUS_SECTION_POWER:
+		if (driver->power_query) {
+			driver->power_query(service, power_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_SIM:
+		if (driver->sim_status_query) {
+			driver->sim_status_query(service, sim_status_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_NETWORK:
+		if (driver->network_status_query) {
+			driver->network_status_query(service, network_status_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_SIGNAL:
+		if (driver->signal_strength_query) {
+			driver->signal_strength_query(service, signal_strength_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_PLATFORM:
+		if (driver->platform_query) {
+			driver->platform_query(service, platform_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_SUBSCRIBER:
+		if (driver->subscriber_id_query) {
+			driver->subscriber_id_query(service, subscriber_id_query_finish, req);
+			return;
+		}
+		break;
+	case STATUS_SECTION_NETWORK_ID:
+		if (driver->network_id_query) {
+			driver->network_id_query(service, network_id_query_finish, req);
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	req->pending--;
+	put_section_error(req, section, &terr);
+}
+
+static bool parse_sections(jvalue_ref sections_obj, guint32 *sections)
+{
+	raw_buffer section_buf;
+	int n, m;
+
+	*sections = 0;
+
+	for (n = 0; n < jarray_size(sections_obj); n++) {
+		section_buf = jstring_get_fast(jarray_get(sections_obj, n));
+
+		for (m = 0; m < STATUS_SECTION_MAX; m++) {
+			if (section_buf.m_str && strlen(section_names[m]) == section_buf.m_len &&
+				strncmp(section_names[m], section_buf.m_str, section_buf.m_len) == 0)
+				break;
+		}
+
+		if (m == STATUS_SECTION_MAX)
+			return false;
+
+		*sections |= SECTION_BIT(m);
+	}
+
+	return *sections != 0;
+}
+
+/**
+ * @brief Query the status of all parts of the service at once
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *       "sections": [ "<ready|power|sim|network|signal|platform|subscriber|networkId>", ... ],
+ *                   # optional; all sections if omitted
+ *       "subscribe": <boolean>, # optional; updates of power, sim, network and signal
+ *       "delta": <boolean> # optional; see subscribe
+ *    }
+ *  response:
+ *    {
+ *       "returnValue": <boolean>,
+ *       "errorCode": <integer>,
+ *       "errorText": <string>,
+ *       "subscribed": <boolean>,
+ *       "extended": {
+ *          "<section>": { ... }, # same fields as the single query method
+ *          ...
+ *       }
+ *    }
+ *
+ *  A section which couldn't be queried contains
+ *    { "returnValue": false, "errorCode": <integer> }
+ *  Updates are posted in the format of the topic subscriptions of the subscribe
+ *  method.
+ **/
+bool _service_get_all_status_cb(LSHandle *handle, LSMessage *message, void *user_data)
+{
+	struct telephony_service *service = user_data;
+	struct status_request *req = NULL;
+	jvalue_ref parsed_obj = NULL;
+	jvalue_ref value_obj = NULL;
+	guint32 sections = (1u << STATUS_SECTION_MAX) - 1;
+	int n;
+
+	parsed_obj = luna_service_message_parse_and_validate(LSMessageGetPayload(message));
+	if (jis_null(parsed_obj)) {
+		luna_service_message_reply_error_bad_json(handle, message);
+		goto cleanup;
+	}
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("sections"), &value_obj) &&
+		(!jis_array(value_obj) || !parse_sections(value_obj, &sections))) {
+		luna_service_message_reply_custom_error(handle, message, "Invalid sections");
+		goto cleanup;
+	}
+
+	req = g_new0(struct status_request, 1);
+	req->service = service;
+	req->req_data = luna_service_req_data_new(handle, message);
+	req->extended_obj = jobject_create();
+	req->sections = sections;
+	req->subscribe = LSMessageIsSubscription(message);
+	req->pending = 1;
+
+	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("delta"), &value_obj))
+		jboolean_get(value_obj, &req->delta);
+
+	for (n = 0; n < STATUS_SECTION_MAX; n++) {
+		if (sections & SECTION_BIT(n))
+			query_section(req, n);
+	}
+
+	status_request_unref(req);
+
+cleanup:
+	j_release(&parsed_obj);
+
+	return true;
+}
+
+// vim:ts=4:sw=4:noexpandtab
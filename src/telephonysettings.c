@@ -16,44 +16,130 @@
 *
 * LICENSE@@@ */
 
+#include <stdlib.h>
 #include <glib.h>
 #include <lunaprefs.h>
 #include <pbnjson.h>
 
 #include "telephonysettings.h"
+#include "luna_service_utils.h"
 
 #define TELEPHONY_LUNA_PREFS_ID		"com.palm.telephony"
 
-static const char *setting_keys[] = {
-	"telephonyPowerState",
+/* Writes are coalesced and flushed to disk once no further change happened for
+ * this amount of time */
+#define SETTINGS_FLUSH_DELAY_SECONDS	2
+
+enum telephony_setting_kind {
+	SETTING_KIND_BOOL = 0,
+	SETTING_KIND_INT
+};
+
+struct telephony_setting {
+	const char *key;
+	enum telephony_setting_kind kind;
+	int value;
+	bool valid;
+	bool dirty;
+};
+
+static struct telephony_setting settings[TELEPHONY_SETTINGS_TYPE_MAX] = {
+	[TELEPHONY_SETTINGS_TYPE_POWER_STATE] = { .key = "telephonyPowerState" },
+	[TELEPHONY_SETTINGS_TYPE_WAN_DISABLED] = { .key = "wanDisabled" },
+	[TELEPHONY_SETTINGS_TYPE_WAN_ROAMGUARD] = { .key = "wanRoamGuard" },
+	[TELEPHONY_SETTINGS_TYPE_SMS_RETRY_BUDGET] = { .key = "smsRetryBudget", .kind = SETTING_KIND_INT },
+	[TELEPHONY_SETTINGS_TYPE_REGISTRATION_DAMPING] = { .key = "registrationDampingMs", .kind = SETTING_KIND_INT },
+	[TELEPHONY_SETTINGS_TYPE_WAN_DORMANCY_TIMEOUT] = { .key = "wanDormancyTimeoutSeconds", .kind = SETTING_KIND_INT },
 };
 
-const char* telephony_settings_load(enum telephony_settings_type type)
+static guint flush_timeout = 0;
+
+/* Boolean settings are stored as {"state":<bool>}, numeric ones as
+ * {"value":<int>} */
+static bool parse_setting(const char *setting_value, struct telephony_setting *setting)
+{
+	jvalue_ref parsed_obj = NULL;
+	jvalue_ref value_obj = NULL;
+	bool result = false;
+	bool state = false;
+
+	parsed_obj = luna_service_message_parse_and_validate(setting_value);
+	if (jis_null(parsed_obj))
+		return false;
+
+	if (setting->kind == SETTING_KIND_INT) {
+		if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("value"), &value_obj))
+			goto cleanup;
+
+		if (jnumber_get_i32(value_obj, &setting->value) != CONV_OK)
+			goto cleanup;
+	}
+	else {
+		if (!jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("state"), &value_obj))
+			goto cleanup;
+
+		if (jboolean_get(value_obj, &state) != CONV_OK)
+			goto cleanup;
+
+		setting->value = state;
+	}
+
+	result = true;
+
+cleanup:
+	j_release(&parsed_obj);
+	return result;
+}
+
+void telephony_settings_init(void)
 {
 	LPErr lperr = LP_ERR_NONE;
 	LPAppHandle handle;
 	char *setting_value = NULL;
+	int n;
 
 	lperr = LPAppGetHandle(TELEPHONY_LUNA_PREFS_ID, &handle);
 	if (lperr) {
 		g_message("Failed to retrieve telephony settings handle");
-		return NULL;
+		return;
 	}
 
-	lperr = LPAppCopyValue(handle, setting_keys[type], &setting_value);
-	LPAppFreeHandle(handle, false);
-	if (lperr) {
-		g_message("Failed in executing LPAppCopyValue for %s", setting_keys[type]);
-		return NULL;
+	for (n = 0; n < TELEPHONY_SETTINGS_TYPE_MAX; n++) {
+		setting_value = NULL;
+
+		lperr = LPAppCopyValue(handle, settings[n].key, &setting_value);
+		if (lperr || !setting_value)
+			continue;
+
+		settings[n].valid = parse_setting(setting_value, &settings[n]);
+		if (!settings[n].valid)
+			g_warning("Ignoring invalid value for setting %s", settings[n].key);
+
+		free(setting_value);
 	}
 
-	return setting_value;
+	LPAppFreeHandle(handle, false);
 }
 
-bool telephony_settings_store(enum telephony_settings_type type, const char *data)
+bool telephony_settings_flush(void)
 {
 	LPErr lperr = LP_ERR_NONE;
 	LPAppHandle handle;
+	gchar *setting_value;
+	bool result = true;
+	bool pending = false;
+	int n;
+
+	if (flush_timeout) {
+		g_source_remove(flush_timeout);
+		flush_timeout = 0;
+	}
+
+	for (n = 0; n < TELEPHONY_SETTINGS_TYPE_MAX; n++)
+		pending |= settings[n].dirty;
+
+	if (!pending)
+		return true;
 
 	lperr = LPAppGetHandle(TELEPHONY_LUNA_PREFS_ID, &handle);
 	if (lperr) {
@@ -61,14 +147,82 @@ bool telephony_settings_store(enum telephony_settings_type type, const char *dat
 		return false;
 	}
 
-	lperr = LPAppSetValue(handle, setting_keys[type], data);
+	for (n = 0; n < TELEPHONY_SETTINGS_TYPE_MAX; n++) {
+		if (!settings[n].dirty)
+			continue;
+
+		if (settings[n].kind == SETTING_KIND_INT)
+			setting_value = g_strdup_printf("{\"value\":%d}", settings[n].value);
+		else
+			setting_value = g_strdup(settings[n].value ? "{\"state\":true}" : "{\"state\":false}");
+
+		lperr = LPAppSetValue(handle, settings[n].key, setting_value);
+		g_free(setting_value);
+		if (lperr) {
+			g_message("Failed to execute LPAppSetValue for %s", settings[n].key);
+			result = false;
+			continue;
+		}
+
+		settings[n].dirty = false;
+	}
+
 	LPAppFreeHandle(handle, true);
-	if (lperr) {
-		g_message("Failed to execute LPAppSetValue for %s", setting_keys[type]);
+
+	return result;
+}
+
+static gboolean flush_timeout_cb(gpointer user_data)
+{
+	flush_timeout = 0;
+	telephony_settings_flush();
+	return FALSE;
+}
+
+void telephony_settings_shutdown(void)
+{
+	if (!telephony_settings_flush())
+		g_warning("Failed to write all pending telephony settings");
+}
+
+bool telephony_settings_get_bool(enum telephony_settings_type type, bool *value)
+{
+	if (type >= TELEPHONY_SETTINGS_TYPE_MAX || !settings[type].valid ||
+		settings[type].kind != SETTING_KIND_BOOL)
 		return false;
-	}
 
-	return false;
+	*value = settings[type].value;
+
+	return true;
+}
+
+bool telephony_settings_get_int(enum telephony_settings_type type, int *value)
+{
+	if (type >= TELEPHONY_SETTINGS_TYPE_MAX || !settings[type].valid ||
+		settings[type].kind != SETTING_KIND_INT)
+		return false;
+
+	*value = settings[type].value;
+
+	return true;
+}
+
+void telephony_settings_set_bool(enum telephony_settings_type type, bool value)
+{
+	if (type >= TELEPHONY_SETTINGS_TYPE_MAX || settings[type].kind != SETTING_KIND_BOOL)
+		return;
+
+	if (settings[type].valid && settings[type].value == value)
+		return;
+
+	settings[type].value = value;
+	settings[type].valid = true;
+	settings[type].dirty = true;
+
+	if (flush_timeout)
+		g_source_remove(flush_timeout);
+
+	flush_timeout = g_timeout_add_seconds(SETTINGS_FLUSH_DELAY_SECONDS, flush_timeout_cb, NULL);
 }
 
 // vim:ts=4:sw=4:noexpandtab
@@ -19,12 +19,26 @@
 #ifndef TELEPHONY_SETTINGS_H_
 #define TELEPHONY_SETTINGS_H_
 
+#include <stdbool.h>
+
 enum telephony_settings_type {
 	TELEPHONY_SETTINGS_TYPE_POWER_STATE = 0,
+	TELEPHONY_SETTINGS_TYPE_WAN_DISABLED,
+	TELEPHONY_SETTINGS_TYPE_WAN_ROAMGUARD,
+	TELEPHONY_SETTINGS_TYPE_SMS_RETRY_BUDGET,
+	TELEPHONY_SETTINGS_TYPE_REGISTRATION_DAMPING,
+	TELEPHONY_SETTINGS_TYPE_WAN_DORMANCY_TIMEOUT,
+	TELEPHONY_SETTINGS_TYPE_MAX
 };
 
-const char* telephony_settings_load(enum telephony_settings_type type);
-bool telephony_settings_store(enum telephony_settings_type type, const char *data);
+void telephony_settings_init(void);
+void telephony_settings_shutdown(void);
+
+bool telephony_settings_get_bool(enum telephony_settings_type type, bool *value);
+void telephony_settings_set_bool(enum telephony_settings_type type, bool value);
+bool telephony_settings_get_int(enum telephony_settings_type type, int *value);
+
+bool telephony_settings_flush(void);
 
 #endif
 
@@ -0,0 +1,203 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <glib.h>
+
+#include "timerwheel.h"
+
+/* A hierarchical timer wheel with a resolution of one second. The first level
+ * covers the next 64 seconds, each further level 64 times the range of the
+ * previous one; timers get cascaded down a level whenever the lower level
+ * wrapped around. Adding a timer is O(1) and all of them are driven by a single
+ * GLib source which is only around as long as there is anything to wait for. */
+
+#define TIMER_WHEEL_BITS		6
+#define TIMER_WHEEL_SIZE		(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK		(TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS		3
+#define TIMER_WHEEL_MAX_DELAY	((1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+struct timer_wheel_timer {
+	guint64 expires;
+	timer_wheel_cb cb;
+	void *data;
+};
+
+struct timer_wheel {
+	GList *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+	/* next tick we have to process */
+	guint64 now;
+	gint64 start;
+	unsigned int count;
+	guint source;
+};
+
+static guint64 current_tick(struct timer_wheel *wheel)
+{
+	return (g_get_monotonic_time() - wheel->start) / G_USEC_PER_SEC;
+}
+
+static void place_timer(struct timer_wheel *wheel, struct timer_wheel_timer *timer)
+{
+	GList **slot;
+	guint64 delta;
+	int level;
+
+	if (timer->expires < wheel->now)
+		timer->expires = wheel->now;
+
+	delta = timer->expires - wheel->now;
+	if (delta > TIMER_WHEEL_MAX_DELAY) {
+		timer->expires = wheel->now + TIMER_WHEEL_MAX_DELAY;
+		delta = TIMER_WHEEL_MAX_DELAY;
+	}
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+		if (delta < (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+			break;
+	}
+
+	slot = &wheel->slots[level][(timer->expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+	*slot = g_list_prepend(*slot, timer);
+}
+
+static unsigned int cascade(struct timer_wheel *wheel, int level)
+{
+	unsigned int index = (wheel->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+	GList *timers, *iter;
+
+	timers = wheel->slots[level][index];
+	wheel->slots[level][index] = NULL;
+
+	for (iter = timers; iter != NULL; iter = g_list_next(iter))
+		place_timer(wheel, iter->data);
+
+	g_list_free(timers);
+
+	return index;
+}
+
+static void process_tick(struct timer_wheel *wheel)
+{
+	unsigned int index = wheel->now & TIMER_WHEEL_MASK;
+	struct timer_wheel_timer *timer;
+	GList *expired, *iter;
+	int level;
+
+	for (level = 1; index == 0 && level < TIMER_WHEEL_LEVELS; level++)
+		index = cascade(wheel, level);
+
+	index = wheel->now & TIMER_WHEEL_MASK;
+	expired = wheel->slots[0][index];
+	wheel->slots[0][index] = NULL;
+
+	/* callbacks are allowed to add new timers */
+	wheel->now++;
+
+	for (iter = expired; iter != NULL; iter = g_list_next(iter)) {
+		timer = iter->data;
+		wheel->count--;
+		timer->cb(timer->data);
+		g_free(timer);
+	}
+
+	g_list_free(expired);
+}
+
+static gboolean tick_cb(gpointer user_data)
+{
+	struct timer_wheel *wheel = user_data;
+	guint64 target = current_tick(wheel);
+
+	/* we might have been woken up late so catch up with all missed ticks */
+	while (wheel->count > 0 && wheel->now <= target)
+		process_tick(wheel);
+
+	if (wheel->count > 0)
+		return TRUE;
+
+	wheel->source = 0;
+	return FALSE;
+}
+
+struct timer_wheel* timer_wheel_new(void)
+{
+	struct timer_wheel *wheel;
+
+	wheel = g_new0(struct timer_wheel, 1);
+	wheel->start = g_get_monotonic_time();
+
+	return wheel;
+}
+
+void timer_wheel_free(struct timer_wheel *wheel, GDestroyNotify destroy)
+{
+	struct timer_wheel_timer *timer;
+	GList *iter;
+	int level, index;
+
+	if (!wheel)
+		return;
+
+	if (wheel->source)
+		g_source_remove(wheel->source);
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (index = 0; index < TIMER_WHEEL_SIZE; index++) {
+			for (iter = wheel->slots[level][index]; iter != NULL; iter = g_list_next(iter)) {
+				timer = iter->data;
+				if (destroy)
+					destroy(timer->data);
+				g_free(timer);
+			}
+
+			g_list_free(wheel->slots[level][index]);
+		}
+	}
+
+	g_free(wheel);
+}
+
+void timer_wheel_add(struct timer_wheel *wheel, unsigned int delay_seconds,
+					 timer_wheel_cb cb, void *data)
+{
+	struct timer_wheel_timer *timer;
+	guint64 now = current_tick(wheel);
+
+	/* nothing to catch up with while nothing was waiting */
+	if (wheel->count == 0)
+		wheel->now = now;
+
+	timer = g_new0(struct timer_wheel_timer, 1);
+	timer->expires = now + (delay_seconds > 0 ? delay_seconds : 1);
+	timer->cb = cb;
+	timer->data = data;
+
+	place_timer(wheel, timer);
+	wheel->count++;
+
+	if (!wheel->source)
+		wheel->source = g_timeout_add_seconds(1, tick_cb, wheel);
+}
+
+unsigned int timer_wheel_get_count(struct timer_wheel *wheel)
+{
+	return wheel ? wheel->count : 0;
+}
+
+// vim:ts=4:sw=4:noexpandtab
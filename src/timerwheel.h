@@ -0,0 +1,37 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <glib.h>
+
+struct timer_wheel;
+
+typedef void (*timer_wheel_cb)(void *data);
+
+struct timer_wheel* timer_wheel_new(void);
+void timer_wheel_free(struct timer_wheel *wheel, GDestroyNotify destroy);
+
+void timer_wheel_add(struct timer_wheel *wheel, unsigned int delay_seconds,
+					 timer_wheel_cb cb, void *data);
+unsigned int timer_wheel_get_count(struct timer_wheel *wheel);
+
+#endif
+
+// vim:ts=4:sw=4:noexpandtab
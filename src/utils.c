@@ -0,0 +1,165 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <luna-service2/lunaservice.h>
+
+#include "utils.h"
+#include "slabpool.h"
+
+/* Both objects are allocated for nearly every request and asynchronous call so
+ * they come from slab pools instead of the heap */
+#define OBJECTS_PER_SLAB		64
+
+static struct slab_pool *req_data_pool = NULL;
+static struct slab_pool *cb_data_pool = NULL;
+
+struct luna_service_req_data *luna_service_req_data_new(LSHandle *handle, LSMessage *message)
+{
+	struct luna_service_req_data *req;
+
+	if (!req_data_pool)
+		req_data_pool = slab_pool_new("luna_service_req_data", sizeof(struct luna_service_req_data),
+									  OBJECTS_PER_SLAB);
+
+	req = slab_pool_alloc0(req_data_pool);
+	req->handle = handle;
+	req->message = message;
+	req->subscribed = false;
+
+	LSMessageRef(req->message);
+
+	return req;
+}
+
+void luna_service_req_data_free(struct luna_service_req_data *req)
+{
+	if (!req)
+		return;
+
+	if (req->message)
+		LSMessageUnref(req->message);
+
+	slab_pool_release(req_data_pool, req);
+}
+
+struct cb_data *cb_data_new(void *cb, void *data)
+{
+	struct cb_data *ret;
+
+	if (!cb_data_pool)
+		cb_data_pool = slab_pool_new("cb_data", sizeof(struct cb_data), OBJECTS_PER_SLAB);
+
+	ret = slab_pool_alloc0(cb_data_pool);
+	ret->cb = cb;
+	ret->data = data;
+	ret->user = NULL;
+
+	return ret;
+}
+
+void cb_data_free(struct cb_data *cbd)
+{
+	if (!cbd)
+		return;
+
+	slab_pool_release(cb_data_pool, cbd);
+}
+
+/* Releases the pools at shutdown; debug builds report what was leaked */
+void utils_pools_shutdown(void)
+{
+	slab_pool_free(req_data_pool);
+	req_data_pool = NULL;
+
+	slab_pool_free(cb_data_pool);
+	cb_data_pool = NULL;
+}
+
+/* Replaces the file atomically like g_file_set_contents, but as it holds
+ * things like the IMSI only we may read it: the directory is created 0700 and
+ * the temporary file which gets renamed over the old one 0600. */
+bool utils_write_private_file(const char *path, const void *contents, gsize length, GError **error)
+{
+	const guchar *data = contents;
+	gchar *dirname, *tmp_path;
+	gssize written;
+	bool result = false;
+	bool created = false;
+	int saved_errno;
+	int fd;
+
+	dirname = g_path_get_dirname(path);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+
+	tmp_path = g_strdup_printf("%s.XXXXXX", path);
+
+	fd = g_mkstemp_full(tmp_path, O_RDWR | O_CLOEXEC, 0600);
+	if (fd < 0)
+		goto failed;
+
+	created = true;
+
+	while (length > 0) {
+		written = write(fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			goto failed;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	if (fsync(fd) < 0)
+		goto failed;
+
+	if (close(fd) < 0) {
+		fd = -1;
+		goto failed;
+	}
+	fd = -1;
+
+	if (g_rename(tmp_path, path) < 0)
+		goto failed;
+
+	result = true;
+	goto cleanup;
+
+failed:
+	saved_errno = errno;
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+				"Failed to write %s: %s", path, g_strerror(saved_errno));
+
+	if (fd >= 0)
+		close(fd);
+	if (created)
+		g_unlink(tmp_path);
+
+cleanup:
+	g_free(tmp_path);
+	return result;
+}
+
+// vim:ts=4:sw=4:noexpandtab
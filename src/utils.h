@@ -22,37 +22,23 @@
 #include <glib.h>
 #include <luna-service2/lunaservice.h>
 
+/* Directory where the daemon keeps state across restarts */
+#define TELEPHONY_STATE_DIR		"/var/lib/webos-telephonyd"
+/* Directory for files which only live as long as the system is up; /run is
+ * always a tmpfs */
+#define TELEPHONY_RUNTIME_DIR	"/run/webos-telephonyd"
+
 struct luna_service_req_data {
 	LSHandle *handle;
 	LSMessage *message;
 	bool subscribed;
+	/* answered from the state cache as the backend isn't available */
+	bool cached;
 	void *user_data;
 };
 
-static inline struct luna_service_req_data *luna_service_req_data_new(LSHandle *handle, LSMessage *message)
-{
-	struct luna_service_req_data *req;
-
-	req = g_new0(struct luna_service_req_data, 1);
-	req->handle = handle;
-	req->message = message;
-	req->subscribed = false;
-
-	LSMessageRef(req->message);
-
-	return req;
-}
-
-static inline void luna_service_req_data_free(struct luna_service_req_data *req)
-{
-	if (!req)
-		return;
-
-	if (req->message)
-		LSMessageUnref(req->message);
-
-	g_free(req);
-}
+struct luna_service_req_data *luna_service_req_data_new(LSHandle *handle, LSMessage *message);
+void luna_service_req_data_free(struct luna_service_req_data *req);
 
 struct cb_data {
 	void *cb;
@@ -60,17 +46,12 @@ struct cb_data {
 	void *user;
 };
 
-static inline struct cb_data *cb_data_new(void *cb, void *data)
-{
-	struct cb_data *ret;
+struct cb_data *cb_data_new(void *cb, void *data);
+void cb_data_free(struct cb_data *cbd);
 
-	ret = g_new0(struct cb_data, 1);
-	ret->cb = cb;
-	ret->data = data;
-	ret->user = NULL;
+void utils_pools_shutdown(void);
 
-	return ret;
-}
+bool utils_write_private_file(const char *path, const void *contents, gsize length, GError **error);
 
 #endif
 
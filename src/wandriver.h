@@ -90,6 +90,14 @@ struct wan_connected_service {
 	int error_code;
 	int cause_code;
 	int mip_failure_code;
+	/* traffic since the context got activated and over its whole lifetime */
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+	guint64 total_rx_bytes;
+	guint64 total_tx_bytes;
+	/* bytes per second */
+	guint32 rx_rate;
+	guint32 tx_rate;
 };
 
 struct wan_status {
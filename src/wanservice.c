@@ -30,6 +30,9 @@
 #include "telephonysettings.h"
 #include "utils.h"
 #include "luna_service_utils.h"
+#include "subscriptions.h"
+#include "statecache.h"
+#include "requestparser.h"
 
 extern GMainLoop *event_loop;
 static GSList *g_driver_list;
@@ -143,6 +146,22 @@ const char* wan_request_status_to_string(enum wan_request_status status)
 	return NULL;
 }
 
+/* Takes over what a client configured last so it survives a restart */
+static void retrieve_configuration_from_settings(struct wan_service *service)
+{
+	bool value;
+
+	if (telephony_settings_get_bool(TELEPHONY_SETTINGS_TYPE_WAN_DISABLED, &value)) {
+		service->configuration.disablewan = value;
+		service->configuration.flags |= WAN_CONFIGURATION_TYPE_DISABLEWAN;
+	}
+
+	if (telephony_settings_get_bool(TELEPHONY_SETTINGS_TYPE_WAN_ROAMGUARD, &value)) {
+		service->configuration.roamguard = value;
+		service->configuration.flags |= WAN_CONFIGURATION_TYPE_ROAMGUARD;
+	}
+}
+
 struct wan_service* wan_service_create(void)
 {
 	struct wan_service *service;
@@ -158,6 +177,7 @@ struct wan_service* wan_service_create(void)
 		return NULL;
 
 	memset(&service->configuration, 0, sizeof(struct wan_configuration));
+	retrieve_configuration_from_settings(service);
 
 	/* take first driver until we have some mechanism to determine the best driver */
 	service->driver = g_driver_list->data;
@@ -181,19 +201,15 @@ struct wan_service* wan_service_create(void)
 		goto error;
 	}
 
-	if (!LSRegisterCategory(service->serviceHandle, "/", _wan_service_methods,
-			NULL, NULL, &error)) {
+	if (!luna_service_register_category(service->serviceHandle, "/", _wan_service_methods,
+			service, &error)) {
 		g_critical("Could not register category for WAN service");
 		LSErrorFree(&error);
-		return NULL;
-	}
-    
-	if (!LSCategorySetData(service->serviceHandle, "/", service, &error)) {
-		g_warning("Could not set data for service category");
-		LSErrorFree(&error);
 		goto error;
 	}
 
+	subscriptions_attach(service->serviceHandle);
+
 	return service;
 
 error:
@@ -316,6 +332,18 @@ static jvalue_ref create_status_update_reply(struct wan_status *status)
 					jnumber_create_i32(wanservice->cause_code));
 		jobject_put(service_obj, J_CSTR_TO_JVAL("mipFailureCode"),
 					jnumber_create_i32(wanservice->mip_failure_code));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("rxBytes"),
+					jnumber_create_i64(wanservice->rx_bytes));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("txBytes"),
+					jnumber_create_i64(wanservice->tx_bytes));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("totalRxBytes"),
+					jnumber_create_i64(wanservice->total_rx_bytes));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("totalTxBytes"),
+					jnumber_create_i64(wanservice->total_tx_bytes));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("rxRate"),
+					jnumber_create_i64(wanservice->rx_rate));
+		jobject_put(service_obj, J_CSTR_TO_JVAL("txRate"),
+					jnumber_create_i64(wanservice->tx_rate));
 
 		jarray_append(connected_services_obj, service_obj);
 	}
@@ -325,15 +353,46 @@ static jvalue_ref create_status_update_reply(struct wan_status *status)
 	return reply_obj;
 }
 
+static void initial_configuration_set_finish(const struct wan_error *error, void *data)
+{
+	if (error)
+		g_warning("Failed to apply the stored WAN configuration");
+}
+
+static void configure_service(struct wan_service *service)
+{
+	if (!service->configuration.flags || !service->driver->set_configuration)
+		return;
+
+	service->driver->set_configuration(service, &service->configuration,
+									   initial_configuration_set_finish, service);
+}
+
+void wan_service_availability_changed_notify(struct wan_service *service, bool available)
+{
+	if (!service)
+		return;
+
+	g_debug("Availability of the WAN service changed to: %s", available ? "available" : "not available");
+
+	if (!service->initialized && available)
+		configure_service(service);
+
+	service->initialized = available;
+}
+
 void wan_service_status_changed_notify(struct wan_service *service, struct wan_status *status)
 {
 	jvalue_ref reply_obj = NULL;
 
+	state_cache_set_wan(status);
+
 	reply_obj = create_status_update_reply(status);
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(true));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 
 	luna_service_post_subscription(service->serviceHandle, "/", "getstatus", reply_obj);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_WAN, reply_obj);
 
 	j_release(&reply_obj);
 }
@@ -343,6 +402,9 @@ void get_status_cb(const struct wan_error *error, struct wan_status *status, voi
 	struct luna_service_req_data *req_data = data;
 	jvalue_ref reply_obj = NULL;
 
+	if (!error)
+		state_cache_set_wan(status);
+
 	reply_obj = create_status_update_reply(status);
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 
@@ -351,14 +413,68 @@ void get_status_cb(const struct wan_error *error, struct wan_status *status, voi
 	luna_service_req_data_free(req_data);
 }
 
+static void get_status_publish_cb(const struct wan_error *error, struct wan_status *status, void *data)
+{
+	jvalue_ref reply_obj = NULL;
+
+	if (error)
+		return;
+
+	state_cache_set_wan(status);
+
+	reply_obj = create_status_update_reply(status);
+	subscriptions_publish(SUBSCRIPTION_TOPIC_WAN, reply_obj);
+
+	j_release(&reply_obj);
+}
+
+/* Delta subscribers are kept by the subscription registry on the wan topic
+ * instead of the getstatus subscription list */
+static bool add_delta_subscription(LSHandle *handle, LSMessage *message)
+{
+	jvalue_ref topics_obj = NULL;
+	const char *error_text = NULL;
+	bool result;
+
+	topics_obj = jarray_create(NULL);
+	jarray_append(topics_obj, jstring_create(subscription_topic_to_string(SUBSCRIPTION_TOPIC_WAN)));
+
+	result = subscriptions_add(handle, message, topics_obj, NULL, true, &error_text);
+	if (!result)
+		g_warning("Failed to add delta subscription for getstatus: %s", error_text);
+
+	j_release(&topics_obj);
+
+	return result;
+}
+
+/**
+ * @brief Query the current WAN status
+ *
+ * JSON format:
+ *  request:
+ *    {
+ *       "subscribe": <boolean>,
+ *       "delta": <boolean> # optional, subscribers only get the changed fields
+ *    }
+ *
+ *  Delta subscribers get a snapshot of the status with its version in the
+ *  reply and updates in the format of the topic subscriptions of the
+ *  telephony service's subscribe method.
+ *
+ *  Until the status was retrieved from the driver once the reply contains the
+ *  last known status (without connected services) and "cached": true.
+ **/
 bool _wan_service_getstatus_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct wan_service *service = user_data;
+	jvalue_ref parsed_obj = NULL;
+	jvalue_ref delta_obj = NULL;
 	jvalue_ref reply_obj = NULL;
 	bool subscribed = false;
+	bool delta = false;
 	struct luna_service_req_data *req_data = NULL;
-
-	reply_obj = jobject_create();
+	struct wan_status cached_status;
 
 	if (!service->driver || !service->driver->get_status) {
 		g_warning("No implementation available for service getstatus API method");
@@ -366,20 +482,42 @@ bool _wan_service_getstatus_cb(LSHandle *handle, LSMessage *message, void *user_
 		return true;
 	}
 
-	subscribed = luna_service_check_for_subscription_and_process(handle, message);
+	parsed_obj = luna_service_message_parse_and_validate(LSMessageGetPayload(message));
+	if (!jis_null(parsed_obj) && jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("delta"), &delta_obj))
+		jboolean_get(delta_obj, &delta);
+
+	if (delta && LSMessageIsSubscription(message))
+		subscribed = add_delta_subscription(handle, message);
+	else
+		subscribed = luna_service_check_for_subscription_and_process(handle, message);
+
+	if (!state_cache_is_live(STATE_CACHE_FIELD_WAN) && state_cache_get_wan(&cached_status)) {
+		reply_obj = create_status_update_reply(&cached_status);
+		jobject_put(reply_obj, J_CSTR_TO_JVAL("cached"), jboolean_create(true));
+	}
+	else {
+		reply_obj = jobject_create();
+	}
 
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create("success"));
 	jobject_put(reply_obj, J_CSTR_TO_JVAL("subscribed"), jboolean_create(subscribed));
+	subscriptions_put_snapshot(message, reply_obj);
 
 	if(!luna_service_message_validate_and_send(handle, message, reply_obj))
 		luna_service_message_reply_error_internal(handle, message);
 
 	j_release(&reply_obj);
+	j_release(&parsed_obj);
 
-	/* Trigger a status update so connected client gets an reply immediately */
-	if (subscribed) {
+	/* Trigger a status update so connected client gets an reply immediately;
+	 * delta subscribers only get something if the status changed since the
+	 * snapshot */
+	if (subscribed && delta) {
+		service->driver->get_status(service, get_status_publish_cb, NULL);
+	}
+	else if (subscribed) {
 		req_data = luna_service_req_data_new(handle, message);
 		service->driver->get_status(service, get_status_cb, req_data);
 	}
@@ -405,6 +543,14 @@ void _service_set_finish(const struct wan_error *error, void *data)
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("errorCode"), jnumber_create_i32(0));
 		jobject_put(reply_obj, J_CSTR_TO_JVAL("errorText"), jstring_create(""));
 	}
+	else {
+		if (is_flag_set(service->configuration.flags, WAN_CONFIGURATION_TYPE_DISABLEWAN))
+			telephony_settings_set_bool(TELEPHONY_SETTINGS_TYPE_WAN_DISABLED,
+										service->configuration.disablewan);
+		if (is_flag_set(service->configuration.flags, WAN_CONFIGURATION_TYPE_ROAMGUARD))
+			telephony_settings_set_bool(TELEPHONY_SETTINGS_TYPE_WAN_ROAMGUARD,
+										service->configuration.roamguard);
+	}
 
 	if(!luna_service_message_validate_and_send(req_data->handle, req_data->message, reply_obj)) {
 		luna_service_message_reply_error_internal(req_data->handle, req_data->message);
@@ -416,14 +562,30 @@ cleanup:
 	luna_service_req_data_free(req_data);
 }
 
+/* indices into set_request_keys */
+enum set_request_key {
+	SET_REQUEST_KEY_DISABLEWAN = 0,
+	SET_REQUEST_KEY_ROAMGUARD,
+};
+
+struct set_request {
+	char disablewan[16];
+	char roamguard[16];
+};
+
+static const struct request_key set_request_keys[] = {
+	[SET_REQUEST_KEY_DISABLEWAN] = REQUEST_KEY(struct set_request, disablewan, "disablewan", REQUEST_VALUE_STRING, false),
+	[SET_REQUEST_KEY_ROAMGUARD] = REQUEST_KEY(struct set_request, roamguard, "roamguard", REQUEST_VALUE_STRING, false),
+	REQUEST_KEYS_END
+};
+
 bool _wan_service_set_cb(LSHandle *handle, LSMessage *message, void *user_data)
 {
 	struct wan_service *service = user_data;
 	struct luna_service_req_data *req_data = NULL;
-	jvalue_ref parsed_obj = NULL;
-	jvalue_ref disablewan_obj = NULL;
-	jvalue_ref roamguard_obj = NULL;
-	const char *payload;
+	struct set_request request;
+	char error_text[REQUEST_ERROR_SIZE];
+	unsigned int present = 0;
 
 	if (!service->driver || !service->driver->set_configuration) {
 		g_warning("No implementation available for service set API method");
@@ -431,29 +593,28 @@ bool _wan_service_set_cb(LSHandle *handle, LSMessage *message, void *user_data)
 		return true;
 	}
 
-	payload = LSMessageGetPayload(message);
-	parsed_obj = luna_service_message_parse_and_validate(payload);
-	if (jis_null(parsed_obj)) {
-		luna_service_message_reply_error_bad_json(handle, message);
+	if (!request_parse(LSMessageGetPayload(message), set_request_keys, &request, &present,
+					   error_text, sizeof(error_text))) {
+		luna_service_message_reply_custom_error(handle, message, error_text);
 		goto cleanup;
 	}
 
 	service->configuration.flags = 0;
 
-	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("disablewan"), &disablewan_obj)) {
-		if (jstring_equal2(disablewan_obj, J_CSTR_TO_BUF("on")))
+	if (present & (1u << SET_REQUEST_KEY_DISABLEWAN)) {
+		if (strcmp(request.disablewan, "on") == 0)
 			service->configuration.disablewan = true;
-		else if (jstring_equal2(disablewan_obj, J_CSTR_TO_BUF("off")))
+		else if (strcmp(request.disablewan, "off") == 0)
 			service->configuration.disablewan = false;
 
 		service->configuration.flags |= WAN_CONFIGURATION_TYPE_DISABLEWAN;
 	}
 
-	if (jobject_get_exists(parsed_obj, J_CSTR_TO_BUF("roamguard"), &roamguard_obj)) {
-		if (jstring_equal2(roamguard_obj, J_CSTR_TO_BUF("enable"))) {
+	if (present & (1u << SET_REQUEST_KEY_ROAMGUARD)) {
+		if (strcmp(request.roamguard, "enable") == 0) {
 			service->configuration.roamguard = true;
 		}
-		else if (jstring_equal2(roamguard_obj, J_CSTR_TO_BUF("disable"))) {
+		else if (strcmp(request.roamguard, "disable") == 0) {
 			service->configuration.roamguard = false;
 		}
 
@@ -466,9 +627,6 @@ bool _wan_service_set_cb(LSHandle *handle, LSMessage *message, void *user_data)
 	service->driver->set_configuration(service, &service->configuration, _service_set_finish, req_data);
 
 cleanup:
-	if (!jis_null(parsed_obj))
-		j_release(&parsed_obj);
-
 	return true;
 }
 
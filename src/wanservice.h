@@ -33,6 +33,7 @@ void* wan_service_get_data(struct wan_service *service);
 void wan_service_register_driver(struct wan_service *service, struct wan_driver *driver);
 void wan_service_unregister_driver(struct wan_service *service, struct wan_driver *driver);
 
+void wan_service_availability_changed_notify(struct wan_service *service, bool available);
 void wan_service_status_changed_notify(struct wan_service *service, struct wan_status *status);
 
 #endif
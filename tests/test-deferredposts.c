@@ -0,0 +1,206 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+#include "luna_service_utils.h"
+#include "displaystate.h"
+#include "flightrecorder.h"
+
+/* The bus calls the helpers make are replaced below: posts are collected and
+ * the display status call is answered by the test acting as the stand-in
+ * display service. */
+
+#define STAND_IN_URI		"luna://org.webosports.test/display/status"
+
+static LSHandle *handle = (LSHandle*) "handle";
+static GPtrArray *posts = NULL;
+static LSFilterFunc display_status_cb = NULL;
+static void *display_status_data = NULL;
+
+bool LSSubscriptionPost(LSHandle *sh, const char *category, const char *method, const char *payload,
+						LSError *lserror)
+{
+	g_ptr_array_add(posts, g_strdup_printf("%s %s", method, payload));
+	return true;
+}
+
+bool LSCall(LSHandle *sh, const char *uri, const char *payload, LSFilterFunc callback, void *user_data,
+			LSMessageToken *token, LSError *lserror)
+{
+	g_assert_cmpstr(uri, ==, STAND_IN_URI);
+
+	display_status_cb = callback;
+	display_status_data = user_data;
+	*token = 1;
+
+	return true;
+}
+
+bool LSCallCancel(LSHandle *sh, LSMessageToken token, LSError *lserror)
+{
+	display_status_cb = NULL;
+	return true;
+}
+
+/* messages of the stand-in are just their payload */
+const char* LSMessageGetPayload(LSMessage *message)
+{
+	return (const char*) message;
+}
+
+void flight_recorder_record(enum flight_event_type type, uint16_t code, uint32_t arg, const char *tag)
+{
+}
+
+static void stand_in_reply(const char *payload)
+{
+	g_assert(display_status_cb != NULL);
+	display_status_cb(handle, (LSMessage*) payload, display_status_data);
+}
+
+static void display_changed_cb(bool on, void *user_data)
+{
+	if (on)
+		luna_service_flush_deferred_posts();
+}
+
+static void post_network_name(const char *name, bool deferrable)
+{
+	jvalue_ref reply_obj = jobject_create();
+
+	jobject_put(reply_obj, J_CSTR_TO_JVAL("networkName"), jstring_create(name));
+
+	if (deferrable)
+		luna_service_post_subscription_deferrable(handle, "/", "networkStatusQuery", reply_obj);
+	else
+		luna_service_post_subscription(handle, "/", "networkStatusQuery", reply_obj);
+
+	j_release(&reply_obj);
+}
+
+static void setup(void)
+{
+	posts = g_ptr_array_new_with_free_func(g_free);
+
+	display_state_set_source(STAND_IN_URI);
+	g_assert(display_state_watch(handle, display_changed_cb, NULL));
+	stand_in_reply("{\"returnValue\":true,\"state\":\"on\"}");
+}
+
+static void teardown(void)
+{
+	display_state_unwatch(handle);
+	display_state_set(true);
+	luna_service_flush_deferred_posts();
+
+	g_ptr_array_free(posts, TRUE);
+	posts = NULL;
+}
+
+static void test_display_on(void)
+{
+	setup();
+
+	post_network_name("first", true);
+	g_assert_cmpuint(posts->len, ==, 1);
+	g_assert(strstr(g_ptr_array_index(posts, 0), "first") != NULL);
+
+	teardown();
+}
+
+/* While the display is off only the last deferrable post is kept and sent
+ * once the display turns on again */
+static void test_deferred_until_display_on(void)
+{
+	unsigned int immediate, deferred, deferred_before;
+
+	setup();
+
+	luna_service_get_deferred_post_counts(&immediate, &deferred_before);
+
+	stand_in_reply("{\"returnValue\":true,\"event\":\"displayOff\"}");
+	g_assert(!display_state_is_on());
+
+	post_network_name("first", true);
+	post_network_name("second", true);
+	g_assert_cmpuint(posts->len, ==, 0);
+
+	luna_service_get_deferred_post_counts(&immediate, &deferred);
+	g_assert_cmpuint(deferred - deferred_before, ==, 2);
+
+	stand_in_reply("{\"returnValue\":true,\"event\":\"displayOn\"}");
+	g_assert(display_state_is_on());
+	g_assert_cmpuint(posts->len, ==, 1);
+	g_assert(strstr(g_ptr_array_index(posts, 0), "networkStatusQuery") != NULL);
+	g_assert(strstr(g_ptr_array_index(posts, 0), "second") != NULL);
+
+	teardown();
+}
+
+/* A post which can't wait replaces the one held back so subscribers don't get
+ * the older state again when the display turns on */
+static void test_superseded(void)
+{
+	setup();
+
+	stand_in_reply("{\"returnValue\":true,\"event\":\"displayOff\"}");
+
+	post_network_name("first", true);
+	post_network_name("second", false);
+	g_assert_cmpuint(posts->len, ==, 1);
+	g_assert(strstr(g_ptr_array_index(posts, 0), "second") != NULL);
+
+	stand_in_reply("{\"returnValue\":true,\"event\":\"displayOn\"}");
+	g_assert_cmpuint(posts->len, ==, 1);
+
+	teardown();
+}
+
+/* Not knowing the display state must never hold posts back */
+static void test_lost_subscription(void)
+{
+	setup();
+
+	stand_in_reply("{\"returnValue\":true,\"event\":\"displayOff\"}");
+	post_network_name("first", true);
+	g_assert_cmpuint(posts->len, ==, 0);
+
+	stand_in_reply("{\"returnValue\":false}");
+	g_assert(display_state_is_on());
+	g_assert_cmpuint(posts->len, ==, 1);
+
+	teardown();
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/deferredposts/display-on", test_display_on);
+	g_test_add_func("/deferredposts/deferred-until-display-on", test_deferred_until_display_on);
+	g_test_add_func("/deferredposts/superseded", test_superseded);
+	g_test_add_func("/deferredposts/lost-subscription", test_lost_subscription);
+
+	return g_test_run();
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,132 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "requestparser.h"
+
+struct test_request {
+	char number[8];
+	bool block;
+	int id;
+};
+
+static const struct request_key test_request_keys[] = {
+	REQUEST_KEY(struct test_request, number, "number", REQUEST_VALUE_STRING, true),
+	REQUEST_KEY(struct test_request, block, "block", REQUEST_VALUE_BOOLEAN, false),
+	REQUEST_KEY(struct test_request, id, "id", REQUEST_VALUE_INTEGER, false),
+	REQUEST_KEYS_END
+};
+
+struct parse_case {
+	const char *payload;
+	bool valid;
+	const char *number;
+	unsigned int present;
+	const char *error_text;
+};
+
+static const struct parse_case cases[] = {
+	{ "{\"number\":\"123\"}", true, "123", 0x1, NULL },
+	{ " { \"x\" : [1, {\"a\": [true, null, -1.5e3]}, \"s\\\"\"], \"number\" : \"12\\u00e9\", "
+	  "\"block\": true, \"id\": -42 } ", true, "12\xc3\xa9", 0x7, NULL },
+	{ "{\"number\":\"\\ud83d\\ude00\"}", true, "\xf0\x9f\x98\x80", 0x1, NULL },
+	{ "{\"number\":\"\\t\\n\\/\"}", true, "\t\n/", 0x1, NULL },
+	/* NUL is fine in values we skip */
+	{ "{\"number\":\"1\",\"other\":\"a\\u0000b\"}", true, "1", 0x1, NULL },
+	/* wrong values */
+	{ "{\"number\":\"123456789\"}", false, NULL, 0, "Value of 'number' is too long" },
+	{ "{\"number\":5}", false, NULL, 0, "Value of 'number' has to be a string" },
+	{ "{\"block\":true}", false, NULL, 0, "Missing required key 'number'" },
+	{ "{\"number\":\"1\",\"id\":1.5}", false, NULL, 0, "Value of 'id' has to be an integer" },
+	{ "{\"number\":\"1\",\"id\":99999999999}", false, NULL, 0, "Value of 'id' is out of range" },
+	{ "{\"number\":\"1\\u0000\"}", false, NULL, 0, "Invalid parameters." },
+	{ "{\"number\\u0000x\":\"1\"}", false, NULL, 0, "Invalid parameters." },
+	{ "{\"number\":\"\xff\xfe\"}", false, NULL, 0, "Invalid parameters." },
+	{ "{\"number\":\"\xc3\"}", false, NULL, 0, "Invalid parameters." },
+	{ "{\"number\":\"\xed\xa0\x80\"}", false, NULL, 0, "Invalid parameters." },
+	/* malformed */
+	{ "{\"number\":\"1\",}", false, NULL, 0, NULL },
+	{ "{\"number\":\"1\"} x", false, NULL, 0, NULL },
+	{ "{\"number\":\"\\ud83d\"}", false, NULL, 0, NULL },
+	{ "{\"number\":\"\\x\"}", false, NULL, 0, NULL },
+	{ "{\"number\":\"1\",\"deep\":[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]}",
+	  false, NULL, 0, NULL },
+	{ "[]", false, NULL, 0, NULL },
+	{ "", false, NULL, 0, NULL },
+};
+
+static void test_parse(void)
+{
+	const struct parse_case *c;
+	struct test_request request;
+	char error_text[REQUEST_ERROR_SIZE];
+	unsigned int present;
+	bool valid;
+	int n;
+
+	for (n = 0; n < G_N_ELEMENTS(cases); n++) {
+		c = &cases[n];
+
+		memset(&request, 0, sizeof(request));
+		error_text[0] = '\0';
+		present = 0;
+
+		valid = request_parse(c->payload, test_request_keys, &request, &present,
+							  error_text, sizeof(error_text));
+		if (valid != c->valid)
+			g_error("'%s': expected %s but got %s (%s)", c->payload,
+					c->valid ? "valid" : "invalid", valid ? "valid" : "invalid", error_text);
+
+		if (valid) {
+			g_assert_cmpstr(request.number, ==, c->number);
+			g_assert_cmpint(present, ==, c->present);
+		}
+		else if (c->error_text) {
+			g_assert_cmpstr(error_text, ==, c->error_text);
+		}
+		else {
+			g_assert(g_str_has_prefix(error_text, "Malformed json"));
+		}
+	}
+}
+
+/* Keys missing in the payload keep their defaults */
+static void test_defaults(void)
+{
+	struct test_request request = { "", true, 7 };
+	char error_text[REQUEST_ERROR_SIZE];
+
+	g_assert(request_parse("{\"number\":\"1\"}", test_request_keys, &request, NULL,
+						   error_text, sizeof(error_text)));
+	g_assert(request.block);
+	g_assert_cmpint(request.id, ==, 7);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/requestparser/parse", test_parse);
+	g_test_add_func("/requestparser/defaults", test_defaults);
+
+	return g_test_run();
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,142 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <glib.h>
+
+#include "signalfilter.h"
+
+/* must match signalfilter.c */
+#define HYSTERESIS		4
+#define MAX_STRENGTH	100
+#define MAX_BARS		5
+#define MAX_SAMPLES		1000
+
+static int expected_bars(int strength)
+{
+	return (strength * MAX_BARS) / MAX_STRENGTH;
+}
+
+/* Keeps feeding the same strength until the filter is settled */
+static void feed_steady(struct signal_filter *filter, int strength)
+{
+	int n;
+
+	signal_filter_update(filter, strength);
+
+	for (n = 0; n < MAX_SAMPLES && !signal_filter_is_settled(filter); n++)
+		signal_filter_settle(filter);
+
+	g_assert(signal_filter_is_settled(filter));
+}
+
+/* Whatever the start was, a steady strength has to end up at its bar count;
+ * only when it is within the hysteresis of the boundary next to the bars may
+ * they stay one off */
+static void test_steady_converges(void)
+{
+	struct signal_filter filter;
+	int start, steady, bars, boundary;
+
+	for (start = 0; start <= MAX_STRENGTH; start++) {
+		for (steady = 0; steady <= MAX_STRENGTH; steady++) {
+			signal_filter_init(&filter);
+			signal_filter_update(&filter, start);
+			feed_steady(&filter, steady);
+
+			bars = signal_filter_get_bars(&filter);
+			if (bars == expected_bars(steady))
+				continue;
+
+			if (bars < expected_bars(steady)) {
+				boundary = (bars + 1) * MAX_STRENGTH / MAX_BARS;
+				g_assert_cmpint(bars, ==, expected_bars(steady) - 1);
+				g_assert_cmpint(steady, <, boundary + HYSTERESIS);
+			}
+			else {
+				boundary = bars * MAX_STRENGTH / MAX_BARS;
+				g_assert_cmpint(bars, ==, expected_bars(steady) + 1);
+				g_assert_cmpint(steady, >=, boundary - HYSTERESIS);
+			}
+		}
+	}
+}
+
+/* A big jump goes straight to the new bar count */
+static void test_jump(void)
+{
+	struct signal_filter filter;
+
+	signal_filter_init(&filter);
+	signal_filter_update(&filter, 25);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 1);
+
+	feed_steady(&filter, 70);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 3);
+
+	feed_steady(&filter, 5);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 0);
+
+	feed_steady(&filter, 100);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 5);
+}
+
+/* When the average skips past a bar the hysteresis is still measured from the
+ * boundary next to the current bars, so they don't get stuck below a steady
+ * signal */
+static void test_skip_bar(void)
+{
+	struct signal_filter filter;
+
+	signal_filter_init(&filter);
+	signal_filter_update(&filter, 0);
+	signal_filter_update(&filter, 92);
+	signal_filter_update(&filter, 92);
+
+	feed_steady(&filter, 40);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 2);
+}
+
+/* A signal hovering around a boundary doesn't change the bars */
+static void test_hysteresis(void)
+{
+	struct signal_filter filter;
+	int n;
+
+	signal_filter_init(&filter);
+	signal_filter_update(&filter, 45);
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 2);
+
+	for (n = 0; n < 50; n++)
+		g_assert(!signal_filter_update(&filter, (n % 2) ? 38 : 41));
+
+	g_assert_cmpint(signal_filter_get_bars(&filter), ==, 2);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/signalfilter/steady-converges", test_steady_converges);
+	g_test_add_func("/signalfilter/jump", test_jump);
+	g_test_add_func("/signalfilter/skip-bar", test_skip_bar);
+	g_test_add_func("/signalfilter/hysteresis", test_hysteresis);
+
+	return g_test_run();
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,129 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "smsjournal.h"
+
+/* must match smsjournal.c */
+#define JOURNAL_MAGIC			0x314a5453
+#define JOURNAL_MIN_SIZE		(64 * 1024)
+#define JOURNAL_RECORD_QUEUED	1
+#define JOURNAL_RECORD_DONE		3
+
+#define ALIGN8(x)	(((x) + 7) & ~((gsize) 7))
+
+static void put_u32(guchar *data, gsize *offset, guint32 value)
+{
+	memcpy(data + *offset, &value, sizeof(value));
+	*offset += sizeof(value);
+}
+
+static void put_string(guchar *data, gsize *offset, const char *str)
+{
+	memcpy(data + *offset, str, strlen(str) + 1);
+	*offset += strlen(str) + 1;
+}
+
+/* Writes the record header for a payload of the given length at offset and
+ * returns where the payload goes */
+static gsize put_record(guchar *data, gsize offset, guint32 type, guint32 length)
+{
+	put_u32(data, &offset, type);
+	put_u32(data, &offset, length);
+
+	return offset;
+}
+
+/* The last record of a journal which got cut off at an odd size fits the file
+ * but its padding doesn't; it has to be dropped without touching anything past
+ * the end */
+static void test_replay_truncated(void)
+{
+	const GList *pending;
+	struct sms_journal *journal;
+	struct sms_journal_entry *entry;
+	gsize size = JOURNAL_MIN_SIZE + 4;
+	gsize offset = 0, payload, length;
+	gchar *dir, *path;
+	guchar *data;
+
+	dir = g_dir_make_tmp("test-smsjournal-XXXXXX", NULL);
+	g_assert(dir != NULL);
+	path = g_build_filename(dir, "journal", NULL);
+
+	data = g_malloc0(size);
+	put_u32(data, &offset, JOURNAL_MAGIC);
+	put_u32(data, &offset, 0);
+
+	/* one pending message ... */
+	length = 3 * sizeof(guint32) + strlen("m1") + 1 + strlen("hello") + 1 + strlen("123") + 1;
+	payload = put_record(data, offset, JOURNAL_RECORD_QUEUED, length);
+	put_u32(data, &payload, 1);
+	put_u32(data, &payload, 0);
+	put_u32(data, &payload, 1);
+	put_string(data, &payload, "m1");
+	put_string(data, &payload, "hello");
+	put_string(data, &payload, "123");
+	offset += 8 + ALIGN8(length);
+
+	/* ... followed by a record reaching up to the unaligned end of the file */
+	length = size - offset - 8;
+	g_assert(length % 8 != 0);
+	payload = put_record(data, offset, JOURNAL_RECORD_DONE, length);
+	memset(data + payload, 'x', length - 1);
+
+	g_assert(g_file_set_contents(path, (const gchar*) data, size, NULL));
+
+	journal = sms_journal_open(path);
+	g_assert(journal != NULL);
+
+	pending = sms_journal_get_pending(journal);
+	g_assert_cmpint(g_list_length((GList*) pending), ==, 1);
+	entry = pending->data;
+	g_assert_cmpstr(entry->id, ==, "m1");
+	g_assert_cmpstr(entry->text, ==, "hello");
+
+	/* the journal has to stay usable */
+	sms_journal_done(journal, "m1");
+	sms_journal_close(journal);
+
+	journal = sms_journal_open(path);
+	g_assert(journal != NULL);
+	g_assert(sms_journal_get_pending(journal) == NULL);
+	sms_journal_close(journal);
+
+	g_unlink(path);
+	g_rmdir(dir);
+	g_free(data);
+	g_free(path);
+	g_free(dir);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/smsjournal/replay-truncated", test_replay_truncated);
+
+	return g_test_run();
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,154 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include "timestamp.h"
+
+/* POSIX TZ rules so the tests don't depend on the installed zoneinfo */
+#define TZ_CET			"CET-1CEST,M3.5.0,M10.5.0/3"
+#define TZ_NEPAL		"NPT-5:45"
+#define TZ_NEWFOUNDLAND	"NST3:30NDT,M3.2.0,M11.1.0"
+
+struct timestamp_case {
+	const char *tz;
+	const char *str;
+	bool valid;
+	gint64 expected;
+};
+
+static const struct timestamp_case cases[] = {
+	/* explicit offsets */
+	{ NULL, "2023-03-26T00:59:59Z", true, 1679792399 },
+	{ NULL, "2012-06-15T12:30:00+0200", true, 1339756200 },
+	{ NULL, "2012-06-15T12:30:00-0500", true, 1339781400 },
+	{ NULL, "2012-06-15T12:30:00+05:30", true, 1339743600 },
+	{ NULL, "2012-06-15T12:30:00+0545", true, 1339742700 },
+	{ NULL, "2012-06-15T12:30:00-0930", true, 1339797600 },
+	{ NULL, "2012-06-15T12:30:00-03:30", true, 1339776000 },
+	{ NULL, "2012-06-15T12:30:00+02", true, 1339756200 },
+	{ NULL, "2012-06-15 12:30:00+02", true, 1339756200 },
+	{ NULL, "2024-02-29T23:59:59Z", true, 1709251199 },
+	{ NULL, "2000-03-01T00:00:00Z", true, 951868800 },
+	{ NULL, "1970-01-01T00:00:00Z", true, 0 },
+	{ NULL, "1969-12-31T23:59:59Z", true, -1 },
+	/* local time right before and after the DST transitions */
+	{ TZ_CET, "2023-03-26T01:59:59", true, 1679792399 },
+	{ TZ_CET, "2023-03-26T03:00:00", true, 1679792400 },
+	{ TZ_CET, "2023-10-29T01:59:59", true, 1698537599 },
+	{ TZ_CET, "2023-10-29T03:00:00", true, 1698544800 },
+	/* zones which are off by a fraction of an hour */
+	{ TZ_NEPAL, "2023-01-01T05:45:00", true, 1672531200 },
+	{ TZ_NEWFOUNDLAND, "2023-07-01T12:00:00", true, 1688221800 },
+	{ TZ_NEWFOUNDLAND, "2023-01-01T12:00:00", true, 1672587000 },
+	/* malformed */
+	{ NULL, NULL, false, 0 },
+	{ NULL, "", false, 0 },
+	{ NULL, "2023-1-01T00:00:00Z", false, 0 },
+	{ NULL, "2023-13-01T00:00:00Z", false, 0 },
+	{ NULL, "2023-01-00T00:00:00Z", false, 0 },
+	{ NULL, "2023-01-01X00:00:00Z", false, 0 },
+	{ NULL, "2023-01-01T24:00:00Z", false, 0 },
+	{ NULL, "2023-01-01T00:60:00Z", false, 0 },
+	{ NULL, "2023-01-01T00:00:00Zjunk", false, 0 },
+	{ NULL, "2023-01-01T00:00:00+2", false, 0 },
+	{ NULL, "2023-01-01T00:00:00+0260", false, 0 },
+	{ NULL, "2023-01-01T00:00:00+02:00junk", false, 0 },
+	{ NULL, "2023-01-01T00:00:00?", false, 0 },
+};
+
+static void test_decode(void)
+{
+	const struct timestamp_case *c;
+	time_t t;
+	bool valid;
+	int n;
+
+	for (n = 0; n < G_N_ELEMENTS(cases); n++) {
+		c = &cases[n];
+
+		g_setenv("TZ", c->tz ? c->tz : "UTC0", TRUE);
+
+		t = 0;
+		valid = timestamp_decode_iso8601(c->str, &t);
+
+		if (valid != c->valid || (valid && t != c->expected))
+			g_error("'%s' (TZ %s): expected %s %lld, got %s %lld", c->str ? c->str : "(null)",
+					c->tz ? c->tz : "UTC", c->valid ? "valid" : "invalid", (long long) c->expected,
+					valid ? "valid" : "invalid", (long long) t);
+	}
+}
+
+/* A new timezone has to be picked up right away */
+static void test_timezone_change(void)
+{
+	time_t t;
+
+	g_setenv("TZ", TZ_NEPAL, TRUE);
+	g_assert(timestamp_decode_iso8601("2023-01-01T05:45:00", &t));
+	g_assert_cmpint(t, ==, 1672531200);
+
+	g_setenv("TZ", "UTC0", TRUE);
+	g_assert(timestamp_decode_iso8601("2023-01-01T05:45:00", &t));
+	g_assert_cmpint(t, ==, 1672551900);
+}
+
+/* The cached offset must not be used past a DST transition, in either
+ * direction and however far the next timestamp is away */
+static void test_cached_offset(void)
+{
+	static const struct {
+		const char *str;
+		gint64 expected;
+	} sequence[] = {
+		{ "2023-03-26T01:59:59", 1679792399 },
+		{ "2023-03-26T03:00:00", 1679792400 },
+		{ "2023-03-26T01:00:00", 1679788800 },
+		{ "2023-03-25T12:00:00", 1679742000 },
+		{ "2023-10-29T03:00:00", 1698544800 },
+		{ "2023-10-29T01:59:59", 1698537599 },
+		{ "2023-07-01T12:00:00", 1688205600 },
+		{ "2023-01-01T12:00:00", 1672570800 },
+		{ "2023-07-01T12:00:00", 1688205600 },
+	};
+	time_t t;
+	int n;
+
+	g_setenv("TZ", TZ_CET, TRUE);
+
+	for (n = 0; n < G_N_ELEMENTS(sequence); n++) {
+		g_assert(timestamp_decode_iso8601(sequence[n].str, &t));
+		if (t != sequence[n].expected)
+			g_error("'%s': expected %lld, got %lld", sequence[n].str,
+					(long long) sequence[n].expected, (long long) t);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/timestamp/decode", test_decode);
+	g_test_add_func("/timestamp/timezone-change", test_timezone_change);
+	g_test_add_func("/timestamp/cached-offset", test_cached_offset);
+
+	return g_test_run();
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,135 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/* Prints a flight recorder dump of webos-telephonyd in a readable form */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "flightrecorder.h"
+
+static const char *event_names[FLIGHT_EVENT_TYPE_MAX] = {
+	[FLIGHT_EVENT_NONE] = "none",
+	[FLIGHT_EVENT_LUNA_REQUEST] = "luna-request",
+	[FLIGHT_EVENT_DRIVER_CALL] = "driver-call",
+	[FLIGHT_EVENT_OFONO_REPLY] = "ofono-reply",
+	[FLIGHT_EVENT_PROPERTY_CHANGE] = "property-change",
+	[FLIGHT_EVENT_SUBSCRIPTION_POST] = "subscription-post",
+	[FLIGHT_EVENT_SMS_STATE] = "sms-state",
+};
+
+static const char *sms_state_names[] = {
+	[FLIGHT_SMS_STATE_SENDING] = "sending",
+	[FLIGHT_SMS_STATE_SUCCESSFUL] = "successful",
+	[FLIGHT_SMS_STATE_FAILED] = "failed",
+};
+
+static void print_record(const struct flight_recorder_header *header,
+						 const struct flight_recorder_record *record)
+{
+	char tag[FLIGHT_RECORDER_TAG_SIZE + 1];
+	char timestr[32];
+	int64_t realtime = (int64_t) record->timestamp + header->realtime_offset;
+	time_t seconds = realtime / 1000000;
+	struct tm tm;
+
+	memcpy(tag, record->tag, FLIGHT_RECORDER_TAG_SIZE);
+	tag[FLIGHT_RECORDER_TAG_SIZE] = '\0';
+
+	localtime_r(&seconds, &tm);
+	strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", &tm);
+
+	printf("%s.%06lld %-17s ", timestr, (long long) (realtime % 1000000),
+		   record->type < FLIGHT_EVENT_TYPE_MAX ? event_names[record->type] : "unknown");
+
+	if (record->type == FLIGHT_EVENT_SMS_STATE && record->code > 0 &&
+		record->code <= FLIGHT_SMS_STATE_FAILED)
+		printf("%-10s ", sms_state_names[record->code]);
+	else
+		printf("code=%-5u ", record->code);
+
+	printf("arg=%-10u %s\n", record->arg, tag);
+}
+
+int main(int argc, char **argv)
+{
+	struct flight_recorder_header header;
+	struct flight_recorder_record *records = NULL;
+	uint64_t first, index;
+	unsigned int skipped = 0;
+	FILE *file;
+	int result = 1;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <dump file>\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[1], "rb");
+	if (!file) {
+		fprintf(stderr, "Failed to open %s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != FLIGHT_RECORDER_MAGIC) {
+		fprintf(stderr, "%s is not a flight recorder dump\n", argv[1]);
+		goto cleanup;
+	}
+
+	if (header.record_size != sizeof(struct flight_recorder_record) || header.capacity == 0) {
+		fprintf(stderr, "%s has an unsupported record format\n", argv[1]);
+		goto cleanup;
+	}
+
+	records = calloc(header.capacity, sizeof(struct flight_recorder_record));
+	if (!records || fread(records, sizeof(struct flight_recorder_record), header.capacity, file) != header.capacity) {
+		fprintf(stderr, "%s is truncated\n", argv[1]);
+		goto cleanup;
+	}
+
+	first = header.head > header.capacity ? header.head - header.capacity : 0;
+
+	/* oldest event first */
+	for (index = first; index < header.head; index++) {
+		const struct flight_recorder_record *record = &records[index % header.capacity];
+
+		/* still being written or already overwritten when the dump was taken */
+		if (record->seq != (uint32_t) (index + 1)) {
+			skipped++;
+			continue;
+		}
+
+		print_record(&header, record);
+	}
+
+	if (skipped > 0)
+		fprintf(stderr, "Skipped %u incomplete records\n", skipped);
+
+	result = 0;
+
+cleanup:
+	free(records);
+	fclose(file);
+
+	return result;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,111 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "logging.h"
+
+/* Measures what logging a message costs the caller: through the asynchronous
+ * ring, written synchronously like before the ring existed and filtered out by
+ * its level. The log itself goes to stdout, so redirect that to where the
+ * daemon's output usually ends up; results are printed to stderr. */
+
+#define LOG_BENCH_TEXT	"[Telephony:SMS] Message object successfully updated for id %u"
+
+static gint64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run(const char *name, unsigned int count, bool filtered)
+{
+	struct logging_stats before, after;
+	gint64 start, elapsed, total = 0, max = 0;
+	unsigned int n;
+
+	logging_get_stats(&before);
+
+	for (n = 0; n < count; n++) {
+		start = now_ns();
+
+		if (filtered)
+			g_debug(LOG_BENCH_TEXT, n);
+		else
+			g_message(LOG_BENCH_TEXT, n);
+
+		elapsed = now_ns() - start;
+		total += elapsed;
+		if (elapsed > max)
+			max = elapsed;
+	}
+
+	logging_get_stats(&after);
+
+	fprintf(stderr, "%-10s %10.1f %10lld %10u\n", name, (double) total / count, (long long) max,
+			after.dropped - before.dropped);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n messages] > <log output>\n"
+			"  -n messages  messages to log per variant (default 100000)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int count = 100000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (count == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fprintf(stderr, "%-10s %10s %10s %10s\n", "variant", "avg ns", "max ns", "dropped");
+
+	logging_init(false);
+	run("async", count, false);
+	run("filtered", count, true);
+
+	/* the handler stays installed but writes synchronously without the ring */
+	logging_shutdown();
+	run("sync", count, false);
+
+	return 0;
+}
+
+// vim:ts=4:sw=4:noexpandtab
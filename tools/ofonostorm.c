@@ -0,0 +1,340 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "ofonoiothread.h"
+
+/* Floods the daemon side with PropertyChanged signals like ofono does during a
+ * modem reset and measures how late a timer on the main loop fires meanwhile,
+ * which is what a luna request would have to wait. The signals come from a fake
+ * ofono on a second thread over a peer to peer connection, so neither a bus nor
+ * ofono is needed. Each run is done once with the signals handled on the main
+ * loop and once through the ofono I/O thread. */
+
+#define STORM_PATH			"/storm_0"
+#define STORM_INTERFACE		"org.ofono.NetworkRegistration"
+/* every that many signals a Status transition is sent, which must not be
+ * coalesced */
+#define TRANSITION_EVERY	100
+#define PROBE_INTERVAL_MS	10
+/* time given to deliver what is still queued after the storm */
+#define DRAIN_MS			500
+
+struct storm {
+	int fd;
+	gchar *guid;
+	unsigned int rate;
+	unsigned int seconds;
+	gint started;
+	gint done;
+	unsigned int emitted;
+	unsigned int transitions;
+};
+
+struct results {
+	unsigned int changes;
+	unsigned int transitions;
+	unsigned int work_us;
+	gint64 last_probe;
+	gint64 lag_total;
+	gint64 lag_max;
+	unsigned int lag_samples;
+	gint64 drain_until;
+	GMainLoop *loop;
+	struct storm *storm;
+};
+
+static GDBusConnection* connect_end(int fd, const gchar *guid, GDBusConnectionFlags flags)
+{
+	GSocket *socket;
+	GSocketConnection *stream;
+	GDBusConnection *conn;
+	GError *error = NULL;
+
+	socket = g_socket_new_from_fd(fd, &error);
+	if (!socket) {
+		fprintf(stderr, "Failed to create socket: %s\n", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	stream = g_socket_connection_factory_create_connection(socket);
+	conn = g_dbus_connection_new_sync(G_IO_STREAM(stream), guid, flags, NULL, NULL, &error);
+
+	g_object_unref(stream);
+	g_object_unref(socket);
+
+	if (!conn) {
+		fprintf(stderr, "Failed to set up connection: %s\n", error->message);
+		g_error_free(error);
+	}
+
+	return conn;
+}
+
+static void emit_one(GDBusConnection *conn, struct storm *storm)
+{
+	GVariant *value;
+	const gchar *name;
+
+	if (storm->emitted % TRANSITION_EVERY == 0) {
+		name = "Status";
+		value = g_variant_new_string((storm->transitions % 2) ? "searching" : "registered");
+		storm->transitions++;
+	}
+	else if (storm->emitted % 10 == 0) {
+		name = "Name";
+		value = g_variant_new_string((storm->emitted % 20) ? "Operator A" : "Operator B");
+	}
+	else {
+		name = "Strength";
+		value = g_variant_new_byte(storm->emitted % 100);
+	}
+
+	g_dbus_connection_emit_signal(conn, NULL, STORM_PATH, STORM_INTERFACE, "PropertyChanged",
+								  g_variant_new("(sv)", name, value), NULL);
+	storm->emitted++;
+}
+
+/* fake ofono */
+static gpointer storm_func(gpointer user_data)
+{
+	struct storm *storm = user_data;
+	GDBusConnection *conn;
+	gint64 start, elapsed;
+	guint64 due;
+
+	conn = connect_end(storm->fd, storm->guid, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER);
+	if (!conn) {
+		g_atomic_int_set(&storm->done, 1);
+		return NULL;
+	}
+
+	while (!g_atomic_int_get(&storm->started))
+		g_usleep(1000);
+
+	start = g_get_monotonic_time();
+
+	while ((elapsed = g_get_monotonic_time() - start) < (gint64) storm->seconds * G_USEC_PER_SEC) {
+		due = (guint64) elapsed * storm->rate / G_USEC_PER_SEC;
+		while (storm->emitted < due)
+			emit_one(conn, storm);
+
+		g_usleep(1000);
+	}
+
+	g_dbus_connection_flush_sync(conn, NULL, NULL);
+	g_object_unref(conn);
+
+	g_atomic_int_set(&storm->done, 1);
+
+	return NULL;
+}
+
+/* stands in for the handlers doing something with the change */
+static void simulate_work(unsigned int us)
+{
+	gint64 until = g_get_monotonic_time() + us;
+
+	while (g_get_monotonic_time() < until)
+		;
+}
+
+static void count_change(struct results *results, const gchar *name)
+{
+	results->changes++;
+	if (g_str_equal(name, "Status"))
+		results->transitions++;
+
+	simulate_work(results->work_us);
+}
+
+static void io_property_changed_cb(const gchar *name, GVariant *value, void *data)
+{
+	count_change(data, name);
+}
+
+static void direct_signal_cb(GDBusConnection *conn, const gchar *sender, const gchar *path,
+							 const gchar *interface, const gchar *signal, GVariant *parameters,
+							 gpointer user_data)
+{
+	const gchar *name = NULL;
+
+	g_variant_get(parameters, "(&sv)", &name, NULL);
+	count_change(user_data, name);
+}
+
+static gboolean probe_cb(gpointer user_data)
+{
+	struct results *results = user_data;
+	gint64 now = g_get_monotonic_time();
+	gint64 lag;
+
+	lag = now - results->last_probe - PROBE_INTERVAL_MS * 1000;
+	if (lag < 0)
+		lag = 0;
+
+	results->last_probe = now;
+	results->lag_total += lag;
+	results->lag_samples++;
+	if (lag > results->lag_max)
+		results->lag_max = lag;
+
+	if (!g_atomic_int_get(&results->storm->done))
+		return TRUE;
+
+	if (!results->drain_until)
+		results->drain_until = now + DRAIN_MS * 1000;
+	else if (now >= results->drain_until)
+		g_main_loop_quit(results->loop);
+
+	return TRUE;
+}
+
+static bool run(const char *variant, bool io_thread, unsigned int rate, unsigned int seconds,
+				unsigned int work_us)
+{
+	struct storm storm;
+	struct results results;
+	struct ofono_io_watch *watch = NULL;
+	GDBusConnection *conn;
+	GThread *thread;
+	guint subscription = 0;
+	guint probe;
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		perror("socketpair");
+		return false;
+	}
+
+	memset(&storm, 0, sizeof(storm));
+	storm.fd = fds[0];
+	storm.guid = g_dbus_generate_guid();
+	storm.rate = rate;
+	storm.seconds = seconds;
+
+	memset(&results, 0, sizeof(results));
+	results.work_us = work_us;
+	results.storm = &storm;
+	results.loop = g_main_loop_new(NULL, FALSE);
+
+	thread = g_thread_new("storm", storm_func, &storm);
+
+	conn = connect_end(fds[1], NULL, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT);
+	if (!conn) {
+		g_atomic_int_set(&storm.started, 1);
+		g_thread_join(thread);
+		g_main_loop_unref(results.loop);
+		g_free(storm.guid);
+		return false;
+	}
+
+	if (io_thread) {
+		ofono_io_thread_start_with_connection(conn, NULL);
+		watch = ofono_io_thread_watch_properties(STORM_PATH, STORM_INTERFACE, io_property_changed_cb, &results);
+	}
+	else {
+		subscription = g_dbus_connection_signal_subscribe(conn, NULL, STORM_INTERFACE, "PropertyChanged",
+														  STORM_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+														  direct_signal_cb, &results, NULL);
+	}
+
+	results.last_probe = g_get_monotonic_time();
+	probe = g_timeout_add(PROBE_INTERVAL_MS, probe_cb, &results);
+
+	g_atomic_int_set(&storm.started, 1);
+	g_main_loop_run(results.loop);
+
+	g_source_remove(probe);
+	g_thread_join(thread);
+
+	if (io_thread) {
+		ofono_io_thread_unwatch(watch);
+		ofono_io_thread_stop();
+	}
+	else {
+		g_dbus_connection_signal_unsubscribe(conn, subscription);
+	}
+
+	printf("%-10s %10u %10u %8u/%-8u %10.2f %10.2f\n", variant, storm.emitted, results.changes,
+		   results.transitions, storm.transitions,
+		   results.lag_samples ? (double) results.lag_total / results.lag_samples / 1000 : 0.0,
+		   (double) results.lag_max / 1000);
+
+	g_object_unref(conn);
+	g_main_loop_unref(results.loop);
+	g_free(storm.guid);
+
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-r rate] [-t seconds] [-w microseconds]\n"
+			"  -r rate          signals per second (default 10000)\n"
+			"  -t seconds       duration of each run (default 5)\n"
+			"  -w microseconds  work per delivered change (default 20)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int rate = 10000, seconds = 5, work_us = 20;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:t:w:")) != -1) {
+		switch (opt) {
+		case 'r':
+			rate = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			work_us = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (rate == 0 || seconds == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%-10s %10s %10s %17s %10s %10s\n", "variant", "emitted", "delivered",
+		   "transitions", "avg lag ms", "max lag ms");
+
+	if (!run("direct", false, rate, seconds, work_us) ||
+		!run("io-thread", true, rate, seconds, work_us))
+		return 1;
+
+	return 0;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,277 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "startuptimeline.h"
+
+/* Starts the daemon over and over again and reports how long it took each
+ * phase of the startup timeline to be reached. The daemon has to find a modem
+ * which registers to a network (e.g. ofono with phonesim); anything which has
+ * to be reset between two runs belongs into a wrapper script used as command. */
+
+#define MAX_PHASES			16
+#define PHASE_NAME_SIZE		32
+#define LINE_SIZE			4096
+
+struct phase_samples {
+	char name[PHASE_NAME_SIZE];
+	long long *values;
+	unsigned int count;
+};
+
+static struct phase_samples phases[MAX_PHASES];
+static unsigned int phase_count = 0;
+
+static struct phase_samples* find_phase(const char *name)
+{
+	unsigned int n;
+
+	for (n = 0; n < phase_count; n++) {
+		if (strcmp(phases[n].name, name) == 0)
+			return &phases[n];
+	}
+
+	if (phase_count == MAX_PHASES)
+		return NULL;
+
+	snprintf(phases[phase_count].name, PHASE_NAME_SIZE, "%s", name);
+
+	return &phases[phase_count++];
+}
+
+/* Takes the "<phase>=<us>" pairs following the log prefix */
+static void add_timeline(const char *timeline, unsigned int runs)
+{
+	char name[PHASE_NAME_SIZE];
+	struct phase_samples *samples;
+	long long value;
+	int consumed;
+
+	while (sscanf(timeline, " %31[^=]=%n", name, &consumed) == 1) {
+		timeline += consumed;
+
+		if (sscanf(timeline, "%lld%n", &value, &consumed) == 1) {
+			timeline += consumed;
+
+			samples = find_phase(name);
+			if (samples) {
+				if (!samples->values)
+					samples->values = calloc(runs, sizeof(long long));
+				samples->values[samples->count++] = value;
+			}
+		}
+		else {
+			/* phase not reached */
+			timeline += strcspn(timeline, " ");
+		}
+	}
+}
+
+static int compare_values(const void *a, const void *b)
+{
+	long long va = *(const long long*) a, vb = *(const long long*) b;
+
+	return (va > vb) - (va < vb);
+}
+
+/* nearest rank of a sorted set of samples */
+static double percentile(const struct phase_samples *samples, unsigned int p)
+{
+	unsigned int rank = (p * samples->count + 99) / 100;
+
+	return samples->values[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+static long long elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000LL + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/* Runs the command on a pseudo terminal so it doesn't buffer its log output
+ * and waits for the timeline to show up */
+static int run_once(char **command, unsigned int timeout, unsigned int runs)
+{
+	char line[LINE_SIZE];
+	size_t length = 0;
+	struct timespec start;
+	struct pollfd pfd;
+	const char *timeline;
+	char *newline;
+	ssize_t count;
+	long long remaining;
+	int master, slave;
+	int result = -1;
+	pid_t pid;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		fprintf(stderr, "Failed to allocate a pseudo terminal: %s\n", strerror(errno));
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "Failed to fork: %s\n", strerror(errno));
+		close(master);
+		return -1;
+	}
+
+	if (pid == 0) {
+		slave = open(ptsname(master), O_RDWR);
+		if (slave < 0)
+			_exit(127);
+
+		close(master);
+		dup2(slave, STDOUT_FILENO);
+		dup2(slave, STDERR_FILENO);
+		close(slave);
+
+		execvp(command[0], command);
+		_exit(127);
+	}
+
+	pfd.fd = master;
+	pfd.events = POLLIN;
+
+	while ((remaining = timeout * 1000LL - elapsed_ms(&start)) > 0) {
+		if (poll(&pfd, 1, remaining) <= 0)
+			break;
+
+		count = read(master, line + length, sizeof(line) - 1 - length);
+		if (count <= 0)
+			break;
+
+		length += count;
+		line[length] = '\0';
+
+		while ((newline = strchr(line, '\n')) != NULL) {
+			*newline = '\0';
+
+			timeline = strstr(line, STARTUP_TIMELINE_LOG_PREFIX);
+			if (timeline) {
+				add_timeline(timeline + strlen(STARTUP_TIMELINE_LOG_PREFIX), runs);
+				result = 0;
+				goto done;
+			}
+
+			length -= newline + 1 - line;
+			memmove(line, newline + 1, length + 1);
+		}
+
+		/* a single line longer than the buffer isn't what we're looking for */
+		if (length == sizeof(line) - 1)
+			length = 0;
+	}
+
+	fprintf(stderr, "No startup timeline within %u seconds\n", timeout);
+
+done:
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	close(master);
+
+	return result;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-r runs] [-t timeout] [-p pause] -- <command> [args...]\n"
+			"  -r runs     number of cold starts (default 20)\n"
+			"  -t timeout  seconds to wait for the service to become ready (default 60)\n"
+			"  -p pause    seconds to wait between two runs (default 1)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int runs = 20, timeout = 60, pause = 1;
+	unsigned int n, completed = 0;
+	struct phase_samples *samples;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:t:p:")) != -1) {
+		switch (opt) {
+		case 'r':
+			runs = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			timeout = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			pause = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc || runs == 0 || timeout == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (n = 0; n < runs; n++) {
+		if (run_once(&argv[optind], timeout, runs) == 0)
+			completed++;
+
+		fprintf(stderr, "Run %u of %u done\n", n + 1, runs);
+
+		if (pause > 0 && n + 1 < runs)
+			sleep(pause);
+	}
+
+	printf("%u of %u runs became ready\n", completed, runs);
+	printf("%-20s %6s %10s %10s %10s %10s %10s\n", "phase (ms)", "count", "min", "p50", "p90", "p99", "max");
+
+	for (n = 0; n < phase_count; n++) {
+		samples = &phases[n];
+		if (samples->count == 0)
+			continue;
+
+		qsort(samples->values, samples->count, sizeof(long long), compare_values);
+
+		printf("%-20s %6u %10.1f %10.1f %10.1f %10.1f %10.1f\n", samples->name, samples->count,
+			   samples->values[0] / 1000.0, percentile(samples, 50), percentile(samples, 90),
+			   percentile(samples, 99), samples->values[samples->count - 1] / 1000.0);
+
+		free(samples->values);
+	}
+
+	return completed == runs ? 0 : 1;
+}
+
+// vim:ts=4:sw=4:noexpandtab
@@ -0,0 +1,118 @@
+/* @@@LICENSE
+*
+* Copyright (c) 2012 Simon Busch <morphis@gravedo.de>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timestamp.h"
+
+/* Measures how long decoding a SMS timestamp takes for the formats ofono sends
+ * and compares it with decoding through sscanf and timegm */
+
+static const char *inputs[] = {
+	"2012-06-15T12:30:00Z",
+	"2012-06-15T12:30:00+0200",
+	"2012-06-15T12:30:00-03:30",
+	"2012-06-15T12:30:00",
+};
+
+static volatile time_t sink;
+
+static time_t decode_with_libc(const char *str)
+{
+	struct tm tm;
+	int offset_hour = 0, offset_min = 0;
+	char sign = '+';
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(str, "%d-%d-%dT%d:%d:%d%c%2d%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+			   &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &sign, &offset_hour, &offset_min) < 6)
+		return -1;
+
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+
+	return timegm(&tm) - (sign == '-' ? -1 : 1) * (offset_hour * 3600 + offset_min * 60);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n iterations]\n"
+			"  -n iterations  decodes per input and variant (default 1000000)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 1000000, n;
+	unsigned int input;
+	double start, parser_ns, libc_ns;
+	time_t t;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (iterations == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%-28s %12s %12s\n", "input", "parser ns", "libc ns");
+
+	for (input = 0; input < sizeof(inputs) / sizeof(inputs[0]); input++) {
+		start = now_ns();
+		for (n = 0; n < iterations; n++) {
+			timestamp_decode_iso8601(inputs[input], &t);
+			sink = t;
+		}
+		parser_ns = (now_ns() - start) / iterations;
+
+		start = now_ns();
+		for (n = 0; n < iterations; n++)
+			sink = decode_with_libc(inputs[input]);
+		libc_ns = (now_ns() - start) / iterations;
+
+		printf("%-28s %12.1f %12.1f\n", inputs[input], parser_ns, libc_ns);
+	}
+
+	return 0;
+}
+
+// vim:ts=4:sw=4:noexpandtab